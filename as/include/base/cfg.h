@@ -66,8 +66,18 @@ struct as_namespace_s;
 
 #define MAX_DEMARSHAL_THREADS 256
 #define MAX_BATCH_THREADS 256
+#define MAX_INDEX_REDUCE_THREADS 128
+#define MAX_INDEX_TREE_GC_THREADS 32
+#define MAX_PROTO_PIPELINE 4096
+#define MIN_PROTO_RECV_BUF_SZ 512
+#define MAX_PROTO_RECV_BUF_SZ (1024 * 1024)
 #define MAX_TLS_SPECS 10
 
+typedef enum {
+	AS_PROTO_IO_ENGINE_EPOLL	= 0, // epoll readiness, then recv()
+	AS_PROTO_IO_ENGINE_IO_URING	= 1  // recv() completions via io_uring
+} as_proto_io_engine;
+
 // Declare bools with PAD_BOOL so they can't share a 4-byte space with other
 // bools, chars or shorts. This prevents adjacent bools set concurrently in
 // different threads (albeit very unlikely) from interfering with each other.
@@ -112,6 +122,9 @@ typedef struct as_config_s {
 	uint32_t		hist_track_back; // total time span in seconds over which to cache data
 	uint32_t		hist_track_slice; // period in seconds at which to cache histogram data
 	char*			hist_track_thresholds; // comma-separated bucket (ms) values to track
+	uint32_t		n_index_reduce_threads; // helpers for reduces that opt in to parallelism
+	uint32_t		index_tree_gc_max_rate; // max dropped tree elements destroyed per second while clients are active, 0 means no limit
+	uint32_t		n_index_tree_gc_threads; // all but one work only while clients are idle
 	int				n_info_threads;
 	// Note - log-local-time affects a cf_fault.c global, so can't be here.
 	uint32_t		migrate_max_num_incoming;
@@ -121,6 +134,9 @@ typedef struct as_config_s {
 	uint32_t		nsup_period;
 	PAD_BOOL		nsup_startup_evict;
 	int				proto_fd_idle_ms; // after this many milliseconds, connections are aborted unless transaction is in progress
+	as_proto_io_engine proto_io_engine; // how demarshal reads client (non-TLS) connections
+	uint32_t		proto_pipeline_max; // max pipelined requests in progress per connection, 0 means no pipelining
+	uint32_t		proto_recv_buf_sz; // per-connection receive buffer, requests are parsed out of it
 	int				proto_slow_netio_sleep_ms; // dynamic only
 	uint32_t		query_bsize;
 	uint64_t		query_buf_size; // dynamic only
@@ -0,0 +1,108 @@
+/*
+ * compression_dict.h
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "citrusleaf/cf_atomic.h"
+
+
+//==========================================================
+// Forward declarations.
+//
+
+struct as_namespace_s;
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Dictionary ids are stamped in device blocks - 0 means no dictionary.
+#define MAX_COMPRESSION_DICTS 1024
+
+// Small records only benefit from the start of a dictionary, and zlib hashes
+// the whole dictionary into every stream, so keep them short.
+#define MAX_COMPRESSION_DICT_SIZE (8 * 1024)
+
+typedef struct as_compression_dict_s {
+	struct as_compression_dict_s* next; // for retired list
+	uint16_t id;
+	uint16_t set_id;
+	uint32_t adler; // zlib's id for the dictionary, verified on inflate
+	uint32_t size;
+	uint8_t data[];
+} as_compression_dict;
+
+typedef struct as_compression_dicts_s {
+	pthread_mutex_t lock; // serializes loading, training and retiring
+
+	// Indexed by id - NULL if never loaded, or retired.
+	as_compression_dict* volatile dicts[MAX_COMPRESSION_DICTS];
+	uint32_t max_id;
+
+	// Superseded dictionaries not referenced on device at the last census.
+	uint64_t retire_candidates[MAX_COMPRESSION_DICTS / 64];
+
+	// Retired at the last census - freed at the next.
+	as_compression_dict* retired;
+
+	cf_atomic32 training;
+	uint32_t n_dicts;
+	uint32_t n_retired;
+} as_compression_dicts;
+
+
+//==========================================================
+// Public API.
+//
+
+void as_compression_dict_init(struct as_namespace_s* ns);
+void as_compression_dict_init_smd();
+bool as_compression_dict_train_cmd(const char* ns_name, const char* set_name);
+void as_compression_dict_census(struct as_namespace_s* ns, uint64_t ref_mask);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+// Bit (in a 64-bit mask) standing for all dictionaries with ids congruent to
+// this one - used to track which dictionaries a wblock may reference.
+static inline uint64_t
+as_compression_dict_ref_bit(uint16_t id)
+{
+	return 1UL << (id & 63);
+}
+
+static inline const as_compression_dict*
+as_compression_dict_get(as_compression_dicts* cd, uint16_t id)
+{
+	return id < MAX_COMPRESSION_DICTS ? cd->dicts[id] : NULL;
+}
@@ -49,6 +49,7 @@
 #include "vmapx.h"
 
 #include "base/cfg.h"
+#include "base/compression_dict.h"
 #include "base/proto.h"
 #include "base/rec_props.h"
 #include "base/transaction_policy.h"
@@ -60,6 +61,7 @@
 
 #define AS_STORAGE_MAX_DEVICES (64) // maximum devices per namespace
 #define AS_STORAGE_MAX_FILES (64) // maximum files per namespace
+#define AS_STORAGE_MAX_TTL_BUCKETS (8) // maximum TTL classes written to separate wblocks
 #define AS_STORAGE_MAX_DEVICE_SIZE (2L * 1024L * 1024L * 1024L * 1024L) // 2Tb, due to rblock_id in as_index
 
 #define OBJ_SIZE_HIST_NUM_BUCKETS 100
@@ -458,7 +460,7 @@ extern int as_record_get(struct as_index_tree_s *tree, cf_digest *keyd, as_index
 extern int as_record_get_live(struct as_index_tree_s *tree, cf_digest *keyd, as_index_ref *r_ref, as_namespace *ns);
 extern int as_record_exists(struct as_index_tree_s *tree, cf_digest *keyd);
 extern int as_record_exists_live(struct as_index_tree_s *tree, cf_digest *keyd, as_namespace *ns);
-extern void as_record_rescue(as_index_ref *r_ref, as_namespace *ns);
+extern void as_record_rescue(struct as_index_tree_s *tree, as_index_ref *r_ref, as_namespace *ns);
 
 extern void as_record_destroy_bins_from(as_storage_rd *rd, uint16_t from);
 extern void as_record_destroy_bins(as_storage_rd *rd);
@@ -544,6 +546,19 @@ struct as_sindex_config_s;
 // Callback invoked when as_index is destroyed.
 typedef void (*as_index_value_destructor) (struct as_index_s* v, void* udata);
 
+// Partition tree sprig structure, and arena stage page size.
+typedef enum {
+	AS_INDEX_TREE_RED_BLACK,
+	AS_INDEX_TREE_BTREE,
+	AS_INDEX_TREE_HASH
+} as_index_tree_type;
+
+typedef enum {
+	AS_INDEX_HUGE_PAGES_NONE,
+	AS_INDEX_HUGE_PAGES_2M,
+	AS_INDEX_HUGE_PAGES_1G
+} as_index_huge_pages;
+
 // TODO - would be nice to put this in as_index.h:
 typedef struct as_index_tree_shared_s {
 	as_index_value_destructor destructor;
@@ -559,6 +574,16 @@ typedef struct as_index_tree_shared_s {
 
 	// Offset into as_index_tree struct's variable-sized data.
 	uint32_t		sprigs_offset;
+
+	// Structure of each sprig.
+	as_index_tree_type type;
+
+	// Set indexes - offset into variable-sized data, and number of sets.
+	uint32_t		set_sprigs_offset;
+	uint32_t		n_set_sprigs;
+
+	// By set-ID, 1-based set index sprig - 0 means set isn't indexed.
+	uint16_t		set_sprig_ids[AS_SET_MAX_COUNT + 1];
 } as_index_tree_shared;
 
 
@@ -609,7 +634,7 @@ struct as_namespace_s {
 
 	// For cold start eviction.
 	pthread_mutex_t	cold_start_evict_lock;
-	uint32_t		cold_start_record_add_count;
+	cf_atomic32		cold_start_record_add_count;
 	cf_atomic32		cold_start_threshold_void_time;
 	uint32_t		cold_start_max_void_time;
 
@@ -644,6 +669,31 @@ struct as_namespace_s {
 	cf_atomic32		n_reads_from_cache;
 	cf_atomic32		n_reads_from_device;
 
+	// For data-not-in-memory, we optionally cache hot records after reading:
+	cf_atomic32		n_read_cache_hits;
+	cf_atomic32		n_read_cache_misses;
+
+	// For storage compression - bytes are per ticker interval, times are total:
+	cf_atomic64		n_compression_orig_bytes;
+	cf_atomic64		n_compression_bytes;
+	cf_atomic64		n_compression_ns;
+	cf_atomic64		n_decompression_ns;
+
+	// For TTL-bucketed writes - per bucket, wblocks filled by writes, and of
+	// those, how many were emptied in place or had to be defragged:
+	cf_atomic64		n_ttl_bucket_wblocks[AS_STORAGE_MAX_TTL_BUCKETS];
+	cf_atomic64		n_ttl_bucket_wblocks_emptied[AS_STORAGE_MAX_TTL_BUCKETS];
+	cf_atomic64		n_ttl_bucket_wblocks_defragged[AS_STORAGE_MAX_TTL_BUCKETS];
+
+	// To track write amplification - bytes are per ticker interval:
+	cf_atomic64		n_device_write_bytes; // by transactions, migrations, etc.
+	cf_atomic64		n_defrag_write_bytes;
+
+	// For the device I/O scheduler - per class, background reads made to wait,
+	// and total time waited:
+	cf_atomic64		n_io_sched_waits[AS_STORAGE_N_IO_CLASSES];
+	cf_atomic64		n_io_sched_wait_us[AS_STORAGE_N_IO_CLASSES];
+
 	uint8_t			storage_encryption_key[32];
 
 	//--------------------------------------------
@@ -652,6 +702,12 @@ struct as_namespace_s {
 
 	as_truncate		truncate;
 
+	//--------------------------------------------
+	// Trained storage compression dictionaries.
+	//
+
+	as_compression_dicts compression_dicts;
+
 	//--------------------------------------------
 	// Secondary index.
 	//
@@ -693,6 +749,9 @@ struct as_namespace_s {
 	uint32_t		evict_tenths_pct;
 	uint32_t		hwm_disk_pct;
 	uint32_t		hwm_memory_pct;
+	uint32_t		index_defrag_lwm_pct;
+	as_index_huge_pages index_huge_pages;
+	PAD_BOOL		index_numa_interleave;
 	uint64_t		max_ttl;
 	uint32_t		migrate_order;
 	uint32_t		migrate_retransmit_ms;
@@ -718,7 +777,11 @@ struct as_namespace_s {
 	PAD_BOOL		storage_data_in_memory;
 
 	PAD_BOOL		storage_cold_start_empty;
+	as_compression_method storage_compression;
+	uint32_t		storage_compression_level; // 0 means codec's default
+	uint32_t		storage_compression_min_size; // don't try compressing smaller records
 	uint32_t		storage_defrag_lwm_pct;
+	as_storage_defrag_policy storage_defrag_policy;
 	uint32_t		storage_defrag_queue_min;
 	uint32_t		storage_defrag_sleep;
 	int				storage_defrag_startup_minimum;
@@ -728,11 +791,18 @@ struct as_namespace_s {
 	char*			storage_encryption_key_file;
 	uint64_t		storage_flush_max_us;
 	uint64_t		storage_fsync_max_us;
+	char*			storage_index_checkpoint_file; // null means no checkpoints
+	uint32_t		storage_index_checkpoint_period; // seconds - 0 means only at shutdown
+	uint32_t		storage_io_sched_target_us; // client read latency background reads yield to - 0 means don't schedule
 	uint64_t		storage_max_write_cache;
 	uint32_t		storage_min_avail_pct;
 	cf_atomic32 	storage_post_write_queue; // number of swbs/device held after writing to device
+	uint64_t		storage_read_cache_size; // bytes of hot records cached after reading - 0 means none
+	as_storage_read_engine storage_read_engine;
 	uint32_t		storage_tomb_raider_sleep; // relevant only for enterprise edition
+	uint32_t		storage_write_stripes; // concurrently filled swbs per device
 	uint32_t		storage_write_threads;
+	uint32_t		storage_write_ttl_buckets; // TTL classes written to separate swbs - 1 means don't separate
 
 	uint32_t		sindex_num_partitions;
 
@@ -767,6 +837,11 @@ struct as_namespace_s {
 	uint32_t		nsup_cycle_duration; // seconds taken for most recent nsup cycle
 	uint32_t		nsup_cycle_sleep_pct; // fraction of most recent nsup cycle that was spent sleeping
 
+	// Index arena defrag stats.
+
+	cf_atomic64		n_index_defrag_moves;
+	cf_atomic64		n_index_defrag_stages_released;
+
 	// Memory usage stats.
 
 	cf_atomic_int	n_bytes_memory;
@@ -775,6 +850,9 @@ struct as_namespace_s {
 	// Persistent storage stats.
 
 	float			cache_read_pct;
+	float			read_cache_hit_pct;
+	float			compression_pct; // compressed size as % of original
+	float			write_amp; // total bytes written per byte not rewritten by defrag
 
 	// Migration stats.
 
@@ -1046,7 +1124,9 @@ struct as_set_s {
 	cf_atomic32		disable_eviction;	// don't evict anything in this set (note - expiration still works)
 	cf_atomic32		enable_xdr;			// white-list (AS_SET_ENABLE_XDR_TRUE) or black-list (AS_SET_ENABLE_XDR_FALSE) a set for XDR replication
 	uint32_t		n_sindexes;
-	uint8_t padding[12];
+	cf_atomic32		compression_dict_id; // dictionary (if any) new writes use - 0 means none
+	uint8_t			enable_index;		// keep a per-partition index of the set's records - configured only at startup
+	uint8_t padding[7];
 };
 
 static inline bool
@@ -264,10 +264,18 @@ typedef struct as_lock_pair_s {
 	// Note: reduce_lock's scope is always inside of lock's scope.
 	cf_mutex lock;        // insert, delete vs. insert, delete, get
 	cf_mutex reduce_lock; // insert, delete vs. reduce
+
+	// Odd while an insert or delete is restructuring one of this pair's
+	// sprigs - lets gets search without the lock, and detect interference.
+	cf_atomic32 seq;
 } as_lock_pair;
 
 typedef struct as_sprig_s {
-	cf_arenax_handle	root_h;
+	union {
+		cf_arenax_handle				root_h; // red-black
+		struct as_index_btree_node_s	*broot; // btree
+		struct as_index_hash_s			*htable; // hash
+	};
 	uint64_t			n_elements;
 } as_sprig;
 
@@ -283,6 +291,27 @@ tree_sprigs(as_index_tree *tree)
 	return (as_sprig*)(tree->data + tree->shared->sprigs_offset);
 }
 
+// Set indexes - one lock pair for all of them, then a btree sprig per indexed
+// set, mapping the set's digests to the same elements as the main sprigs.
+static inline as_lock_pair *
+tree_set_locks(as_index_tree *tree)
+{
+	return (as_lock_pair*)(tree->data + tree->shared->set_sprigs_offset);
+}
+
+static inline as_sprig *
+tree_set_sprigs(as_index_tree *tree)
+{
+	return (as_sprig*)(tree->data + tree->shared->set_sprigs_offset +
+			sizeof(as_lock_pair));
+}
+
+static inline bool
+as_index_tree_has_set_index(const as_index_tree *tree, uint16_t set_id)
+{
+	return tree->shared->set_sprig_ids[set_id] != 0;
+}
+
 
 //------------------------------------------------
 // as_index_tree public API.
@@ -290,25 +319,47 @@ tree_sprigs(as_index_tree *tree)
 
 void as_index_tree_gc_init();
 int as_index_tree_gc_queue_size();
+uint32_t as_index_tree_gc_active();
+uint64_t as_index_tree_gc_pending();
 
 as_index_tree *as_index_tree_create(as_index_tree_shared *shared, cf_arenax *arena);
 as_index_tree *as_index_tree_resume(as_index_tree_shared *shared, cf_arenax *arena, as_treex *treex);
 void as_index_tree_shutdown(as_index_tree *tree, as_treex *treex);
 int as_index_tree_release(as_index_tree *tree);
 uint64_t as_index_tree_size(as_index_tree *tree);
+uint64_t as_index_tree_set_size(as_index_tree *tree, uint16_t set_id);
 
 typedef void (*as_index_reduce_fn) (as_index_ref *value, void *udata);
 
 void as_index_reduce(as_index_tree *tree, as_index_reduce_fn cb, void *udata);
 void as_index_reduce_partial(as_index_tree *tree, uint64_t sample_count, as_index_reduce_fn cb, void *udata);
+void as_index_reduce_from(as_index_tree *tree, const cf_digest *keyd, as_index_reduce_fn cb, void *udata);
 
 void as_index_reduce_live(as_index_tree *tree, as_index_reduce_fn cb, void *udata);
 void as_index_reduce_partial_live(as_index_tree *tree, uint64_t sample_count, as_index_reduce_fn cb, void *udata);
+void as_index_reduce_from_live(as_index_tree *tree, const cf_digest *keyd, as_index_reduce_fn cb, void *udata);
+
+void as_index_reduce_init();
+void as_index_reduce_parallel(as_index_tree *tree, as_index_reduce_fn cb, void *udata);
+void as_index_reduce_parallel_live(as_index_tree *tree, as_index_reduce_fn cb, void *udata);
+
+// Reduce only a set's elements - these return false if the set isn't indexed.
+bool as_index_reduce_set(as_index_tree *tree, uint16_t set_id, as_index_reduce_fn cb, void *udata);
+bool as_index_reduce_set_partial(as_index_tree *tree, uint16_t set_id, uint64_t sample_count, as_index_reduce_fn cb, void *udata);
+bool as_index_reduce_set_from(as_index_tree *tree, uint16_t set_id, const cf_digest *keyd, as_index_reduce_fn cb, void *udata);
+
+bool as_index_reduce_set_live(as_index_tree *tree, uint16_t set_id, as_index_reduce_fn cb, void *udata);
+bool as_index_reduce_set_partial_live(as_index_tree *tree, uint16_t set_id, uint64_t sample_count, as_index_reduce_fn cb, void *udata);
+bool as_index_reduce_set_from_live(as_index_tree *tree, uint16_t set_id, const cf_digest *keyd, as_index_reduce_fn cb, void *udata);
 
 int as_index_exists(as_index_tree *tree, cf_digest *keyd);
 int as_index_get_vlock(as_index_tree *tree, cf_digest *keyd, as_index_ref *index_ref);
+void as_index_prefetch_multi(as_index_tree *trees[], cf_digest *keyds[], uint32_t n_keys);
 int as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd, as_index_ref *index_ref);
 int as_index_delete(as_index_tree *tree, cf_digest *keyd);
+int as_index_relocate(as_index_tree *tree, cf_arenax_handle r_h);
+void as_index_set_index_insert(as_index_tree *tree, as_index_ref *r_ref);
+void as_index_set_index_delete(as_index_tree *tree, as_index *r);
 
 #define as_index_reserve(_r) cf_atomic32_incr(&(_r->rc))
 #define as_index_release(_r) cf_atomic32_decr(&(_r->rc))
@@ -324,9 +375,12 @@ typedef struct as_index_sprig_s {
 	void			*destructor_udata;
 
 	cf_arenax		*arena;
+	as_index_tree_type type;
 
 	as_lock_pair	*pair;
 	as_sprig		*sprig;
+
+	as_index_tree	*tree; // for set index upkeep
 } as_index_sprig;
 
 #define SENTINEL_H 0
@@ -0,0 +1,66 @@
+/*
+ * index_btree.h
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+
+#include "base/index.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Return false to stop a traversal.
+typedef bool (*as_index_btree_visit_fn)(cf_arenax_handle r_h, void *udata);
+
+
+//==========================================================
+// Public API.
+//
+
+// B+tree sprig structure, for partition-tree-type btree. Leaves map digests to
+// arena handles of as_index elements - callers lock as for red-black sprigs.
+
+int as_index_btree_search(const as_sprig *sprig, const cf_digest *keyd, cf_arenax_handle *ret_h);
+cf_arenax_handle *as_index_btree_find(as_sprig *sprig, const cf_digest *keyd);
+void as_index_btree_insert(as_sprig *sprig, const cf_digest *keyd, cf_arenax_handle r_h);
+int as_index_btree_delete(as_sprig *sprig, const cf_digest *keyd, cf_arenax_handle *ret_h);
+
+// Visits in descending digest order, same as red-black sprig traversal.
+void as_index_btree_traverse(const as_sprig *sprig, as_index_btree_visit_fn cb, void *udata);
+
+// Visits only digests smaller than keyd (which needn't be in the sprig).
+void as_index_btree_traverse_from(const as_sprig *sprig, const cf_digest *keyd, as_index_btree_visit_fn cb, void *udata);
+
+// Visits everything (unless cb is NULL) and frees all nodes, leaving the sprig
+// empty.
+void as_index_btree_purge(as_sprig *sprig, as_index_btree_visit_fn cb, void *udata);
@@ -0,0 +1,68 @@
+/*
+ * index_hash.h
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+
+#include "base/index.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Return false to stop a traversal.
+typedef bool (*as_index_hash_visit_fn)(cf_arenax_handle r_h, void *udata);
+
+
+//==========================================================
+// Public API.
+//
+
+// Hash table sprig structure, for partition-tree-type hash. Slots map digests
+// to arena handles of as_index elements - callers lock as for red-black sprigs.
+// Full digests live only in the elements, so lookups need the arena.
+
+int as_index_hash_search(const as_sprig *sprig, cf_arenax *arena, const cf_digest *keyd, cf_arenax_handle *ret_h);
+int as_index_hash_replace(as_sprig *sprig, const cf_digest *keyd, cf_arenax_handle old_h, cf_arenax_handle new_h);
+void as_index_hash_insert(as_sprig *sprig, const cf_digest *keyd, cf_arenax_handle r_h);
+int as_index_hash_delete(as_sprig *sprig, cf_arenax *arena, const cf_digest *keyd, cf_arenax_handle *ret_h);
+
+// Visits in descending digest order, same as red-black sprig traversal - sorts,
+// so not cheap.
+void as_index_hash_traverse(const as_sprig *sprig, cf_arenax *arena, as_index_hash_visit_fn cb, void *udata);
+
+// Visits only digests smaller than keyd (which needn't be in the sprig).
+void as_index_hash_traverse_from(const as_sprig *sprig, cf_arenax *arena, const cf_digest *keyd, as_index_hash_visit_fn cb, void *udata);
+
+// Visits everything (unless cb is NULL), in no particular order, and frees the
+// table, leaving the sprig empty.
+void as_index_hash_purge(as_sprig *sprig, as_index_hash_visit_fn cb, void *udata);
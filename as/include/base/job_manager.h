@@ -108,6 +108,7 @@ typedef struct as_job_s {
 
 	// Which partitions to reduce:
 	as_job_rsv_type				rsv_type;
+	bool*						pids; // NULL means all - freed with job
 
 	// Unique identifier:
 	uint64_t					trid;
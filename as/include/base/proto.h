@@ -190,6 +190,8 @@ typedef struct as_msg_field_s {
 #define AS_MSG_FIELD_TYPE_TRID					7
 #define AS_MSG_FIELD_TYPE_SCAN_OPTIONS			8
 #define AS_MSG_FIELD_TYPE_SOCKET_TIMEOUT		9
+#define AS_MSG_FIELD_TYPE_PID_ARRAY				11
+#define AS_MSG_FIELD_TYPE_DIGEST_ARRAY			12
 
 #define AS_MSG_FIELD_TYPE_INDEX_NAME			21
 #define	AS_MSG_FIELD_TYPE_INDEX_RANGE			22
@@ -233,6 +235,8 @@ typedef struct as_msg_field_s {
 #define AS_MSG_FIELD_BIT_BATCH				0x00010000
 #define AS_MSG_FIELD_BIT_BATCH_WITH_SET		0x00020000
 #define AS_MSG_FIELD_BIT_PREDEXP			0x00040000
+#define AS_MSG_FIELD_BIT_PID_ARRAY			0x00080000
+#define AS_MSG_FIELD_BIT_DIGEST_ARRAY		0x00100000
 
 // as_msg ops
 
@@ -354,9 +358,10 @@ typedef struct cl_msg_s {
 #define AS_MSG_INFO3_UPDATE_ONLY		(1 << 3) // update existing record only, do not create new record
 #define AS_MSG_INFO3_CREATE_OR_REPLACE	(1 << 4) // completely replace existing record, or create new record
 #define AS_MSG_INFO3_REPLACE_ONLY		(1 << 5) // completely replace existing record, do not create new record
-// (Note:  Bit 6 is unused.)
-// (Note:  Bit 7 is unused.)
+#define AS_MSG_INFO3_PARTITION_DONE		(1 << 6) // scan response marks a partition done - generation is the partition-ID
+#define AS_MSG_INFO3_PIPELINE			(1 << 7) // single-record request may be answered out of order - matched by its TRID field
 
+#define AS_MSG_FIELD_SCAN_DEVICE_ORDER				(0x01) // sweep devices sequentially - results not grouped by partition
 #define AS_MSG_FIELD_SCAN_UNUSED_2					(0x02) // was - whether to send ldt bin data back to the client
 #define AS_MSG_FIELD_SCAN_DISCONNECTED_JOB			(0x04) // for sproc jobs that won't be sending results back to the client [UNUSED]
 #define AS_MSG_FIELD_SCAN_FAIL_ON_CLUSTER_CHANGE	(0x08) // if we should fail when cluster is migrating or cluster changes
@@ -492,12 +497,16 @@ cl_msg *as_msg_make_val_response(bool success, const as_val *val,
 		uint64_t trid, size_t *p_msg_sz);
 void as_msg_make_val_response_bufbuilder(const as_val *val,
 		cf_buf_builder **bb_r, uint32_t val_sz, bool);
+void as_msg_make_partition_done_bufbuilder(cf_buf_builder **bb_r,
+		uint32_t pid, const cf_digest *keyd);
 
 int as_msg_send_reply(struct as_file_handle_s *fd_h, uint32_t result_code,
 		uint32_t generation, uint32_t void_time, as_msg_op **ops,
 		struct as_bin_s **bins, uint16_t bin_count, struct as_namespace_s *ns,
 		uint64_t trid);
 int as_msg_send_ops_reply(struct as_file_handle_s *fd_h, cf_dyn_buf *db);
+int as_msg_send_reply_buf(struct as_file_handle_s *fd_h, uint8_t *msgp,
+		size_t msg_sz);
 bool as_msg_send_fin(cf_socket *sock, uint32_t result_code);
 size_t as_msg_send_fin_timeout(cf_socket *sock, uint32_t result_code,
 		int32_t timeout);
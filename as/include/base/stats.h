@@ -91,6 +91,10 @@ typedef struct as_stats_s {
 	uint64_t		sindex_gc_garbage_found; // amount of garbage found during list creation phase
 	uint64_t		sindex_gc_garbage_cleaned; // amount of garbage deleted during list deletion phase
 
+	// Index tree GC stats.
+	cf_atomic64		tree_gc_trees_destroyed;
+	cf_atomic64		tree_gc_elements_destroyed;
+
 	// Fabric stats.
 	uint64_t		fabric_bulk_s_rate;
 	uint64_t		fabric_bulk_r_rate;
@@ -43,6 +43,12 @@ struct as_transaction_s;
 #define MAX_TRANSACTION_QUEUES 128
 #define MAX_TRANSACTION_THREADS_PER_QUEUE 256
 
+// Queued work that isn't a transaction, e.g. completing an asynchronous device
+// read. Embed in the owning struct - fn gets the embedded member back.
+typedef struct as_tsvc_cb_s {
+	void (*fn)(struct as_tsvc_cb_s *cb);
+} as_tsvc_cb;
+
 
 //==========================================================
 // Public API.
@@ -50,6 +56,7 @@ struct as_transaction_s;
 
 void as_tsvc_init();
 void as_tsvc_enqueue(struct as_transaction_s *tr);
+void as_tsvc_enqueue_cb(as_tsvc_cb *cb);
 void as_tsvc_set_threads_per_queue(uint32_t n_threads);
 int as_tsvc_queue_get_size();
 void as_tsvc_process_transaction(struct as_transaction_s *tr);
@@ -29,13 +29,16 @@
 #include <stdint.h>
 
 #include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_byte_order.h"
 #include "citrusleaf/cf_clock.h"
 #include "citrusleaf/cf_digest.h"
 
+#include "cf_mutex.h"
 #include "msg.h"
 #include "node.h"
 #include "socket.h"
+#include "uring.h"
 
 #include "base/cfg.h"
 #include "base/index.h"
@@ -105,6 +108,27 @@ typedef struct as_file_handle_s {
 	as_proto	*proto;
 	uint64_t	proto_unread;
 	void		*security_filter;
+
+	// Pipelining - requests flagged AS_MSG_INFO3_PIPELINE don't wait for the
+	// previous request's reply before the next is read.
+	uint32_t	pipeline_max;	// proto-pipeline-max when connection was accepted
+	cf_atomic32	n_pipelined;	// pipelined requests in progress
+	cf_mutex	send_lock;		// protects the following - never held while sending
+	bool		sending;		// a thread is writing replies
+	struct as_queued_reply_s *reply_head; // replies for that thread to write
+	struct as_queued_reply_s *reply_tail;
+
+	// Receive buffer - one recv may bring in several requests, which demarshal
+	// parses out of it. Only demarshal touches it, and only while it owns the
+	// connection (i.e. between epoll event and re-arm).
+	uint8_t		*recv_buf;		// allocated on first read
+	uint32_t	recv_buf_sz;	// proto-recv-buffer-size when connection was accepted
+	uint32_t	recv_off;		// start of unparsed bytes
+	uint32_t	recv_len;		// end of unparsed bytes
+
+	// With proto-io-engine io-uring, re-arm submits a recv on the demarshal
+	// thread's ring instead of re-enabling epoll. NULL for epoll and TLS.
+	cf_uring	*ring;
 } as_file_handle;
 
 #define FH_INFO_DONOT_REAP	0x00000001	// this bit indicates that this file handle should not be reaped
@@ -143,11 +167,13 @@ typedef enum {
 	FROM_BATCH,
 	FROM_IUDF,
 	FROM_NSUP,
+	FROM_TSVC_CB, // not a transaction - see as_tsvc_enqueue_cb()
 
 	FROM_UNDEF	= 0
 } transaction_origin;
 
 struct as_batch_shared_s;
+struct as_tsvc_cb_s;
 struct iudf_origin_s;
 
 typedef struct as_transaction_s {
@@ -170,6 +196,7 @@ typedef struct as_transaction_s {
 		cf_node						proxy_node;
 		struct as_batch_shared_s*	batch_shared;
 		struct iudf_origin_s*		iudf_orig;
+		struct as_tsvc_cb_s*		tsvc_cb;
 	} from;
 
 	union {
@@ -311,6 +338,18 @@ as_transaction_has_predexp(const as_transaction *tr)
 	return (tr->msg_fields & AS_MSG_FIELD_BIT_PREDEXP) != 0;
 }
 
+static inline bool
+as_transaction_has_pid_array(const as_transaction *tr)
+{
+	return (tr->msg_fields & AS_MSG_FIELD_BIT_PID_ARRAY) != 0;
+}
+
+static inline bool
+as_transaction_has_digest_array(const as_transaction *tr)
+{
+	return (tr->msg_fields & AS_MSG_FIELD_BIT_DIGEST_ARRAY) != 0;
+}
+
 // For now it's not worth storing the trid in the as_transaction struct since we
 // only parse it from the msg once per transaction anyway.
 static inline uint64_t
@@ -29,6 +29,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/types.h>
 
 #include "citrusleaf/cf_atomic.h"
@@ -36,9 +37,12 @@
 
 #include "cf_mutex.h"
 #include "hist.h"
+#include "uring.h"
 
 #include "base/datamodel.h"
+#include "base/thr_tsvc.h"
 #include "fabric/partition.h"
+#include "storage/record_cache.h"
 
 
 //==========================================================
@@ -62,18 +66,22 @@ struct drv_ssd_s;
 #endif
 
 #define SSD_HEADER_MAGIC	(0x4349747275730707L)
-#define SSD_VERSION			2
+#define SSD_VERSION			3
 // Must update conversion code when bumping version.
 //
 // SSD_VERSION history:
 // 1 - original
 // 2 - minimum storage increment (RBLOCK_SIZE) from 512 to 128 bytes
+// 3 - record header's deprecated sig replaced by compression, checkpoint
+//     epoch, dictionary id and flat length
 
 // Device header flags.
 #define SSD_HEADER_FLAG_ENCRYPTED	0x01
 
 #define MAX_SSD_THREADS 20
 
+#define MAX_WRITE_STRIPES 32
+
 
 //------------------------------------------------
 // Device header.
@@ -121,6 +129,22 @@ typedef struct {
 } ssd_write_buf;
 
 
+//------------------------------------------------
+// Independently locked slot holding a write buffer
+// being filled by writes - writers are spread over
+// a device's stripes to avoid contending.
+//
+typedef struct ssd_write_stripe_s {
+	pthread_mutex_t		lock;		// lock protects writes to swb
+	ssd_write_buf		*swb;		// swb currently being filled by writes
+	uint64_t			n_swb_pushes;	// full swbs queued from this stripe
+
+	// Used only by the maintenance thread's flush:
+	uint64_t			prev_n_swb_pushes;
+	uint32_t			prev_flush_pos;
+} ssd_write_stripe;
+
+
 //------------------------------------------------
 // Per-wblock information.
 //
@@ -130,8 +154,14 @@ typedef struct ssd_wblock_state_s {
 	ssd_write_buf		*swb;		// pending writes for the wblock, also treated as a cache for reads
 	uint32_t			state;		// for now just a defrag flag
 	cf_atomic32			n_vac_dests; // number of wblocks into which this wblock defragged
+	uint64_t			dict_mask;	// compression dictionaries its blocks may reference
+	uint32_t			write_time;	// newest data in the wblock - seconds, void-time clock
+	uint8_t				ttl_bucket;	// TTL class of records written to it, if known
 } ssd_wblock_state;
 
+// Filled by defrag, or found at startup.
+#define SSD_TTL_BUCKET_NONE		0xFF
+
 // wblock state
 //
 // Ultimately this may become a full-blown state, but for now it's effectively
@@ -158,6 +188,31 @@ typedef enum {
 } e_free_to;
 
 
+//------------------------------------------------
+// Per-device I/O scheduler - background reads draw
+// from per-class token buckets sharing a budget
+// that adapts to observed client read latency.
+//
+typedef struct ssd_io_class_s {
+	uint32_t		weight;			// share of budget relative to other active classes
+	int64_t			tokens;			// bytes - may go negative to admit a large read
+	uint64_t		last_ns;		// last read - class is idle if long ago
+} ssd_io_class;
+
+typedef struct ssd_io_sched_s {
+	pthread_mutex_t	lock;			// protects budget and token buckets
+	uint64_t		target_ns;		// client read latency to stay under - 0 if off
+	uint64_t		budget;			// bytes/sec shared by active background classes
+	uint64_t		refill_ns;		// when token buckets were last refilled
+	uint64_t		adapt_ns;		// when budget was last adjusted
+	uint64_t		adapt_n_client_reads;
+	cf_atomic32		n_client_in_flight;
+	cf_atomic64		n_client_reads;	// total completed
+	cf_atomic64		client_lat_ns;	// moving average of client read latency
+	ssd_io_class	classes[AS_STORAGE_N_IO_CLASSES]; // client entry unused
+} ssd_io_sched;
+
+
 //------------------------------------------------
 // Per-device information.
 //
@@ -170,8 +225,10 @@ typedef struct drv_ssd_s
 
 	uint32_t		running;
 
-	pthread_mutex_t	write_lock;			// lock protects writes to current swb
-	ssd_write_buf	*current_swb;		// swb currently being filled by writes
+	uint32_t		n_ttl_buckets;		// TTL classes written to separate stripes
+	uint32_t		n_write_stripes;	// stripes per TTL class
+	uint32_t		n_stripes;			// all stripes - TTL classes x stripes per class
+	ssd_write_stripe write_stripes[AS_STORAGE_MAX_TTL_BUCKETS * MAX_WRITE_STRIPES];
 
 	pthread_mutex_t	defrag_lock;		// lock protects writes to defrag swb
 	ssd_write_buf	*defrag_swb;		// swb currently being filled by defrag
@@ -182,11 +239,22 @@ typedef struct drv_ssd_s
 	cf_queue		*free_wblock_q;		// IDs of free wblocks
 	cf_queue		*defrag_wblock_q;	// IDs of wblocks to defrag
 
+	pthread_rwlock_t free_wblock_lock;	// lets checkpoints see free & in-use wblocks consistently
+	cf_queue		*held_wblock_q;		// freed wblocks held until checkpoints no longer need them
+	uint32_t		*replay_wblock_ids;	// from index checkpoint - wblocks to sweep at startup
+	uint32_t		n_replay_open;		// ... of which in swbs at checkpoint (listed first)
+	uint32_t		n_replay_free;		// ... of which free at checkpoint, in allocation order
+
 	cf_queue		*swb_write_q;		// pointers to swbs ready to write
 	cf_queue		*swb_shadow_q;		// pointers to swbs ready to write to shadow, if any
 	cf_queue		*swb_free_q;		// pointers to swbs free and waiting
 	cf_queue		*post_write_q;		// pointers to swbs that have been written but are cached
 
+	cf_uring		*read_ring;			// null unless read-engine is io-uring
+	int				read_ring_fd;		// fd on which asynchronous reads are issued
+
+	ssd_io_sched	io_sched;			// throttles background reads
+
 	cf_atomic64		n_defrag_wblock_reads;	// total number of wblocks added to the defrag_wblock_q
 	cf_atomic64		n_defrag_wblock_writes;	// total number of swbs added to the swb_write_q by defrag
 	cf_atomic64		n_wblock_writes;		// total number of swbs added to the swb_write_q by writes
@@ -208,12 +276,12 @@ typedef struct drv_ssd_s
 
 	uint32_t		write_block_size;	// number of bytes to write at a time
 
-	uint32_t		sweep_wblock_id;				// wblocks read at startup
-	uint64_t		record_add_older_counter;		// records not inserted due to better existing one
-	uint64_t		record_add_expired_counter;		// records not inserted due to expiration
-	uint64_t		record_add_max_ttl_counter;		// records not inserted due to max-ttl
-	uint64_t		record_add_replace_counter;		// records reinserted
-	uint64_t		record_add_unique_counter;		// records inserted
+	cf_atomic32		sweep_wblock_id;				// wblocks read at startup
+	cf_atomic64		record_add_older_counter;		// records not inserted due to better existing one
+	cf_atomic64		record_add_expired_counter;		// records not inserted due to expiration
+	cf_atomic64		record_add_max_ttl_counter;		// records not inserted due to max-ttl
+	cf_atomic64		record_add_replace_counter;		// records reinserted
+	cf_atomic64		record_add_unique_counter;		// records inserted
 
 	ssd_alloc_table	*alloc_table;
 
@@ -221,6 +289,7 @@ typedef struct drv_ssd_s
 	pthread_t		write_worker_thread[MAX_SSD_THREADS];
 	pthread_t		shadow_worker_thread;
 	pthread_t		defrag_thread;
+	pthread_t		read_reaper_thread;
 
 	histogram		*hist_read;
 	histogram		*hist_large_block_read;
@@ -230,6 +299,21 @@ typedef struct drv_ssd_s
 } drv_ssd;
 
 
+//------------------------------------------------
+// Per-namespace index checkpoint state.
+//
+typedef struct ssd_checkpoint_s {
+	pthread_mutex_t	lock;			// serializes checkpoints
+	bool			enabled;		// configured, and devices are loaded
+	uint64_t		prev_random;	// device header signature from the previous run
+	FILE			*load_file;		// checkpoint being loaded at startup, if any
+	uint32_t		gen;			// latest checkpoint started
+	uint32_t		durable_gen;	// latest checkpoint completely written
+	uint32_t		replay_gen;		// checkpoint loaded at startup
+	volatile uint8_t epoch;			// stamped in records written since gen started
+} ssd_checkpoint;
+
+
 //------------------------------------------------
 // Per-namespace storage information.
 //
@@ -242,6 +326,14 @@ typedef struct drv_ssds_s
 	// load a record.
 	bool get_state_from_storage[AS_PARTITIONS];
 
+	as_record_cache		*read_cache;	// hot records read from devices, if configured
+	ssd_checkpoint		ckpt;
+
+	// Device-order sweeps in progress - told about records that move.
+	pthread_rwlock_t	sweeps_lock;
+	cf_atomic32			n_sweeps;
+	struct as_storage_sweep_s *sweeps;
+
 	int					n_ssds;
 	drv_ssd				ssds[];
 } drv_ssds;
@@ -276,7 +368,10 @@ typedef struct ssd_load_records_info_s {
 
 // Per-record metadata on device.
 typedef struct drv_ssd_block_s {
-	uint64_t		sig;			// deprecated
+	uint8_t			compression;	// as_compression_method of bins - replaces deprecated sig
+	uint8_t			ckpt_epoch;		// index checkpoint epoch when written - 0 if none
+	uint16_t		dict_id;		// if compressed with a dictionary, its id
+	uint32_t		flat_length;	// if compressed, length before compressing bins
 	uint32_t		magic;
 	uint32_t		length;			// total after this field - this struct's pointer + 16
 	cf_digest		keyd;
@@ -297,6 +392,27 @@ typedef struct drv_ssd_bin_s {
 	uint32_t	next;				// location of next bin: block offset
 } __attribute__ ((__packed__)) drv_ssd_bin;
 
+// Asynchronous record read - owned by the device until the callback, then by
+// the caller until adopted or discarded.
+typedef struct ssd_read_req_s {
+	as_tsvc_cb		tsvc_cb;		// must be first - completes on a transaction thread
+	drv_ssd			*ssd;
+	cf_digest		keyd;
+	uint64_t		rblock_id;		// record location & generation at submit
+	uint32_t		n_rblocks;
+	uint16_t		generation;
+	int				result;			// 0 if block passed sanity checks
+	int32_t			res;			// from the ring - bytes read, or -errno
+	uint8_t			*read_buf;
+	drv_ssd_block	*block;
+	uint64_t		read_offset;
+	size_t			read_size;
+	uint64_t		start_ns;
+	uint64_t		sched_start_ns;	// for I/O scheduler - 0 if not scheduling
+	as_storage_read_done_fn cb;
+	void			*udata;
+} ssd_read_req;
+
 // Warm and cool restart.
 void ssd_resume_devices(drv_ssds *ssds);
 void *run_ssd_cool_start(void *udata);
@@ -305,7 +421,7 @@ void ssd_start_maintenance_threads(drv_ssds *ssds);
 void ssd_start_write_worker_threads(drv_ssds *ssds);
 void ssd_start_defrag_threads(drv_ssds *ssds);
 bool is_valid_record(const drv_ssd_block *block, const char *ns_name);
-void apply_rec_props(struct as_index_s *r, struct as_namespace_s *ns, const struct as_rec_props_s *p_props);
+void apply_rec_props(struct as_index_tree_s *tree, struct as_index_ref_s *r_ref, struct as_namespace_s *ns, const struct as_rec_props_s *p_props);
 
 // Tomb raider.
 void ssd_cold_start_adjust_cenotaph(struct as_namespace_s *ns, const drv_ssd_block *block, struct as_index_s *r);
@@ -326,10 +442,37 @@ bool ssd_cold_start_is_record_truncated(struct as_namespace_s *ns, const drv_ssd
 // Called in (enterprise-split) storage table function.
 int ssd_write(struct as_storage_rd_s *rd);
 
+// Index checkpoint.
+void ssd_checkpoint_init(drv_ssds *ssds);
+bool ssd_checkpoint_open(drv_ssds *ssds);
+void ssd_checkpoint_load(drv_ssds *ssds);
+void ssd_checkpoint_hold_wblock(drv_ssd *ssd, uint32_t wblock_id);
+void ssd_checkpoint_write(drv_ssds *ssds);
+void ssd_start_checkpoint_thread(drv_ssds *ssds);
+
+// Device I/O scheduler.
+void ssd_io_sched_init(drv_ssd *ssd);
+void ssd_io_sched_acquire(drv_ssd *ssd, as_storage_io_class io_class, uint64_t size);
+uint64_t ssd_io_sched_client_start(drv_ssd *ssd);
+void ssd_io_sched_client_done(drv_ssd *ssd, uint64_t start_ns);
+void ssd_io_sched_ticker(drv_ssd *ssd);
+
 
 //
-// Conversions between bytes and rblocks.
+// Index checkpoint epochs.
+//
+
+// Records are stamped with an 8-bit epoch derived from the checkpoint
+// generation - 0 means written while not checkpointing.
+static inline uint8_t
+ssd_checkpoint_epoch(uint32_t gen)
+{
+	return gen == 0 ? 0 : (uint8_t)((gen % 255) + 1);
+}
+
+
 //
+// Conversions between bytes and rblocks.
 
 // TODO - make checks stricter (exclude drive header, consider drive size) ???
 #define STORAGE_RBLOCK_IS_VALID(__x)	((__x) != 0)
@@ -403,9 +546,11 @@ static inline uint64_t BYTES_UP_TO_IO_MIN(drv_ssd *ssd, uint64_t bytes) {
 static inline bool
 can_convert_storage_version(uint16_t version)
 {
-	return version == 1
-			// In case I bump version 2 and forget to tweak conversion code:
-			&& SSD_VERSION == 2;
+	// Older versions always wrote 0 in what was sig, which reads as not
+	// compressed and not covered by an index checkpoint.
+	return (version == 1 || version == 2)
+			// In case I bump version 3 and forget to tweak conversion code:
+			&& SSD_VERSION == 3;
 }
 
 
@@ -0,0 +1,65 @@
+/*
+ * record_cache.h
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "citrusleaf/cf_digest.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Opaque - sharded, memory-bounded cache of record images read from device,
+// with S3-FIFO eviction so one-hit scans and migrations pass through a small
+// probationary queue and don't displace the hot set.
+typedef struct as_record_cache_s as_record_cache;
+
+// Entries are only valid for the record version they were read from.
+typedef struct as_record_cache_key_s {
+	cf_digest keyd;
+	uint64_t last_update_time;
+	uint16_t generation;
+} as_record_cache_key;
+
+
+//==========================================================
+// Public API.
+//
+
+as_record_cache* as_record_cache_create(uint64_t max_bytes);
+
+// Returns a copy of the cached image which caller frees, or NULL on a miss.
+void* as_record_cache_get(as_record_cache* cache, const as_record_cache_key* key, uint32_t* p_size);
+bool as_record_cache_contains(as_record_cache* cache, const as_record_cache_key* key);
+
+void as_record_cache_put(as_record_cache* cache, const as_record_cache_key* key, const void* buf, uint32_t size);
+void as_record_cache_remove(as_record_cache* cache, const cf_digest* keyd);
+
+uint64_t as_record_cache_bytes(const as_record_cache* cache);
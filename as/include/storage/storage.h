@@ -35,10 +35,13 @@
 // Forward declarations.
 struct as_bin_s;
 struct as_index_s;
+struct as_index_tree_s;
 struct as_partition_s;
 struct as_namespace_s;
+struct as_storage_sweep_s;
 struct drv_ssd_s;
 struct drv_ssd_block_s;
+struct ssd_read_req_s;
 
 
 typedef enum {
@@ -48,6 +51,35 @@ typedef enum {
 	AS_NUM_STORAGE_ENGINES
 } as_storage_type;
 
+typedef enum {
+	AS_COMPRESSION_NONE			= 0,
+	AS_COMPRESSION_ZLIB			= 1,
+	AS_COMPRESSION_ZLIB_DICT	= 2, // zlib with a trained per-set dictionary
+
+	AS_NUM_COMPRESSION_METHODS
+} as_compression_method;
+
+typedef enum {
+	AS_STORAGE_DEFRAG_POLICY_FIFO			= 0, // wblocks below defrag-lwm-pct, in order queued
+	AS_STORAGE_DEFRAG_POLICY_COST_BENEFIT	= 1  // of those, emptiest and oldest first
+} as_storage_defrag_policy;
+
+typedef enum {
+	AS_STORAGE_READ_ENGINE_FD_POOL	= 0, // blocking read() on pooled fd
+	AS_STORAGE_READ_ENGINE_IO_URING	= 1  // asynchronous, via io_uring
+} as_storage_read_engine;
+
+// Who a device read is for - all but client reads are background work that the
+// device I/O scheduler may throttle.
+typedef enum {
+	AS_STORAGE_IO_CLIENT	= 0,
+	AS_STORAGE_IO_DEFRAG	= 1,
+	AS_STORAGE_IO_MIGRATE	= 2,
+	AS_STORAGE_IO_SCAN		= 3, // scans, queries, sindex builds
+
+	AS_STORAGE_N_IO_CLASSES
+} as_storage_io_class;
+
 typedef struct as_storage_rd_s {
 	struct as_index_s		*r;
 	struct as_namespace_s	*ns;
@@ -66,12 +98,21 @@ typedef struct as_storage_rd_s {
 
 	bool					is_durable_delete; // enterprise only
 
+	as_storage_io_class		io_class; // client unless caller says otherwise
+
 	// Specific to storage type AS_STORAGE_ENGINE_SSD:
 	struct drv_ssd_block_s	*block;
 	uint8_t					*must_free_block;
 	struct drv_ssd_s		*ssd;
 } as_storage_rd;
 
+// Invoked (on a storage thread) when an asynchronous record read completes.
+typedef void (*as_storage_read_done_fn)(struct ssd_read_req_s *req, void *udata);
+
+// Invoked for each current record found by a device sweep, with rd open and the
+// record locked - return false to stop the sweep.
+typedef bool (*as_storage_sweep_fn)(as_storage_rd *rd, void *udata);
+
 
 //------------------------------------------------
 // Generic "base class" functions that call
@@ -125,6 +166,24 @@ extern bool as_storage_record_get_key(as_storage_rd *rd);
 extern size_t as_storage_record_rec_props_size(as_storage_rd *rd);
 extern void as_storage_record_set_rec_props(as_storage_rd *rd, uint8_t* rec_props_data);
 
+// Asynchronous record reads - false means caller must read synchronously. On
+// completion, caller re-opens the record and adopts the read (which re-reads
+// synchronously if the record moved meanwhile), or discards it.
+extern bool as_storage_record_read_async(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata);
+extern void as_storage_record_adopt_read(as_storage_rd *rd, struct ssd_read_req_s *req);
+extern void as_storage_read_discard(struct ssd_read_req_s *req);
+
+// Device-order sweeps - visit records in slice n of n_slices of all devices'
+// wblocks, if in partitions whose trees are given (others are NULL). A record
+// that a write or defrag moves while the sweep is running is skipped wherever
+// it's found, unless its old copy was already visited - ending the sweep visits
+// those. So each record present throughout is visited exactly once, at a cost
+// of a hash entry per record moved during the sweep.
+extern bool as_storage_has_device_sweep(struct as_namespace_s *ns);
+extern struct as_storage_sweep_s *as_storage_device_sweep_start(struct as_namespace_s *ns, struct as_index_tree_s *const *trees, uint32_t n_slices);
+extern void as_storage_device_sweep(struct as_storage_sweep_s *sweep, uint32_t slice, as_storage_sweep_fn cb, void *udata);
+extern void as_storage_device_sweep_end(struct as_storage_sweep_s *sweep, as_storage_sweep_fn cb, void *udata);
+
 // Called only at shutdown to flush all device write-queues.
 extern void as_storage_shutdown();
 
@@ -178,4 +237,10 @@ extern int as_storage_histogram_clear_ssd(struct as_namespace_s *ns);
 
 // Called by "base class" functions but not via table.
 extern bool as_storage_record_get_key_ssd(as_storage_rd *rd);
+extern bool as_storage_record_read_async_ssd(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata);
+extern void as_storage_record_adopt_read_ssd(as_storage_rd *rd, struct ssd_read_req_s *req);
+extern void as_storage_read_discard_ssd(struct ssd_read_req_s *req);
+extern struct as_storage_sweep_s *as_storage_device_sweep_start_ssd(struct as_namespace_s *ns, struct as_index_tree_s *const *trees, uint32_t n_slices);
+extern void as_storage_device_sweep_ssd(struct as_storage_sweep_s *sweep, uint32_t slice, as_storage_sweep_fn cb, void *udata);
+extern void as_storage_device_sweep_end_ssd(struct as_storage_sweep_s *sweep, as_storage_sweep_fn cb, void *udata);
 extern void as_storage_shutdown_ssd(struct as_namespace_s *ns);
@@ -350,6 +350,7 @@ main(int argc, char **argv)
 	as_json_init();				// Jansson JSON API used by System Metadata
 	as_smd_init();				// System Metadata first - others depend on it
 	as_index_tree_gc_init();	// thread to purge dropped index trees
+	as_index_reduce_init();		// threads to help parallel index reduces
 	as_sindex_thr_init();		// defrag secondary index (ok during population)
 
 	// Initialize namespaces. Each namespace decides here whether it will do a
@@ -36,6 +36,7 @@
 #include "base/stats.h"
 #include "base/thr_tsvc.h"
 #include "base/transaction.h"
+#include "fabric/partition.h"
 #include "hardware.h"
 #include "socket.h"
 #include <errno.h>
@@ -48,6 +49,7 @@
 #define BATCH_BLOCK_SIZE (1024 * 128) // 128K
 #define BATCH_MAX_TRANSACTION_SIZE (1024 * 1024 * 10) // 10MB
 #define BATCH_REPEAT_SIZE 25  // index(4),digest(20) and repeat(1)
+#define BATCH_PREFETCH_GROUP 16 // sub-transactions whose index lookups are overlapped
 
 //---------------------------------------------------------
 // TYPES
@@ -106,6 +108,13 @@ typedef struct {
 	bool complete;
 } as_batch_work;
 
+// Parsed sub-transaction, held until its group is submitted.
+typedef struct {
+	uint8_t head[AS_TRANSACTION_HEAD_SIZE];
+	as_namespace* ns;
+	bool should_inline;
+} as_batch_pending;
+
 //---------------------------------------------------------
 // STATIC DATA
 //---------------------------------------------------------
@@ -620,6 +629,70 @@ as_batch_init()
 	return 0;
 }
 
+// Walk the index for the group's inlined sub-transactions with their lookups
+// overlapped, so each then finds its index path in cache. Sub-transactions
+// queued to transaction threads do their lookups on another core, where this
+// thread's cache does them no good - they're skipped.
+static void
+as_batch_prefetch_index(as_batch_pending* pending, uint32_t n_pending)
+{
+	as_index_tree* trees[BATCH_PREFETCH_GROUP];
+	cf_digest* keyds[BATCH_PREFETCH_GROUP];
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < n_pending; i++) {
+		if (pending[i].ns && pending[i].should_inline) {
+			n++;
+		}
+	}
+
+	// Nothing to overlap - don't pay for the tree reservations.
+	if (n < 2) {
+		return;
+	}
+
+	n = 0;
+
+	for (uint32_t i = 0; i < n_pending; i++) {
+		as_transaction* tr = (as_transaction*)pending[i].head;
+
+		// Bad namespace - sub-transaction will fail anyway.
+		if (! pending[i].ns || ! pending[i].should_inline) {
+			continue;
+		}
+
+		keyds[n] = &tr->keyd;
+		trees[n] = as_partition_reserve_tree(pending[i].ns, as_partition_getid(&tr->keyd));
+		n++;
+	}
+
+	as_index_prefetch_multi(trees, keyds, n);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_index_tree_release(trees[i]);
+	}
+}
+
+static void
+as_batch_submit_pending(as_transaction* tr, as_batch_pending* pending, uint32_t n_pending)
+{
+	if (n_pending > 1) {
+		as_batch_prefetch_index(pending, n_pending);
+	}
+
+	for (uint32_t i = 0; i < n_pending; i++) {
+		memcpy(tr, pending[i].head, AS_TRANSACTION_HEAD_SIZE);
+
+		if (pending[i].should_inline) {
+			as_tsvc_process_transaction(tr);
+		}
+		else {
+			// Queue transaction to be processed by a transaction thread.
+			as_tsvc_enqueue(tr);
+		}
+	}
+}
+
 int
 as_batch_queue_task(as_transaction* btr)
 {
@@ -749,6 +822,9 @@ as_batch_queue_task(as_transaction* btr)
 	as_msg_op* op;
 	uint32_t tran_row = 0;
 	uint8_t info = *data++;  // allow transaction inline.
+	as_namespace* row_ns = NULL;
+	as_batch_pending pending[BATCH_PREFETCH_GROUP];
+	uint32_t n_pending = 0;
 
 	bool allow_inline = (g_config.n_namespaces_inlined != 0 && info);
 	bool check_inline = (allow_inline && g_config.n_namespaces_not_inlined != 0);
@@ -811,9 +887,9 @@ as_batch_queue_task(as_transaction* btr)
 			data += sizeof(cl_msg);
 			mf = (as_msg_field*)data;
 			as_msg_swap_field(mf);
+			row_ns = as_namespace_get_bymsgfield(mf);
 			if (check_inline) {
-				as_namespace* ns = as_namespace_get_bymsgfield(mf);
-				should_inline = ns && ns->storage_data_in_memory;
+				should_inline = row_ns && row_ns->storage_data_in_memory;
 			}
 			mf = as_msg_field_get_next(mf);
 			data = (uint8_t*)mf;
@@ -859,18 +935,23 @@ as_batch_queue_task(as_transaction* btr)
 			break;
 		}
 
-		// Submit transaction.
-		if (should_inline) {
-			as_tsvc_process_transaction(&tr);
-		}
-		else {
-			// Queue transaction to be processed by a transaction thread.
-			as_tsvc_enqueue(&tr);
+		// Submit transactions a group at a time.
+		as_batch_pending* p = &pending[n_pending++];
+
+		memcpy(p->head, &tr, AS_TRANSACTION_HEAD_SIZE);
+		p->ns = row_ns;
+		p->should_inline = should_inline;
+
+		if (n_pending == BATCH_PREFETCH_GROUP) {
+			as_batch_submit_pending(&tr, pending, n_pending);
+			n_pending = 0;
 		}
 		tran_row++;
 	}
 
 TranEnd:
+	as_batch_submit_pending(&tr, pending, n_pending);
+
 	if (tran_row < tran_count) {
 		// Mismatch between tran_count and actual data.  Terminate transaction.
 		cf_warning(AS_BATCH, "Batch keys mismatch. Expected %u Received %u", tran_count, tran_row);
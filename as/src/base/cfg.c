@@ -145,6 +145,8 @@ cfg_set_defaults()
 	c->clock_skew_max_ms = 1000;
 	c->hist_track_back = 300;
 	c->hist_track_slice = 10;
+	c->n_index_reduce_threads = 4;
+	c->n_index_tree_gc_threads = 4;
 	c->n_info_threads = 16;
 	c->migrate_max_num_incoming = AS_MIGRATE_DEFAULT_MAX_NUM_INCOMING; // for receiver-side migration flow-control
 	c->n_migrate_threads = 1;
@@ -152,6 +154,8 @@ cfg_set_defaults()
 	c->nsup_period = 120; // run nsup once every 2 minutes
 	c->nsup_startup_evict = true;
 	c->proto_fd_idle_ms = 60000; // 1 minute reaping of proto file descriptors
+	c->proto_pipeline_max = 64;
+	c->proto_recv_buf_sz = 16 * 1024;
 	c->proto_slow_netio_sleep_ms = 1; // 1 ms sleep between retry for slow queries
 	c->run_as_daemon = true; // set false only to run in debugger & see console output
 	c->scan_max_active = 100;
@@ -275,6 +279,9 @@ typedef enum {
 	CASE_SERVICE_HIST_TRACK_BACK,
 	CASE_SERVICE_HIST_TRACK_SLICE,
 	CASE_SERVICE_HIST_TRACK_THRESHOLDS,
+	CASE_SERVICE_INDEX_REDUCE_THREADS,
+	CASE_SERVICE_INDEX_TREE_GC_MAX_RATE,
+	CASE_SERVICE_INDEX_TREE_GC_THREADS,
 	CASE_SERVICE_INFO_THREADS,
 	CASE_SERVICE_LOG_LOCAL_TIME,
 	CASE_SERVICE_LOG_MILLIS,
@@ -287,6 +294,9 @@ typedef enum {
 	CASE_SERVICE_NSUP_PERIOD,
 	CASE_SERVICE_NSUP_STARTUP_EVICT,
 	CASE_SERVICE_PROTO_FD_IDLE_MS,
+	CASE_SERVICE_PROTO_IO_ENGINE,
+	CASE_SERVICE_PROTO_PIPELINE_MAX,
+	CASE_SERVICE_PROTO_RECV_BUFFER_SIZE,
 	CASE_SERVICE_QUERY_BATCH_SIZE,
 	CASE_SERVICE_QUERY_BUFPOOL_SIZE,
 	CASE_SERVICE_QUERY_IN_TRANSACTION_THREAD,
@@ -388,6 +398,10 @@ typedef enum {
 	CASE_SERVICE_DEBUG_ALLOCATIONS_PERSISTENT,
 	CASE_SERVICE_DEBUG_ALLOCATIONS_ALL,
 
+	// Service proto-io-engine options (value tokens):
+	CASE_SERVICE_PROTO_IO_ENGINE_EPOLL,
+	CASE_SERVICE_PROTO_IO_ENGINE_IO_URING,
+
 	// Logging options:
 	// Normally visible:
 	CASE_LOG_FILE_BEGIN,
@@ -534,6 +548,9 @@ typedef enum {
 	CASE_NAMESPACE_EVICT_TENTHS_PCT,
 	CASE_NAMESPACE_HIGH_WATER_DISK_PCT,
 	CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT,
+	CASE_NAMESPACE_INDEX_DEFRAG_LWM_PCT,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES,
+	CASE_NAMESPACE_INDEX_NUMA_INTERLEAVE,
 	CASE_NAMESPACE_MAX_TTL,
 	CASE_NAMESPACE_MIGRATE_ORDER,
 	CASE_NAMESPACE_MIGRATE_RETRANSMIT_MS,
@@ -541,6 +558,7 @@ typedef enum {
 	CASE_NAMESPACE_OBJ_SIZE_HIST_MAX,
 	CASE_NAMESPACE_PARTITION_TREE_LOCKS,
 	CASE_NAMESPACE_PARTITION_TREE_SPRIGS,
+	CASE_NAMESPACE_PARTITION_TREE_TYPE,
 	CASE_NAMESPACE_RACK_ID,
 	CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE,
 	CASE_NAMESPACE_SET_BEGIN,
@@ -563,6 +581,16 @@ typedef enum {
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_GENERATION,
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME,
 
+	// Namespace index-huge-pages options (value tokens):
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_NONE,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_2M,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES_1G,
+
+	// Namespace partition-tree-type options (value tokens):
+	CASE_NAMESPACE_PARTITION_TREE_TYPE_BTREE,
+	CASE_NAMESPACE_PARTITION_TREE_TYPE_HASH,
+	CASE_NAMESPACE_PARTITION_TREE_TYPE_RED_BLACK,
+
 	// Namespace read consistency level options:
 	CASE_NAMESPACE_READ_CONSISTENCY_ALL,
 	CASE_NAMESPACE_READ_CONSISTENCY_OFF,
@@ -589,7 +617,11 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY,
 	// Normally hidden:
 	CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_MIN_SIZE,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT,
+	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_STARTUP_MINIMUM,
@@ -599,11 +631,18 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_ENCRYPTION_KEY_FILE,
 	CASE_NAMESPACE_STORAGE_DEVICE_FLUSH_MAX_MS,
 	CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC,
+	CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_FILE,
+	CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_PERIOD,
+	CASE_NAMESPACE_STORAGE_DEVICE_IO_SCHED_TARGET_US,
 	CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE,
 	CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT,
 	CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE,
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE,
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE,
 	CASE_NAMESPACE_STORAGE_DEVICE_TOMB_RAIDER_SLEEP,
+	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES,
 	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS,
+	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_TTL_BUCKETS,
 	// Deprecated:
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_PERIOD,
@@ -613,8 +652,22 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_SIGNATURE,
 	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_SMOOTHING_PERIOD,
 
+	// Namespace storage-engine device compression options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB_DICT,
+
+	// Namespace storage-engine device defrag-policy options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_FIFO,
+	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_COST_BENEFIT,
+
+	// Namespace storage-engine device read-engine options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_FD_POOL,
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_IO_URING,
+
 	// Namespace set options:
 	CASE_NAMESPACE_SET_DISABLE_EVICTION,
+	CASE_NAMESPACE_SET_ENABLE_INDEX,
 	CASE_NAMESPACE_SET_ENABLE_XDR,
 	CASE_NAMESPACE_SET_STOP_WRITES_COUNT,
 	// Deprecated:
@@ -766,6 +819,9 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "hist-track-back",				CASE_SERVICE_HIST_TRACK_BACK },
 		{ "hist-track-slice",				CASE_SERVICE_HIST_TRACK_SLICE },
 		{ "hist-track-thresholds",			CASE_SERVICE_HIST_TRACK_THRESHOLDS },
+		{ "index-reduce-threads",			CASE_SERVICE_INDEX_REDUCE_THREADS },
+		{ "index-tree-gc-max-rate",			CASE_SERVICE_INDEX_TREE_GC_MAX_RATE },
+		{ "index-tree-gc-threads",			CASE_SERVICE_INDEX_TREE_GC_THREADS },
 		{ "info-threads",					CASE_SERVICE_INFO_THREADS },
 		{ "log-local-time",					CASE_SERVICE_LOG_LOCAL_TIME },
 		{ "log-millis",						CASE_SERVICE_LOG_MILLIS},
@@ -778,6 +834,9 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "nsup-period",					CASE_SERVICE_NSUP_PERIOD },
 		{ "nsup-startup-evict",				CASE_SERVICE_NSUP_STARTUP_EVICT },
 		{ "proto-fd-idle-ms",				CASE_SERVICE_PROTO_FD_IDLE_MS },
+		{ "proto-io-engine",				CASE_SERVICE_PROTO_IO_ENGINE },
+		{ "proto-pipeline-max",				CASE_SERVICE_PROTO_PIPELINE_MAX },
+		{ "proto-recv-buffer-size",			CASE_SERVICE_PROTO_RECV_BUFFER_SIZE },
 		{ "query-batch-size",				CASE_SERVICE_QUERY_BATCH_SIZE },
 		{ "query-bufpool-size",				CASE_SERVICE_QUERY_BUFPOOL_SIZE },
 		{ "query-in-transaction-thread",	CASE_SERVICE_QUERY_IN_TRANSACTION_THREAD },
@@ -880,6 +939,11 @@ const cfg_opt SERVICE_DEBUG_ALLOCATIONS_OPTS[] = {
 		{ "all",							CASE_SERVICE_DEBUG_ALLOCATIONS_ALL }
 };
 
+const cfg_opt SERVICE_PROTO_IO_ENGINE_OPTS[] = {
+		{ "epoll",							CASE_SERVICE_PROTO_IO_ENGINE_EPOLL },
+		{ "io-uring",						CASE_SERVICE_PROTO_IO_ENGINE_IO_URING }
+};
+
 const cfg_opt LOGGING_OPTS[] = {
 		{ "file",							CASE_LOG_FILE_BEGIN },
 		{ "console",						CASE_LOG_CONSOLE_BEGIN },
@@ -1026,6 +1090,9 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "evict-tenths-pct",				CASE_NAMESPACE_EVICT_TENTHS_PCT },
 		{ "high-water-disk-pct",			CASE_NAMESPACE_HIGH_WATER_DISK_PCT },
 		{ "high-water-memory-pct",			CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT },
+		{ "index-defrag-lwm-pct",			CASE_NAMESPACE_INDEX_DEFRAG_LWM_PCT },
+		{ "index-huge-pages",				CASE_NAMESPACE_INDEX_HUGE_PAGES },
+		{ "index-numa-interleave",			CASE_NAMESPACE_INDEX_NUMA_INTERLEAVE },
 		{ "max-ttl",						CASE_NAMESPACE_MAX_TTL },
 		{ "migrate-order",					CASE_NAMESPACE_MIGRATE_ORDER },
 		{ "migrate-retransmit-ms",			CASE_NAMESPACE_MIGRATE_RETRANSMIT_MS },
@@ -1033,6 +1100,7 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "obj-size-hist-max",				CASE_NAMESPACE_OBJ_SIZE_HIST_MAX },
 		{ "partition-tree-locks",			CASE_NAMESPACE_PARTITION_TREE_LOCKS },
 		{ "partition-tree-sprigs",			CASE_NAMESPACE_PARTITION_TREE_SPRIGS },
+		{ "partition-tree-type",			CASE_NAMESPACE_PARTITION_TREE_TYPE },
 		{ "rack-id",						CASE_NAMESPACE_RACK_ID },
 		{ "read-consistency-level-override", CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE },
 		{ "set",							CASE_NAMESPACE_SET_BEGIN },
@@ -1057,6 +1125,18 @@ const cfg_opt NAMESPACE_CONFLICT_RESOLUTION_OPTS[] = {
 		{ "last-update-time",				CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME }
 };
 
+const cfg_opt NAMESPACE_INDEX_HUGE_PAGES_OPTS[] = {
+		{ "none",							CASE_NAMESPACE_INDEX_HUGE_PAGES_NONE },
+		{ "2m",								CASE_NAMESPACE_INDEX_HUGE_PAGES_2M },
+		{ "1g",								CASE_NAMESPACE_INDEX_HUGE_PAGES_1G }
+};
+
+const cfg_opt NAMESPACE_PARTITION_TREE_TYPE_OPTS[] = {
+		{ "btree",							CASE_NAMESPACE_PARTITION_TREE_TYPE_BTREE },
+		{ "hash",							CASE_NAMESPACE_PARTITION_TREE_TYPE_HASH },
+		{ "red-black",						CASE_NAMESPACE_PARTITION_TREE_TYPE_RED_BLACK }
+};
+
 const cfg_opt NAMESPACE_READ_CONSISTENCY_OPTS[] = {
 		{ "all",							CASE_NAMESPACE_READ_CONSISTENCY_ALL },
 		{ "off",							CASE_NAMESPACE_READ_CONSISTENCY_OFF },
@@ -1084,7 +1164,11 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "memory-all",						CASE_NAMESPACE_STORAGE_DEVICE_MEMORY_ALL },
 		{ "data-in-memory",					CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY },
 		{ "cold-start-empty",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY },
+		{ "compression",					CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION },
+		{ "compression-level",				CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL },
+		{ "compression-min-size",			CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_MIN_SIZE },
 		{ "defrag-lwm-pct",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT },
+		{ "defrag-policy",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY },
 		{ "defrag-queue-min",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN },
 		{ "defrag-sleep",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP },
 		{ "defrag-startup-minimum",			CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_STARTUP_MINIMUM },
@@ -1094,11 +1178,18 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "encryption-key-file",			CASE_NAMESPACE_STORAGE_DEVICE_ENCRYPTION_KEY_FILE },
 		{ "flush-max-ms",					CASE_NAMESPACE_STORAGE_DEVICE_FLUSH_MAX_MS },
 		{ "fsync-max-sec",					CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC },
+		{ "index-checkpoint-file",			CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_FILE },
+		{ "index-checkpoint-period",		CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_PERIOD },
+		{ "io-sched-target-us",				CASE_NAMESPACE_STORAGE_DEVICE_IO_SCHED_TARGET_US },
 		{ "max-write-cache",				CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE },
 		{ "min-avail-pct",					CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT },
 		{ "post-write-queue",				CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE },
+		{ "read-cache-size",				CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE },
+		{ "read-engine",					CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE },
 		{ "tomb-raider-sleep",				CASE_NAMESPACE_STORAGE_DEVICE_TOMB_RAIDER_SLEEP },
+		{ "write-stripes",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES },
 		{ "write-threads",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS },
+		{ "write-ttl-buckets",				CASE_NAMESPACE_STORAGE_DEVICE_WRITE_TTL_BUCKETS },
 		{ "defrag-max-blocks",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS },
 		{ "defrag-period",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_PERIOD },
 		{ "load-at-startup",				CASE_NAMESPACE_STORAGE_DEVICE_LOAD_AT_STARTUP },
@@ -1109,8 +1200,25 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "}",								CASE_CONTEXT_END }
 };
 
+const cfg_opt NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS[] = {
+		{ "none",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE },
+		{ "zlib",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB },
+		{ "zlib-dict",						CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB_DICT }
+};
+
+const cfg_opt NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_OPTS[] = {
+		{ "fifo",							CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_FIFO },
+		{ "cost-benefit",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_COST_BENEFIT }
+};
+
+const cfg_opt NAMESPACE_STORAGE_DEVICE_READ_ENGINE_OPTS[] = {
+		{ "fd-pool",						CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_FD_POOL },
+		{ "io-uring",						CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_IO_URING }
+};
+
 const cfg_opt NAMESPACE_SET_OPTS[] = {
 		{ "set-disable-eviction",			CASE_NAMESPACE_SET_DISABLE_EVICTION },
+		{ "set-enable-index",				CASE_NAMESPACE_SET_ENABLE_INDEX },
 		{ "set-enable-xdr",					CASE_NAMESPACE_SET_ENABLE_XDR },
 		{ "set-stop-writes-count",			CASE_NAMESPACE_SET_STOP_WRITES_COUNT },
 		{ "set-evict-hwm-count",			CASE_NAMESPACE_SET_EVICT_HWM_COUNT },
@@ -1238,6 +1346,7 @@ const int NUM_GLOBAL_OPTS							= sizeof(GLOBAL_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_OPTS							= sizeof(SERVICE_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_AUTO_PIN_OPTS					= sizeof(SERVICE_AUTO_PIN_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_DEBUG_ALLOCATIONS_OPTS		= sizeof(SERVICE_DEBUG_ALLOCATIONS_OPTS) / sizeof(cfg_opt);
+const int NUM_SERVICE_PROTO_IO_ENGINE_OPTS			= sizeof(SERVICE_PROTO_IO_ENGINE_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_OPTS							= sizeof(LOGGING_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_FILE_OPTS						= sizeof(LOGGING_FILE_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_CONSOLE_OPTS					= sizeof(LOGGING_CONSOLE_OPTS) / sizeof(cfg_opt);
@@ -1251,10 +1360,15 @@ const int NUM_NETWORK_INFO_OPTS						= sizeof(NETWORK_INFO_OPTS) / sizeof(cfg_op
 const int NUM_NETWORK_TLS_OPTS						= sizeof(NETWORK_TLS_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_OPTS						= sizeof(NAMESPACE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_CONFLICT_RESOLUTION_OPTS	= sizeof(NAMESPACE_CONFLICT_RESOLUTION_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_INDEX_HUGE_PAGES_OPTS		= sizeof(NAMESPACE_INDEX_HUGE_PAGES_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_PARTITION_TREE_TYPE_OPTS	= sizeof(NAMESPACE_PARTITION_TREE_TYPE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_READ_CONSISTENCY_OPTS		= sizeof(NAMESPACE_READ_CONSISTENCY_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_WRITE_COMMIT_OPTS			= sizeof(NAMESPACE_WRITE_COMMIT_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_OPTS				= sizeof(NAMESPACE_STORAGE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_DEVICE_OPTS			= sizeof(NAMESPACE_STORAGE_DEVICE_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_READ_ENGINE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_OPTS					= sizeof(NAMESPACE_SET_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_ENABLE_XDR_OPTS			= sizeof(NAMESPACE_SET_ENABLE_XDR_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SI_OPTS						= sizeof(NAMESPACE_SI_OPTS) / sizeof(cfg_opt);
@@ -2192,6 +2306,15 @@ as_config_init(const char* config_file)
 				c->hist_track_thresholds = cfg_strdup_no_checks(&line);
 				// TODO - if config key present but no value (not even space) failure mode is bad...
 				break;
+			case CASE_SERVICE_INDEX_REDUCE_THREADS:
+				c->n_index_reduce_threads = cfg_u32(&line, 0, MAX_INDEX_REDUCE_THREADS);
+				break;
+			case CASE_SERVICE_INDEX_TREE_GC_MAX_RATE:
+				c->index_tree_gc_max_rate = cfg_u32_no_checks(&line);
+				break;
+			case CASE_SERVICE_INDEX_TREE_GC_THREADS:
+				c->n_index_tree_gc_threads = cfg_u32(&line, 1, MAX_INDEX_TREE_GC_THREADS);
+				break;
 			case CASE_SERVICE_INFO_THREADS:
 				c->n_info_threads = cfg_int_no_checks(&line);
 				break;
@@ -2228,6 +2351,26 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_PROTO_FD_IDLE_MS:
 				c->proto_fd_idle_ms = cfg_int_no_checks(&line);
 				break;
+			case CASE_SERVICE_PROTO_IO_ENGINE:
+				switch (cfg_find_tok(line.val_tok_1, SERVICE_PROTO_IO_ENGINE_OPTS, NUM_SERVICE_PROTO_IO_ENGINE_OPTS)) {
+				case CASE_SERVICE_PROTO_IO_ENGINE_EPOLL:
+					c->proto_io_engine = AS_PROTO_IO_ENGINE_EPOLL;
+					break;
+				case CASE_SERVICE_PROTO_IO_ENGINE_IO_URING:
+					c->proto_io_engine = AS_PROTO_IO_ENGINE_IO_URING;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_SERVICE_PROTO_PIPELINE_MAX:
+				c->proto_pipeline_max = cfg_u32(&line, 0, MAX_PROTO_PIPELINE);
+				break;
+			case CASE_SERVICE_PROTO_RECV_BUFFER_SIZE:
+				c->proto_recv_buf_sz = cfg_u32(&line, MIN_PROTO_RECV_BUF_SZ, MAX_PROTO_RECV_BUF_SZ);
+				break;
 			case CASE_SERVICE_QUERY_BATCH_SIZE:
 				c->query_bsize = cfg_int_no_checks(&line);
 				break;
@@ -2940,6 +3083,29 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT:
 				ns->hwm_memory_pct = cfg_u32(&line, 0, 100);
 				break;
+			case CASE_NAMESPACE_INDEX_DEFRAG_LWM_PCT:
+				ns->index_defrag_lwm_pct = cfg_u32(&line, 0, 99);
+				break;
+			case CASE_NAMESPACE_INDEX_HUGE_PAGES:
+				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_INDEX_HUGE_PAGES_OPTS, NUM_NAMESPACE_INDEX_HUGE_PAGES_OPTS)) {
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_NONE:
+					ns->index_huge_pages = AS_INDEX_HUGE_PAGES_NONE;
+					break;
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_2M:
+					ns->index_huge_pages = AS_INDEX_HUGE_PAGES_2M;
+					break;
+				case CASE_NAMESPACE_INDEX_HUGE_PAGES_1G:
+					ns->index_huge_pages = AS_INDEX_HUGE_PAGES_1G;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_INDEX_NUMA_INTERLEAVE:
+				ns->index_numa_interleave = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_MAX_TTL:
 				ns->max_ttl = cfg_seconds(&line, 1, MAX_ALLOWED_TTL);
 				break;
@@ -2961,6 +3127,23 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_PARTITION_TREE_SPRIGS:
 				ns->tree_shared.n_sprigs = cfg_u32_power_of_2(&line, 16, 4096);
 				break;
+			case CASE_NAMESPACE_PARTITION_TREE_TYPE:
+				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_PARTITION_TREE_TYPE_OPTS, NUM_NAMESPACE_PARTITION_TREE_TYPE_OPTS)) {
+				case CASE_NAMESPACE_PARTITION_TREE_TYPE_BTREE:
+					ns->tree_shared.type = AS_INDEX_TREE_BTREE;
+					break;
+				case CASE_NAMESPACE_PARTITION_TREE_TYPE_HASH:
+					ns->tree_shared.type = AS_INDEX_TREE_HASH;
+					break;
+				case CASE_NAMESPACE_PARTITION_TREE_TYPE_RED_BLACK:
+					ns->tree_shared.type = AS_INDEX_TREE_RED_BLACK;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
 			case CASE_NAMESPACE_RACK_ID:
 				ns->rack_id = cfg_u32(&line, 0, MAX_RACK_ID);
 				break;
@@ -3092,9 +3275,46 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY:
 				ns->storage_cold_start_empty = cfg_bool(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION:
+				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE:
+					ns->storage_compression = AS_COMPRESSION_NONE;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB:
+					ns->storage_compression = AS_COMPRESSION_ZLIB;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB_DICT:
+					ns->storage_compression = AS_COMPRESSION_ZLIB_DICT;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL:
+				ns->storage_compression_level = cfg_u32(&line, 1, 9);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_MIN_SIZE:
+				ns->storage_compression_min_size = cfg_u32_no_checks(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT:
 				ns->storage_defrag_lwm_pct = cfg_u32_no_checks(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY:
+				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_FIFO:
+					ns->storage_defrag_policy = AS_STORAGE_DEFRAG_POLICY_FIFO;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_POLICY_COST_BENEFIT:
+					ns->storage_defrag_policy = AS_STORAGE_DEFRAG_POLICY_COST_BENEFIT;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN:
 				ns->storage_defrag_queue_min = cfg_u32_no_checks(&line);
 				break;
@@ -3123,6 +3343,15 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_FSYNC_MAX_SEC:
 				ns->storage_fsync_max_us = cfg_u64_no_checks(&line) * 1000000;
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_FILE:
+				ns->storage_index_checkpoint_file = cfg_strdup(&line, true);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_INDEX_CHECKPOINT_PERIOD:
+				ns->storage_index_checkpoint_period = cfg_u32_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_IO_SCHED_TARGET_US:
+				ns->storage_io_sched_target_us = cfg_u32_no_checks(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE:
 				ns->storage_max_write_cache = cfg_u64_no_checks(&line);
 				break;
@@ -3132,13 +3361,36 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE:
 				ns->storage_post_write_queue = cfg_u32(&line, 0, 4 * 1024);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE:
+				ns->storage_read_cache_size = cfg_u64_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE:
+				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_READ_ENGINE_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_FD_POOL:
+					ns->storage_read_engine = AS_STORAGE_READ_ENGINE_FD_POOL;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_READ_ENGINE_IO_URING:
+					ns->storage_read_engine = AS_STORAGE_READ_ENGINE_IO_URING;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_TOMB_RAIDER_SLEEP:
 				cfg_enterprise_only(&line);
 				ns->storage_tomb_raider_sleep = cfg_u32_no_checks(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES:
+				ns->storage_write_stripes = cfg_u32(&line, 1, MAX_WRITE_STRIPES);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS:
 				ns->storage_write_threads = cfg_u32_no_checks(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_TTL_BUCKETS:
+				ns->storage_write_ttl_buckets = cfg_u32(&line, 1, AS_STORAGE_MAX_TTL_BUCKETS);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS:
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_PERIOD:
 			case CASE_NAMESPACE_STORAGE_DEVICE_LOAD_AT_STARTUP:
@@ -3166,6 +3418,9 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_SET_DISABLE_EVICTION:
 				DISABLE_SET_EVICTION(p_set, cfg_bool(&line));
 				break;
+			case CASE_NAMESPACE_SET_ENABLE_INDEX:
+				p_set->enable_index = cfg_bool(&line) ? 1 : 0;
+				break;
 			case CASE_NAMESPACE_SET_ENABLE_XDR:
 				switch (cfg_find_tok(line.val_tok_1, NAMESPACE_SET_ENABLE_XDR_OPTS, NUM_NAMESPACE_SET_ENABLE_XDR_OPTS)) {
 				case CASE_NAMESPACE_SET_ENABLE_XDR_USE_DEFAULT:
@@ -3837,6 +4092,7 @@ as_config_post_process(as_config* c, const char* config_file)
 		ns->tree_shared.locks_shift			= 12 - cf_msb(ns->tree_shared.n_lock_pairs);
 		ns->tree_shared.sprigs_shift		= 12 - cf_msb(ns->tree_shared.n_sprigs);
 		ns->tree_shared.sprigs_offset		= sizeof(as_lock_pair) * ns->tree_shared.n_lock_pairs;
+		ns->tree_shared.set_sprigs_offset	= ns->tree_shared.sprigs_offset + sizeof(as_sprig) * ns->tree_shared.n_sprigs;
 
 		ssd_init_encryption_key(ns);
 
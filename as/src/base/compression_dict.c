@@ -0,0 +1,629 @@
+/*
+ * compression_dict.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/compression_dict.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_b64.h"
+
+#include "fault.h"
+
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "base/system_metadata.h"
+#include "fabric/partition.h"
+#include "storage/storage.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct train_info_s {
+	as_namespace* ns;
+	uint16_t set_id;
+	char set_name[AS_SET_NAME_MAX_SIZE];
+	uint32_t n_partition_samples;
+	uint32_t n_samples;
+	uint32_t size;
+	uint8_t buf[MAX_COMPRESSION_DICT_SIZE];
+} train_info;
+
+// Spread samples over partitions, rather than filling up on the first few.
+static const uint32_t MAX_PARTITION_SAMPLES = 4;
+
+// Training on records bigger than this doesn't help the small ones.
+static const uint32_t MAX_SAMPLE_SIZE = 1024;
+
+// Not worth publishing a dictionary smaller than this.
+static const uint32_t MIN_DICT_SIZE = 256;
+
+// Compression dictionary system metadata module name.
+const char AS_COMPRESSION_DICT_MODULE[] = "compression-dict";
+#define COMPRESSION_DICT_MODULE ((char*)AS_COMPRESSION_DICT_MODULE)
+
+// Includes 1 for delimiter and 1 for null-terminator.
+#define DICT_KEY_SIZE (AS_ID_NAMESPACE_SZ + 5)
+
+// System metadata key and value format token.
+#define TOK_DELIMITER ('|')
+
+
+//==========================================================
+// Globals.
+//
+
+static bool g_dict_smd_loaded = false;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+bool dict_smd_conflict_cb(char* module, as_smd_item_t* existing_item, as_smd_item_t* new_item, void* udata);
+int dict_smd_accept_cb(char* module, as_smd_item_list_t* items, void* udata, uint32_t accept_opt);
+int dict_smd_can_accept_cb(char* module, as_smd_item_t* item, void* udata);
+
+as_namespace* ns_from_smd_key(const char* key, uint32_t* p_id);
+as_compression_dict* dict_from_smd_value(as_namespace* ns, const char* value, uint32_t id);
+void dict_install(as_namespace* ns, as_compression_dict* dict);
+void* run_train(void* arg);
+void train_reduce_cb(as_index_ref* r_ref, void* udata);
+void train_publish(train_info* info);
+
+
+//==========================================================
+// Public API.
+//
+
+void
+as_compression_dict_init(as_namespace* ns)
+{
+	as_compression_dicts* cd = &ns->compression_dicts;
+
+	memset(cd, 0, sizeof(as_compression_dicts));
+	pthread_mutex_init(&cd->lock, NULL);
+}
+
+
+void
+as_compression_dict_init_smd()
+{
+	if (as_smd_create_module(COMPRESSION_DICT_MODULE,
+			NULL, NULL,
+			dict_smd_conflict_cb, NULL,
+			dict_smd_accept_cb, NULL,
+			dict_smd_can_accept_cb, NULL) != 0) {
+		cf_crash(AS_STORAGE, "compression dict init - failed smd create module");
+	}
+
+	// Cold start needs the dictionaries to read compressed blocks.
+	while (! g_dict_smd_loaded) {
+		usleep(1000);
+	}
+}
+
+
+// Samples the set's records on this node in a background thread, then
+// publishes the resulting dictionary to all nodes (including this one).
+bool
+as_compression_dict_train_cmd(const char* ns_name, const char* set_name)
+{
+	as_namespace* ns = as_namespace_get_byname((char*)ns_name);
+
+	if (! ns) {
+		cf_warning(AS_STORAGE, "compression dict train - unknown namespace %s",
+				ns_name);
+		return false;
+	}
+
+	if (ns->storage_type != AS_STORAGE_ENGINE_SSD) {
+		cf_warning(AS_STORAGE, "{%s} compression dict train - not a device namespace",
+				ns->name);
+		return false;
+	}
+
+	uint16_t set_id = as_namespace_get_set_id(ns, set_name);
+
+	if (set_id == INVALID_SET_ID) {
+		cf_warning(AS_STORAGE, "{%s} compression dict train - unknown set %s",
+				ns->name, set_name);
+		return false;
+	}
+
+	as_compression_dicts* cd = &ns->compression_dicts;
+
+	if (cf_atomic32_cas(&cd->training, 0, 1) != 0) {
+		cf_warning(AS_STORAGE, "{%s} compression dict train - already training",
+				ns->name);
+		return false;
+	}
+
+	train_info* info = cf_malloc(sizeof(train_info));
+
+	memset(info, 0, offsetof(train_info, buf));
+	info->ns = ns;
+	info->set_id = set_id;
+	strcpy(info->set_name, set_name);
+
+	pthread_t thread;
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&thread, &attrs, run_train, info) != 0) {
+		cf_warning(AS_STORAGE, "{%s} compression dict train - failed thread create",
+				ns->name);
+		cf_free(info);
+		cf_atomic32_set(&cd->training, 0);
+		return false;
+	}
+
+	cf_info(AS_STORAGE, "{%s|%s} started training compression dictionary",
+			ns->name, set_name);
+
+	return true;
+}
+
+
+// Called periodically by the storage layer with a mask of dictionary bits that
+// may still be referenced by blocks on device. A dictionary that's been
+// superseded for its set, and isn't referenced at two consecutive censuses, is
+// retired - the gap covers writes that picked up the dictionary just before it
+// was superseded. Its memory is freed at the census after it's retired.
+void
+as_compression_dict_census(as_namespace* ns, uint64_t ref_mask)
+{
+	as_compression_dicts* cd = &ns->compression_dicts;
+
+	pthread_mutex_lock(&cd->lock);
+
+	as_compression_dict* dict = cd->retired;
+
+	while (dict) {
+		as_compression_dict* next = dict->next;
+
+		cf_free(dict);
+		dict = next;
+	}
+
+	cd->retired = NULL;
+
+	for (uint32_t id = 1; id <= cd->max_id; id++) {
+		dict = cd->dicts[id];
+
+		uint64_t* p_candidates = &cd->retire_candidates[id / 64];
+		uint64_t candidate_bit = 1UL << (id % 64);
+
+		if (! dict) {
+			*p_candidates &= ~candidate_bit;
+			continue;
+		}
+
+		as_set* p_set = as_namespace_get_set_by_id(ns, dict->set_id);
+
+		if ((p_set && cf_atomic32_get(p_set->compression_dict_id) == id) ||
+				(ref_mask & as_compression_dict_ref_bit((uint16_t)id)) != 0) {
+			*p_candidates &= ~candidate_bit;
+			continue;
+		}
+
+		if ((*p_candidates & candidate_bit) == 0) {
+			*p_candidates |= candidate_bit;
+			continue;
+		}
+
+		*p_candidates &= ~candidate_bit;
+
+		cd->dicts[id] = NULL;
+		dict->next = cd->retired;
+		cd->retired = dict;
+		cd->n_dicts--;
+		cd->n_retired++;
+
+		cf_info(AS_STORAGE, "{%s} retired compression dictionary %u", ns->name,
+				id);
+	}
+
+	pthread_mutex_unlock(&cd->lock);
+}
+
+
+//==========================================================
+// Local helpers - SMD callbacks.
+//
+
+bool
+dict_smd_conflict_cb(char* module, as_smd_item_t* existing_item,
+		as_smd_item_t* new_item, void* udata)
+{
+	// Dictionaries are immutable - the first one published under an id wins.
+	return existing_item->timestamp <= new_item->timestamp;
+}
+
+
+int
+dict_smd_accept_cb(char* module, as_smd_item_list_t* items, void* udata,
+		uint32_t accept_opt)
+{
+	if ((accept_opt & AS_SMD_ACCEPT_OPT_CREATE) != 0) {
+		g_dict_smd_loaded = true;
+		return 0;
+	}
+
+	for (int i = 0; i < (int)items->num_items; i++) {
+		as_smd_item_t* item = items->item[i];
+
+		if (item->action != AS_SMD_ACTION_SET) {
+			// Dictionaries are only ever retired locally.
+			cf_detail(AS_STORAGE, "{%s} ignoring dictionary delete", item->key);
+			continue;
+		}
+
+		uint32_t id;
+		as_namespace* ns = ns_from_smd_key(item->key, &id);
+
+		if (! ns) {
+			continue;
+		}
+
+		as_compression_dict* dict = dict_from_smd_value(ns, item->value, id);
+
+		if (dict) {
+			dict_install(ns, dict);
+		}
+	}
+
+	return 0;
+}
+
+
+int
+dict_smd_can_accept_cb(char* module, as_smd_item_t* item, void* udata)
+{
+	if (item->action != AS_SMD_ACTION_SET) {
+		return 0;
+	}
+
+	uint32_t id;
+	as_namespace* ns = ns_from_smd_key(item->key, &id);
+
+	if (! ns) {
+		return -1;
+	}
+
+	if (as_compression_dict_get(&ns->compression_dicts, (uint16_t)id)) {
+		cf_warning(AS_STORAGE, "{%s} ignoring duplicate dictionary id",
+				item->key);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+//==========================================================
+// Local helpers - SMD callbacks' helpers.
+//
+
+// SMD key is "ns-name|dict-id".
+as_namespace*
+ns_from_smd_key(const char* key, uint32_t* p_id)
+{
+	const char* tok = strchr(key, TOK_DELIMITER);
+
+	if (! tok) {
+		cf_warning(AS_STORAGE, "{%s} bad dictionary key", key);
+		return NULL;
+	}
+
+	as_namespace* ns = as_namespace_get_bybuf((uint8_t*)key,
+			(size_t)(tok - key));
+
+	if (! ns) {
+		cf_detail(AS_STORAGE, "skipping invalid ns");
+		return NULL;
+	}
+
+	char* end;
+	uint64_t id = strtoul(tok + 1, &end, 10);
+
+	if (*end != 0 || id == 0 || id >= MAX_COMPRESSION_DICTS) {
+		cf_warning(AS_STORAGE, "{%s} bad dictionary id", key);
+		return NULL;
+	}
+
+	*p_id = (uint32_t)id;
+
+	return ns;
+}
+
+
+// SMD value is "set-name|base64-dictionary".
+as_compression_dict*
+dict_from_smd_value(as_namespace* ns, const char* value, uint32_t id)
+{
+	const char* tok = strchr(value, TOK_DELIMITER);
+
+	if (! tok || tok == value || tok - value >= AS_SET_NAME_MAX_SIZE) {
+		cf_warning(AS_STORAGE, "{%s} dictionary %u has bad set name", ns->name,
+				id);
+		return NULL;
+	}
+
+	char set_name[AS_SET_NAME_MAX_SIZE];
+
+	memcpy(set_name, value, (size_t)(tok - value));
+	set_name[tok - value] = 0;
+
+	const char* b64 = tok + 1;
+	uint32_t b64_len = (uint32_t)strlen(b64);
+
+	if (cf_b64_decoded_buf_size(b64_len) > MAX_COMPRESSION_DICT_SIZE) {
+		cf_warning(AS_STORAGE, "{%s} dictionary %u too big", ns->name, id);
+		return NULL;
+	}
+
+	uint16_t set_id = as_namespace_get_create_set_id(ns, set_name);
+
+	if (set_id == INVALID_SET_ID) {
+		cf_warning(AS_STORAGE, "{%s} dictionary %u can't add set %s", ns->name,
+				id, set_name);
+		return NULL;
+	}
+
+	as_compression_dict* dict = cf_malloc(sizeof(as_compression_dict) +
+			cf_b64_decoded_buf_size(b64_len));
+
+	if (! cf_b64_validate_and_decode(b64, b64_len, dict->data, &dict->size)) {
+		cf_warning(AS_STORAGE, "{%s} dictionary %u bad base64", ns->name, id);
+		cf_free(dict);
+		return NULL;
+	}
+
+	dict->next = NULL;
+	dict->id = (uint16_t)id;
+	dict->set_id = set_id;
+	dict->adler = (uint32_t)adler32(adler32(0, NULL, 0), dict->data,
+			dict->size);
+
+	return dict;
+}
+
+
+void
+dict_install(as_namespace* ns, as_compression_dict* dict)
+{
+	as_compression_dicts* cd = &ns->compression_dicts;
+
+	pthread_mutex_lock(&cd->lock);
+
+	as_compression_dict* existing = cd->dicts[dict->id];
+
+	if (existing) {
+		// Normal on merge - blocks on device may already use ours, so keep it.
+		if (existing->adler != dict->adler) {
+			cf_warning(AS_STORAGE, "{%s} conflicting dictionary %u - keeping existing",
+					ns->name, dict->id);
+		}
+
+		pthread_mutex_unlock(&cd->lock);
+		cf_free(dict);
+		return;
+	}
+
+	cd->dicts[dict->id] = dict;
+	cd->n_dicts++;
+
+	if (dict->id > cd->max_id) {
+		cd->max_id = dict->id;
+	}
+
+	pthread_mutex_unlock(&cd->lock);
+
+	as_set* p_set = as_namespace_get_set_by_id(ns, dict->set_id);
+
+	// Newer dictionary (higher id) for a set supersedes older ones.
+	if (p_set) {
+		cf_atomic32_setmax(&p_set->compression_dict_id, dict->id);
+	}
+
+	cf_info(AS_STORAGE, "{%s} loaded compression dictionary %u (%u bytes) for set %u",
+			ns->name, dict->id, dict->size, dict->set_id);
+}
+
+
+//==========================================================
+// Local helpers - training.
+//
+
+void*
+run_train(void* arg)
+{
+	train_info* info = (train_info*)arg;
+	as_namespace* ns = info->ns;
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		if (info->size == MAX_COMPRESSION_DICT_SIZE) {
+			break;
+		}
+
+		as_partition_reservation rsv;
+		as_partition_reserve(ns, pid, &rsv);
+
+		info->n_partition_samples = 0;
+
+		as_index_reduce_live(rsv.tree, train_reduce_cb, (void*)info);
+		as_partition_release(&rsv);
+	}
+
+	if (info->size < MIN_DICT_SIZE) {
+		cf_warning(AS_STORAGE, "{%s|%s} not enough data to train compression dictionary",
+				ns->name, info->set_name);
+	}
+	else {
+		train_publish(info);
+	}
+
+	cf_atomic32_set(&ns->compression_dicts.training, 0);
+	cf_free(info);
+
+	return NULL;
+}
+
+
+// Samples are concatenated bin names and flattened particles - close to what
+// the device compressor sees. Later samples end up nearer the data, where zlib
+// matches are cheapest.
+void
+train_reduce_cb(as_index_ref* r_ref, void* udata)
+{
+	as_index* r = r_ref->r;
+	train_info* info = (train_info*)udata;
+	as_namespace* ns = info->ns;
+
+	if (info->n_partition_samples == MAX_PARTITION_SAMPLES ||
+			info->size == MAX_COMPRESSION_DICT_SIZE ||
+			as_index_get_set_id(r) != info->set_id ||
+			as_record_is_doomed(r, ns)) {
+		as_record_done(r_ref, ns);
+		return;
+	}
+
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r, &rd);
+	rd.io_class = AS_STORAGE_IO_SCAN;
+
+	if (as_storage_rd_load_n_bins(&rd) != 0) {
+		as_storage_record_close(&rd);
+		as_record_done(r_ref, ns);
+		return;
+	}
+
+	as_bin stack_bins[rd.ns->storage_data_in_memory ? 0 : rd.n_bins];
+
+	if (as_storage_rd_load_bins(&rd, stack_bins) != 0) {
+		as_storage_record_close(&rd);
+		as_record_done(r_ref, ns);
+		return;
+	}
+
+	uint32_t room = MAX_COMPRESSION_DICT_SIZE - info->size;
+
+	if (room > MAX_SAMPLE_SIZE) {
+		room = MAX_SAMPLE_SIZE;
+	}
+
+	uint8_t* start = info->buf + info->size;
+	uint8_t* at = start;
+
+	for (uint16_t i = 0; i < rd.n_bins; i++) {
+		as_bin* b = &rd.bins[i];
+
+		if (! as_bin_inuse(b)) {
+			break;
+		}
+
+		const char* name = ns->single_bin ?
+				"" : as_bin_get_name_from_id(ns, b->id);
+		uint32_t name_len = (uint32_t)strlen(name);
+		uint32_t flat_size = as_bin_particle_flat_size(b);
+
+		if ((uint32_t)(at - start) + name_len + flat_size > room) {
+			break;
+		}
+
+		memcpy(at, name, name_len);
+		at += name_len;
+		at += as_bin_particle_to_flat(b, at);
+	}
+
+	as_storage_record_close(&rd);
+	as_record_done(r_ref, ns);
+
+	if (at != start) {
+		info->size += (uint32_t)(at - start);
+		info->n_samples++;
+		info->n_partition_samples++;
+	}
+}
+
+
+void
+train_publish(train_info* info)
+{
+	as_namespace* ns = info->ns;
+	as_compression_dicts* cd = &ns->compression_dicts;
+
+	pthread_mutex_lock(&cd->lock);
+
+	uint32_t id = cd->max_id + 1;
+
+	pthread_mutex_unlock(&cd->lock);
+
+	if (id >= MAX_COMPRESSION_DICTS) {
+		cf_warning(AS_STORAGE, "{%s} out of compression dictionary ids",
+				ns->name);
+		return;
+	}
+
+	char smd_key[DICT_KEY_SIZE];
+
+	sprintf(smd_key, "%s%c%u", ns->name, TOK_DELIMITER, id);
+
+	size_t set_name_len = strlen(info->set_name);
+	char* smd_value = cf_malloc(set_name_len + 1 +
+			cf_b64_encoded_len(info->size) + 1);
+	char* p_write = smd_value;
+
+	memcpy(p_write, info->set_name, set_name_len);
+	p_write += set_name_len;
+	*p_write++ = TOK_DELIMITER;
+
+	cf_b64_encode(info->buf, info->size, p_write);
+	p_write[cf_b64_encoded_len(info->size)] = 0;
+
+	cf_info(AS_STORAGE, "{%s|%s} trained compression dictionary %u from %u samples (%u bytes)",
+			ns->name, info->set_name, id, info->n_samples, info->size);
+
+	// Broadcast the dictionary to all nodes (including this one).
+	as_smd_set_metadata(COMPRESSION_DICT_MODULE, smd_key, smd_value);
+
+	cf_free(smd_value);
+}
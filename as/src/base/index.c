@@ -27,10 +27,12 @@
 #include "base/index.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include <xmmintrin.h>
 
 #include "citrusleaf/alloc.h"
@@ -46,6 +48,8 @@
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/index_btree.h"
+#include "base/index_hash.h"
 #include "base/stats.h"
 
 
@@ -69,6 +73,34 @@ typedef struct as_index_ph_array_s {
 	as_index_ph	indexes[];
 } as_index_ph_array;
 
+// State of one digest's search, in a group searched in lockstep.
+typedef struct multi_search_s {
+	as_index_sprig		isprig;
+	uint32_t			seq;
+	int					rv; // 1 while searching, then as for search_optimistic
+	cf_arenax_handle	r_h;
+	as_index			*r;
+} multi_search;
+
+// A reduce fanned out across helper threads. Ref-counted - helpers may pop it
+// after the caller is done.
+typedef struct reduce_job_s {
+	as_index_tree		*tree;
+	as_index_reduce_fn	cb;
+	void				*udata;
+
+	cf_atomic32			next_sprig; // sprigs are claimed from the top down
+	uint32_t			n_sprigs_done;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+} reduce_job;
+
+typedef struct mapped_reduce_info_s {
+	as_index_sprig		*isprig;
+	as_index_ph_array	*v_a;
+} mapped_reduce_info;
+
 typedef struct as_index_ele_s {
 	struct as_index_ele_s	*parent;
 	cf_arenax_handle		me_h;
@@ -77,6 +109,22 @@ typedef struct as_index_ele_s {
 
 const size_t MAX_STACK_ARRAY_BYTES = 128 * 1024;
 
+// Gets first search without the sprig lock, this many times, before giving up
+// and searching under the lock.
+#define MAX_OPTIMISTIC_TRIES 2
+
+// Deeper than any valid red-black sprig - a search this deep is lost.
+#define MAX_OPTIMISTIC_DEPTH 128
+
+// Smaller trees aren't worth fanning out.
+#define MIN_PARALLEL_REDUCE_SIZE (64 * 1024)
+
+// Digests searched in lockstep - enough in flight to cover a memory miss.
+#define MULTI_GROUP_SIZE 16
+
+// Clients count as idle if no transactions completed over this long.
+#define TREE_GC_IDLE_CHECK_NS (1000UL * 1000 * 1000)
+
 
 //==========================================================
 // Globals.
@@ -84,31 +132,63 @@ const size_t MAX_STACK_ARRAY_BYTES = 128 * 1024;
 
 static cf_queue g_gc_queue;
 
+static pthread_mutex_t g_gc_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_gc_next_ns = 0; // rate limit - when the next sprig may start
+static uint64_t g_gc_idle_check_ns = 0;
+static uint64_t g_gc_n_client_trans = 0;
+static bool g_gc_clients_idle = false;
+
+static cf_atomic32 g_gc_n_active = 0;
+static cf_atomic64 g_gc_n_pending = 0; // elements in queued and active trees
+
+static cf_queue g_reduce_queue;
+static uint32_t g_n_reduce_threads = 0;
+
 
 //==========================================================
 // Forward declarations.
 //
 
-void *run_index_tree_gc(void *unused);
+void *run_index_tree_gc(void *udata);
+bool tree_gc_clients_idle(void);
+void tree_gc_throttle(uint64_t n_elements);
+void *run_index_reduce(void *unused);
+void reduce_job_work(reduce_job *job);
+void reduce_job_release(reduce_job *job);
 void as_index_tree_destroy(as_index_tree *tree);
 void as_index_sprig_done(as_index_sprig *isprig, as_index *r, cf_arenax_handle r_h);
 bool as_index_sprig_invalid_record_done(as_index_sprig *isprig, as_index_ref *index_ref);
 
-uint64_t as_index_sprig_reduce_partial(as_index_sprig *isprig, uint64_t sample_count, as_index_reduce_fn cb, void *udata);
+uint64_t as_index_sprig_reduce_partial(as_index_sprig *isprig, uint64_t sample_count, const cf_digest *from, as_index_reduce_fn cb, void *udata);
 void as_index_sprig_traverse(as_index_sprig *isprig, cf_arenax_handle r_h, as_index_ph_array *v_a);
+void as_index_sprig_traverse_from(as_index_sprig *isprig, cf_arenax_handle r_h, const cf_digest *from, as_index_ph_array *v_a);
 void as_index_sprig_traverse_purge(as_index_sprig *isprig, cf_arenax_handle r_h);
+bool as_index_sprig_mapped_reduce_cb(cf_arenax_handle r_h, void *udata);
+bool as_index_sprig_mapped_purge_cb(cf_arenax_handle r_h, void *udata);
 
 int as_index_sprig_exists(as_index_sprig *isprig, cf_digest *keyd);
 int as_index_sprig_get_vlock(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
+int as_index_sprig_vlock_reserved(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
 int as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
 int as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd);
+int as_index_sprig_get_insert_vlock_mapped(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
+int as_index_sprig_delete_mapped(as_index_sprig *isprig, cf_digest *keyd);
 
+bool as_index_sprig_get_optimistic(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref, int *p_rv);
+int as_index_sprig_search_optimistic(as_index_sprig *isprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+void as_index_sprig_search_multi(multi_search *ms, cf_digest *keyds[], uint32_t n_keys);
 int as_index_sprig_search_lockless(as_index_sprig *isprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+bool as_index_sprig_find_parent(as_index_sprig *isprig, const cf_digest *keyd, cf_arenax_handle r_h, as_index **p_parent, bool *p_left);
 void as_index_sprig_insert_rebalance(as_index_sprig *isprig, as_index *root_parent, as_index_ele *ele);
 void as_index_sprig_delete_rebalance(as_index_sprig *isprig, as_index *root_parent, as_index_ele *ele);
 void as_index_rotate_left(as_index_ele *a, as_index_ele *b);
 void as_index_rotate_right(as_index_ele *a, as_index_ele *b);
 
+
+//==========================================================
+// Inlines & macros.
+//
+
 static inline void
 as_index_sprig_from_i(as_index_tree *tree, as_index_sprig *isprig,
 		uint32_t sprig_i)
@@ -119,8 +199,10 @@ as_index_sprig_from_i(as_index_tree *tree, as_index_sprig *isprig,
 	isprig->destructor = tree->shared->destructor;
 	isprig->destructor_udata = tree->shared->destructor_udata;
 	isprig->arena = tree->arena;
+	isprig->type = tree->shared->type;
 	isprig->pair = tree_locks(tree) + lock_i;
 	isprig->sprig = tree_sprigs(tree) + sprig_i;
+	isprig->tree = tree;
 }
 
 static inline void
@@ -139,8 +221,134 @@ as_index_sprig_from_keyd(as_index_tree *tree, as_index_sprig *isprig,
 	isprig->destructor = tree->shared->destructor;
 	isprig->destructor_udata = tree->shared->destructor_udata;
 	isprig->arena = tree->arena;
+	isprig->type = tree->shared->type;
 	isprig->pair = tree_locks(tree) + lock_i;
 	isprig->sprig = tree_sprigs(tree) + sprig_i;
+	isprig->tree = tree;
+}
+
+// Returns false if the set isn't indexed. Set sprigs are always btrees, and
+// have no lockless readers.
+static inline bool
+as_index_sprig_from_set_id(as_index_tree *tree, as_index_sprig *isprig,
+		uint16_t set_id)
+{
+	uint32_t set_sprig_id = tree->shared->set_sprig_ids[set_id];
+
+	if (set_sprig_id == 0) {
+		return false;
+	}
+
+	isprig->destructor = tree->shared->destructor;
+	isprig->destructor_udata = tree->shared->destructor_udata;
+	isprig->arena = tree->arena;
+	isprig->type = AS_INDEX_TREE_BTREE;
+	isprig->pair = tree_set_locks(tree);
+	isprig->sprig = tree_set_sprigs(tree) + set_sprig_id - 1;
+	isprig->tree = tree;
+
+	return true;
+}
+
+// Seqlock around sprig restructuring - called under the pair's lock.
+static inline void
+sprig_write_begin(as_lock_pair *pair)
+{
+	cf_atomic32_incr(&pair->seq); // full barrier - odd before any change
+}
+
+static inline void
+sprig_write_end(as_lock_pair *pair)
+{
+	cf_atomic32_incr(&pair->seq); // full barrier - even after all changes
+}
+
+static inline uint32_t
+sprig_read_begin(const as_lock_pair *pair)
+{
+	return __atomic_load_n(&pair->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline bool
+sprig_read_valid(const as_lock_pair *pair, uint32_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&pair->seq, __ATOMIC_RELAXED) == seq;
+}
+
+// B+tree and hash sprigs map digests to handles, instead of linking elements.
+// Their memory is freed as they change - only search them under the lock.
+static inline bool
+sprig_is_mapped(const as_index_sprig *isprig)
+{
+	return isprig->type != AS_INDEX_TREE_RED_BLACK;
+}
+
+static inline int
+mapped_search(const as_index_sprig *isprig, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	return isprig->type == AS_INDEX_TREE_HASH ?
+			as_index_hash_search(isprig->sprig, isprig->arena, keyd, ret_h) :
+			as_index_btree_search(isprig->sprig, keyd, ret_h);
+}
+
+static inline void
+mapped_insert(as_index_sprig *isprig, const cf_digest *keyd,
+		cf_arenax_handle r_h)
+{
+	if (isprig->type == AS_INDEX_TREE_HASH) {
+		as_index_hash_insert(isprig->sprig, keyd, r_h);
+	}
+	else {
+		as_index_btree_insert(isprig->sprig, keyd, r_h);
+	}
+}
+
+static inline int
+mapped_delete(as_index_sprig *isprig, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	return isprig->type == AS_INDEX_TREE_HASH ?
+			as_index_hash_delete(isprig->sprig, isprig->arena, keyd, ret_h) :
+			as_index_btree_delete(isprig->sprig, keyd, ret_h);
+}
+
+// Resolve a handle read without the sprig lock - it may be garbage, so don't
+// resolve it into a stage that doesn't exist.
+static inline as_index *
+resolve_unsafe(cf_arenax *arena, cf_arenax_handle h)
+{
+	uint64_t stage_id = h >> ELEMENT_ID_NUM_BITS;
+
+	if (stage_id >= CF_ARENAX_MAX_STAGES ||
+			(h & ELEMENT_ID_MASK) >= arena->stage_capacity) {
+		return NULL;
+	}
+
+	uint8_t *stage = ((uint8_t *volatile *)arena->stages)[stage_id];
+
+	return stage ?
+			(as_index *)(stage + (h & ELEMENT_ID_MASK) * arena->element_size) :
+			NULL;
+}
+
+// Reserve an element found without the sprig lock, only if it's still live. A
+// freed element's ref-count is 0, or the arena's free magic (negative), and
+// an increment could race its reallocation.
+static inline bool
+reserve_if_live(as_index *r)
+{
+	int32_t rc;
+
+	while ((rc = (int32_t)cf_atomic32_get(r->rc)) > 0) {
+		if (cf_atomic32_cas(&r->rc, rc, rc + 1) == rc) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 
@@ -159,8 +367,13 @@ as_index_tree_gc_init()
 	pthread_attr_init(&attrs);
 	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
 
-	if (pthread_create(&thread, &attrs, run_index_tree_gc, NULL) != 0) {
-		cf_crash(AS_INDEX, "failed to create garbage collection thread");
+	// The first thread always works - the rest are helpers, for when clients
+	// are idle.
+	for (uint32_t i = 0; i < g_config.n_index_tree_gc_threads; i++) {
+		if (pthread_create(&thread, &attrs, run_index_tree_gc,
+				(void*)(uint64_t)i) != 0) {
+			cf_crash(AS_INDEX, "failed to create garbage collection thread");
+		}
 	}
 }
 
@@ -172,6 +385,22 @@ as_index_tree_gc_queue_size()
 }
 
 
+// Trees currently being destroyed.
+uint32_t
+as_index_tree_gc_active()
+{
+	return (uint32_t)cf_atomic32_get(g_gc_n_active);
+}
+
+
+// Elements left to destroy, in queued and active trees.
+uint64_t
+as_index_tree_gc_pending()
+{
+	return (uint64_t)cf_atomic64_get(g_gc_n_pending);
+}
+
+
 //==========================================================
 // Public API - create/destroy/size a tree.
 //
@@ -180,9 +409,12 @@ as_index_tree_gc_queue_size()
 as_index_tree *
 as_index_tree_create(as_index_tree_shared *shared, cf_arenax *arena)
 {
-	size_t locks_size = sizeof(cf_mutex) * shared->n_lock_pairs * 2;
+	size_t locks_size = sizeof(as_lock_pair) * shared->n_lock_pairs;
 	size_t sprigs_size = sizeof(as_sprig) * shared->n_sprigs;
-	size_t tree_size = sizeof(as_index_tree) + locks_size + sprigs_size;
+	size_t set_sprigs_size = shared->n_set_sprigs == 0 ? 0 :
+			sizeof(as_lock_pair) + sizeof(as_sprig) * shared->n_set_sprigs;
+	size_t tree_size = sizeof(as_index_tree) + locks_size + sprigs_size +
+			set_sprigs_size;
 
 	as_index_tree *tree = cf_rc_alloc(tree_size);
 
@@ -195,12 +427,24 @@ as_index_tree_create(as_index_tree_shared *shared, cf_arenax *arena)
 	while (pair < pair_end) {
 		cf_mutex_init(&pair->lock);
 		cf_mutex_init(&pair->reduce_lock);
+		pair->seq = 0;
 		pair++;
 	}
 
 	// The tree starts empty.
 	memset(tree_sprigs(tree), 0, sprigs_size);
 
+	if (shared->n_set_sprigs != 0) {
+		pair = tree_set_locks(tree);
+
+		cf_mutex_init(&pair->lock);
+		cf_mutex_init(&pair->reduce_lock);
+		pair->seq = 0;
+
+		memset(tree_set_sprigs(tree), 0,
+				sizeof(as_sprig) * shared->n_set_sprigs);
+	}
+
 	return tree;
 }
 
@@ -220,6 +464,7 @@ as_index_tree_release(as_index_tree *tree)
 
 	// TODO - call as_index_tree_destroy() directly if tree is empty?
 
+	cf_atomic64_add(&g_gc_n_pending, (int64_t)as_index_tree_size(tree));
 	cf_queue_push(&g_gc_queue, &tree);
 
 	return 0;
@@ -243,6 +488,17 @@ as_index_tree_size(as_index_tree *tree)
 }
 
 
+// Get the number of elements in an indexed set - 0 if the set isn't indexed.
+uint64_t
+as_index_tree_set_size(as_index_tree *tree, uint16_t set_id)
+{
+	uint32_t set_sprig_id = tree->shared->set_sprig_ids[set_id];
+
+	return set_sprig_id == 0 ?
+			0 : tree_set_sprigs(tree)[set_sprig_id - 1].n_elements;
+}
+
+
 //==========================================================
 // Public API - reduce a tree.
 //
@@ -268,8 +524,8 @@ as_index_reduce_partial(as_index_tree *tree, uint64_t sample_count,
 		as_index_sprig isprig;
 		as_index_sprig_from_i(tree, &isprig, (uint32_t)i);
 
-		sample_count -= as_index_sprig_reduce_partial(&isprig, sample_count, cb,
-				udata);
+		sample_count -= as_index_sprig_reduce_partial(&isprig, sample_count,
+				NULL, cb, udata);
 
 		if (sample_count == 0) {
 			break;
@@ -278,6 +534,149 @@ as_index_reduce_partial(as_index_tree *tree, uint64_t sample_count,
 }
 
 
+// Make a callback for every element in the tree that comes after the specified
+// digest in reduce order - i.e. every smaller digest - from outside the tree
+// lock. The digest needn't be in the tree, so a reduce that stopped after some
+// element can resume from it.
+void
+as_index_reduce_from(as_index_tree *tree, const cf_digest *keyd,
+		as_index_reduce_fn cb, void *udata)
+{
+	as_index_sprig isprig;
+	as_index_sprig_from_keyd(tree, &isprig, keyd);
+
+	int start_i = (int)(isprig.sprig - tree_sprigs(tree));
+
+	// Sprigs with larger digests were done - finish the digest's own sprig.
+	as_index_sprig_reduce_partial(&isprig, AS_REDUCE_ALL, keyd, cb, udata);
+
+	for (int i = start_i - 1; i >= 0; i--) {
+		as_index_sprig_from_i(tree, &isprig, (uint32_t)i);
+		as_index_sprig_reduce_partial(&isprig, AS_REDUCE_ALL, NULL, cb, udata);
+	}
+}
+
+
+// Make a callback for every element in the set, from outside the tree lock.
+// Visits only the set's elements, if the set is indexed - otherwise makes no
+// callbacks and returns false, so the caller can reduce the whole tree.
+bool
+as_index_reduce_set(as_index_tree *tree, uint16_t set_id,
+		as_index_reduce_fn cb, void *udata)
+{
+	return as_index_reduce_set_partial(tree, set_id, AS_REDUCE_ALL, cb, udata);
+}
+
+
+bool
+as_index_reduce_set_partial(as_index_tree *tree, uint16_t set_id,
+		uint64_t sample_count, as_index_reduce_fn cb, void *udata)
+{
+	as_index_sprig isprig;
+
+	if (! as_index_sprig_from_set_id(tree, &isprig, set_id)) {
+		return false;
+	}
+
+	as_index_sprig_reduce_partial(&isprig, sample_count, NULL, cb, udata);
+
+	return true;
+}
+
+
+// Like as_index_reduce_from(), but only for the set's elements. Set sprigs are
+// in the same (descending digest) order as the whole tree, so a cursor from
+// either kind of reduce works for both.
+bool
+as_index_reduce_set_from(as_index_tree *tree, uint16_t set_id,
+		const cf_digest *keyd, as_index_reduce_fn cb, void *udata)
+{
+	as_index_sprig isprig;
+
+	if (! as_index_sprig_from_set_id(tree, &isprig, set_id)) {
+		return false;
+	}
+
+	as_index_sprig_reduce_partial(&isprig, AS_REDUCE_ALL, keyd, cb, udata);
+
+	return true;
+}
+
+
+void
+as_index_reduce_init()
+{
+	g_n_reduce_threads = g_config.n_index_reduce_threads;
+
+	if (g_n_reduce_threads == 0) {
+		return;
+	}
+
+	cf_queue_init(&g_reduce_queue, sizeof(reduce_job*), 1024, true);
+
+	pthread_t thread;
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	for (uint32_t i = 0; i < g_n_reduce_threads; i++) {
+		if (pthread_create(&thread, &attrs, run_index_reduce, NULL) != 0) {
+			cf_crash(AS_INDEX, "failed to create index reduce thread");
+		}
+	}
+}
+
+
+// Make a callback for every element in the tree, from outside the tree lock,
+// with sprigs reduced concurrently by the calling thread and helper threads.
+// Callbacks within a sprig are in order, but callback must be thread-safe. Each
+// thread holds at most one sprig's worth of element references at a time.
+void
+as_index_reduce_parallel(as_index_tree *tree, as_index_reduce_fn cb,
+		void *udata)
+{
+	uint32_t n_sprigs = tree->shared->n_sprigs;
+	uint32_t n_helpers = g_n_reduce_threads < n_sprigs - 1 ?
+			g_n_reduce_threads : n_sprigs - 1;
+
+	if (n_helpers == 0 ||
+			as_index_tree_size(tree) < MIN_PARALLEL_REDUCE_SIZE) {
+		as_index_reduce(tree, cb, udata);
+		return;
+	}
+
+	reduce_job *job = cf_rc_alloc(sizeof(reduce_job));
+
+	job->tree = tree;
+	job->cb = cb;
+	job->udata = udata;
+	job->next_sprig = n_sprigs;
+	job->n_sprigs_done = 0;
+
+	pthread_mutex_init(&job->lock, NULL);
+	pthread_cond_init(&job->cond, NULL);
+
+	for (uint32_t i = 0; i < n_helpers; i++) {
+		cf_rc_reserve(job);
+		cf_queue_push(&g_reduce_queue, &job);
+	}
+
+	// Busy helpers may be late - the caller always works too.
+	reduce_job_work(job);
+
+	pthread_mutex_lock(&job->lock);
+
+	while (job->n_sprigs_done < n_sprigs) {
+		pthread_cond_wait(&job->cond, &job->lock);
+	}
+
+	pthread_mutex_unlock(&job->lock);
+
+	reduce_job_release(job);
+}
+
+
 //==========================================================
 // Public API - get/insert/delete an element in a tree.
 //
@@ -314,6 +713,33 @@ as_index_get_vlock(as_index_tree *tree, cf_digest *keyd,
 }
 
 
+// Bring the elements for n_keys digests, each in its own tree, into cache.
+// Searches are interleaved, prefetching each search's next element while
+// stepping the others, so memory misses overlap instead of being paid one
+// after another. Caller must hold the trees reserved.
+void
+as_index_prefetch_multi(as_index_tree *trees[], cf_digest *keyds[],
+		uint32_t n_keys)
+{
+	multi_search ms[MULTI_GROUP_SIZE];
+
+	for (uint32_t base = 0; base < n_keys; base += MULTI_GROUP_SIZE) {
+		uint32_t n = n_keys - base;
+
+		if (n > MULTI_GROUP_SIZE) {
+			n = MULTI_GROUP_SIZE;
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			as_index_sprig_from_keyd(trees[base + i], &ms[i].isprig,
+					keyds[base + i]);
+		}
+
+		as_index_sprig_search_multi(ms, keyds + base, n);
+	}
+}
+
+
 // If there's an element with specified digest in the tree, return a locked
 // and reserved reference to it in index_ref. If not, create an element with
 // this digest, insert it into the tree, and return a locked and reserved
@@ -351,26 +777,374 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 }
 
 
+// Move the element at r_h to a newly allocated element, and free r_h, so the
+// arena stage it's in can be emptied. Moves only an element nobody else holds,
+// so all it takes is re-linking under the sprig (and set index) locks.
+//
+// Returns:
+//		 0 - moved
+//		-1 - r_h isn't an element in this tree (e.g. it's free)
+//		-2 - element is reserved, didn't move it
+//		-3 - error - could not allocate arena stage
+int
+as_index_relocate(as_index_tree *tree, cf_arenax_handle r_h)
+{
+	as_index *r = (as_index *)cf_arenax_resolve(tree->arena, r_h);
+
+	// If r_h isn't a live element of this tree, this is garbage - it then
+	// won't be found at r_h.
+	cf_digest keyd = r->keyd;
+
+	as_index_sprig isprig;
+	as_index_sprig_from_keyd(tree, &isprig, &keyd);
+
+	cf_mutex_lock(&isprig.pair->lock);
+
+	as_index *parent = NULL;
+	bool left = false;
+	cf_arenax_handle *leaf_h = NULL;
+
+	if (isprig.type == AS_INDEX_TREE_BTREE) {
+		leaf_h = as_index_btree_find(isprig.sprig, &keyd);
+
+		if (! leaf_h || *leaf_h != r_h) {
+			cf_mutex_unlock(&isprig.pair->lock);
+			return -1;
+		}
+	}
+	else if (isprig.type == AS_INDEX_TREE_HASH) {
+		cf_arenax_handle t_h;
+
+		if (as_index_hash_search(isprig.sprig, isprig.arena, &keyd, &t_h) != 0 ||
+				t_h != r_h) {
+			cf_mutex_unlock(&isprig.pair->lock);
+			return -1;
+		}
+	}
+	else if (! as_index_sprig_find_parent(&isprig, &keyd, r_h, &parent,
+			&left)) {
+		cf_mutex_unlock(&isprig.pair->lock);
+		return -1;
+	}
+
+	// Reduces reserve elements under only the reduce lock.
+	cf_mutex_lock(&isprig.pair->reduce_lock);
+
+	// Set reduces likewise, under the set index reduce lock.
+	uint16_t set_id = as_index_get_set_id(r);
+	as_index_sprig set_isprig;
+	bool has_set_index = as_index_sprig_from_set_id(tree, &set_isprig, set_id);
+
+	if (has_set_index) {
+		cf_mutex_lock(&set_isprig.pair->lock);
+		cf_mutex_lock(&set_isprig.pair->reduce_lock);
+	}
+
+	int rv = 0;
+
+	// Holding the only reference - make r look freed to lockless gets, so none
+	// can reserve it while (or after) it moves.
+	if (cf_atomic32_cas(&r->rc, 1, 0) != 1) {
+		rv = -2;
+	}
+	// A record being created may have got its set (and set index entry) since
+	// we looked - unlikely, try again later.
+	else if (as_index_get_set_id(r) != set_id) {
+		cf_atomic32_set(&r->rc, 1);
+		rv = -2;
+	}
+
+	cf_arenax_handle new_h = 0;
+
+	if (rv == 0 && (new_h = cf_arenax_alloc(isprig.arena)) == 0) {
+		cf_atomic32_set(&r->rc, 1);
+		rv = -3;
+	}
+
+	if (rv != 0) {
+		if (has_set_index) {
+			cf_mutex_unlock(&set_isprig.pair->reduce_lock);
+			cf_mutex_unlock(&set_isprig.pair->lock);
+		}
+
+		cf_mutex_unlock(&isprig.pair->reduce_lock);
+		cf_mutex_unlock(&isprig.pair->lock);
+		return rv;
+	}
+
+	as_index *new_r = (as_index *)cf_arenax_resolve(isprig.arena, new_h);
+
+	memcpy(new_r, r, sizeof(as_index));
+	new_r->rc = 1;
+
+	sprig_write_begin(isprig.pair);
+
+	if (leaf_h) {
+		*leaf_h = new_h;
+	}
+	else if (isprig.type == AS_INDEX_TREE_HASH) {
+		as_index_hash_replace(isprig.sprig, &keyd, r_h, new_h);
+	}
+	else if (! parent) {
+		isprig.sprig->root_h = new_h;
+	}
+	else if (left) {
+		parent->left_h = new_h;
+	}
+	else {
+		parent->right_h = new_h;
+	}
+
+	sprig_write_end(isprig.pair);
+
+	if (has_set_index) {
+		cf_arenax_handle *set_leaf_h = as_index_btree_find(set_isprig.sprig,
+				&keyd);
+
+		if (set_leaf_h) {
+			*set_leaf_h = new_h;
+		}
+
+		cf_mutex_unlock(&set_isprig.pair->reduce_lock);
+		cf_mutex_unlock(&set_isprig.pair->lock);
+	}
+
+	cf_mutex_unlock(&isprig.pair->reduce_lock);
+	cf_mutex_unlock(&isprig.pair->lock);
+
+	cf_arenax_free(isprig.arena, r_h);
+
+	return 0;
+}
+
+
+// Called with the record locked, once a newly created record's set-ID is
+// written. If the set is indexed, adds the record to the set's sprig - set
+// reduces will then find it (and skip it until it's valid).
+void
+as_index_set_index_insert(as_index_tree *tree, as_index_ref *r_ref)
+{
+	as_index_sprig isprig;
+
+	if (! as_index_sprig_from_set_id(tree, &isprig,
+			as_index_get_set_id(r_ref->r))) {
+		return;
+	}
+
+	cf_mutex_lock(&isprig.pair->lock);
+	cf_mutex_lock(&isprig.pair->reduce_lock);
+
+	as_index_btree_insert(isprig.sprig, &r_ref->r->keyd, r_ref->r_h);
+	isprig.sprig->n_elements++;
+
+	cf_mutex_unlock(&isprig.pair->reduce_lock);
+	cf_mutex_unlock(&isprig.pair->lock);
+}
+
+
+// Called as a record leaves the tree, or with the record locked before its
+// set-ID is cleared. If the set is indexed, removes the record from the set's
+// sprig.
+void
+as_index_set_index_delete(as_index_tree *tree, as_index *r)
+{
+	as_index_sprig isprig;
+
+	if (! as_index_sprig_from_set_id(tree, &isprig, as_index_get_set_id(r))) {
+		return;
+	}
+
+	cf_arenax_handle r_h;
+
+	cf_mutex_lock(&isprig.pair->lock);
+	cf_mutex_lock(&isprig.pair->reduce_lock);
+
+	if (as_index_btree_delete(isprig.sprig, &r->keyd, &r_h) == 0) {
+		isprig.sprig->n_elements--;
+	}
+
+	cf_mutex_unlock(&isprig.pair->reduce_lock);
+	cf_mutex_unlock(&isprig.pair->lock);
+}
+
+
 //==========================================================
 // Local helpers - garbage collection, generic.
 //
 
 void *
-run_index_tree_gc(void *unused)
+run_index_tree_gc(void *udata)
 {
+	bool is_helper = (uint64_t)udata != 0;
 	as_index_tree *tree;
 
-	while (cf_queue_pop(&g_gc_queue, &tree, CF_QUEUE_FOREVER) == CF_QUEUE_OK) {
+	while (true) {
+		if (is_helper && ! tree_gc_clients_idle()) {
+			sleep(1);
+			continue;
+		}
+
+		// Helpers look again at clients now and then, even if trees keep
+		// coming.
+		int rv = cf_queue_pop(&g_gc_queue, &tree,
+				is_helper ? 1000 : CF_QUEUE_FOREVER);
+
+		if (rv == CF_QUEUE_EMPTY) {
+			continue;
+		}
+
+		if (rv != CF_QUEUE_OK) {
+			break;
+		}
+
+		cf_atomic32_incr(&g_gc_n_active);
 		as_index_tree_destroy(tree);
+		cf_atomic32_decr(&g_gc_n_active);
+
+		cf_atomic64_incr(&g_stats.tree_gc_trees_destroyed);
+	}
+
+	return NULL;
+}
+
+
+// Cached for a second - sums client transactions over all namespaces.
+bool
+tree_gc_clients_idle(void)
+{
+	uint64_t now = cf_getns();
+
+	pthread_mutex_lock(&g_gc_lock);
+
+	if (now - g_gc_idle_check_ns >= TREE_GC_IDLE_CHECK_NS) {
+		uint64_t n_trans = 0;
+
+		for (uint32_t i = 0; i < g_config.n_namespaces; i++) {
+			as_namespace *ns = g_config.namespaces[i];
+
+			n_trans += ns->n_client_read_success +
+					ns->n_client_read_not_found +
+					ns->n_client_write_success +
+					ns->n_client_delete_success +
+					ns->n_client_udf_complete +
+					ns->n_batch_sub_read_success;
+		}
+
+		g_gc_clients_idle = n_trans == g_gc_n_client_trans;
+		g_gc_n_client_trans = n_trans;
+		g_gc_idle_check_ns = now;
+	}
+
+	bool idle = g_gc_clients_idle;
+
+	pthread_mutex_unlock(&g_gc_lock);
+
+	return idle;
+}
+
+
+// Called between sprigs - paces all gc threads together to the configured
+// rate while clients are active, otherwise just yields.
+void
+tree_gc_throttle(uint64_t n_elements)
+{
+	uint32_t max_rate = g_config.index_tree_gc_max_rate;
+
+	if (max_rate == 0 || n_elements == 0 || tree_gc_clients_idle()) {
+		sched_yield();
+		return;
+	}
+
+	uint64_t now = cf_getns();
+
+	pthread_mutex_lock(&g_gc_lock);
+
+	// Don't save up - a burst after a quiet spell is what we're avoiding.
+	if (g_gc_next_ns < now) {
+		g_gc_next_ns = now;
+	}
+
+	g_gc_next_ns += n_elements * 1000000000 / max_rate;
+
+	uint64_t until_ns = g_gc_next_ns;
+
+	pthread_mutex_unlock(&g_gc_lock);
+
+	if (until_ns > now) {
+		usleep((useconds_t)((until_ns - now) / 1000));
+	}
+}
+
+
+void *
+run_index_reduce(void *unused)
+{
+	reduce_job *job;
+
+	while (cf_queue_pop(&g_reduce_queue, &job, CF_QUEUE_FOREVER) ==
+			CF_QUEUE_OK) {
+		reduce_job_work(job);
+		reduce_job_release(job);
 	}
 
 	return NULL;
 }
 
 
+// Claim and reduce sprigs until there are none left. Once the last sprig is
+// done the caller may return, so the tree must not be touched after a failed
+// claim.
+void
+reduce_job_work(reduce_job *job)
+{
+	int32_t sprig_i;
+
+	while ((sprig_i = (int32_t)cf_atomic32_decr(&job->next_sprig)) >= 0) {
+		as_index_sprig isprig;
+		as_index_sprig_from_i(job->tree, &isprig, (uint32_t)sprig_i);
+
+		as_index_sprig_reduce_partial(&isprig, AS_REDUCE_ALL, NULL, job->cb,
+				job->udata);
+
+		pthread_mutex_lock(&job->lock);
+
+		if (++job->n_sprigs_done == job->tree->shared->n_sprigs) {
+			pthread_cond_signal(&job->cond);
+		}
+
+		pthread_mutex_unlock(&job->lock);
+	}
+}
+
+
+void
+reduce_job_release(reduce_job *job)
+{
+	if (cf_rc_release(job) == 0) {
+		pthread_mutex_destroy(&job->lock);
+		pthread_cond_destroy(&job->cond);
+		cf_rc_free(job);
+	}
+}
+
+
 void
 as_index_tree_destroy(as_index_tree *tree)
 {
+	// Set sprigs don't hold references - just free their nodes.
+	if (tree->shared->n_set_sprigs != 0) {
+		as_sprig* set_sprig = tree_set_sprigs(tree);
+		as_sprig* set_sprig_end = set_sprig + tree->shared->n_set_sprigs;
+
+		while (set_sprig < set_sprig_end) {
+			as_index_btree_purge(set_sprig, NULL, NULL);
+			set_sprig++;
+		}
+
+		cf_mutex_destroy(&tree_set_locks(tree)->lock);
+		cf_mutex_destroy(&tree_set_locks(tree)->reduce_lock);
+	}
+
 	as_sprig* sprig = tree_sprigs(tree);
 	as_sprig* sprig_end = sprig + tree->shared->n_sprigs;
 
@@ -380,9 +1154,31 @@ as_index_tree_destroy(as_index_tree *tree)
 		isprig.destructor = tree->shared->destructor;
 		isprig.destructor_udata = tree->shared->destructor_udata;
 		isprig.arena = tree->arena;
+		isprig.type = tree->shared->type;
 		isprig.sprig = sprig;
+		isprig.tree = tree;
+
+		uint64_t n_elements = sprig->n_elements;
+
+		if (isprig.type == AS_INDEX_TREE_BTREE) {
+			as_index_btree_purge(isprig.sprig, as_index_sprig_mapped_purge_cb,
+					&isprig);
+		}
+		else if (isprig.type == AS_INDEX_TREE_HASH) {
+			as_index_hash_purge(isprig.sprig, as_index_sprig_mapped_purge_cb,
+					&isprig);
+		}
+		else {
+			as_index_sprig_traverse_purge(&isprig, isprig.sprig->root_h);
+		}
+
+		cf_atomic64_sub(&g_gc_n_pending, (int64_t)n_elements);
+		cf_atomic64_add(&g_stats.tree_gc_elements_destroyed,
+				(int64_t)n_elements);
+
+		// Spread the arena and storage frees out, a sprig at a time.
+		tree_gc_throttle(n_elements);
 
-		as_index_sprig_traverse_purge(&isprig, isprig.sprig->root_h);
 		sprig++;
 	}
 
@@ -441,10 +1237,10 @@ as_index_sprig_invalid_record_done(as_index_sprig *isprig,
 //
 
 // Make a callback for a specified number of elements in the tree, from outside
-// the tree lock.
+// the tree lock. If from is not NULL, skip elements with digests >= from.
 uint64_t
 as_index_sprig_reduce_partial(as_index_sprig *isprig, uint64_t sample_count,
-		as_index_reduce_fn cb, void *udata)
+		const cf_digest *from, as_index_reduce_fn cb, void *udata)
 {
 	bool reduce_all = sample_count == AS_REDUCE_ALL;
 
@@ -474,7 +1270,36 @@ as_index_sprig_reduce_partial(as_index_sprig *isprig, uint64_t sample_count,
 
 	// Recursively, fetch all the value pointers into this array, so we can make
 	// all the callbacks outside the big lock.
-	as_index_sprig_traverse(isprig, isprig->sprig->root_h, v_a);
+	if (isprig->type == AS_INDEX_TREE_BTREE) {
+		mapped_reduce_info bri = { .isprig = isprig, .v_a = v_a };
+
+		if (from) {
+			as_index_btree_traverse_from(isprig->sprig, from,
+					as_index_sprig_mapped_reduce_cb, &bri);
+		}
+		else {
+			as_index_btree_traverse(isprig->sprig,
+					as_index_sprig_mapped_reduce_cb, &bri);
+		}
+	}
+	else if (isprig->type == AS_INDEX_TREE_HASH) {
+		mapped_reduce_info bri = { .isprig = isprig, .v_a = v_a };
+
+		if (from) {
+			as_index_hash_traverse_from(isprig->sprig, isprig->arena, from,
+					as_index_sprig_mapped_reduce_cb, &bri);
+		}
+		else {
+			as_index_hash_traverse(isprig->sprig, isprig->arena,
+					as_index_sprig_mapped_reduce_cb, &bri);
+		}
+	}
+	else if (from) {
+		as_index_sprig_traverse_from(isprig, isprig->sprig->root_h, from, v_a);
+	}
+	else {
+		as_index_sprig_traverse(isprig, isprig->sprig->root_h, v_a);
+	}
 
 	cf_detail(AS_INDEX, "sprig reduce took %lu ms", cf_getms() - start_ms);
 
@@ -536,6 +1361,39 @@ as_index_sprig_traverse(as_index_sprig *isprig, cf_arenax_handle r_h,
 }
 
 
+// Like as_index_sprig_traverse(), but only for elements with digests < from.
+void
+as_index_sprig_traverse_from(as_index_sprig *isprig, cf_arenax_handle r_h,
+		const cf_digest *from, as_index_ph_array *v_a)
+{
+	if (r_h == SENTINEL_H) {
+		return;
+	}
+
+	as_index *r = RESOLVE_H(r_h);
+
+	// Larger digests are to the left - none there qualify unless r does.
+	if (cf_digest_compare(&r->keyd, from) >= 0) {
+		as_index_sprig_traverse_from(isprig, r->right_h, from, v_a);
+		return;
+	}
+
+	as_index_sprig_traverse_from(isprig, r->left_h, from, v_a);
+
+	if (v_a->pos >= v_a->alloc_sz) {
+		return;
+	}
+
+	as_index_reserve(r);
+
+	v_a->indexes[v_a->pos].r = r;
+	v_a->indexes[v_a->pos].r_h = r_h;
+	v_a->pos++;
+
+	as_index_sprig_traverse(isprig, r->right_h, v_a);
+}
+
+
 void
 as_index_sprig_traverse_purge(as_index_sprig *isprig, cf_arenax_handle r_h)
 {
@@ -552,6 +1410,39 @@ as_index_sprig_traverse_purge(as_index_sprig *isprig, cf_arenax_handle r_h)
 }
 
 
+bool
+as_index_sprig_mapped_reduce_cb(cf_arenax_handle r_h, void *udata)
+{
+	mapped_reduce_info *bri = (mapped_reduce_info *)udata;
+	as_index_ph_array *v_a = bri->v_a;
+
+	if (v_a->pos >= v_a->alloc_sz) {
+		return false;
+	}
+
+	as_index *r = (as_index *)cf_arenax_resolve(bri->isprig->arena, r_h);
+
+	as_index_reserve(r);
+
+	v_a->indexes[v_a->pos].r = r;
+	v_a->indexes[v_a->pos].r_h = r_h;
+	v_a->pos++;
+
+	return true;
+}
+
+
+bool
+as_index_sprig_mapped_purge_cb(cf_arenax_handle r_h, void *udata)
+{
+	as_index_sprig *isprig = (as_index_sprig *)udata;
+
+	as_index_sprig_done(isprig, RESOLVE_H(r_h), r_h);
+
+	return true;
+}
+
+
 //==========================================================
 // Local helpers - get/insert/delete an element in a sprig.
 //
@@ -559,6 +1450,22 @@ as_index_sprig_traverse_purge(as_index_sprig *isprig, cf_arenax_handle r_h)
 int
 as_index_sprig_exists(as_index_sprig *isprig, cf_digest *keyd)
 {
+	uint32_t max_tries = sprig_is_mapped(isprig) ? 0 : MAX_OPTIMISTIC_TRIES;
+
+	for (uint32_t n = 0; n < max_tries; n++) {
+		uint32_t seq = sprig_read_begin(isprig->pair);
+
+		if ((seq & 1) != 0) {
+			break; // sprig is changing - wait on the lock
+		}
+
+		int rv = as_index_sprig_search_optimistic(isprig, keyd, NULL, NULL);
+
+		if (rv != -2 && sprig_read_valid(isprig->pair, seq)) {
+			return rv;
+		}
+	}
+
 	cf_mutex_lock(&isprig->pair->lock);
 
 	int rv = as_index_sprig_search_lockless(isprig, keyd, NULL, NULL);
@@ -573,25 +1480,39 @@ int
 as_index_sprig_get_vlock(as_index_sprig *isprig, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
-	cf_mutex_lock(&isprig->pair->lock);
+	int rv;
+
+	if (! as_index_sprig_get_optimistic(isprig, keyd, index_ref, &rv)) {
+		cf_mutex_lock(&isprig->pair->lock);
+
+		rv = as_index_sprig_search_lockless(isprig, keyd, &index_ref->r,
+				&index_ref->r_h);
 
-	int rv = as_index_sprig_search_lockless(isprig, keyd, &index_ref->r,
-			&index_ref->r_h);
+		if (rv == 0) {
+			as_index_reserve(index_ref->r);
+		}
 
-	if (rv != 0) {
 		cf_mutex_unlock(&isprig->pair->lock);
+	}
+
+	if (rv != 0) {
 		return rv;
 	}
 
-	as_index_reserve(index_ref->r);
+	return as_index_sprig_vlock_reserved(isprig, keyd, index_ref);
+}
 
-	cf_mutex_unlock(&isprig->pair->lock);
 
+// Lock a found and reserved element - treat it as not found if it's "half
+// created" or deleted.
+int
+as_index_sprig_vlock_reserved(as_index_sprig *isprig, cf_digest *keyd,
+		as_index_ref *index_ref)
+{
 	if (! index_ref->skip_lock) {
 		olock_vlock(g_record_locks, keyd, &index_ref->olock);
 	}
 
-	// Treat record as not found if it's "half created" or deleted.
 	if (as_index_sprig_invalid_record_done(isprig, index_ref)) {
 		return -1;
 	}
@@ -604,6 +1525,10 @@ int
 as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
+	if (sprig_is_mapped(isprig)) {
+		return as_index_sprig_get_insert_vlock_mapped(isprig, keyd, index_ref);
+	}
+
 	int cmp = 0;
 	bool retry;
 
@@ -710,6 +1635,8 @@ as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd,
 	// Make sure we can detect that the record isn't initialized.
 	as_index_clear_record_info(n);
 
+	sprig_write_begin(isprig->pair);
+
 	// Insert the new element n under parent ele.
 	if (ele->me == &root_parent || 0 < cmp) {
 		ele->me->left_h = n_h;
@@ -733,6 +1660,8 @@ as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd,
 
 	isprig->sprig->n_elements++;
 
+	sprig_write_end(isprig->pair);
+
 	cf_mutex_unlock(&isprig->pair->reduce_lock);
 	cf_mutex_unlock(&isprig->pair->lock);
 
@@ -750,6 +1679,10 @@ as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd,
 int
 as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 {
+	if (sprig_is_mapped(isprig)) {
+		return as_index_sprig_delete_mapped(isprig, keyd);
+	}
+
 	as_index *r;
 	cf_arenax_handle r_h;
 	bool retry;
@@ -819,6 +1752,8 @@ as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 
 	// Delete the element.
 
+	sprig_write_begin(isprig->pair);
+
 	// Save the root so we can detect whether it changes.
 	cf_arenax_handle old_root = isprig->sprig->root_h;
 
@@ -894,6 +1829,155 @@ as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 		isprig->sprig->root_h = root_parent.left_h;
 	}
 
+	// No set reduce can find (and reserve) r after this.
+	as_index_set_index_delete(isprig->tree, r);
+
+	// Flag record as deleted.
+	as_index_invalidate_record(r);
+
+	// We may now destroy r, which is no longer in the sprig.
+	as_index_sprig_done(isprig, r, r_h);
+
+	isprig->sprig->n_elements--;
+
+	sprig_write_end(isprig->pair);
+
+	cf_mutex_unlock(&isprig->pair->reduce_lock);
+	cf_mutex_unlock(&isprig->pair->lock);
+
+	return 0;
+}
+
+
+int
+as_index_sprig_get_insert_vlock_mapped(as_index_sprig *isprig, cf_digest *keyd,
+		as_index_ref *index_ref)
+{
+	bool retry;
+
+	do {
+		cf_mutex_lock(&isprig->pair->lock);
+
+		cf_arenax_handle t_h;
+
+		if (mapped_search(isprig, keyd, &t_h) == 0) {
+			// The element already exists, simply return it.
+			as_index *t = RESOLVE_H(t_h);
+
+			as_index_reserve(t);
+
+			cf_mutex_unlock(&isprig->pair->lock);
+
+			if (! index_ref->skip_lock) {
+				olock_vlock(g_record_locks, keyd, &index_ref->olock);
+			}
+
+			index_ref->r = t;
+			index_ref->r_h = t_h;
+
+			// Fail if the record is "half created" or deleted.
+			if (as_index_sprig_invalid_record_done(isprig, index_ref)) {
+				return -2;
+			}
+
+			return 0;
+		}
+
+		// We didn't find the tree element, so we'll be inserting it.
+
+		retry = false;
+
+		if (! cf_mutex_trylock(&isprig->pair->reduce_lock)) {
+			// Same as red-black - don't block reads and overwrites while the
+			// sprig is reduced, then start over.
+			cf_mutex_unlock(&isprig->pair->lock);
+
+			cf_mutex_lock(&isprig->pair->reduce_lock);
+			cf_mutex_unlock(&isprig->pair->reduce_lock);
+
+			retry = true;
+		}
+	} while (retry);
+
+	cf_arenax_handle n_h = cf_arenax_alloc(isprig->arena);
+
+	if (n_h == 0) {
+		cf_warning(AS_INDEX, "arenax alloc failed");
+		cf_mutex_unlock(&isprig->pair->reduce_lock);
+		cf_mutex_unlock(&isprig->pair->lock);
+		return -1;
+	}
+
+	as_index *n = RESOLVE_H(n_h);
+
+	n->rc = 2; // one for create (eventually balanced by delete), one for caller
+
+	n->keyd = *keyd;
+
+	// Tree links are unused in a mapped sprig.
+	n->left_h = n->right_h = SENTINEL_H;
+	n->color = AS_BLACK;
+
+	// Make sure we can detect that the record isn't initialized.
+	as_index_clear_record_info(n);
+
+	sprig_write_begin(isprig->pair);
+
+	mapped_insert(isprig, keyd, n_h);
+	isprig->sprig->n_elements++;
+
+	sprig_write_end(isprig->pair);
+
+	cf_mutex_unlock(&isprig->pair->reduce_lock);
+	cf_mutex_unlock(&isprig->pair->lock);
+
+	if (! index_ref->skip_lock) {
+		olock_vlock(g_record_locks, keyd, &index_ref->olock);
+	}
+
+	index_ref->r = n;
+	index_ref->r_h = n_h;
+
+	return 1;
+}
+
+
+int
+as_index_sprig_delete_mapped(as_index_sprig *isprig, cf_digest *keyd)
+{
+	bool retry;
+
+	do {
+		cf_mutex_lock(&isprig->pair->lock);
+
+		if (mapped_search(isprig, keyd, NULL) != 0) {
+			cf_mutex_unlock(&isprig->pair->lock);
+			return -1; // not found, nothing to delete
+		}
+
+		retry = false;
+
+		if (! cf_mutex_trylock(&isprig->pair->reduce_lock)) {
+			cf_mutex_unlock(&isprig->pair->lock);
+
+			cf_mutex_lock(&isprig->pair->reduce_lock);
+			cf_mutex_unlock(&isprig->pair->reduce_lock);
+
+			retry = true;
+		}
+	} while (retry);
+
+	sprig_write_begin(isprig->pair);
+
+	cf_arenax_handle r_h;
+
+	mapped_delete(isprig, keyd, &r_h);
+
+	as_index *r = RESOLVE_H(r_h);
+
+	// No set reduce can find (and reserve) r after this.
+	as_index_set_index_delete(isprig->tree, r);
+
 	// Flag record as deleted.
 	as_index_invalidate_record(r);
 
@@ -902,6 +1986,8 @@ as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 
 	isprig->sprig->n_elements--;
 
+	sprig_write_end(isprig->pair);
+
 	cf_mutex_unlock(&isprig->pair->reduce_lock);
 	cf_mutex_unlock(&isprig->pair->lock);
 
@@ -913,10 +1999,207 @@ as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 // Local helpers - search/rebalance a sprig.
 //
 
+// Get without the sprig lock, validated by the lock pair's sequence number.
+// Returns false if the sprig kept changing - caller must then search under the
+// lock. Otherwise *p_rv is 0 if found and reserved, -1 if not found.
+//
+// No safe reclamation scheme is needed beyond this - callers hold the tree
+// reserved, so the tree (and its lock pairs) can't be destroyed under them,
+// arena stages are never unmapped, and a freed (or relocated) element is never
+// reserved.
+bool
+as_index_sprig_get_optimistic(as_index_sprig *isprig, cf_digest *keyd,
+		as_index_ref *index_ref, int *p_rv)
+{
+	if (sprig_is_mapped(isprig)) {
+		return false;
+	}
+
+	as_lock_pair *pair = isprig->pair;
+
+	for (uint32_t n = 0; n < MAX_OPTIMISTIC_TRIES; n++) {
+		uint32_t seq = sprig_read_begin(pair);
+
+		if ((seq & 1) != 0) {
+			return false; // sprig is changing - wait on the lock
+		}
+
+		as_index *r;
+		cf_arenax_handle r_h;
+		int rv = as_index_sprig_search_optimistic(isprig, keyd, &r, &r_h);
+
+		if (rv == -2 || ! sprig_read_valid(pair, seq)) {
+			continue;
+		}
+
+		if (rv == -1) {
+			*p_rv = -1;
+			return true;
+		}
+
+		// Validated before reserving, so r was allocated and in the sprig - if
+		// it's since been freed and reallocated, we reserve a live element.
+		if (! reserve_if_live(r)) {
+			continue;
+		}
+
+		if (! sprig_read_valid(pair, seq)) {
+			as_index_sprig_done(isprig, r, r_h);
+			continue;
+		}
+
+		index_ref->r = r;
+		index_ref->r_h = r_h;
+		*p_rv = 0;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+// Like as_index_sprig_search_lockless(), but without the sprig lock, so tree
+// pointers may change under us. Returns -2 if the search went astray - result
+// is only meaningful if the lock pair's sequence number is still unchanged.
+int
+as_index_sprig_search_optimistic(as_index_sprig *isprig, cf_digest *keyd,
+		as_index **ret, cf_arenax_handle *ret_h)
+{
+	cf_arenax_handle r_h = ((volatile as_sprig *)isprig->sprig)->root_h;
+	uint32_t depth = 0;
+
+	while (r_h != SENTINEL_H) {
+		as_index *r = resolve_unsafe(isprig->arena, r_h);
+
+		if (! r || ++depth > MAX_OPTIMISTIC_DEPTH) {
+			return -2;
+		}
+
+		_mm_prefetch(r, _MM_HINT_NTA);
+
+		int cmp = cf_digest_compare(keyd, &r->keyd);
+
+		if (cmp == 0) {
+			if (ret_h) {
+				*ret_h = r_h;
+			}
+
+			if (ret) {
+				*ret = r;
+			}
+
+			return 0; // found
+		}
+
+		r_h = cmp > 0 ? r->left_h : r->right_h;
+	}
+
+	return -1; // not found
+}
+
+
+// Like as_index_sprig_search_optimistic(), for a group of digests, stepping
+// each search down one level in turn. Each element is prefetched when reached,
+// and only looked at a whole round later. Results are only meaningful if each
+// lock pair's sequence number is still unchanged.
+void
+as_index_sprig_search_multi(multi_search *ms, cf_digest *keyds[],
+		uint32_t n_keys)
+{
+	uint32_t n_active = 0;
+
+	for (uint32_t i = 0; i < n_keys; i++) {
+		multi_search *m = &ms[i];
+
+		m->seq = sprig_read_begin(m->isprig.pair);
+
+		if ((m->seq & 1) != 0 || sprig_is_mapped(&m->isprig)) {
+			m->rv = -2;
+			continue;
+		}
+
+		m->r_h = ((volatile as_sprig *)m->isprig.sprig)->root_h;
+
+		if (m->r_h == SENTINEL_H) {
+			m->rv = -1;
+			continue;
+		}
+
+		if (! (m->r = resolve_unsafe(m->isprig.arena, m->r_h))) {
+			m->rv = -2;
+			continue;
+		}
+
+		_mm_prefetch(m->r, _MM_HINT_T0);
+		m->rv = 1;
+		n_active++;
+	}
+
+	for (uint32_t depth = 0; n_active != 0; depth++) {
+		for (uint32_t i = 0; i < n_keys; i++) {
+			multi_search *m = &ms[i];
+
+			if (m->rv != 1) {
+				continue;
+			}
+
+			if (depth > MAX_OPTIMISTIC_DEPTH) {
+				m->rv = -2;
+				n_active--;
+				continue;
+			}
+
+			int cmp = cf_digest_compare(keyds[i], &m->r->keyd);
+
+			if (cmp == 0) {
+				m->rv = 0; // found
+				n_active--;
+				continue;
+			}
+
+			m->r_h = cmp > 0 ? m->r->left_h : m->r->right_h;
+
+			if (m->r_h == SENTINEL_H) {
+				m->rv = -1; // not found
+				n_active--;
+				continue;
+			}
+
+			if (! (m->r = resolve_unsafe(m->isprig.arena, m->r_h))) {
+				m->rv = -2;
+				n_active--;
+				continue;
+			}
+
+			_mm_prefetch(m->r, _MM_HINT_T0);
+		}
+	}
+}
+
+
 int
 as_index_sprig_search_lockless(as_index_sprig *isprig, cf_digest *keyd,
 		as_index **ret, cf_arenax_handle *ret_h)
 {
+	if (sprig_is_mapped(isprig)) {
+		cf_arenax_handle b_h;
+
+		if (mapped_search(isprig, keyd, &b_h) != 0) {
+			return -1; // not found
+		}
+
+		if (ret_h) {
+			*ret_h = b_h;
+		}
+
+		if (ret) {
+			*ret = RESOLVE_H(b_h);
+		}
+
+		return 0; // found
+	}
+
 	cf_arenax_handle r_h = isprig->sprig->root_h;
 	as_index *r = RESOLVE_H(r_h);
 
@@ -945,6 +2228,41 @@ as_index_sprig_search_lockless(as_index_sprig *isprig, cf_digest *keyd,
 }
 
 
+// Find a red-black sprig element's parent (NULL if it's the root) and which
+// side of it the element is on. Returns false if the digest isn't in the sprig,
+// or is but not at r_h. Called under the sprig lock.
+bool
+as_index_sprig_find_parent(as_index_sprig *isprig, const cf_digest *keyd,
+		cf_arenax_handle r_h, as_index **p_parent, bool *p_left)
+{
+	as_index *parent = NULL;
+	bool left = false;
+	cf_arenax_handle t_h = isprig->sprig->root_h;
+
+	while (t_h != SENTINEL_H) {
+		as_index *t = RESOLVE_H(t_h);
+		int cmp = cf_digest_compare(keyd, &t->keyd);
+
+		if (cmp == 0) {
+			if (t_h != r_h) {
+				return false;
+			}
+
+			*p_parent = parent;
+			*p_left = left;
+
+			return true;
+		}
+
+		parent = t;
+		left = cmp > 0;
+		t_h = left ? t->left_h : t->right_h;
+	}
+
+	return false;
+}
+
+
 void
 as_index_sprig_insert_rebalance(as_index_sprig *isprig, as_index *root_parent,
 		as_index_ele *ele)
@@ -0,0 +1,622 @@
+/*
+ * index_btree.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * B+tree sprigs - a lookup touches a few wide nodes instead of chasing a
+ * handle through a cache-missing as_index at every level of a red-black tree.
+ *
+ * Nodes are 8 cache lines. Keys are digests, but nodes keep each key's first 8
+ * bytes (big-endian, so integer order is digest order) in a separate array, so
+ * a node search mostly touches only that - full digests are compared only when
+ * prefixes match. Leaves hold the as_index arena handles.
+ *
+ * Deletes don't merge or redistribute - a node is freed only when it empties.
+ * Digests are uniformly distributed, so inserts refill sparse nodes.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/index_btree.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "fault.h"
+
+#include "base/index.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define LEAF_CAPACITY 14 // (512 - 8) / (8 + 8 + 20)
+#define INNER_CAPACITY 14 // children - keys are one fewer
+
+typedef struct leaf_s {
+	uint64_t			prefixes[LEAF_CAPACITY];
+	cf_arenax_handle	handles[LEAF_CAPACITY];
+	cf_digest			keys[LEAF_CAPACITY];
+} leaf;
+
+// Key i is the smallest key under child i + 1.
+typedef struct inner_s {
+	uint64_t						prefixes[INNER_CAPACITY - 1];
+	struct as_index_btree_node_s	*children[INNER_CAPACITY];
+	cf_digest						keys[INNER_CAPACITY - 1];
+} inner;
+
+typedef struct as_index_btree_node_s {
+	uint16_t	n; // keys in a leaf, children in an inner node
+	uint8_t		is_leaf;
+	uint8_t		unused[5];
+
+	union {
+		leaf	leaf;
+		inner	inner;
+	};
+} node;
+
+// Result of splitting a node - new right sibling, and its smallest key.
+typedef struct split_s {
+	node		*right;
+	uint64_t	prefix;
+	cf_digest	keyd;
+} split;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static bool insert_into(node *n, uint64_t prefix, const cf_digest *keyd, cf_arenax_handle r_h, split *sp);
+static void inner_insert(node *n, uint32_t c, const split *child_sp, split *sp);
+static bool delete_from(node *n, uint64_t prefix, const cf_digest *keyd, cf_arenax_handle *ret_h);
+static bool traverse(const node *n, as_index_btree_visit_fn cb, void *udata);
+static bool traverse_from(const node *n, uint64_t prefix, const cf_digest *keyd, as_index_btree_visit_fn cb, void *udata);
+static void purge(node *n, as_index_btree_visit_fn cb, void *udata);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline uint64_t
+key_prefix(const cf_digest *keyd)
+{
+	uint64_t prefix;
+
+	memcpy(&prefix, keyd->digest, sizeof(prefix));
+
+	return __builtin_bswap64(prefix);
+}
+
+static inline int
+key_cmp(uint64_t prefix, const cf_digest *keyd, uint64_t n_prefix,
+		const cf_digest *n_keyd)
+{
+	if (prefix != n_prefix) {
+		return prefix < n_prefix ? -1 : 1;
+	}
+
+	return cf_digest_compare(keyd, n_keyd);
+}
+
+static inline node *
+node_create(bool is_leaf)
+{
+	// 512 bytes - jemalloc aligns this size class to cache lines.
+	node *n = cf_malloc(sizeof(node));
+
+	n->n = 0;
+	n->is_leaf = is_leaf ? 1 : 0;
+
+	return n;
+}
+
+// Index of the child to descend into - the number of keys <= the key.
+static inline uint32_t
+inner_child_ix(const node *n, uint64_t prefix, const cf_digest *keyd)
+{
+	uint32_t lo = 0;
+	uint32_t hi = n->n - 1U;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+
+		if (key_cmp(prefix, keyd, n->inner.prefixes[mid],
+				&n->inner.keys[mid]) < 0) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+
+	return lo;
+}
+
+// Index of the key if found, otherwise where it would be inserted.
+static inline uint32_t
+leaf_ix(const node *n, uint64_t prefix, const cf_digest *keyd, bool *found)
+{
+	uint32_t lo = 0;
+	uint32_t hi = n->n;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		int cmp = key_cmp(prefix, keyd, n->leaf.prefixes[mid],
+				&n->leaf.keys[mid]);
+
+		if (cmp == 0) {
+			*found = true;
+			return mid;
+		}
+
+		if (cmp < 0) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+
+	*found = false;
+
+	return lo;
+}
+
+static inline void
+leaf_insert_at(node *n, uint32_t i, uint64_t prefix, const cf_digest *keyd,
+		cf_arenax_handle r_h)
+{
+	uint32_t n_move = n->n - i;
+
+	memmove(&n->leaf.prefixes[i + 1], &n->leaf.prefixes[i],
+			n_move * sizeof(uint64_t));
+	memmove(&n->leaf.handles[i + 1], &n->leaf.handles[i],
+			n_move * sizeof(cf_arenax_handle));
+	memmove(&n->leaf.keys[i + 1], &n->leaf.keys[i], n_move * sizeof(cf_digest));
+
+	n->leaf.prefixes[i] = prefix;
+	n->leaf.handles[i] = r_h;
+	n->leaf.keys[i] = *keyd;
+	n->n++;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+int
+as_index_btree_search(const as_sprig *sprig, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	const node *n = sprig->broot;
+
+	if (! n) {
+		return -1;
+	}
+
+	uint64_t prefix = key_prefix(keyd);
+
+	while (! n->is_leaf) {
+		n = n->inner.children[inner_child_ix(n, prefix, keyd)];
+		_mm_prefetch(n, _MM_HINT_T0);
+	}
+
+	bool found;
+	uint32_t i = leaf_ix(n, prefix, keyd, &found);
+
+	if (! found) {
+		return -1;
+	}
+
+	if (ret_h) {
+		*ret_h = n->leaf.handles[i];
+	}
+
+	return 0;
+}
+
+
+// Where the key's handle is kept, so it can be changed in place - NULL if the
+// key isn't in the sprig.
+cf_arenax_handle *
+as_index_btree_find(as_sprig *sprig, const cf_digest *keyd)
+{
+	node *n = sprig->broot;
+
+	if (! n) {
+		return NULL;
+	}
+
+	uint64_t prefix = key_prefix(keyd);
+
+	while (! n->is_leaf) {
+		n = n->inner.children[inner_child_ix(n, prefix, keyd)];
+	}
+
+	bool found;
+	uint32_t i = leaf_ix(n, prefix, keyd, &found);
+
+	return found ? &n->leaf.handles[i] : NULL;
+}
+
+
+// Caller has verified the key isn't already in the sprig.
+void
+as_index_btree_insert(as_sprig *sprig, const cf_digest *keyd,
+		cf_arenax_handle r_h)
+{
+	uint64_t prefix = key_prefix(keyd);
+
+	if (! sprig->broot) {
+		node *root = node_create(true);
+
+		leaf_insert_at(root, 0, prefix, keyd, r_h);
+		sprig->broot = root;
+
+		return;
+	}
+
+	split sp;
+
+	if (! insert_into(sprig->broot, prefix, keyd, r_h, &sp)) {
+		return;
+	}
+
+	// The root split - grow a level.
+	node *root = node_create(false);
+
+	root->n = 2;
+	root->inner.children[0] = sprig->broot;
+	root->inner.children[1] = sp.right;
+	root->inner.prefixes[0] = sp.prefix;
+	root->inner.keys[0] = sp.keyd;
+
+	sprig->broot = root;
+}
+
+
+int
+as_index_btree_delete(as_sprig *sprig, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	node *root = sprig->broot;
+
+	if (! root || ! delete_from(root, key_prefix(keyd), keyd, ret_h)) {
+		return -1;
+	}
+
+	// Shed levels with a single child, and an empty root.
+	while (root->n <= 1 && ! root->is_leaf) {
+		node *child = root->n == 1 ? root->inner.children[0] : NULL;
+
+		cf_free(root);
+		root = child;
+
+		if (! root) {
+			break;
+		}
+	}
+
+	if (root && root->n == 0) {
+		cf_free(root);
+		root = NULL;
+	}
+
+	sprig->broot = root;
+
+	return 0;
+}
+
+
+void
+as_index_btree_traverse(const as_sprig *sprig, as_index_btree_visit_fn cb,
+		void *udata)
+{
+	if (sprig->broot) {
+		traverse(sprig->broot, cb, udata);
+	}
+}
+
+
+void
+as_index_btree_traverse_from(const as_sprig *sprig, const cf_digest *keyd,
+		as_index_btree_visit_fn cb, void *udata)
+{
+	if (sprig->broot) {
+		traverse_from(sprig->broot, key_prefix(keyd), keyd, cb, udata);
+	}
+}
+
+
+void
+as_index_btree_purge(as_sprig *sprig, as_index_btree_visit_fn cb, void *udata)
+{
+	if (sprig->broot) {
+		purge(sprig->broot, cb, udata);
+		sprig->broot = NULL;
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Returns true if n split - caller must insert sp->right as n's right sibling.
+static bool
+insert_into(node *n, uint64_t prefix, const cf_digest *keyd,
+		cf_arenax_handle r_h, split *sp)
+{
+	if (! n->is_leaf) {
+		uint32_t c = inner_child_ix(n, prefix, keyd);
+		split child_sp;
+
+		if (! insert_into(n->inner.children[c], prefix, keyd, r_h,
+				&child_sp)) {
+			return false;
+		}
+
+		if (n->n < INNER_CAPACITY) {
+			inner_insert(n, c, &child_sp, NULL);
+			return false;
+		}
+
+		inner_insert(n, c, &child_sp, sp);
+		return true;
+	}
+
+	bool found;
+	uint32_t i = leaf_ix(n, prefix, keyd, &found);
+
+	cf_assert(! found, AS_INDEX, "btree insert of existing digest");
+
+	if (n->n < LEAF_CAPACITY) {
+		leaf_insert_at(n, i, prefix, keyd, r_h);
+		return false;
+	}
+
+	// Split - upper half moves to a new right sibling.
+	uint32_t half = LEAF_CAPACITY / 2;
+	node *right = node_create(true);
+
+	right->n = (uint16_t)(LEAF_CAPACITY - half);
+
+	memcpy(right->leaf.prefixes, &n->leaf.prefixes[half],
+			right->n * sizeof(uint64_t));
+	memcpy(right->leaf.handles, &n->leaf.handles[half],
+			right->n * sizeof(cf_arenax_handle));
+	memcpy(right->leaf.keys, &n->leaf.keys[half], right->n * sizeof(cf_digest));
+
+	n->n = (uint16_t)half;
+
+	if (i <= half) {
+		leaf_insert_at(n, i, prefix, keyd, r_h);
+	}
+	else {
+		leaf_insert_at(right, i - half, prefix, keyd, r_h);
+	}
+
+	sp->right = right;
+	sp->prefix = right->leaf.prefixes[0];
+	sp->keyd = right->leaf.keys[0];
+
+	return true;
+}
+
+
+// Insert a split child's new sibling after child c. If sp is not NULL, n is
+// full and must split too.
+static void
+inner_insert(node *n, uint32_t c, const split *child_sp, split *sp)
+{
+	uint32_t n_keys = n->n - 1U;
+
+	// Assemble all keys and children, in order, then distribute.
+	uint64_t prefixes[INNER_CAPACITY];
+	cf_digest keys[INNER_CAPACITY];
+	node *children[INNER_CAPACITY + 1];
+
+	memcpy(prefixes, n->inner.prefixes, c * sizeof(uint64_t));
+	memcpy(keys, n->inner.keys, c * sizeof(cf_digest));
+	prefixes[c] = child_sp->prefix;
+	keys[c] = child_sp->keyd;
+	memcpy(&prefixes[c + 1], &n->inner.prefixes[c],
+			(n_keys - c) * sizeof(uint64_t));
+	memcpy(&keys[c + 1], &n->inner.keys[c], (n_keys - c) * sizeof(cf_digest));
+
+	memcpy(children, n->inner.children, (c + 1) * sizeof(node *));
+	children[c + 1] = child_sp->right;
+	memcpy(&children[c + 2], &n->inner.children[c + 1],
+			(n->n - c - 1) * sizeof(node *));
+
+	uint32_t n_children = n->n + 1U;
+	uint32_t n_left = sp ? (n_children + 1) / 2 : n_children;
+
+	memcpy(n->inner.prefixes, prefixes, (n_left - 1) * sizeof(uint64_t));
+	memcpy(n->inner.keys, keys, (n_left - 1) * sizeof(cf_digest));
+	memcpy(n->inner.children, children, n_left * sizeof(node *));
+	n->n = (uint16_t)n_left;
+
+	if (! sp) {
+		return;
+	}
+
+	// Key n_left - 1 separates the halves - it moves up, not right.
+	node *right = node_create(false);
+	uint32_t n_right = n_children - n_left;
+
+	memcpy(right->inner.prefixes, &prefixes[n_left],
+			(n_right - 1) * sizeof(uint64_t));
+	memcpy(right->inner.keys, &keys[n_left], (n_right - 1) * sizeof(cf_digest));
+	memcpy(right->inner.children, &children[n_left], n_right * sizeof(node *));
+	right->n = (uint16_t)n_right;
+
+	sp->right = right;
+	sp->prefix = prefixes[n_left - 1];
+	sp->keyd = keys[n_left - 1];
+}
+
+
+// Returns false if not found. Frees children that empty - caller handles n
+// itself emptying.
+static bool
+delete_from(node *n, uint64_t prefix, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	if (n->is_leaf) {
+		bool found;
+		uint32_t i = leaf_ix(n, prefix, keyd, &found);
+
+		if (! found) {
+			return false;
+		}
+
+		*ret_h = n->leaf.handles[i];
+
+		uint32_t n_move = n->n - i - 1U;
+
+		memmove(&n->leaf.prefixes[i], &n->leaf.prefixes[i + 1],
+				n_move * sizeof(uint64_t));
+		memmove(&n->leaf.handles[i], &n->leaf.handles[i + 1],
+				n_move * sizeof(cf_arenax_handle));
+		memmove(&n->leaf.keys[i], &n->leaf.keys[i + 1],
+				n_move * sizeof(cf_digest));
+		n->n--;
+
+		return true;
+	}
+
+	uint32_t c = inner_child_ix(n, prefix, keyd);
+	node *child = n->inner.children[c];
+
+	if (! delete_from(child, prefix, keyd, ret_h)) {
+		return false;
+	}
+
+	if (child->n != 0) {
+		return true;
+	}
+
+	cf_free(child);
+
+	// Drop the child, and the key bounding it - its left key, or if it's the
+	// first child, the key after it (the next child inherits the lower range).
+	uint32_t n_keys = n->n - 1U;
+
+	if (n_keys != 0) {
+		uint32_t k = c == 0 ? 0 : c - 1;
+
+		memmove(&n->inner.prefixes[k], &n->inner.prefixes[k + 1],
+				(n_keys - k - 1) * sizeof(uint64_t));
+		memmove(&n->inner.keys[k], &n->inner.keys[k + 1],
+				(n_keys - k - 1) * sizeof(cf_digest));
+	}
+
+	memmove(&n->inner.children[c], &n->inner.children[c + 1],
+			(n->n - c - 1) * sizeof(node *));
+	n->n--;
+
+	return true;
+}
+
+
+static bool
+traverse(const node *n, as_index_btree_visit_fn cb, void *udata)
+{
+	for (int i = (int)n->n - 1; i >= 0; i--) {
+		if (n->is_leaf) {
+			if (! cb(n->leaf.handles[i], udata)) {
+				return false;
+			}
+		}
+		else if (! traverse(n->inner.children[i], cb, udata)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Children left of the one the key would be in hold only smaller keys.
+static bool
+traverse_from(const node *n, uint64_t prefix, const cf_digest *keyd,
+		as_index_btree_visit_fn cb, void *udata)
+{
+	if (n->is_leaf) {
+		bool found;
+
+		// Keys left of the key's index are smaller, whether it's found or not.
+		for (uint32_t i = leaf_ix(n, prefix, keyd, &found); i > 0; i--) {
+			if (! cb(n->leaf.handles[i - 1], udata)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	uint32_t c = inner_child_ix(n, prefix, keyd);
+
+	if (! traverse_from(n->inner.children[c], prefix, keyd, cb, udata)) {
+		return false;
+	}
+
+	for (int i = (int)c - 1; i >= 0; i--) {
+		if (! traverse(n->inner.children[i], cb, udata)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static void
+purge(node *n, as_index_btree_visit_fn cb, void *udata)
+{
+	for (uint32_t i = 0; i < n->n; i++) {
+		if (n->is_leaf) {
+			if (cb) {
+				cb(n->leaf.handles[i], udata);
+			}
+		}
+		else {
+			purge(n->inner.children[i], cb, udata);
+		}
+	}
+
+	cf_free(n);
+}
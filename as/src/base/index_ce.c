@@ -65,3 +65,43 @@ as_index_reduce_partial_live(as_index_tree *tree, uint64_t sample_count,
 {
 	as_index_reduce_partial(tree, sample_count, cb, udata);
 }
+
+
+void
+as_index_reduce_from_live(as_index_tree *tree, const cf_digest *keyd,
+		as_index_reduce_fn cb, void *udata)
+{
+	as_index_reduce_from(tree, keyd, cb, udata);
+}
+
+
+void
+as_index_reduce_parallel_live(as_index_tree *tree, as_index_reduce_fn cb,
+		void *udata)
+{
+	as_index_reduce_parallel(tree, cb, udata);
+}
+
+
+bool
+as_index_reduce_set_live(as_index_tree *tree, uint16_t set_id,
+		as_index_reduce_fn cb, void *udata)
+{
+	return as_index_reduce_set(tree, set_id, cb, udata);
+}
+
+
+bool
+as_index_reduce_set_partial_live(as_index_tree *tree, uint16_t set_id,
+		uint64_t sample_count, as_index_reduce_fn cb, void *udata)
+{
+	return as_index_reduce_set_partial(tree, set_id, sample_count, cb, udata);
+}
+
+
+bool
+as_index_reduce_set_from_live(as_index_tree *tree, uint16_t set_id,
+		const cf_digest *keyd, as_index_reduce_fn cb, void *udata)
+{
+	return as_index_reduce_set_from(tree, set_id, keyd, cb, udata);
+}
@@ -0,0 +1,546 @@
+/*
+ * index_hash.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Hash table sprigs - for namespaces that mostly do point lookups. A lookup
+ * typically touches one slot cache line and the as_index it finds.
+ *
+ * Open addressing with linear probing. A slot is 8 bytes - a 32-bit hash taken
+ * from the digest (bytes the partition and sprig aren't picked by), and the
+ * 32-bit element handle. Full digests are compared only when hashes match.
+ * Deletes shift later slots back, so there are no tombstones.
+ *
+ * Tables double at 3/4 full. Growing is incremental - the old table stays
+ * searchable while each insert or delete moves a few more of its slots to the
+ * new table, so no single write pays for rehashing the whole sprig. Tables
+ * never shrink.
+ *
+ * Reduces need descending digest order, so traversals collect and sort.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/index_hash.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "arenax.h"
+#include "fault.h"
+
+#include "base/index.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define INITIAL_N_SLOTS 64 // 512 bytes
+#define MIGRATE_STEP 16 // old slots moved per insert or delete
+
+// Only in an old table, for a slot whose element moved or was deleted - probes
+// must continue past it. A real slot's handle is never 0.
+#define MOVED_SLOT (1UL << 32)
+
+typedef struct as_index_hash_s {
+	uint64_t	*slots;
+	uint32_t	mask;
+	uint32_t	n_used;
+
+	// While growing - old table, next old slot to move, and its elements still
+	// to move.
+	uint64_t	*old_slots;
+	uint32_t	old_mask;
+	uint32_t	migrate_i;
+	uint32_t	n_old;
+} table;
+
+typedef struct sort_ele_s {
+	cf_digest			keyd;
+	cf_arenax_handle	r_h;
+} sort_ele;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static table *table_create(void);
+static void table_grow(table *t);
+static void migrate(table *t, uint32_t n_slots);
+static uint64_t *find_slot(uint64_t *slots, uint32_t mask, cf_arenax *arena, const cf_digest *keyd, uint32_t hash);
+static void remove_slot(table *t, uint32_t i);
+static void traverse_sorted(const table *t, cf_arenax *arena, const cf_digest *keyd, as_index_hash_visit_fn cb, void *udata);
+static int sort_cmp(const void *pa, const void *pb);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline uint32_t
+key_hash(const cf_digest *keyd)
+{
+	uint32_t hash;
+
+	memcpy(&hash, keyd->digest + 4, sizeof(hash));
+
+	return hash;
+}
+
+static inline uint64_t
+slot_make(uint32_t hash, cf_arenax_handle r_h)
+{
+	return ((uint64_t)hash << 32) | r_h;
+}
+
+static inline uint32_t
+slot_hash(uint64_t slot)
+{
+	return (uint32_t)(slot >> 32);
+}
+
+static inline cf_arenax_handle
+slot_handle(uint64_t slot)
+{
+	return slot & 0xFFFFffff;
+}
+
+// Caller guarantees there's an empty slot.
+static inline void
+slot_place(uint64_t *slots, uint32_t mask, uint64_t slot)
+{
+	uint32_t i = slot_hash(slot) & mask;
+
+	while (slots[i] != 0) {
+		i = (i + 1) & mask;
+	}
+
+	slots[i] = slot;
+}
+
+static inline uint64_t *
+slots_create(uint32_t n_slots)
+{
+	return cf_calloc(n_slots, sizeof(uint64_t));
+}
+
+
+//==========================================================
+// Public API.
+//
+
+int
+as_index_hash_search(const as_sprig *sprig, cf_arenax *arena,
+		const cf_digest *keyd, cf_arenax_handle *ret_h)
+{
+	table *t = sprig->htable;
+
+	if (! t) {
+		return -1;
+	}
+
+	uint32_t hash = key_hash(keyd);
+	uint64_t *slot = find_slot(t->slots, t->mask, arena, keyd, hash);
+
+	if (! slot && t->old_slots) {
+		slot = find_slot(t->old_slots, t->old_mask, arena, keyd, hash);
+	}
+
+	if (! slot) {
+		return -1;
+	}
+
+	if (ret_h) {
+		*ret_h = slot_handle(*slot);
+	}
+
+	return 0;
+}
+
+
+// For relocation - the element at old_h may already be a copy, so match on
+// handle, not digest.
+int
+as_index_hash_replace(as_sprig *sprig, const cf_digest *keyd,
+		cf_arenax_handle old_h, cf_arenax_handle new_h)
+{
+	table *t = sprig->htable;
+
+	if (! t) {
+		return -1;
+	}
+
+	uint32_t hash = key_hash(keyd);
+	uint64_t old_slot = slot_make(hash, old_h);
+	uint64_t *slots = t->slots;
+	uint32_t mask = t->mask;
+
+	for (uint32_t pass = 0; pass < 2; pass++) {
+		for (uint32_t i = hash & mask; slots[i] != 0; i = (i + 1) & mask) {
+			if (slots[i] == old_slot) {
+				slots[i] = slot_make(hash, new_h);
+				return 0;
+			}
+		}
+
+		if (! t->old_slots) {
+			break;
+		}
+
+		slots = t->old_slots;
+		mask = t->old_mask;
+	}
+
+	return -1;
+}
+
+
+// Caller guarantees keyd isn't already in the sprig.
+void
+as_index_hash_insert(as_sprig *sprig, const cf_digest *keyd,
+		cf_arenax_handle r_h)
+{
+	if (r_h > 0xFFFFffff) {
+		cf_crash(AS_INDEX, "arena handle %lu too big for hash slot", r_h);
+	}
+
+	table *t = sprig->htable;
+
+	if (! t) {
+		t = table_create();
+		sprig->htable = t;
+	}
+
+	migrate(t, MIGRATE_STEP);
+
+	// Everything left in the old table will end up in this one.
+	if ((uint64_t)(t->n_used + t->n_old + 1) * 4 > ((uint64_t)t->mask + 1) * 3) {
+		table_grow(t);
+	}
+
+	slot_place(t->slots, t->mask, slot_make(key_hash(keyd), r_h));
+	t->n_used++;
+}
+
+
+int
+as_index_hash_delete(as_sprig *sprig, cf_arenax *arena, const cf_digest *keyd,
+		cf_arenax_handle *ret_h)
+{
+	table *t = sprig->htable;
+
+	if (! t) {
+		return -1;
+	}
+
+	migrate(t, MIGRATE_STEP);
+
+	uint32_t hash = key_hash(keyd);
+	uint64_t *slot = find_slot(t->slots, t->mask, arena, keyd, hash);
+
+	if (slot) {
+		if (ret_h) {
+			*ret_h = slot_handle(*slot);
+		}
+
+		remove_slot(t, (uint32_t)(slot - t->slots));
+		t->n_used--;
+
+		return 0;
+	}
+
+	if (t->old_slots &&
+			(slot = find_slot(t->old_slots, t->old_mask, arena, keyd,
+					hash)) != NULL) {
+		if (ret_h) {
+			*ret_h = slot_handle(*slot);
+		}
+
+		*slot = MOVED_SLOT;
+		t->n_old--;
+
+		// May have been the last one - don't wait for the next write to free.
+		migrate(t, 0);
+
+		return 0;
+	}
+
+	return -1;
+}
+
+
+void
+as_index_hash_traverse(const as_sprig *sprig, cf_arenax *arena,
+		as_index_hash_visit_fn cb, void *udata)
+{
+	if (sprig->htable) {
+		traverse_sorted(sprig->htable, arena, NULL, cb, udata);
+	}
+}
+
+
+void
+as_index_hash_traverse_from(const as_sprig *sprig, cf_arenax *arena,
+		const cf_digest *keyd, as_index_hash_visit_fn cb, void *udata)
+{
+	if (sprig->htable) {
+		traverse_sorted(sprig->htable, arena, keyd, cb, udata);
+	}
+}
+
+
+void
+as_index_hash_purge(as_sprig *sprig, as_index_hash_visit_fn cb, void *udata)
+{
+	table *t = sprig->htable;
+
+	if (! t) {
+		return;
+	}
+
+	if (cb) {
+		for (uint32_t i = 0; i <= t->mask; i++) {
+			if (t->slots[i] != 0) {
+				cb(slot_handle(t->slots[i]), udata);
+			}
+		}
+
+		if (t->old_slots) {
+			for (uint32_t i = 0; i <= t->old_mask; i++) {
+				uint64_t slot = t->old_slots[i];
+
+				if (slot != 0 && slot != MOVED_SLOT) {
+					cb(slot_handle(slot), udata);
+				}
+			}
+		}
+	}
+
+	if (t->old_slots) {
+		cf_free(t->old_slots);
+	}
+
+	cf_free(t->slots);
+	cf_free(t);
+
+	sprig->htable = NULL;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static table *
+table_create(void)
+{
+	table *t = cf_malloc(sizeof(table));
+
+	t->slots = slots_create(INITIAL_N_SLOTS);
+	t->mask = INITIAL_N_SLOTS - 1;
+	t->n_used = 0;
+
+	t->old_slots = NULL;
+	t->old_mask = 0;
+	t->migrate_i = 0;
+	t->n_old = 0;
+
+	return t;
+}
+
+
+static void
+table_grow(table *t)
+{
+	// Still moving the last grow's leftovers - unlikely, since the new table
+	// fills far slower than the old one drains. Finish now.
+	if (t->old_slots) {
+		migrate(t, t->old_mask + 1);
+	}
+
+	t->old_slots = t->slots;
+	t->old_mask = t->mask;
+	t->migrate_i = 0;
+	t->n_old = t->n_used;
+
+	t->mask = (t->mask << 1) | 1;
+	t->slots = slots_create(t->mask + 1);
+	t->n_used = 0;
+}
+
+
+// Moves up to n_slots more old slots to the current table, and frees the old
+// table once it's empty.
+static void
+migrate(table *t, uint32_t n_slots)
+{
+	if (! t->old_slots) {
+		return;
+	}
+
+	uint32_t end = t->old_mask + 1;
+
+	while (n_slots-- != 0 && t->n_old != 0 && t->migrate_i < end) {
+		uint64_t *slot = &t->old_slots[t->migrate_i++];
+
+		if (*slot == 0 || *slot == MOVED_SLOT) {
+			continue;
+		}
+
+		slot_place(t->slots, t->mask, *slot);
+		t->n_used++;
+		t->n_old--;
+
+		// Can't empty it - old table probes must get past it.
+		*slot = MOVED_SLOT;
+	}
+
+	if (t->n_old == 0) {
+		cf_free(t->old_slots);
+
+		t->old_slots = NULL;
+		t->old_mask = 0;
+		t->migrate_i = 0;
+	}
+}
+
+
+static uint64_t *
+find_slot(uint64_t *slots, uint32_t mask, cf_arenax *arena,
+		const cf_digest *keyd, uint32_t hash)
+{
+	for (uint32_t i = hash & mask; slots[i] != 0; i = (i + 1) & mask) {
+		uint64_t slot = slots[i];
+
+		if (slot == MOVED_SLOT || slot_hash(slot) != hash) {
+			continue;
+		}
+
+		as_index *r = (as_index *)cf_arenax_resolve(arena, slot_handle(slot));
+
+		if (cf_digest_compare(&r->keyd, keyd) == 0) {
+			return &slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+// Backward shift - pull later slots of the run into the hole unless that would
+// put them before their home slot.
+static void
+remove_slot(table *t, uint32_t i)
+{
+	uint64_t *slots = t->slots;
+	uint32_t mask = t->mask;
+	uint32_t j = i;
+
+	while (true) {
+		j = (j + 1) & mask;
+
+		if (slots[j] == 0) {
+			break;
+		}
+
+		uint32_t home = slot_hash(slots[j]) & mask;
+
+		// Distance from home to j must cover the distance from i to j.
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+
+	slots[i] = 0;
+}
+
+
+static void
+traverse_sorted(const table *t, cf_arenax *arena, const cf_digest *keyd,
+		as_index_hash_visit_fn cb, void *udata)
+{
+	uint32_t n_eles = t->n_used + t->n_old;
+
+	if (n_eles == 0) {
+		return;
+	}
+
+	sort_ele *eles = cf_malloc(n_eles * sizeof(sort_ele));
+	uint32_t n = 0;
+
+	const uint64_t *slots = t->slots;
+	uint32_t mask = t->mask;
+
+	for (uint32_t pass = 0; pass < 2 && slots; pass++) {
+		for (uint32_t i = 0; i <= mask; i++) {
+			uint64_t slot = slots[i];
+
+			if (slot == 0 || slot == MOVED_SLOT) {
+				continue;
+			}
+
+			cf_arenax_handle r_h = slot_handle(slot);
+			as_index *r = (as_index *)cf_arenax_resolve(arena, r_h);
+
+			if (keyd && cf_digest_compare(&r->keyd, keyd) >= 0) {
+				continue;
+			}
+
+			eles[n].keyd = r->keyd;
+			eles[n].r_h = r_h;
+			n++;
+		}
+
+		slots = t->old_slots;
+		mask = t->old_mask;
+	}
+
+	qsort(eles, n, sizeof(sort_ele), sort_cmp);
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (! cb(eles[i].r_h, udata)) {
+			break;
+		}
+	}
+
+	cf_free(eles);
+}
+
+
+// Descending digest order.
+static int
+sort_cmp(const void *pa, const void *pb)
+{
+	const sort_ele *a = (const sort_ele *)pa;
+	const sort_ele *b = (const sort_ele *)pb;
+
+	return cf_digest_compare(&b->keyd, &a->keyd);
+}
@@ -358,6 +358,10 @@ as_job_destroy(as_job* _job)
 {
 	_job->vtable.destroy_fn(_job);
 
+	if (_job->pids) {
+		cf_free(_job->pids);
+	}
+
 	pthread_mutex_destroy(&_job->requeue_lock);
 	cf_free(_job);
 }
@@ -426,8 +430,8 @@ int
 as_job_partition_reserve(as_job* _job, int pid, as_partition_reservation* rsv)
 {
 	if (_job->rsv_type == RSV_WRITE) {
-		while (pid < AS_PARTITIONS && as_partition_reserve_write(_job->ns, pid,
-				rsv, NULL) != 0) {
+		while (pid < AS_PARTITIONS && ((_job->pids && ! _job->pids[pid]) ||
+				as_partition_reserve_write(_job->ns, pid, rsv, NULL) != 0)) {
 			pid++;
 		}
 	}
@@ -40,6 +40,7 @@
 #include "vmapx.h"
 
 #include "base/cfg.h"
+#include "base/compression_dict.h"
 #include "base/datamodel.h"
 #include "base/index.h"
 #include "base/proto.h"
@@ -161,6 +162,7 @@ as_namespace_create(char *name)
 	ns->tomb_raider_period = 60 * 60 * 24; // 1 day
 	ns->tree_shared.n_lock_pairs = 8;
 	ns->tree_shared.n_sprigs = 64;
+	ns->tree_shared.type = AS_INDEX_TREE_RED_BLACK;
 	ns->write_commit_level = AS_WRITE_COMMIT_LEVEL_PROTO;
 
 	ns->storage_type = AS_STORAGE_ENGINE_MEMORY;
@@ -171,15 +173,20 @@ as_namespace_create(char *name)
 	ns->storage_filesize = 1024UL * 1024UL * 1024UL * 16UL; // default file size is 16G per file
 	ns->storage_scheduler_mode = NULL; // null indicates default is to not change scheduler mode
 	ns->storage_write_block_size = 1024 * 1024;
+	ns->storage_compression_min_size = 256; // smaller records rarely save an rblock
 	ns->storage_defrag_lwm_pct = 50; // defrag if occupancy of block is < 50%
+	ns->storage_defrag_policy = AS_STORAGE_DEFRAG_POLICY_FIFO;
 	ns->storage_defrag_sleep = 1000; // sleep this many microseconds between each wblock
 	ns->storage_defrag_startup_minimum = 10; // defrag until >= 10% disk is writable before joining cluster
 	ns->storage_flush_max_us = 1000 * 1000; // wait this many microseconds before flushing inactive current write buffer (0 = never)
 	ns->storage_max_write_cache = 1024 * 1024 * 64;
 	ns->storage_min_avail_pct = 5; // stop writes when < 5% disk is writable
 	ns->storage_post_write_queue = 256; // number of wblocks per device used as post-write cache
+	ns->storage_read_engine = AS_STORAGE_READ_ENGINE_FD_POOL;
 	ns->storage_tomb_raider_sleep = 1000; // sleep this many microseconds between each device read
+	ns->storage_write_stripes = 1;
 	ns->storage_write_threads = 1;
+	ns->storage_write_ttl_buckets = 1;
 
 	ns->sindex_num_partitions = DEFAULT_PARTITIONS_PER_INDEX;
 
@@ -190,6 +197,8 @@ as_namespace_create(char *name)
 	ns->geo2dsphere_within_level_mod = 1;
 	ns->geo2dsphere_within_earth_radius_meters = 6371000;  // Wikipedia, mean
 
+	ns->write_amp = 1.0f; // nothing defragged yet
+
 	return ns;
 }
 
@@ -214,10 +223,12 @@ as_namespaces_init(bool cold_start_cmd, uint32_t instance)
 		}
 
 		as_truncate_init(ns);
+		as_compression_dict_init(ns);
 		as_sindex_init(ns);
 	}
 
 	as_truncate_init_smd();
+	as_compression_dict_init_smd(); // before as_storage_init() reads devices
 	as_sindex_init_smd(); // before as_storage_init() populates the indexes
 }
 
@@ -243,6 +254,14 @@ as_namespace_configure_sets(as_namespace *ns)
 			p_set->stop_writes_count = ns->sets_cfg_array[i].stop_writes_count;
 			p_set->disable_eviction = ns->sets_cfg_array[i].disable_eviction;
 			p_set->enable_xdr = ns->sets_cfg_array[i].enable_xdr;
+
+			// Trees are created after this, with a sprig per indexed set.
+			if (ns->sets_cfg_array[i].enable_index &&
+					ns->tree_shared.set_sprig_ids[idx + 1] == 0) {
+				p_set->enable_index = 1;
+				ns->tree_shared.set_sprig_ids[idx + 1] =
+						(uint16_t)++ns->tree_shared.n_set_sprigs;
+			}
 		}
 		else {
 			// Maybe exceeded max sets allowed, but try failing gracefully.
@@ -740,5 +759,9 @@ append_set_props(as_set *p_set, cf_dyn_buf *db)
 
 	cf_dyn_buf_append_string(db, "disable-eviction=");
 	cf_dyn_buf_append_bool(db, IS_SET_EVICTION_DISABLED(p_set));
+	cf_dyn_buf_append_char(db, ':');
+
+	cf_dyn_buf_append_string(db, "set-enable-index=");
+	cf_dyn_buf_append_bool(db, p_set->enable_index != 0);
 	cf_dyn_buf_append_char(db, ';');
 }
@@ -124,7 +124,20 @@ setup_namespace(as_namespace* ns, uint32_t stage_capacity)
 
 	ns->arena = (cf_arenax*)cf_malloc(cf_arenax_sizeof());
 
-	cf_arenax_init(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, CF_ARENAX_BIGLOCK);
+	uint32_t arena_flags = CF_ARENAX_BIGLOCK;
+
+	if (ns->index_huge_pages == AS_INDEX_HUGE_PAGES_2M) {
+		arena_flags |= CF_ARENAX_HUGE_2M;
+	}
+	else if (ns->index_huge_pages == AS_INDEX_HUGE_PAGES_1G) {
+		arena_flags |= CF_ARENAX_HUGE_1G;
+	}
+
+	if (ns->index_numa_interleave) {
+		arena_flags |= CF_ARENAX_INTERLEAVE;
+	}
+
+	cf_arenax_init(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, arena_flags);
 }
 
 void
@@ -62,6 +62,14 @@
 static const char SUCCESS_BIN_NAME[] = "SUCCESS";
 static const char FAILURE_BIN_NAME[] = "FAILURE";
 
+// A reply that arrived while another thread was writing to the connection.
+// Its transaction ends when the writing thread sends it.
+typedef struct as_queued_reply_s {
+	struct as_queued_reply_s *next;
+	size_t msg_sz;
+	uint8_t msgp[];
+} as_queued_reply;
+
 
 //==========================================================
 // Globals.
@@ -75,9 +83,9 @@ static cf_queue g_netio_slow_queue;
 // Forward declarations.
 //
 
-static int send_reply_buf(as_file_handle *fd_h, uint8_t *msgp, size_t msg_sz);
 static void *run_netio(void *q_to_wait_on);
 static int netio_send_packet(as_file_handle *fd_h, cf_buf_builder *bb_r, uint32_t *offset, bool blocking);
+static bool send_reply(as_file_handle *fd_h, const uint8_t *msgp, size_t msg_sz, bool more);
 
 
 //==========================================================
@@ -619,6 +627,45 @@ as_msg_make_val_response_bufbuilder(const as_val *val, cf_buf_builder **bb_r,
 	as_msg_swap_op(op);
 }
 
+// Mark the end of a partition in a scan response stream. The digest, if any, is
+// where a later scan of the partition would resume.
+void
+as_msg_make_partition_done_bufbuilder(cf_buf_builder **bb_r, uint32_t pid,
+		const cf_digest *keyd)
+{
+	size_t msg_sz = sizeof(as_msg) +
+			(keyd ? sizeof(as_msg_field) + sizeof(cf_digest) : 0);
+
+	uint8_t *buf;
+
+	cf_buf_builder_reserve(bb_r, (int)msg_sz, &buf);
+
+	as_msg *m = (as_msg *)buf;
+
+	m->header_sz = sizeof(as_msg);
+	m->info1 = 0;
+	m->info2 = 0;
+	m->info3 = AS_MSG_INFO3_PARTITION_DONE;
+	m->unused = 0;
+	m->result_code = AS_PROTO_RESULT_OK;
+	m->generation = pid;
+	m->record_ttl = 0;
+	m->transaction_ttl = 0;
+	m->n_fields = keyd ? 1 : 0;
+	m->n_ops = 0;
+
+	as_msg_swap_header(m);
+
+	if (keyd) {
+		as_msg_field *mf = (as_msg_field *)m->data;
+
+		mf->field_sz = sizeof(cf_digest) + 1;
+		mf->type = AS_MSG_FIELD_TYPE_DIGEST_RIPE;
+		memcpy(mf->data, keyd, sizeof(cf_digest));
+		as_msg_swap_field(mf);
+	}
+}
+
 
 //==========================================================
 // Public API - sending responses to client.
@@ -636,7 +683,7 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code,
 			void_time, ops, bins, bin_count, ns, (cl_msg *)stack_buf, &msg_sz,
 			trid);
 
-	int rv = send_reply_buf(fd_h, msgp, msg_sz);
+	int rv = as_msg_send_reply_buf(fd_h, msgp, msg_sz);
 
 	if (msgp != stack_buf) {
 		cf_free(msgp);
@@ -649,7 +696,88 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code,
 int
 as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
 {
-	return send_reply_buf(fd_h, db->buf, db->used_sz);
+	return as_msg_send_reply_buf(fd_h, db->buf, db->used_sz);
+}
+
+// Send a single-record reply and end the transaction. Replies to pipelined
+// requests may race - at most one thread per connection writes, and replies
+// arriving meanwhile are queued for it, so a client that stops reading blocks
+// only that thread. Queued replies' transactions stay in progress until sent,
+// so pipelining stops reading new requests while replies back up. Returns 0 if
+// queued - a later send failure then just closes the connection.
+int
+as_msg_send_reply_buf(as_file_handle *fd_h, uint8_t *msgp, size_t msg_sz)
+{
+	cf_assert(cf_socket_exists(&fd_h->sock), AS_PROTO, "fd is invalid");
+
+	cf_mutex_lock(&fd_h->send_lock);
+
+	if (fd_h->sending) {
+		as_queued_reply *qr = cf_malloc(sizeof(as_queued_reply) + msg_sz);
+
+		qr->next = NULL;
+		qr->msg_sz = msg_sz;
+		memcpy(qr->msgp, msgp, msg_sz);
+
+		if (fd_h->reply_tail != NULL) {
+			fd_h->reply_tail->next = qr;
+		}
+		else {
+			fd_h->reply_head = qr;
+		}
+
+		fd_h->reply_tail = qr;
+
+		cf_mutex_unlock(&fd_h->send_lock);
+		return 0;
+	}
+
+	fd_h->sending = true;
+
+	cf_mutex_unlock(&fd_h->send_lock);
+
+	bool ok = send_reply(fd_h, msgp, msg_sz, false);
+
+	// Write what queued up meanwhile - our transaction's reference keeps fd_h
+	// alive, so end it last.
+	while (true) {
+		cf_mutex_lock(&fd_h->send_lock);
+
+		as_queued_reply *qr = fd_h->reply_head;
+
+		if (qr == NULL) {
+			fd_h->sending = false;
+			cf_mutex_unlock(&fd_h->send_lock);
+			break;
+		}
+
+		if ((fd_h->reply_head = qr->next) == NULL) {
+			fd_h->reply_tail = NULL;
+		}
+
+		bool more = fd_h->reply_head != NULL;
+
+		cf_mutex_unlock(&fd_h->send_lock);
+
+		// After a failure, don't wait out a timeout for each reply.
+		if (ok && send_reply(fd_h, qr->msgp, qr->msg_sz, more)) {
+			as_end_of_transaction_ok(fd_h);
+		}
+		else {
+			ok = false;
+			as_end_of_transaction_force_close(fd_h);
+		}
+
+		cf_free(qr);
+	}
+
+	if (! ok) {
+		as_end_of_transaction_force_close(fd_h);
+		return -1;
+	}
+
+	as_end_of_transaction_ok(fd_h);
+	return 0;
 }
 
 // Send a blocking "fin" message with default timeout.
@@ -784,23 +912,21 @@ as_netio_send(as_netio *io, bool slow, bool blocking)
 // Local helpers.
 //
 
-static int
-send_reply_buf(as_file_handle *fd_h, uint8_t *msgp, size_t msg_sz)
+static bool
+send_reply(as_file_handle *fd_h, const uint8_t *msgp, size_t msg_sz, bool more)
 {
-	cf_assert(cf_socket_exists(&fd_h->sock), AS_PROTO, "fd is invalid");
+	// If more replies are queued, let them coalesce into fewer packets.
+	int flags = more ? MSG_NOSIGNAL | MSG_MORE : MSG_NOSIGNAL;
 
-	if (cf_socket_send_all(&fd_h->sock, msgp, msg_sz, MSG_NOSIGNAL,
+	if (cf_socket_send_all(&fd_h->sock, msgp, msg_sz, flags,
 			CF_SOCKET_TIMEOUT) < 0) {
 		// Common when a client aborts.
 		cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zu errno %d",
 				CSFD(&fd_h->sock), msg_sz, errno);
-
-		as_end_of_transaction_force_close(fd_h);
-		return -1;
+		return false;
 	}
 
-	as_end_of_transaction_ok(fd_h);
-	return 0;
+	return true;
 }
 
 static void *
@@ -193,10 +193,11 @@ as_record_is_expired(const as_record *r)
 // Called when writes encounter a "doomed" record, to delete the doomed record
 // and create a new one in place without giving up the record lock.
 void
-as_record_rescue(as_index_ref *r_ref, as_namespace *ns)
+as_record_rescue(as_index_tree *tree, as_index_ref *r_ref, as_namespace *ns)
 {
 	record_delete_adjust_sindex(r_ref->r, ns);
 	as_record_destroy(r_ref->r, ns);
+	as_index_set_index_delete(tree, r_ref->r); // before set-ID is cleared
 	as_index_clear_record_info(r_ref->r);
 	cf_atomic64_incr(&ns->n_objects);
 }
@@ -413,6 +414,8 @@ as_record_replace_if_better(as_remote_record *rr, bool is_repl_write,
 			return -result;
 		}
 
+		as_index_set_index_insert(tree, &r_ref);
+
 		r->last_update_time = rr->last_update_time;
 
 		// Don't write record if it would be truncated.
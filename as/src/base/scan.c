@@ -116,14 +116,22 @@ int udf_bg_scan_job_start(as_transaction* tr, as_namespace* ns,
 typedef struct scan_options_s {
 	int			priority;
 	bool		fail_on_cluster_change;
+	bool		device_order;
 	uint32_t	sample_pct;
 } scan_options;
 
+// Where to resume scanning a partition - after (i.e. below) this digest.
+typedef struct scan_cursor_s {
+	bool		set;
+	cf_digest	keyd;
+} scan_cursor;
+
 int get_scan_set_id(as_transaction* tr, as_namespace* ns, uint16_t* p_set_id);
 scan_type get_scan_type(as_transaction* tr);
 bool get_scan_options(as_transaction* tr, scan_options* options);
 bool get_scan_socket_timeout(as_transaction* tr, uint32_t* timeout);
 bool get_scan_predexp(as_transaction* tr, predexp_eval_t** p_predexp);
+bool get_scan_pids(as_transaction* tr, bool** p_pids, scan_cursor** p_cursors);
 size_t send_blocking_response_chunk(as_file_handle* fd_h, uint8_t* buf, size_t size, int32_t timeout);
 static inline bool excluded_set(as_index* r, uint16_t set_id);
 
@@ -319,6 +327,8 @@ get_scan_options(as_transaction* tr, scan_options* options)
 	options->priority = AS_MSG_FIELD_SCAN_PRIORITY(f->data[0]);
 	options->fail_on_cluster_change =
 			(AS_MSG_FIELD_SCAN_FAIL_ON_CLUSTER_CHANGE & f->data[0]) != 0;
+	options->device_order =
+			(AS_MSG_FIELD_SCAN_DEVICE_ORDER & f->data[0]) != 0;
 	options->sample_pct = f->data[1];
 
 	return true;
@@ -359,6 +369,75 @@ get_scan_predexp(as_transaction* tr, predexp_eval_t** p_predexp)
 	return *p_predexp != NULL;
 }
 
+// Partitions may be specified by ID, or by a digest to resume after - either
+// way, only the specified partitions are scanned.
+bool
+get_scan_pids(as_transaction* tr, bool** p_pids, scan_cursor** p_cursors)
+{
+	if (! as_transaction_has_pid_array(tr) &&
+			! as_transaction_has_digest_array(tr)) {
+		return true;
+	}
+
+	bool* pids = cf_calloc(AS_PARTITIONS, sizeof(bool));
+	scan_cursor* cursors = NULL;
+
+	if (as_transaction_has_pid_array(tr)) {
+		as_msg_field* f = as_msg_field_get(&tr->msgp->msg,
+				AS_MSG_FIELD_TYPE_PID_ARRAY);
+		uint32_t n_pids = as_msg_field_get_value_sz(f) / sizeof(uint16_t);
+
+		if (as_msg_field_get_value_sz(f) % sizeof(uint16_t) != 0) {
+			cf_warning(AS_SCAN, "scan pid array field size not multiple of 2");
+			cf_free(pids);
+			return false;
+		}
+
+		const uint16_t* data = (const uint16_t*)f->data;
+
+		for (uint32_t i = 0; i < n_pids; i++) {
+			uint16_t pid = cf_swap_from_be16(data[i]);
+
+			if (pid >= AS_PARTITIONS) {
+				cf_warning(AS_SCAN, "scan pid array has bad pid %u", pid);
+				cf_free(pids);
+				return false;
+			}
+
+			pids[pid] = true;
+		}
+	}
+
+	if (as_transaction_has_digest_array(tr)) {
+		as_msg_field* f = as_msg_field_get(&tr->msgp->msg,
+				AS_MSG_FIELD_TYPE_DIGEST_ARRAY);
+		uint32_t n_digests = as_msg_field_get_value_sz(f) / sizeof(cf_digest);
+
+		if (as_msg_field_get_value_sz(f) % sizeof(cf_digest) != 0) {
+			cf_warning(AS_SCAN, "scan digest array field size not multiple of 20");
+			cf_free(pids);
+			return false;
+		}
+
+		cursors = cf_calloc(AS_PARTITIONS, sizeof(scan_cursor));
+
+		const cf_digest* data = (const cf_digest*)f->data;
+
+		for (uint32_t i = 0; i < n_digests; i++) {
+			uint32_t pid = as_partition_getid(&data[i]);
+
+			pids[pid] = true;
+			cursors[pid].set = true;
+			cursors[pid].keyd = data[i];
+		}
+	}
+
+	*p_pids = pids;
+	*p_cursors = cursors;
+
+	return true;
+}
+
 size_t
 send_blocking_response_chunk(as_file_handle* fd_h, uint8_t* buf, size_t size,
 		int32_t timeout)
@@ -533,6 +612,16 @@ typedef struct basic_scan_job_s {
 	uint32_t		sample_pct;
 	predexp_eval_t*	predexp;
 	cf_vector*		bin_names;
+
+	// Device-order only - partitions reserved for the whole job, their trees
+	// (NULL where not reserved), and the sweep over them:
+	as_partition_reservation*	rsvs;
+	as_index_tree**				trees;
+	struct as_storage_sweep_s*	sweep;
+
+	// Partition scans only - mark partitions done, resume after cursors:
+	bool				partition_done;
+	scan_cursor*		cursors;
 } basic_scan_job;
 
 void basic_scan_job_slice(as_job* _job, as_partition_reservation* rsv);
@@ -550,9 +639,16 @@ const as_job_vtable basic_scan_job_vtable = {
 typedef struct basic_scan_slice_s {
 	basic_scan_job*		job;
 	cf_buf_builder**	bb_r;
+	scan_cursor			last; // last digest reduced, for partition done
 } basic_scan_slice;
 
 void basic_scan_job_reduce_cb(as_index_ref* r_ref, void* udata);
+bool basic_scan_job_sweep_cb(as_storage_rd* rd, void* udata);
+bool basic_scan_job_check(basic_scan_job* job);
+void basic_scan_job_send_record(basic_scan_slice* slice, as_storage_rd* rd);
+void basic_scan_job_reserve_all(basic_scan_job* job);
+void basic_scan_job_sweep_moved(basic_scan_job* job);
+void basic_scan_job_release_all(basic_scan_job* job);
 cf_vector* bin_names_from_op(as_msg* m, int* result);
 
 //----------------------------------------------------------
@@ -568,23 +664,66 @@ basic_scan_job_start(as_transaction* tr, as_namespace* ns, uint16_t set_id)
 	scan_options options = { .sample_pct = 100 };
 	uint32_t timeout = CF_SOCKET_TIMEOUT;
 	predexp_eval_t* predexp = NULL;
+	bool* pids = NULL;
+	scan_cursor* cursors = NULL;
 
 	if (! get_scan_options(tr, &options) ||
 			! get_scan_socket_timeout(tr, &timeout) ||
-			! get_scan_predexp(tr, &predexp)) {
+			! get_scan_predexp(tr, &predexp) ||
+			! get_scan_pids(tr, &pids, &cursors)) {
 		cf_warning(AS_SCAN, "basic scan job failed msg field processing");
+
+		if (predexp) {
+			predexp_destroy(predexp);
+		}
+
 		cf_free(job);
 		return AS_PROTO_RESULT_FAIL_PARAMETER;
 	}
 
-	as_job_init(_job, &basic_scan_job_vtable, &g_scan_manager, RSV_WRITE,
-			as_transaction_trid(tr), ns, set_id, options.priority);
+	// A sample wouldn't be the same records on resuming.
+	if (pids && options.sample_pct != 100) {
+		cf_warning(AS_SCAN, "basic scan job can't sample specified partitions");
+
+		if (predexp) {
+			predexp_destroy(predexp);
+		}
+
+		cf_free(pids);
+
+		if (cursors) {
+			cf_free(cursors);
+		}
+
+		cf_free(job);
+		return AS_PROTO_RESULT_FAIL_PARAMETER;
+	}
+
+	// Sampling picks records per partition, and partition scans resume in
+	// digest order, so both need the trees walked. An indexed set is cheaper
+	// to walk than the device.
+	bool device_order = options.device_order && options.sample_pct == 100 &&
+			! pids && ns->tree_shared.set_sprig_ids[set_id] == 0 &&
+			as_storage_has_device_sweep(ns);
+
+	// In device order, slices are runs of wblocks, not partitions - every
+	// slice must run, so use a reservation type that doesn't skip any.
+	as_job_init(_job, &basic_scan_job_vtable, &g_scan_manager,
+			device_order ? RSV_MIGRATE : RSV_WRITE, as_transaction_trid(tr),
+			ns, set_id, options.priority);
 
 	job->cluster_key = as_exchange_cluster_key();
 	job->fail_on_cluster_change = options.fail_on_cluster_change;
 	job->no_bin_data = (tr->msgp->msg.info1 & AS_MSG_INFO1_GET_NO_BINS) != 0;
 	job->sample_pct = options.sample_pct;
 	job->predexp = predexp;
+	job->rsvs = NULL;
+	job->trees = NULL;
+	job->sweep = NULL;
+	job->partition_done = pids != NULL;
+	job->cursors = cursors;
+
+	_job->pids = pids;
 
 	int result;
 
@@ -604,14 +743,20 @@ basic_scan_job_start(as_transaction* tr, as_namespace* ns, uint16_t set_id)
 		return AS_PROTO_RESULT_FAIL_CLUSTER_KEY_MISMATCH;
 	}
 
+	if (device_order) {
+		basic_scan_job_reserve_all(job);
+	}
+
 	// Take ownership of socket from transaction.
 	conn_scan_job_own_fd((conn_scan_job*)job, tr->from.proto_fd_h, timeout);
 
-	cf_info(AS_SCAN, "starting basic scan job %lu {%s:%s} priority %u, sample-pct %u%s%s",
+	cf_info(AS_SCAN, "starting basic scan job %lu {%s:%s} priority %u, sample-pct %u%s%s%s%s",
 			_job->trid, ns->name, as_namespace_get_set_name(ns, set_id),
 			_job->priority, job->sample_pct,
 			job->no_bin_data ? ", metadata-only" : "",
-			job->fail_on_cluster_change ? ", fail-on-cluster-change" : "");
+			job->fail_on_cluster_change ? ", fail-on-cluster-change" : "",
+			device_order ? ", device-order" : "",
+			job->partition_done ? ", by-partition" : "");
 
 	if ((result = as_job_manager_start_job(_job->mgr, _job)) != 0) {
 		cf_warning(AS_SCAN, "basic scan job %lu failed to start (%d)",
@@ -642,10 +787,37 @@ basic_scan_job_slice(as_job* _job, as_partition_reservation* rsv)
 	}
 
 	uint64_t slice_start = cf_getms();
-	basic_scan_slice slice = { job, &bb };
+	scan_cursor* cursor = job->cursors && job->cursors[rsv->p->id].set ?
+			&job->cursors[rsv->p->id] : NULL;
+	basic_scan_slice slice = { job, &bb, { false } };
 
-	if (job->sample_pct == 100) {
-		as_index_reduce_live(tree, basic_scan_job_reduce_cb, (void*)&slice);
+	if (cursor) {
+		slice.last = *cursor;
+	}
+
+	if (job->sweep) {
+		as_storage_device_sweep(job->sweep, rsv->p->id, basic_scan_job_sweep_cb,
+				(void*)&slice);
+	}
+	else if (cursor) {
+		if (! as_index_reduce_set_from_live(tree, _job->set_id, &cursor->keyd,
+				basic_scan_job_reduce_cb, (void*)&slice)) {
+			as_index_reduce_from_live(tree, &cursor->keyd,
+					basic_scan_job_reduce_cb, (void*)&slice);
+		}
+	}
+	else if (job->sample_pct == 100) {
+		if (! as_index_reduce_set_live(tree, _job->set_id,
+				basic_scan_job_reduce_cb, (void*)&slice)) {
+			as_index_reduce_live(tree, basic_scan_job_reduce_cb, (void*)&slice);
+		}
+	}
+	else if (as_index_tree_has_set_index(tree, _job->set_id)) {
+		uint64_t sample_count = ((as_index_tree_set_size(tree, _job->set_id) *
+				job->sample_pct) / 100);
+
+		as_index_reduce_set_partial_live(tree, _job->set_id, sample_count,
+				basic_scan_job_reduce_cb, (void*)&slice);
 	}
 	else {
 		uint64_t sample_count =
@@ -655,6 +827,13 @@ basic_scan_job_slice(as_job* _job, as_partition_reservation* rsv)
 				basic_scan_job_reduce_cb, (void*)&slice);
 	}
 
+	// Only a partition reduced to the end is done - the client resumes any
+	// other from the last record it got.
+	if (job->partition_done && basic_scan_job_check(job)) {
+		as_msg_make_partition_done_bufbuilder(&bb, rsv->p->id,
+				slice.last.set ? &slice.last.keyd : NULL);
+	}
+
 	if (bb->used_sz != 0) {
 		conn_scan_job_send_response((conn_scan_job*)job, bb->buf, bb->used_sz);
 	}
@@ -670,6 +849,8 @@ basic_scan_job_slice(as_job* _job, as_partition_reservation* rsv)
 void
 basic_scan_job_finish(as_job* _job)
 {
+	basic_scan_job_sweep_moved((basic_scan_job*)_job);
+	basic_scan_job_release_all((basic_scan_job*)_job);
 	conn_scan_job_finish((conn_scan_job*)_job);
 
 	switch (_job->abandoned) {
@@ -697,6 +878,8 @@ basic_scan_job_destroy(as_job* _job)
 {
 	basic_scan_job* job = (basic_scan_job*)_job;
 
+	basic_scan_job_release_all(job);
+
 	if (job->bin_names) {
 		cf_vector_destroy(job->bin_names);
 	}
@@ -704,6 +887,10 @@ basic_scan_job_destroy(as_job* _job)
 	if (job->predexp) {
 		predexp_destroy(job->predexp);
 	}
+
+	if (job->cursors) {
+		cf_free(job->cursors);
+	}
 }
 
 void
@@ -722,68 +909,104 @@ basic_scan_job_reduce_cb(as_index_ref* r_ref, void* udata)
 {
 	basic_scan_slice* slice = (basic_scan_slice*)udata;
 	basic_scan_job* job = slice->job;
-	as_job* _job = (as_job*)job;
-	as_namespace* ns = _job->ns;
+	as_namespace* ns = ((as_job*)job)->ns;
 
-	if (_job->abandoned != 0) {
+	if (! basic_scan_job_check(job)) {
 		as_record_done(r_ref, ns);
 		return;
 	}
 
+	// Even if not sent (e.g. other set) - resuming needn't pass it again.
+	slice->last.set = true;
+	slice->last.keyd = r_ref->r->keyd;
+
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r_ref->r, &rd);
+	rd.io_class = AS_STORAGE_IO_SCAN;
+
+	basic_scan_job_send_record(slice, &rd);
+
+	as_storage_record_close(&rd);
+	as_record_done(r_ref, ns);
+}
+
+// Device sweep has opened rd (with image already loaded) and locked record.
+bool
+basic_scan_job_sweep_cb(as_storage_rd* rd, void* udata)
+{
+	basic_scan_slice* slice = (basic_scan_slice*)udata;
+
+	if (! basic_scan_job_check(slice->job)) {
+		return false;
+	}
+
+	basic_scan_job_send_record(slice, rd);
+
+	return true;
+}
+
+// Returns false if job is (now) abandoned.
+bool
+basic_scan_job_check(basic_scan_job* job)
+{
+	as_job* _job = (as_job*)job;
+
+	if (_job->abandoned != 0) {
+		return false;
+	}
+
 	if (job->fail_on_cluster_change &&
 			job->cluster_key != as_exchange_cluster_key()) {
-		as_record_done(r_ref, ns);
 		as_job_manager_abandon_job(_job->mgr, _job,
 				AS_PROTO_RESULT_FAIL_CLUSTER_KEY_MISMATCH);
-		return;
+		return false;
 	}
 
-	as_index* r = r_ref->r;
+	return true;
+}
+
+void
+basic_scan_job_send_record(basic_scan_slice* slice, as_storage_rd* rd)
+{
+	basic_scan_job* job = slice->job;
+	as_job* _job = (as_job*)job;
+	as_namespace* ns = _job->ns;
+	as_index* r = rd->r;
 
 	if (excluded_set(r, _job->set_id) || as_record_is_doomed(r, ns)) {
-		as_record_done(r_ref, ns);
 		return;
 	}
 
 	predexp_args_t predargs = { .ns = ns, .md = r, .vl = NULL, .rd = NULL };
 
 	if (job->predexp && ! predexp_matches_metadata(job->predexp, &predargs)) {
-		as_record_done(r_ref, ns);
 		return;
 	}
 
-	as_storage_rd rd;
-
-	as_storage_record_open(ns, r, &rd);
-
 	if (job->no_bin_data) {
 		// TODO - suppose the predexp needs bin values???
 
-		as_msg_make_response_bufbuilder(slice->bb_r, &rd, true, true, true,
+		as_msg_make_response_bufbuilder(slice->bb_r, rd, true, true, true,
 				NULL);
 	}
 	else {
-		as_storage_rd_load_n_bins(&rd); // TODO - handle error returned
+		as_storage_rd_load_n_bins(rd); // TODO - handle error returned
 
-		as_bin stack_bins[rd.ns->storage_data_in_memory ? 0 : rd.n_bins];
+		as_bin stack_bins[ns->storage_data_in_memory ? 0 : rd->n_bins];
 
-		as_storage_rd_load_bins(&rd, stack_bins); // TODO - handle error returned
+		as_storage_rd_load_bins(rd, stack_bins); // TODO - handle error returned
 
-		predargs.rd = &rd;
+		predargs.rd = rd;
 
 		if (job->predexp && ! predexp_matches_record(job->predexp, &predargs)) {
-			as_storage_record_close(&rd);
-			as_record_done(r_ref, ns);
 			return;
 		}
 
-		as_msg_make_response_bufbuilder(slice->bb_r, &rd, false, true, true,
+		as_msg_make_response_bufbuilder(slice->bb_r, rd, false, true, true,
 				job->bin_names);
 	}
 
-	as_storage_record_close(&rd);
-	as_record_done(r_ref, ns);
-
 	cf_atomic64_incr(&_job->n_records_read);
 
 	cf_buf_builder* bb = *slice->bb_r;
@@ -800,6 +1023,80 @@ basic_scan_job_reduce_cb(as_index_ref* r_ref, void* udata)
 	}
 }
 
+// Records found in a device slice may be in any partition, so reserve all the
+// partitions a (partition-order) scan would for the life of the job.
+void
+basic_scan_job_reserve_all(basic_scan_job* job)
+{
+	as_namespace* ns = ((as_job*)job)->ns;
+
+	job->rsvs = cf_malloc(AS_PARTITIONS * sizeof(as_partition_reservation));
+	job->trees = cf_malloc(AS_PARTITIONS * sizeof(as_index_tree*));
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		job->trees[pid] = as_partition_reserve_write(ns, pid, &job->rsvs[pid],
+				NULL) == 0 ? job->rsvs[pid].tree : NULL;
+	}
+
+	job->sweep = as_storage_device_sweep_start(ns, job->trees, AS_PARTITIONS);
+}
+
+// Records that writes or defrag moved before their slice was swept were skipped
+// by the slices - send them last.
+void
+basic_scan_job_sweep_moved(basic_scan_job* job)
+{
+	as_job* _job = (as_job*)job;
+
+	if (! job->sweep || _job->abandoned != 0) {
+		return;
+	}
+
+	cf_buf_builder* bb = cf_buf_builder_create_size(INIT_BUF_BUILDER_SIZE);
+
+	if (! bb) {
+		as_job_manager_abandon_job(_job->mgr, _job,
+				AS_PROTO_RESULT_FAIL_UNKNOWN);
+		return;
+	}
+
+	basic_scan_slice slice = { job, &bb, { false } };
+
+	as_storage_device_sweep_end(job->sweep, basic_scan_job_sweep_cb,
+			(void*)&slice);
+	job->sweep = NULL;
+
+	if (bb->used_sz != 0) {
+		conn_scan_job_send_response((conn_scan_job*)job, bb->buf, bb->used_sz);
+	}
+
+	cf_buf_builder_free(bb);
+}
+
+void
+basic_scan_job_release_all(basic_scan_job* job)
+{
+	if (job->sweep) {
+		as_storage_device_sweep_end(job->sweep, NULL, NULL);
+		job->sweep = NULL;
+	}
+
+	if (! job->trees) {
+		return;
+	}
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		if (job->trees[pid]) {
+			as_partition_release(&job->rsvs[pid]);
+		}
+	}
+
+	cf_free(job->trees);
+	cf_free(job->rsvs);
+	job->trees = NULL;
+	job->rsvs = NULL;
+}
+
 cf_vector*
 bin_names_from_op(as_msg* m, int* result)
 {
@@ -963,7 +1260,11 @@ aggr_scan_job_slice(as_job* _job, as_partition_reservation* rsv)
 
 	aggr_scan_slice slice = { job, &ll, &bb, rsv };
 
-	as_index_reduce_live(rsv->tree, aggr_scan_job_reduce_cb, (void*)&slice);
+	if (! as_index_reduce_set_live(rsv->tree, _job->set_id,
+			aggr_scan_job_reduce_cb, (void*)&slice)) {
+		as_index_reduce_live(rsv->tree, aggr_scan_job_reduce_cb,
+				(void*)&slice);
+	}
 
 	if (cf_ll_size(&ll) != 0) {
 		as_result result;
@@ -1290,7 +1591,10 @@ udf_bg_scan_job_start(as_transaction* tr, as_namespace* ns, uint16_t set_id)
 void
 udf_bg_scan_job_slice(as_job* _job, as_partition_reservation* rsv)
 {
-	as_index_reduce_live(rsv->tree, udf_bg_scan_job_reduce_cb, (void*)_job);
+	if (! as_index_reduce_set_live(rsv->tree, _job->set_id,
+			udf_bg_scan_job_reduce_cb, (void*)_job)) {
+		as_index_reduce_live(rsv->tree, udf_bg_scan_job_reduce_cb, (void*)_job);
+	}
 }
 
 void
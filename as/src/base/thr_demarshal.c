@@ -44,6 +44,7 @@
 #include "hist.h"
 #include "socket.h"
 #include "tls.h"
+#include "uring.h"
 
 #include "base/as_stap.h"
 #include "base/batch.h"
@@ -60,6 +61,13 @@
 
 #define POLL_SZ 1024
 
+// Each connection has at most one operation in flight - when a ring is full,
+// connections fall back to epoll.
+#define URING_DEPTH 4096
+
+// Tags the udata of wake-up no-ops, as opposed to recvs.
+#define URING_NOP_TAG 1UL
+
 #define XDR_WRITE_BUFFER_SIZE (5 * 1024 * 1024)
 #define XDR_READ_BUFFER_SIZE (15 * 1024 * 1024)
 
@@ -67,12 +75,16 @@ extern void *thr_demarshal(void *arg);
 
 typedef struct {
 	cf_poll			polls[MAX_DEMARSHAL_THREADS];
+	cf_uring		*rings[MAX_DEMARSHAL_THREADS]; // NULL unless io-uring
 	unsigned int	num_threads;
 	pthread_t	dm_th[MAX_DEMARSHAL_THREADS];
 } demarshal_args;
 
 static demarshal_args *g_demarshal_args = 0;
 
+// Set if a ring rejects a recv despite probing - all connections go to epoll.
+static cf_atomic32 g_uring_disabled = 0;
+
 as_info_access g_access = {
 	.service = { .addrs = { .n_addrs = 0 }, .port = 0 },
 	.alt_service = { .addrs = { .n_addrs = 0 }, .port = 0 },
@@ -97,16 +109,174 @@ pthread_t		g_demarshal_reaper_th;
 void *thr_demarshal_reaper_fn(void *arg);
 static cf_queue *g_freeslot = 0;
 
+//
+// Per-connection receive buffer.
+//
+
+static inline uint32_t
+recv_buffered(const as_file_handle *fd_h)
+{
+	return fd_h->recv_len - fd_h->recv_off;
+}
+
+// Make all free space contiguous, at the end.
+static void
+recv_make_room(as_file_handle *fd_h)
+{
+	if (fd_h->recv_buf == NULL) {
+		fd_h->recv_buf = cf_malloc(fd_h->recv_buf_sz);
+	}
+	else if (fd_h->recv_off != 0) {
+		uint32_t n_buffered = recv_buffered(fd_h);
+
+		memmove(fd_h->recv_buf, fd_h->recv_buf + fd_h->recv_off, n_buffered);
+		fd_h->recv_off = 0;
+		fd_h->recv_len = n_buffered;
+	}
+}
+
+// One recv for as much as fits - returns like cf_socket_recv().
+static int32_t
+recv_fill(as_file_handle *fd_h)
+{
+	recv_make_room(fd_h);
+
+	int32_t recv_sz = cf_socket_recv(&fd_h->sock,
+			fd_h->recv_buf + fd_h->recv_len,
+			fd_h->recv_buf_sz - fd_h->recv_len, 0);
+
+	if (recv_sz > 0) {
+		fd_h->recv_len += (uint32_t)recv_sz;
+	}
+
+	return recv_sz;
+}
+
+// Copy out up to sz buffered bytes - returns how many.
+static uint32_t
+recv_take(as_file_handle *fd_h, uint8_t *to, uint64_t sz)
+{
+	uint32_t n_buffered = recv_buffered(fd_h);
+	uint32_t n = sz < n_buffered ? (uint32_t)sz : n_buffered;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	memcpy(to, fd_h->recv_buf + fd_h->recv_off, n);
+	fd_h->recv_off += n;
+
+	if (fd_h->recv_off == fd_h->recv_len) {
+		fd_h->recv_off = 0;
+		fd_h->recv_len = 0;
+	}
+
+	return n;
+}
+
+// Returns false if the ring is full, or submission fails.
+static bool
+rearm_uring(as_file_handle *fd_h)
+{
+	// Next request's header is already buffered - just wake demarshal.
+	if (recv_buffered(fd_h) >= sizeof(as_proto)) {
+		return cf_uring_nop(fd_h->ring,
+				(void *)((uint64_t)fd_h | URING_NOP_TAG));
+	}
+
+	recv_make_room(fd_h);
+
+	return cf_uring_recv(fd_h->ring, CSFD(&fd_h->sock),
+			fd_h->recv_buf + fd_h->recv_len,
+			fd_h->recv_buf_sz - fd_h->recv_len, fd_h);
+}
+
+// Reap ring completions as events for the demarshal loop - received bytes are
+// already in the connection's buffer.
+static int
+uring_events(cf_uring *ring, cf_poll_event *events, int max_events)
+{
+	// If there's no room, the ring fd stays readable - epoll will be back.
+	if (max_events <= 0) {
+		return 0;
+	}
+
+	cf_uring_cqe cqes[POLL_SZ];
+	uint32_t n_cqes = cf_uring_reap(ring, cqes, (uint32_t)MIN(max_events, POLL_SZ),
+			false);
+
+	int n_events = 0;
+
+	for (uint32_t i = 0; i < n_cqes; i++) {
+		uint64_t udata = (uint64_t)cqes[i].udata;
+		as_file_handle *fd_h = (as_file_handle *)(udata & ~URING_NOP_TAG);
+		int32_t res = cqes[i].res;
+		cf_poll_event *ev = &events[n_events];
+
+		ev->data = fd_h;
+
+		if ((udata & URING_NOP_TAG) != 0) {
+			ev->events = EPOLLOUT;
+		}
+		else if (res > 0) {
+			fd_h->recv_len += (uint32_t)res;
+			ev->events = EPOLLIN;
+		}
+		else if (res == 0) {
+			ev->events = EPOLLRDHUP;
+		}
+		else if (res == -EAGAIN || res == -EINTR) {
+			// Demarshal's own recv will sort it out.
+			ev->events = EPOLLIN;
+		}
+		else if (res == -EINVAL) {
+			// Kernel doesn't do recv after all - nothing was read, so hand
+			// the connection to epoll, along with all others from now on.
+			if (cf_atomic32_cas(&g_uring_disabled, 0, 1) == 0) {
+				cf_warning(AS_DEMARSHAL, "io_uring recv not supported - falling back to epoll");
+			}
+
+			thr_demarshal_rearm(fd_h);
+			continue;
+		}
+		else {
+			cf_detail(AS_DEMARSHAL, "io_uring recv fail: fd %d errno %d",
+					CSFD(&fd_h->sock), -res);
+			ev->events = EPOLLERR;
+		}
+
+		n_events++;
+	}
+
+	return n_events;
+}
+
 void
 thr_demarshal_rearm(as_file_handle *fd_h)
 {
+	// Connections are registered with epoll either way - it handles the first
+	// read, and is the fallback if the ring can't take the recv. Once a
+	// connection is reaped, leave it to epoll, which will refuse.
+	if (fd_h->ring != NULL && cf_atomic32_get(g_uring_disabled) == 0 &&
+			! fd_h->reap_me && rearm_uring(fd_h)) {
+		return;
+	}
+
 	// This causes ENOENT, when we reached NextEvent_FD_Cleanup (e.g, because
 	// the client disconnected) while the transaction was still ongoing.
 
+	// If the next request's header is already buffered, there may be nothing
+	// left on the socket to trigger EPOLLIN - EPOLLOUT fires right away.
+
+	uint32_t events = EPOLLIN | EPOLLONESHOT | EPOLLRDHUP;
+
+	if (recv_buffered(fd_h) >= sizeof(as_proto)) {
+		events |= EPOLLOUT;
+	}
+
 	static int32_t err_ok[] = { ENOENT };
 	CF_IGNORE_ERROR(cf_poll_modify_socket_forgiving(fd_h->poll, &fd_h->sock,
-			EPOLLIN | EPOLLONESHOT | EPOLLRDHUP, fd_h,
-			sizeof(err_ok) / sizeof(int32_t), err_ok));
+			events, fd_h, sizeof(err_ok) / sizeof(int32_t), err_ok));
 }
 
 void
@@ -373,6 +543,21 @@ peek_data_in_memory(const as_msg *m)
 	return ns && ns->storage_data_in_memory;
 }
 
+// Header check only - proto is swapped, as_msg isn't (yet).
+static bool
+is_pipeline_request(const as_file_handle *fd_h, const as_proto *proto)
+{
+	if (fd_h->pipeline_max == 0 || proto->type != PROTO_TYPE_AS_MSG ||
+			proto->sz < sizeof(as_msg)) {
+		return false;
+	}
+
+	const as_msg *m = &((const cl_msg *)proto)->msg;
+
+	return (m->info3 & AS_MSG_INFO3_PIPELINE) != 0 &&
+			(m->info1 & AS_MSG_INFO1_BATCH) == 0;
+}
+
 // Set of threads which talk to client over the connection for doing the needful
 // processing. Note that once fd is assigned to a thread all the work on that fd
 // is done by that thread. Fair fd usage is expected of the client. First thread
@@ -409,6 +594,28 @@ thr_demarshal(void *unused)
 
 	cf_poll_create(&poll);
 
+	cf_uring *ring = NULL;
+
+	if (g_config.proto_io_engine == AS_PROTO_IO_ENGINE_IO_URING) {
+		if ((ring = cf_uring_create(URING_DEPTH)) != NULL &&
+				! cf_uring_supports_recv(ring)) {
+			cf_warning(AS_DEMARSHAL, "kernel lacks io_uring recv or fast poll");
+			cf_uring_destroy(ring);
+			ring = NULL;
+		}
+
+		if (ring != NULL) {
+			// Level-triggered - readable while completions wait.
+			cf_poll_add_fd(poll, cf_uring_fd(ring), EPOLLIN, ring);
+		}
+		else {
+			cf_warning(AS_DEMARSHAL, "demarshal thread %d falling back to epoll", thr_id);
+		}
+	}
+
+	// Set before poll - threads wait for polls to be set.
+	g_demarshal_args->rings[thr_id] = ring;
+
 	// First thread accepts new connection at interface socket.
 	if (thr_id == 0) {
 		demarshal_file_handle_init();
@@ -436,6 +643,12 @@ thr_demarshal(void *unused)
 
 		// Iterate over all events.
 		for (i = 0; i < nevents; i++) {
+			if (ring != NULL && events[i].data == ring) {
+				// Ring completions join the list, handled as epoll events.
+				nevents += uring_events(ring, events + nevents, POLL_SZ - nevents);
+				continue;
+			}
+
 			cf_socket *ssock = events[i].data;
 
 			if (cf_sockets_has_socket(&g_sockets, ssock)) {
@@ -491,9 +704,19 @@ thr_demarshal(void *unused)
 				fd_h->last_used = cf_getms();
 				fd_h->reap_me = false;
 				fd_h->proto = 0;
-				fd_h->proto_unread = (uint64_t)sizeof(as_proto);
+				fd_h->proto_unread = 0;
 				fd_h->fh_info = 0;
 				fd_h->security_filter = as_security_filter_create();
+				fd_h->pipeline_max = g_config.proto_pipeline_max;
+				fd_h->n_pipelined = 0;
+				cf_mutex_init(&fd_h->send_lock);
+				fd_h->sending = false;
+				fd_h->reply_head = NULL;
+				fd_h->reply_tail = NULL;
+				fd_h->recv_buf = NULL;
+				fd_h->recv_buf_sz = g_config.proto_recv_buf_sz;
+				fd_h->recv_off = 0;
+				fd_h->recv_len = 0;
 
 				// Insert into the global table so the reaper can manage it. Do
 				// this before queueing it up for demarshal threads - once
@@ -536,6 +759,10 @@ thr_demarshal(void *unused)
 
 					fd_h->poll = g_demarshal_args->polls[id];
 
+					// TLS reads must go through the TLS library.
+					fd_h->ring = cfg->owner == CF_SOCK_OWNER_SERVICE_TLS ?
+							NULL : g_demarshal_args->rings[id];
+
 					// Place the client socket in the event queue.
 					cf_poll_add_socket(fd_h->poll, &fd_h->sock, EPOLLIN | EPOLLONESHOT | EPOLLRDHUP, fd_h);
 					cf_atomic64_incr(&g_stats.proto_connections_opened);
@@ -579,31 +806,34 @@ thr_demarshal(void *unused)
 					goto NextEvent;
 				}
 
+NextRequest:
 				// If pointer is NULL, then we need to create a transaction and
 				// store it in the buffer.
 				if (fd_h->proto == NULL) {
-					int32_t recv_sz = cf_socket_recv(sock, (uint8_t *)&fd_h->proto_hdr + sizeof(as_proto) - fd_h->proto_unread,	fd_h->proto_unread, 0);
+					if (recv_buffered(fd_h) < sizeof(as_proto)) {
+						int32_t recv_sz = recv_fill(fd_h);
+
+						if (recv_sz <= 0) {
+							if (recv_sz != 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+								// This can happen because TLS protocol
+								// overhead can trip the epoll but no
+								// application-level bytes are actually
+								// available yet.
+								thr_demarshal_rearm(fd_h);
+								goto NextEvent;
+							}
+							cf_detail(AS_DEMARSHAL, "proto socket: read header fail: error: rv %d errno %d", recv_sz, errno);
+							goto NextEvent_FD_Cleanup;
+						}
 
-					if (recv_sz <= 0) {
-						if (recv_sz != 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-							// This can happen because TLS protocol
-							// overhead can trip the epoll but no
-							// application-level bytes are actually
-							// available yet.
+						if (recv_buffered(fd_h) < sizeof(as_proto)) {
+							tls_socket_must_not_have_data(&fd_h->sock, "partial client read (size)");
 							thr_demarshal_rearm(fd_h);
 							goto NextEvent;
 						}
-						cf_detail(AS_DEMARSHAL, "proto socket: read header fail: error: rv %d errno %d", recv_sz, errno);
-						goto NextEvent_FD_Cleanup;
 					}
 
-					fd_h->proto_unread -= recv_sz;
-
-					if (fd_h->proto_unread != 0) {
-						tls_socket_must_not_have_data(&fd_h->sock, "partial client read (size)");
-						thr_demarshal_rearm(fd_h);
-						goto NextEvent;
-					}
+					recv_take(fd_h, (uint8_t *)&fd_h->proto_hdr, sizeof(as_proto));
 
 					// Check for a TLS ClientHello arriving at a non-TLS socket. Heuristic:
 					//   - tls[0] == ContentType.handshake (22)
@@ -645,7 +875,12 @@ thr_demarshal(void *unused)
 				}
 
 				if (fd_h->proto_unread != 0) {
-					// Read the data.
+					fd_h->proto_unread -= recv_take(fd_h, fd_h->proto->data + (fd_h->proto->sz - fd_h->proto_unread), fd_h->proto_unread);
+				}
+
+				if (fd_h->proto_unread != 0) {
+					// Buffer is empty - read the rest straight into the
+					// message, no point in staging it.
 					int32_t recv_sz = cf_socket_recv(sock, fd_h->proto->data + (fd_h->proto->sz - fd_h->proto_unread), fd_h->proto_unread, 0);
 
 					if (recv_sz <= 0) {
@@ -672,17 +907,27 @@ thr_demarshal(void *unused)
 				cf_debug(AS_DEMARSHAL, "running on CPU %hu", cf_topo_current_cpu());
 
 				// fd_h->proto_unread == 0 - finished reading complete proto.
-				// In current pipelining model, can't rearm fd_h until end of
-				// transaction.
+				// Unless the request is pipelined, can't rearm fd_h until end
+				// of transaction.
 				as_proto *proto_p = fd_h->proto;
 
 				fd_h->proto = NULL;
-				fd_h->proto_unread = (uint64_t)sizeof(as_proto);
 				fd_h->last_used = now_ms;
 
 				cf_rc_reserve(fd_h);
 				has_extra_ref = true;
 
+				bool pipelined = is_pipeline_request(fd_h, proto_p);
+
+				// Only more pipelined requests may follow pipelined requests
+				// still in progress - any other reply could interleave.
+				if (! pipelined && cf_atomic32_get(fd_h->n_pipelined) != 0) {
+					cf_warning(AS_DEMARSHAL, "proto input from %s: non-pipelined request while pipelined requests in progress",
+							fd_h->client);
+					cf_free(proto_p);
+					goto NextEvent_FD_Cleanup;
+				}
+
 				// Info protocol requests.
 				if (proto_p->type == PROTO_TYPE_INFO) {
 					as_info_transaction it = { fd_h, proto_p, now_ns };
@@ -770,7 +1015,20 @@ thr_demarshal(void *unused)
 
 				// Swap as_msg fields and bin-ops to host order, and flag
 				// which fields are present, to reduce re-parsing.
-				if (! as_transaction_prepare(&tr, true)) {
+				bool prepared = as_transaction_prepare(&tr, true);
+
+				// A pipelined request's only reply must carry its trid - if
+				// that's not possible, the client can't match replies.
+				if (pipelined && (! prepared ||
+						as_transaction_is_multi_record(&tr) ||
+						(tr.msg_fields & AS_MSG_FIELD_BIT_TRID) == 0)) {
+					cf_warning(AS_DEMARSHAL, "proto input from %s: only valid single-record requests with a trid may be pipelined",
+							fd_h->client);
+					cf_free(tr.msgp);
+					goto NextEvent_FD_Cleanup;
+				}
+
+				if (! prepared) {
 					cf_warning(AS_DEMARSHAL, "bad client msg");
 					as_transaction_demarshal_error(&tr, AS_PROTO_RESULT_FAIL_PARAMETER);
 					goto NextEvent;
@@ -778,6 +1036,10 @@ thr_demarshal(void *unused)
 
 				ASD_TRANS_DEMARSHAL(nodeid, (uint64_t) tr.msgp, as_transaction_trid(&tr));
 
+				// Count it before it can finish.
+				uint32_t n_pipelined = pipelined ?
+						(uint32_t)cf_atomic32_incr(&fd_h->n_pipelined) : 0;
+
 				// Directly process or queue the transaction.
 				if (g_config.n_namespaces_inlined != 0 &&
 						(g_config.n_namespaces_not_inlined == 0 ||
@@ -791,6 +1053,18 @@ thr_demarshal(void *unused)
 					as_tsvc_enqueue(&tr);
 				}
 
+				// Read the next pipelined request now, unless the connection
+				// is at its limit - then the first to finish re-arms.
+				if (n_pipelined != 0 && n_pipelined < fd_h->pipeline_max) {
+					// If it's already buffered, skip the trip through epoll.
+					if (recv_buffered(fd_h) >= sizeof(as_proto)) {
+						has_extra_ref = false;
+						goto NextRequest;
+					}
+
+					thr_demarshal_rearm(fd_h);
+				}
+
 				// Jump the proto message free & FD cleanup. If we get here, the
 				// above operations went smoothly. The message free & FD cleanup
 				// job is handled elsewhere as directed by
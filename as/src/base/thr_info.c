@@ -42,6 +42,7 @@
 #include "citrusleaf/cf_queue.h"
 #include "citrusleaf/cf_vector.h"
 
+#include "arenax.h"
 #include "cf_str.h"
 #include "dynbuf.h"
 #include "fault.h"
@@ -54,6 +55,7 @@
 
 #include "base/batch.h"
 #include "base/cfg.h"
+#include "base/compression_dict.h"
 #include "base/datamodel.h"
 #include "base/index.h"
 #include "base/monitor.h"
@@ -265,6 +267,10 @@ info_get_stats(char *name, cf_dyn_buf *db)
 	info_append_uint32(db, "rw_in_progress", rw_request_hash_count());
 	info_append_uint32(db, "proxy_in_progress", as_proxy_hash_count());
 	info_append_int(db, "tree_gc_queue", as_index_tree_gc_queue_size());
+	info_append_uint32(db, "tree_gc_active", as_index_tree_gc_active());
+	info_append_uint64(db, "tree_gc_pending_elements", as_index_tree_gc_pending());
+	info_append_uint64(db, "tree_gc_trees_destroyed", g_stats.tree_gc_trees_destroyed);
+	info_append_uint64(db, "tree_gc_elements_destroyed", g_stats.tree_gc_elements_destroyed);
 
 	info_append_uint64(db, "client_connections", g_stats.proto_connections_opened - g_stats.proto_connections_closed);
 	info_append_uint64(db, "heartbeat_connections", g_stats.heartbeat_connections_opened - g_stats.heartbeat_connections_closed);
@@ -1493,6 +1499,9 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "hist-track-back", g_config.hist_track_back);
 	info_append_uint32(db, "hist-track-slice", g_config.hist_track_slice);
 	info_append_string_safe(db, "hist-track-thresholds", g_config.hist_track_thresholds);
+	info_append_uint32(db, "index-reduce-threads", g_config.n_index_reduce_threads);
+	info_append_uint32(db, "index-tree-gc-max-rate", g_config.index_tree_gc_max_rate);
+	info_append_uint32(db, "index-tree-gc-threads", g_config.n_index_tree_gc_threads);
 	info_append_int(db, "info-threads", g_config.n_info_threads);
 	info_append_bool(db, "log-local-time", cf_fault_is_using_local_time());
 	info_append_uint32(db, "migrate-max-num-incoming", g_config.migrate_max_num_incoming);
@@ -1504,6 +1513,11 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "nsup-period", g_config.nsup_period);
 	info_append_bool(db, "nsup-startup-evict", g_config.nsup_startup_evict);
 	info_append_int(db, "proto-fd-idle-ms", g_config.proto_fd_idle_ms);
+	info_append_string(db, "proto-io-engine",
+			g_config.proto_io_engine == AS_PROTO_IO_ENGINE_IO_URING ?
+					"io-uring" : "epoll");
+	info_append_uint32(db, "proto-pipeline-max", g_config.proto_pipeline_max);
+	info_append_uint32(db, "proto-recv-buffer-size", g_config.proto_recv_buf_sz);
 	info_append_int(db, "proto-slow-netio-sleep-ms", g_config.proto_slow_netio_sleep_ms); // dynamic only
 	info_append_uint32(db, "query-batch-size", g_config.query_bsize);
 	info_append_uint32(db, "query-buf-size", g_config.query_buf_size); // dynamic only
@@ -1693,6 +1707,10 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	info_append_uint32(db, "evict-tenths-pct", ns->evict_tenths_pct);
 	info_append_uint32(db, "high-water-disk-pct", ns->hwm_disk_pct);
 	info_append_uint32(db, "high-water-memory-pct", ns->hwm_memory_pct);
+	info_append_uint32(db, "index-defrag-lwm-pct", ns->index_defrag_lwm_pct);
+	info_append_string(db, "index-huge-pages", ns->index_huge_pages == AS_INDEX_HUGE_PAGES_NONE ?
+			"none" : (ns->index_huge_pages == AS_INDEX_HUGE_PAGES_2M ? "2m" : "1g"));
+	info_append_bool(db, "index-numa-interleave", ns->index_numa_interleave);
 	info_append_uint64(db, "max-ttl", ns->max_ttl);
 	info_append_uint32(db, "migrate-order", ns->migrate_order);
 	info_append_uint32(db, "migrate-retransmit-ms", ns->migrate_retransmit_ms);
@@ -1700,6 +1718,8 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	info_append_uint32(db, "obj-size-hist-max", ns->obj_size_hist_max); // not original, may have been rounded
 	info_append_uint32(db, "partition-tree-locks", ns->tree_shared.n_lock_pairs);
 	info_append_uint32(db, "partition-tree-sprigs", ns->tree_shared.n_sprigs);
+	info_append_string(db, "partition-tree-type", ns->tree_shared.type == AS_INDEX_TREE_BTREE ?
+			"btree" : (ns->tree_shared.type == AS_INDEX_TREE_HASH ? "hash" : "red-black"));
 	info_append_uint32(db, "rack-id", ns->rack_id);
 	info_append_string(db, "read-consistency-level-override", NS_READ_CONSISTENCY_LEVEL_NAME());
 	info_append_bool(db, "single-bin", ns->single_bin);
@@ -1736,7 +1756,16 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 		info_append_uint32(db, "storage-engine.write-block-size", ns->storage_write_block_size);
 		info_append_bool(db, "storage-engine.data-in-memory", ns->storage_data_in_memory);
 		info_append_bool(db, "storage-engine.cold-start-empty", ns->storage_cold_start_empty);
+		info_append_string(db, "storage-engine.compression",
+				ns->storage_compression == AS_COMPRESSION_ZLIB ? "zlib" :
+						(ns->storage_compression == AS_COMPRESSION_ZLIB_DICT ?
+								"zlib-dict" : "none"));
+		info_append_uint32(db, "storage-engine.compression-level", ns->storage_compression_level);
+		info_append_uint32(db, "storage-engine.compression-min-size", ns->storage_compression_min_size);
 		info_append_uint32(db, "storage-engine.defrag-lwm-pct", ns->storage_defrag_lwm_pct);
+		info_append_string(db, "storage-engine.defrag-policy",
+				ns->storage_defrag_policy == AS_STORAGE_DEFRAG_POLICY_COST_BENEFIT ?
+						"cost-benefit" : "fifo");
 		info_append_uint32(db, "storage-engine.defrag-queue-min", ns->storage_defrag_queue_min);
 		info_append_uint32(db, "storage-engine.defrag-sleep", ns->storage_defrag_sleep);
 		info_append_int(db, "storage-engine.defrag-startup-minimum", ns->storage_defrag_startup_minimum);
@@ -1746,11 +1775,20 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 		info_append_string_safe(db, "storage-engine.encryption-key-file", ns->storage_encryption_key_file);
 		info_append_uint64(db, "storage-engine.flush-max-ms", ns->storage_flush_max_us / 1000);
 		info_append_uint64(db, "storage-engine.fsync-max-sec", ns->storage_fsync_max_us / 1000000);
+		info_append_string_safe(db, "storage-engine.index-checkpoint-file", ns->storage_index_checkpoint_file);
+		info_append_uint32(db, "storage-engine.index-checkpoint-period", ns->storage_index_checkpoint_period);
+		info_append_uint32(db, "storage-engine.io-sched-target-us", ns->storage_io_sched_target_us);
 		info_append_uint64(db, "storage-engine.max-write-cache", ns->storage_max_write_cache);
 		info_append_uint32(db, "storage-engine.min-avail-pct", ns->storage_min_avail_pct);
 		info_append_uint32(db, "storage-engine.post-write-queue", ns->storage_post_write_queue);
+		info_append_uint64(db, "storage-engine.read-cache-size", ns->storage_read_cache_size);
+		info_append_string(db, "storage-engine.read-engine",
+				ns->storage_read_engine == AS_STORAGE_READ_ENGINE_IO_URING ?
+						"io-uring" : "fd-pool");
 		info_append_uint32(db, "storage-engine.tomb-raider-sleep", ns->storage_tomb_raider_sleep);
+		info_append_uint32(db, "storage-engine.write-stripes", ns->storage_write_stripes);
 		info_append_uint32(db, "storage-engine.write-threads", ns->storage_write_threads);
+		info_append_uint32(db, "storage-engine.write-ttl-buckets", ns->storage_write_ttl_buckets);
 	}
 
 	info_append_uint32(db, "sindex.num-partitions", ns->sindex_num_partitions);
@@ -1993,6 +2031,12 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of proto-fd-idle-ms from %d to %d ", g_config.proto_fd_idle_ms, val);
 			g_config.proto_fd_idle_ms = val;
 		}
+		else if (0 == as_info_parameter_get(params, "proto-pipeline-max", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 0 || val > MAX_PROTO_PIPELINE)
+				goto Error;
+			cf_info(AS_INFO, "Changing value of proto-pipeline-max from %u to %d ", g_config.proto_pipeline_max, val);
+			g_config.proto_pipeline_max = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "proto-slow-netio-sleep-ms", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2097,6 +2141,12 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			g_config.sindex_builder_threads = (uint32_t)val;
 			as_sbld_resize_thread_pool(g_config.sindex_builder_threads);
 		}
+		else if (0 == as_info_parameter_get(params, "index-tree-gc-max-rate", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 0)
+				goto Error;
+			cf_info(AS_INFO, "Changing value of index-tree-gc-max-rate from %u to %d ", g_config.index_tree_gc_max_rate, val);
+			g_config.index_tree_gc_max_rate = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "sindex-gc-max-rate", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2529,6 +2579,13 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of high-water-memory-pct memory of ns %s from %u to %d ", ns->name, ns->hwm_memory_pct, val);
 			ns->hwm_memory_pct = (uint32_t)val;
 		}
+		else if (0 == as_info_parameter_get(params, "index-defrag-lwm-pct", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 0 || val > 99) {
+				goto Error;
+			}
+			cf_info(AS_INFO, "Changing value of index-defrag-lwm-pct of ns %s from %u to %d ", ns->name, ns->index_defrag_lwm_pct, val);
+			ns->index_defrag_lwm_pct = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "evict-tenths-pct", context, &context_len)) {
 			cf_info(AS_INFO, "Changing value of evict-tenths-pct memory of ns %s from %d to %d ", ns->name, ns->evict_tenths_pct, atoi(context));
 			ns->evict_tenths_pct = atoi(context);
@@ -3436,6 +3493,46 @@ info_command_truncate_undo(char *name, char *params, cf_dyn_buf *db)
 	return 0;
 }
 
+// Format is:
+//
+//	compression-dict-train:namespace=<ns-name>;set=<set-name>
+//
+int
+info_command_compression_dict_train(char *name, char *params, cf_dyn_buf *db)
+{
+	// Get the namespace name.
+
+	char ns_name[AS_ID_NAMESPACE_SZ];
+	int ns_name_len = (int)sizeof(ns_name);
+	int ns_rv = as_info_parameter_get(params, "namespace", ns_name, &ns_name_len);
+
+	if (ns_rv != 0 || ns_name_len == 0) {
+		cf_warning(AS_INFO, "compression-dict-train command: missing or invalid namespace name in command");
+		cf_dyn_buf_append_string(db, "ERROR::namespace-name");
+		return 0;
+	}
+
+	// Get the set-name - dictionaries are per set.
+
+	char set_name[AS_SET_NAME_MAX_SIZE];
+	int set_name_len = (int)sizeof(set_name);
+	int set_rv = as_info_parameter_get(params, "set", set_name, &set_name_len);
+
+	if (set_rv != 0 || set_name_len == 0) {
+		cf_warning(AS_INFO, "compression-dict-train command: missing or invalid set name in command");
+		cf_dyn_buf_append_string(db, "ERROR::set-name");
+		return 0;
+	}
+
+	// Start training - the dictionary is published when done.
+
+	bool ok = as_compression_dict_train_cmd(ns_name, set_name);
+
+	cf_dyn_buf_append_string(db, ok ? "ok" : "ERROR::compression-dict-train");
+
+	return 0;
+}
+
 //
 // Log a message to the server.
 // Limited to 2048 characters.
@@ -5387,6 +5484,20 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	info_append_uint64(db, "memory_used_index_bytes", index_memory);
 	info_append_uint64(db, "memory_used_sindex_bytes", sindex_memory);
 
+	// Index arena stats - fragmentation is free elements as a percentage of
+	// elements in stages holding memory.
+
+	cf_arenax_stats arena_stats;
+
+	cf_arenax_get_stats(ns->arena, &arena_stats);
+
+	info_append_uint32(db, "index_arena_stages", arena_stats.n_stages);
+	info_append_uint32(db, "index_arena_vacant_stages", arena_stats.n_vacant_stages);
+	info_append_uint64(db, "index_arena_fragmentation_pct", arena_stats.n_slots == 0 ?
+			0 : ((arena_stats.n_slots - arena_stats.n_used) * 100) / arena_stats.n_slots);
+	info_append_uint64(db, "index_defrag_moves", ns->n_index_defrag_moves);
+	info_append_uint64(db, "index_defrag_stages_released", ns->n_index_defrag_stages_released);
+
 	uint64_t free_pct = (ns->memory_size != 0 && (ns->memory_size > used_memory)) ?
 			((ns->memory_size - used_memory) * 100L) / ns->memory_size : 0;
 
@@ -5415,9 +5526,49 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 
 		info_append_uint64(db, "device_free_pct", free_pct);
 		info_append_int(db, "device_available_pct", available_pct);
+		info_append_int(db, "device_write_amp_pct", (int)(ns->write_amp * 100 + 0.5));
 
 		if (! ns->storage_data_in_memory) {
 			info_append_int(db, "cache_read_pct", (int)(ns->cache_read_pct + 0.5));
+
+			if (ns->storage_read_cache_size != 0) {
+				info_append_int(db, "read_cache_hit_pct", (int)(ns->read_cache_hit_pct + 0.5));
+			}
+		}
+
+		if (ns->storage_compression != AS_COMPRESSION_NONE) {
+			info_append_int(db, "device_compression_pct", (int)(ns->compression_pct + 0.5));
+			info_append_uint64(db, "device_compression_cpu_us", ns->n_compression_ns / 1000);
+			info_append_uint64(db, "device_decompression_cpu_us", ns->n_decompression_ns / 1000);
+		}
+
+		if (ns->compression_dicts.max_id != 0) {
+			info_append_uint32(db, "device_compression_dicts", ns->compression_dicts.n_dicts);
+			info_append_uint32(db, "device_compression_dicts_retired", ns->compression_dicts.n_retired);
+		}
+
+		if (ns->storage_write_ttl_buckets > 1) {
+			for (uint32_t i = 0; i < ns->storage_write_ttl_buckets; i++) {
+				char name[64];
+
+				sprintf(name, "device_ttl_bucket_%u_wblocks", i);
+				info_append_uint64(db, name, ns->n_ttl_bucket_wblocks[i]);
+
+				sprintf(name, "device_ttl_bucket_%u_wblocks_emptied", i);
+				info_append_uint64(db, name, ns->n_ttl_bucket_wblocks_emptied[i]);
+
+				sprintf(name, "device_ttl_bucket_%u_wblocks_defragged", i);
+				info_append_uint64(db, name, ns->n_ttl_bucket_wblocks_defragged[i]);
+			}
+		}
+
+		if (ns->storage_io_sched_target_us != 0) {
+			info_append_uint64(db, "device_defrag_read_waits", ns->n_io_sched_waits[AS_STORAGE_IO_DEFRAG]);
+			info_append_uint64(db, "device_defrag_read_wait_us", ns->n_io_sched_wait_us[AS_STORAGE_IO_DEFRAG]);
+			info_append_uint64(db, "device_migrate_read_waits", ns->n_io_sched_waits[AS_STORAGE_IO_MIGRATE]);
+			info_append_uint64(db, "device_migrate_read_wait_us", ns->n_io_sched_wait_us[AS_STORAGE_IO_MIGRATE]);
+			info_append_uint64(db, "device_scan_read_waits", ns->n_io_sched_waits[AS_STORAGE_IO_SCAN]);
+			info_append_uint64(db, "device_scan_read_wait_us", ns->n_io_sched_wait_us[AS_STORAGE_IO_SCAN]);
 		}
 	}
 
@@ -6532,7 +6683,7 @@ as_info_init()
 	as_info_set( hb_mode == AS_HB_MODE_MESH ? "mesh" :  "mcast", istr, false);
 
 	// All commands accepted by asinfo/telnet
-	as_info_set("help", "alloc-info;asm;bins;build;build_os;build_time;cluster-name;config-get;config-set;"
+	as_info_set("help", "alloc-info;asm;bins;build;build_os;build_time;cluster-name;compression-dict-train;config-get;config-set;"
 				"df;digests;dump-cluster;dump-fabric;dump-hb;dump-migrates;dump-msgs;dump-rw;"
 				"dump-si;dump-smd;dump-wb;dump-wb-summary;get-config;get-sl;hist-dump;"
 				"hist-track-start;hist-track-stop;jem-stats;jobs;latency;log;log-set;"
@@ -6601,6 +6752,7 @@ as_info_init()
 	as_info_set_command("config-get", info_command_config_get, PERM_NONE);                    // Returns running config for specified context.
 	as_info_set_command("config-set", info_command_config_set, PERM_SET_CONFIG);              // Set a configuration parameter at run time, configuration parameter must be dynamic.
 	as_info_set_command("dump-cluster", info_command_dump_cluster, PERM_LOGGING_CTRL);        // Print debug information about clustering and exchange to the log file.
+	as_info_set_command("compression-dict-train", info_command_compression_dict_train, PERM_SERVICE_CTRL); // Train a set's storage compression dictionary.
 	as_info_set_command("dump-fabric", info_command_dump_fabric, PERM_LOGGING_CTRL);          // Print debug information about fabric to the log file.
 	as_info_set_command("dump-hb", info_command_dump_hb, PERM_LOGGING_CTRL);                  // Print debug information about heartbeat state to the log file.
 	as_info_set_command("dump-hlc", info_command_dump_hlc, PERM_LOGGING_CTRL);                // Print debug information about Hybrid Logical Clock to the log file.
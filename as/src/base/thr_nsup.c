@@ -42,6 +42,7 @@
 #include "citrusleaf/cf_digest.h"
 #include "citrusleaf/cf_queue.h"
 
+#include "arenax.h"
 #include "fault.h"
 #include "hardware.h"
 #include "linear_hist.h"
@@ -64,6 +65,7 @@
 //
 
 #define EVAL_STOP_WRITES_PERIOD 10 // seconds
+#define INDEX_DEFRAG_PERIOD 60 // seconds
 
 
 //==========================================================
@@ -297,14 +299,15 @@ set_cold_start_threshold(as_namespace* ns, linear_hist* hist)
 bool
 as_cold_start_evict_if_needed(as_namespace* ns)
 {
-	pthread_mutex_lock(&ns->cold_start_evict_lock);
-
-	// Only go further than here every thousand record add attempts.
-	if (ns->cold_start_record_add_count++ % EVAL_WRITE_STATE_FREQUENCY != 0) {
-		pthread_mutex_unlock(&ns->cold_start_evict_lock);
+	// Only go further than here every thousand record add attempts. Checked
+	// before locking - many sweep threads call this for every record.
+	if ((cf_atomic32_incr(&ns->cold_start_record_add_count) - 1) %
+			EVAL_WRITE_STATE_FREQUENCY != 0) {
 		return true;
 	}
 
+	pthread_mutex_lock(&ns->cold_start_evict_lock);
+
 	uint32_t now = as_record_void_time_get();
 
 	// Update threshold void-time if we're past it.
@@ -627,7 +630,7 @@ add_to_ttl_histograms(as_namespace* ns, as_index* r)
 typedef struct evict_prep_info_s {
 	as_namespace*	ns;
 	bool*			sets_not_evicting;
-	uint64_t		num_0_void_time;
+	cf_atomic64		num_0_void_time;
 } evict_prep_info;
 
 static void
@@ -649,7 +652,7 @@ evict_prep_reduce_cb(as_index_ref* r_ref, void* udata)
 		add_to_ttl_histograms(ns, r);
 	}
 	else {
-		p_info->num_0_void_time++;
+		cf_atomic64_incr(&p_info->num_0_void_time);
 	}
 
 	as_record_done(r_ref, ns);
@@ -665,7 +668,7 @@ typedef struct evict_info_s {
 	uint32_t		now;
 	bool*			sets_not_evicting;
 	uint32_t		evict_void_time;
-	uint64_t		num_evicted;
+	cf_atomic64		num_evicted;
 } evict_info;
 
 static void
@@ -681,12 +684,12 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 		if (p_info->sets_not_evicting[set_id]) {
 			if (p_info->now > void_time) {
 				queue_for_delete(ns, &r->keyd);
-				p_info->num_evicted++;
+				cf_atomic64_incr(&p_info->num_evicted);
 			}
 		}
 		else if (void_time < p_info->evict_void_time) {
 			queue_for_delete(ns, &r->keyd);
-			p_info->num_evicted++;
+			cf_atomic64_incr(&p_info->num_evicted);
 		}
 	}
 
@@ -702,8 +705,8 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 typedef struct expire_info_s {
 	as_namespace*	ns;
 	uint32_t		now;
-	uint64_t		num_expired;
-	uint64_t		num_0_void_time;
+	cf_atomic64		num_expired;
+	cf_atomic64		num_0_void_time;
 } expire_info;
 
 static void
@@ -717,7 +720,7 @@ expire_reduce_cb(as_index_ref* r_ref, void* udata)
 	if (void_time != 0) {
 		if (p_info->now > void_time) {
 			queue_for_delete(ns, &r->keyd);
-			p_info->num_expired++;
+			cf_atomic64_incr(&p_info->num_expired);
 		}
 		else {
 			add_to_obj_size_histograms(ns, r);
@@ -726,7 +729,7 @@ expire_reduce_cb(as_index_ref* r_ref, void* udata)
 	}
 	else {
 		add_to_obj_size_histograms(ns, r);
-		p_info->num_0_void_time++;
+		cf_atomic64_incr(&p_info->num_0_void_time);
 	}
 
 	as_record_done(r_ref, ns);
@@ -736,7 +739,8 @@ expire_reduce_cb(as_index_ref* r_ref, void* udata)
 // Reduce all master partitions, using specified
 // functionality. Throttle to make sure deletions
 // generated by reducing each partition don't blow
-// up the delete queue.
+// up the delete queue. Large partitions are reduced
+// in parallel - callbacks must be thread-safe.
 //
 static void
 reduce_master_partitions(as_namespace* ns, as_index_reduce_fn cb, void* udata, uint32_t* p_n_waits, const char* tag)
@@ -748,7 +752,7 @@ reduce_master_partitions(as_namespace* ns, as_index_reduce_fn cb, void* udata, u
 			continue;
 		}
 
-		as_index_reduce_live(rsv.tree, cb, udata);
+		as_index_reduce_parallel_live(rsv.tree, cb, udata);
 
 		as_partition_release(&rsv);
 
@@ -1002,7 +1006,7 @@ run_nsup(void *arg)
 				// general eviction threshold.
 				reduce_master_partitions(ns, evict_prep_reduce_cb, &cb_info1, &n_general_waits, "evict-prep");
 
-				n_0_void_time_records = cb_info1.num_0_void_time;
+				n_0_void_time_records = (uint64_t)cf_atomic64_get(cb_info1.num_0_void_time);
 
 				evict_info cb_info2;
 
@@ -1022,7 +1026,7 @@ run_nsup(void *arg)
 					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, &n_general_waits, "evict");
 
 					evict_ttl = cb_info2.evict_void_time - now;
-					n_evicted_records = cb_info2.num_evicted;
+					n_evicted_records = (uint64_t)cf_atomic64_get(cb_info2.num_evicted);
 				}
 				else if (sets_protected || cb_info2.evict_void_time == now) {
 					// Convert eviction into expiration.
@@ -1033,7 +1037,7 @@ run_nsup(void *arg)
 					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, &n_general_waits, "expire-protected-sets");
 
 					// Count these as expired rather than evicted, since we can.
-					n_expired_records = cb_info2.num_evicted;
+					n_expired_records = (uint64_t)cf_atomic64_get(cb_info2.num_evicted);
 				}
 
 				// For now there's no get_info() call for evict_hist.
@@ -1051,8 +1055,8 @@ run_nsup(void *arg)
 				// Reduce master partitions, deleting expired records.
 				reduce_master_partitions(ns, expire_reduce_cb, &cb_info, &n_general_waits, "expire");
 
-				n_expired_records = cb_info.num_expired;
-				n_0_void_time_records = cb_info.num_0_void_time;
+				n_expired_records = (uint64_t)cf_atomic64_get(cb_info.num_expired);
+				n_0_void_time_records = (uint64_t)cf_atomic64_get(cb_info.num_0_void_time);
 			}
 
 			linear_hist_dump(ns->obj_size_hist);
@@ -1108,6 +1112,78 @@ run_stop_writes(void *arg)
 	return NULL;
 }
 
+//------------------------------------------------
+// Move an index element out of the stage being
+// drained, unless it's in use.
+//
+typedef struct index_defrag_info_s {
+	as_namespace*	ns;
+	uint64_t		n_moves;
+} index_defrag_info;
+
+static bool
+index_defrag_cb(cf_arenax_handle h, void* udata)
+{
+	index_defrag_info* p_info = (index_defrag_info*)udata;
+	as_namespace* ns = p_info->ns;
+	as_index* r = (as_index*)cf_arenax_resolve(ns->arena, h);
+
+	// If the element's been freed the digest is garbage - relocate will then
+	// not find the element, whatever tree we look in.
+	as_index_tree* tree = as_partition_reserve_tree(ns, as_partition_getid(&r->keyd));
+	int rv = as_index_relocate(tree, h);
+
+	as_index_tree_release(tree);
+
+	if (rv == 0) {
+		p_info->n_moves++;
+	}
+
+	// Stop if the arena is full, or defrag was switched off.
+	return rv != -3 && ns->index_defrag_lwm_pct != 0;
+}
+
+//------------------------------------------------
+// Namespace index arena defrag thread "run"
+// function. Empties sparse arena stages and
+// returns their memory to the OS.
+//
+void *
+run_index_defrag(void *arg)
+{
+	while (true) {
+		sleep(INDEX_DEFRAG_PERIOD);
+
+		for (uint32_t ns_ix = 0; ns_ix < g_config.n_namespaces; ns_ix++) {
+			as_namespace *ns = g_config.namespaces[ns_ix];
+
+			while (ns->index_defrag_lwm_pct != 0) {
+				uint64_t start_ms = cf_getms();
+				index_defrag_info info = { ns, 0 };
+				bool released = cf_arenax_drain(ns->arena,
+						ns->index_defrag_lwm_pct, index_defrag_cb, &info);
+
+				cf_atomic64_add(&ns->n_index_defrag_moves, (int64_t)info.n_moves);
+
+				if (info.n_moves != 0 || released) {
+					cf_info(AS_NSUP, "{%s} index-defrag: moved %lu elements, %s stage, in %lu ms",
+							ns->name, info.n_moves,
+							released ? "released" : "kept",
+							cf_getms() - start_ms);
+				}
+
+				if (! released) {
+					break; // nothing (more) to do, or elements in use - retry later
+				}
+
+				cf_atomic64_incr(&ns->n_index_defrag_stages_released);
+			}
+		}
+	}
+
+	return NULL;
+}
+
 //------------------------------------------------
 // Start supervisor threads.
 //
@@ -1142,6 +1218,11 @@ as_nsup_start()
 	if (0 != pthread_create(&thread, &attrs, run_stop_writes, NULL)) {
 		cf_crash(AS_NSUP, "nsup stop-writes thread create failed");
 	}
+
+	// Start thread to defrag index arenas.
+	if (0 != pthread_create(&thread, &attrs, run_index_defrag, NULL)) {
+		cf_crash(AS_NSUP, "nsup index defrag thread create failed");
+	}
 }
 
 
@@ -1607,6 +1607,7 @@ query_io(as_query_transaction *qtr, cf_digest *dig, as_sindex_key * skey)
 		// make sure it's brought in from storage if necessary
 		as_storage_rd rd;
 		as_storage_record_open(ns, r, &rd);
+		rd.io_class = AS_STORAGE_IO_SCAN;
 		qtr->n_read_success += 1;
 
 		// TODO - even if qtr->no_bin_data is true, we still read bins in order
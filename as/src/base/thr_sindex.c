@@ -740,7 +740,12 @@ sbld_job_create(as_namespace* ns, uint16_t set_id, as_sindex* si)
 void
 sbld_job_slice(as_job* _job, as_partition_reservation* rsv)
 {
-	as_index_reduce_live(rsv->tree, sbld_job_reduce_cb, (void*)_job);
+	// A set-level sindex needs only the set's records, if the set is indexed.
+	if (! as_index_reduce_set_live(rsv->tree, _job->set_id, sbld_job_reduce_cb,
+			(void*)_job)) {
+		as_index_reduce_parallel_live(rsv->tree, sbld_job_reduce_cb,
+				(void*)_job);
+	}
 }
 
 void
@@ -819,6 +824,7 @@ sbld_job_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	as_storage_rd rd;
 	as_storage_record_open(ns, r, &rd);
+	rd.io_class = AS_STORAGE_IO_SCAN;
 	as_storage_rd_load_n_bins(&rd); // TODO - handle error returned
 	as_bin stack_bins[rd.ns->storage_data_in_memory ? 0 : rd.n_bins];
 	as_storage_rd_load_bins(&rd, stack_bins); // TODO - handle error returned
@@ -168,6 +168,16 @@ as_tsvc_enqueue(as_transaction *tr)
 }
 
 
+// Queue work for a transaction thread - it runs in turn with transactions.
+void
+as_tsvc_enqueue_cb(as_tsvc_cb *cb)
+{
+	as_transaction tr = { .origin = FROM_TSVC_CB, .from.tsvc_cb = cb };
+
+	as_tsvc_enqueue(&tr);
+}
+
+
 // Triggered via dynamic configuration change.
 void
 as_tsvc_set_threads_per_queue(uint32_t target_n_threads)
@@ -553,6 +563,11 @@ run_tsvc(void *arg)
 			cf_crash(AS_TSVC, "unable to pop from transaction queue");
 		}
 
+		if (tr.origin == FROM_TSVC_CB) {
+			tr.from.tsvc_cb->fn(tr.from.tsvc_cb);
+			continue;
+		}
+
 		if (! tr.msgp) {
 			break; // thread termination via configuration change
 		}
@@ -75,6 +75,7 @@ void log_ticker_frame(uint64_t delta_time);
 
 void log_line_system_memory();
 void log_line_in_progress();
+void log_line_tree_gc();
 void log_line_fds();
 void log_line_heartbeat();
 void log_fabric_rate(uint64_t delta_time);
@@ -89,6 +90,7 @@ void log_line_migrations(as_namespace* ns);
 void log_line_memory_usage(as_namespace* ns, size_t total_mem, size_t index_mem,
 		size_t sindex_mem, size_t data_mem);
 void log_line_device_usage(as_namespace* ns);
+void log_line_device_compression(as_namespace* ns);
 
 void log_line_client(as_namespace* ns);
 void log_line_xdr_client(as_namespace* ns);
@@ -167,6 +169,7 @@ log_ticker_frame(uint64_t delta_time)
 
 	log_line_system_memory();
 	log_line_in_progress();
+	log_line_tree_gc();
 	log_line_fds();
 	log_line_heartbeat();
 	log_fabric_rate(delta_time);
@@ -198,6 +201,7 @@ log_ticker_frame(uint64_t delta_time)
 		log_line_migrations(ns);
 		log_line_memory_usage(ns, total_mem, index_mem, sindex_mem, data_mem);
 		log_line_device_usage(ns);
+		log_line_device_compression(ns);
 
 		log_line_client(ns);
 		log_line_xdr_client(ns);
@@ -260,6 +264,26 @@ log_line_in_progress()
 }
 
 
+void
+log_line_tree_gc()
+{
+	uint64_t n_trees = g_stats.tree_gc_trees_destroyed;
+	uint64_t n_elements = g_stats.tree_gc_elements_destroyed;
+	uint64_t n_pending = as_index_tree_gc_pending();
+
+	if ((n_trees | n_elements | n_pending) == 0) {
+		return;
+	}
+
+	cf_info(AS_INFO, "   tree-gc: queue %d active %u pending-elements %lu destroyed (%lu,%lu)",
+			as_index_tree_gc_queue_size(),
+			as_index_tree_gc_active(),
+			n_pending,
+			n_trees, n_elements
+			);
+}
+
+
 void
 log_line_fds()
 {
@@ -461,11 +485,24 @@ log_line_device_usage(as_namespace* ns)
 	uint64_t inuse_disk_bytes;
 	as_storage_stats(ns, &available_pct, &inuse_disk_bytes);
 
+	uint64_t write_bytes = cf_atomic64_get(ns->n_device_write_bytes);
+	uint64_t defrag_write_bytes = cf_atomic64_get(ns->n_defrag_write_bytes);
+
+	cf_atomic64_sub(&ns->n_device_write_bytes, (int64_t)write_bytes);
+	cf_atomic64_sub(&ns->n_defrag_write_bytes, (int64_t)defrag_write_bytes);
+
+	// Keep previous ratio if nothing was written this interval.
+	if (write_bytes != 0) {
+		ns->write_amp = (float)(write_bytes + defrag_write_bytes) /
+				(float)write_bytes;
+	}
+
 	if (ns->storage_data_in_memory) {
-		cf_info(AS_INFO, "{%s} device-usage: used-bytes %lu avail-pct %d",
+		cf_info(AS_INFO, "{%s} device-usage: used-bytes %lu avail-pct %d write-amp %.2f",
 				ns->name,
 				inuse_disk_bytes,
-				available_pct
+				available_pct,
+				ns->write_amp
 				);
 	}
 	else {
@@ -479,16 +516,68 @@ log_line_device_usage(as_namespace* ns)
 				(float)(100 * n_reads_from_cache) /
 				(float)(n_total_reads == 0 ? 1 : n_total_reads);
 
-		cf_info(AS_INFO, "{%s} device-usage: used-bytes %lu avail-pct %d cache-read-pct %.2f",
+		if (ns->storage_read_cache_size == 0) {
+			cf_info(AS_INFO, "{%s} device-usage: used-bytes %lu avail-pct %d write-amp %.2f cache-read-pct %.2f",
+					ns->name,
+					inuse_disk_bytes,
+					available_pct,
+					ns->write_amp,
+					ns->cache_read_pct
+					);
+			return;
+		}
+
+		uint32_t n_read_cache_hits = ns->n_read_cache_hits;
+		uint32_t n_read_cache_lookups =
+				ns->n_read_cache_misses + n_read_cache_hits;
+
+		cf_atomic32_set(&ns->n_read_cache_hits, 0);
+		cf_atomic32_set(&ns->n_read_cache_misses, 0);
+
+		ns->read_cache_hit_pct =
+				(float)(100 * n_read_cache_hits) /
+				(float)(n_read_cache_lookups == 0 ? 1 : n_read_cache_lookups);
+
+		cf_info(AS_INFO, "{%s} device-usage: used-bytes %lu avail-pct %d write-amp %.2f cache-read-pct %.2f read-cache-hit-pct %.2f",
 				ns->name,
 				inuse_disk_bytes,
 				available_pct,
-				ns->cache_read_pct
+				ns->write_amp,
+				ns->cache_read_pct,
+				ns->read_cache_hit_pct
 				);
 	}
 }
 
 
+void
+log_line_device_compression(as_namespace* ns)
+{
+	if (ns->storage_type != AS_STORAGE_ENGINE_SSD ||
+			ns->storage_compression == AS_COMPRESSION_NONE) {
+		return;
+	}
+
+	uint64_t orig_bytes = cf_atomic64_get(ns->n_compression_orig_bytes);
+	uint64_t bytes = cf_atomic64_get(ns->n_compression_bytes);
+
+	cf_atomic64_sub(&ns->n_compression_orig_bytes, (int64_t)orig_bytes);
+	cf_atomic64_sub(&ns->n_compression_bytes, (int64_t)bytes);
+
+	// Keep previous ratio if nothing was written this interval.
+	if (orig_bytes != 0) {
+		ns->compression_pct = (float)(100 * bytes) / (float)orig_bytes;
+	}
+
+	cf_info(AS_INFO, "{%s} device-compression: pct %.2f cpu-ms (%lu,%lu)",
+			ns->name,
+			ns->compression_pct,
+			cf_atomic64_get(ns->n_compression_ns) / 1000000,
+			cf_atomic64_get(ns->n_decompression_ns) / 1000000
+			);
+}
+
+
 void
 log_line_client(as_namespace* ns)
 {
@@ -164,6 +164,12 @@ as_transaction_set_msg_field_flag(as_transaction *tr, uint8_t type)
 	case AS_MSG_FIELD_TYPE_SOCKET_TIMEOUT:
 		tr->msg_fields |= AS_MSG_FIELD_BIT_SOCKET_TIMEOUT;
 		break;
+	case AS_MSG_FIELD_TYPE_PID_ARRAY:
+		tr->msg_fields |= AS_MSG_FIELD_BIT_PID_ARRAY;
+		break;
+	case AS_MSG_FIELD_TYPE_DIGEST_ARRAY:
+		tr->msg_fields |= AS_MSG_FIELD_BIT_DIGEST_ARRAY;
+		break;
 	case AS_MSG_FIELD_TYPE_INDEX_NAME:
 		tr->msg_fields |= AS_MSG_FIELD_BIT_INDEX_NAME;
 		break;
@@ -443,6 +449,12 @@ as_release_file_handle(as_file_handle *proto_fd_h)
 		proto_fd_h->security_filter = NULL;
 	}
 
+	if (proto_fd_h->recv_buf) {
+		cf_free(proto_fd_h->recv_buf);
+		proto_fd_h->recv_buf = NULL;
+	}
+
+	cf_mutex_destroy(&proto_fd_h->send_lock);
 	cf_rc_free(proto_fd_h);
 	cf_atomic64_incr(&g_stats.proto_connections_closed);
 }
@@ -450,7 +462,13 @@ as_release_file_handle(as_file_handle *proto_fd_h)
 void
 as_end_of_transaction(as_file_handle *proto_fd_h, bool force_close)
 {
-	thr_demarshal_rearm(proto_fd_h);
+	// If pipelined requests are in progress, this is one of them - they were
+	// re-armed as read, unless the connection reached its limit.
+	if (cf_atomic32_get(proto_fd_h->n_pipelined) == 0 ||
+			(uint32_t)cf_atomic32_decr(&proto_fd_h->n_pipelined) ==
+					proto_fd_h->pipeline_max - 1) {
+		thr_demarshal_rearm(proto_fd_h);
+	}
 
 	if (force_close) {
 		cf_socket_shutdown(&proto_fd_h->sock);
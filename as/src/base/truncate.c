@@ -56,7 +56,7 @@
 typedef struct truncate_reduce_cb_info_s {
 	as_namespace* ns;
 	as_index_tree* tree;
-	int64_t n_deleted;
+	cf_atomic64 n_deleted;
 } truncate_reduce_cb_info;
 
 static const uint32_t NUM_TRUNCATE_THREADS = 4;
@@ -99,6 +99,7 @@ void truncate_action_do(as_namespace* ns, const char* set_name, uint64_t lut);
 void truncate_action_undo(as_namespace* ns, const char* set_name);
 void truncate_all(as_namespace* ns);
 void* run_truncate(void* arg);
+bool truncate_reduce_sets(as_namespace* ns, truncate_reduce_cb_info* cb_info);
 void truncate_finish(as_namespace* ns);
 void truncate_reduce_cb(as_index_ref* r_ref, void* udata);
 
@@ -550,7 +551,11 @@ run_truncate(void* arg)
 
 		truncate_reduce_cb_info cb_info = { .ns = ns, .tree = rsv.tree };
 
-		as_index_reduce(rsv.tree, truncate_reduce_cb, (void*)&cb_info);
+		if (! truncate_reduce_sets(ns, &cb_info)) {
+			as_index_reduce_parallel(rsv.tree, truncate_reduce_cb,
+					(void*)&cb_info);
+		}
+
 		as_partition_release(&rsv);
 
 		cf_atomic64_add(&ns->truncate.n_records_this_run, cb_info.n_deleted);
@@ -562,6 +567,40 @@ run_truncate(void* arg)
 }
 
 
+// If only indexed sets are being truncated, reduce just those sets' records.
+// Returns false if the whole tree must be reduced.
+bool
+truncate_reduce_sets(as_namespace* ns, truncate_reduce_cb_info* cb_info)
+{
+	if (ns->truncate.lut != 0 || ns->tree_shared.n_set_sprigs == 0) {
+		return false;
+	}
+
+	uint32_t n_sets = cf_vmapx_count(ns->p_sets_vmap);
+
+	for (uint32_t set_id = 1; set_id <= n_sets; set_id++) {
+		as_set* p_set = as_namespace_get_set_by_id(ns, (uint16_t)set_id);
+
+		if (p_set && p_set->truncate_lut != 0 &&
+				! as_index_tree_has_set_index(cb_info->tree,
+						(uint16_t)set_id)) {
+			return false;
+		}
+	}
+
+	for (uint32_t set_id = 1; set_id <= n_sets; set_id++) {
+		as_set* p_set = as_namespace_get_set_by_id(ns, (uint16_t)set_id);
+
+		if (p_set && p_set->truncate_lut != 0) {
+			as_index_reduce_set(cb_info->tree, (uint16_t)set_id,
+					truncate_reduce_cb, (void*)cb_info);
+		}
+	}
+
+	return true;
+}
+
+
 void
 truncate_finish(as_namespace* ns)
 {
@@ -601,7 +640,7 @@ truncate_reduce_cb(as_index_ref* r_ref, void* udata)
 	as_namespace* ns = cb_info->ns;
 
 	if (r->last_update_time < ns->truncate.lut) {
-		cb_info->n_deleted++;
+		cf_atomic64_incr(&cb_info->n_deleted);
 		record_delete_adjust_sindex(r, ns);
 		as_index_delete(cb_info->tree, &r->keyd);
 		as_record_done(r_ref, ns);
@@ -612,7 +651,7 @@ truncate_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	// Delete records not updated since their set's threshold last-update-time.
 	if (p_set && r->last_update_time < p_set->truncate_lut) {
-		cb_info->n_deleted++;
+		cf_atomic64_incr(&cb_info->n_deleted);
 		record_delete_adjust_sindex(r, ns);
 		as_index_delete(cb_info->tree, &r->keyd);
 	}
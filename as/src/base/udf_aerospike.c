@@ -738,7 +738,7 @@ udf_aerospike_rec_create(const as_aerospike * as, const as_rec * rec)
 	} else if (rv == 0) {
 		// If it's an expired or truncated record, pretend it's a fresh create.
 		if (as_record_is_doomed(r_ref->r, tr->rsv.ns)) {
-			as_record_rescue(r_ref, tr->rsv.ns);
+			as_record_rescue(tree, r_ref, tr->rsv.ns);
 		} else {
 			cf_warning(AS_UDF, "udf_aerospike_rec_create: Record Already Exists 2");
 			as_record_done(r_ref, tr->rsv.ns);
@@ -763,6 +763,8 @@ udf_aerospike_rec_create(const as_aerospike * as, const as_rec * rec)
 			return 4;
 		}
 
+		as_index_set_index_insert(tree, r_ref);
+
 		// Don't write record if it would be truncated.
 		if (as_truncate_now_is_truncated(tr->rsv.ns, as_index_get_set_id(r_ref->r))) {
 			as_index_delete(tree, &tr->keyd);
@@ -928,6 +928,7 @@ emigrate_tree_reduce_fn(as_index_ref *r_ref, void *udata)
 	as_storage_rd rd;
 
 	as_storage_record_open(ns, r, &rd);
+	rd.io_class = AS_STORAGE_IO_MIGRATE;
 
 	as_storage_rd_load_n_bins(&rd); // TODO - handle error returned
 
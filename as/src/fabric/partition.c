@@ -505,6 +505,25 @@ as_partition_reserve_xdr_read(as_namespace* ns, uint32_t pid,
 }
 
 
+// Reserves just the tree, regardless of partition state - for looking ahead at
+// the index, not for transactions. Release with as_index_tree_release().
+as_index_tree*
+as_partition_reserve_tree(as_namespace* ns, uint32_t pid)
+{
+	as_partition* p = &ns->partitions[pid];
+
+	pthread_mutex_lock(&p->lock);
+
+	as_index_tree* tree = p->vp;
+
+	cf_rc_reserve(tree);
+
+	pthread_mutex_unlock(&p->lock);
+
+	return tree;
+}
+
+
 void
 as_partition_reservation_copy(as_partition_reservation* dst,
 		as_partition_reservation* src)
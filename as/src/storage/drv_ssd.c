@@ -29,7 +29,9 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <float.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -40,6 +42,7 @@
 #include <linux/fs.h> // for BLKGETSIZE64
 #include <sys/ioctl.h>
 #include <sys/param.h> // for MAX()
+#include <zlib.h>
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
@@ -50,10 +53,14 @@
 
 #include "cf_mutex.h"
 #include "fault.h"
+#include "hardware.h"
 #include "hist.h"
+#include "shash.h"
+#include "uring.h"
 #include "vmapx.h"
 
 #include "base/cfg.h"
+#include "base/compression_dict.h"
 #include "base/datamodel.h"
 #include "base/index.h"
 #include "base/proto.h"
@@ -72,6 +79,9 @@
 // Defined in thr_nsup.c, for historical reasons.
 extern bool as_cold_start_evict_if_needed(as_namespace* ns);
 
+void ssd_read_complete(as_tsvc_cb *cb);
+void ssd_sweeps_note_move(drv_ssds *ssds, const cf_digest *keyd, drv_ssd *old_ssd, uint64_t old_rblock_id, drv_ssd *new_ssd, uint64_t new_rblock_id);
+
 
 //==========================================================
 // Constants.
@@ -82,6 +92,18 @@ extern bool as_cold_start_evict_if_needed(as_namespace* ns);
 #define DEFRAG_STARTUP_RESERVE	4
 #define DEFRAG_RUNTIME_RESERVE	4
 
+#define READ_RING_DEPTH			512 // max async reads in flight per device
+#define READ_REAP_MAX			64
+
+#define COLD_START_READ_SIZE			(8 * 1024 * 1024)
+#define MAX_COLD_START_SWEEP_THREADS	8 // per device
+
+#define SWEEP_MOVED_N_BUCKETS	(64 * 1024)
+
+// Device-order sweep's verdicts on records moved during the sweep.
+#define SWEEP_MOVED		1 // not visited yet - visit when sweep ends
+#define SWEEP_DONE		2 // visited - skip any newer copy
+
 
 //==========================================================
 // Typedefs.
@@ -93,6 +115,293 @@ typedef struct info_buf_s {
 	as_partition_version version;
 } __attribute__ ((__packed__)) info_buf;
 
+// Shared by the threads sweeping a device at cold start.
+typedef struct ssd_sweep_s {
+	drv_ssds *ssds;
+	drv_ssd *ssd;
+	uint32_t first_wblock_id;
+	uint32_t n_wblocks;
+	uint32_t n_wblocks_per_read;
+	cf_atomic32 n_reads_claimed;
+	cf_atomic32 end_wblock_id; // lowered if we find the end of used space
+} ssd_sweep;
+
+// A device-order sweep. Wblocks are numbered across devices in order, and
+// positions are rblocks counted the same way.
+typedef struct as_storage_sweep_s {
+	struct as_storage_sweep_s *next; // in drv_ssds' list of sweeps
+	drv_ssds *ssds;
+	as_index_tree *const *trees;
+	uint32_t n_slices;
+	uint64_t n_wblocks; // all devices
+	uint64_t *bases; // per device - number of its first wblock
+	cf_atomic64 *cursors; // per slice - position swept up to
+	cf_shash *moved; // digest -> SWEEP_MOVED or SWEEP_DONE
+} as_storage_sweep;
+
+
+//==========================================================
+// Compression utilities.
+//
+
+// Setting up a zlib stream allocates a few hundred KB, far too much to do per
+// record, so each thread keeps one of each and resets them between records.
+
+static z_stream *
+ssd_deflate_stream(int level)
+{
+	static __thread z_stream strm;
+	static __thread bool initialized = false;
+	static __thread int strm_level;
+
+	if (initialized && strm_level != level) {
+		deflateEnd(&strm);
+		initialized = false;
+	}
+
+	if (initialized) {
+		deflateReset(&strm);
+		return &strm;
+	}
+
+	memset(&strm, 0, sizeof(strm));
+
+	if (deflateInit(&strm, level) != Z_OK) {
+		return NULL;
+	}
+
+	initialized = true;
+	strm_level = level;
+
+	return &strm;
+}
+
+static z_stream *
+ssd_inflate_stream()
+{
+	static __thread z_stream strm;
+	static __thread bool initialized = false;
+
+	if (initialized) {
+		inflateReset(&strm);
+		return &strm;
+	}
+
+	memset(&strm, 0, sizeof(strm));
+
+	if (inflateInit(&strm) != Z_OK) {
+		return NULL;
+	}
+
+	initialized = true;
+
+	return &strm;
+}
+
+
+// The dictionary new writes to this set should use, if any.
+static inline const as_compression_dict *
+ssd_set_compression_dict(as_namespace *ns, uint16_t set_id)
+{
+	as_set *p_set = as_namespace_get_set_by_id(ns, set_id);
+
+	return p_set ? as_compression_dict_get(&ns->compression_dicts,
+			(uint16_t)cf_atomic32_get(p_set->compression_dict_id)) : NULL;
+}
+
+
+// Compress the bins of a flat block into an allocated buffer which caller
+// frees, setting *p_packed_size. Returns NULL if that fails or doesn't save at
+// least an rblock. With a dictionary, zlib's stream header carries the
+// dictionary's checksum, so a mismatch is caught when inflating.
+static uint8_t *
+ssd_compress_flat(as_namespace *ns, const uint8_t *flat, uint32_t flat_used,
+		uint32_t flat_size, const as_compression_dict *dict,
+		uint32_t *p_packed_size)
+{
+	const drv_ssd_block *flat_block = (const drv_ssd_block*)flat;
+	uint32_t bins_start = (uint32_t)offsetof(drv_ssd_block, data) +
+			flat_block->bins_offset;
+	uint32_t bins_sz = flat_used - bins_start;
+
+	int level = ns->storage_compression_level == 0 ?
+			Z_DEFAULT_COMPRESSION : (int)ns->storage_compression_level;
+	z_stream *strm = ssd_deflate_stream(level);
+
+	if (! strm) {
+		return NULL;
+	}
+
+	uint64_t start_ns = cf_getns();
+
+	if (dict) {
+		deflateSetDictionary(strm, dict->data, dict->size);
+	}
+
+	// Note - bound includes dictionary id in stream header, if set.
+	uint32_t packed_bins_capacity = (uint32_t)deflateBound(strm, bins_sz);
+	uint32_t packed_capacity = BYTES_TO_RBLOCK_BYTES(bins_start +
+			packed_bins_capacity);
+	uint8_t *packed = cf_malloc(packed_capacity);
+
+	strm->next_in = (uint8_t*)flat + bins_start;
+	strm->avail_in = bins_sz;
+	strm->next_out = packed + bins_start;
+	strm->avail_out = packed_bins_capacity;
+
+	int rv = deflate(strm, Z_FINISH);
+
+	cf_atomic64_add(&ns->n_compression_ns, (int64_t)(cf_getns() - start_ns));
+
+	uint32_t packed_used = bins_start + (uint32_t)strm->total_out;
+	uint32_t packed_size = BYTES_TO_RBLOCK_BYTES(packed_used);
+
+	if (rv != Z_STREAM_END || packed_size >= flat_size) {
+		cf_free(packed);
+		return NULL;
+	}
+
+	memcpy(packed, flat, bins_start);
+	memset(packed + packed_used, 0, packed_size - packed_used);
+
+	drv_ssd_block *block = (drv_ssd_block*)packed;
+
+	block->compression = (uint8_t)(dict ?
+			AS_COMPRESSION_ZLIB_DICT : AS_COMPRESSION_ZLIB);
+	block->dict_id = dict ? dict->id : 0;
+	block->flat_length = flat_block->length;
+	block->length = packed_size - LENGTH_BASE;
+
+	*p_packed_size = packed_size;
+
+	return packed;
+}
+
+
+// Returns an expanded copy of a block whose bins are compressed, allocated as a
+// single buffer which caller frees, or NULL on failure.
+static drv_ssd_block *
+ssd_decompress_block(as_namespace *ns, const drv_ssd_block *block)
+{
+	const as_compression_dict *dict = NULL;
+
+	if (block->compression == AS_COMPRESSION_ZLIB_DICT) {
+		if (! (dict = as_compression_dict_get(&ns->compression_dicts,
+				block->dict_id))) {
+			cf_warning(AS_DRV_SSD, "read: missing compression dictionary %u",
+					block->dict_id);
+			return NULL;
+		}
+	}
+	else if (block->compression != AS_COMPRESSION_ZLIB) {
+		cf_warning(AS_DRV_SSD, "read: bad block compression %u",
+				block->compression);
+		return NULL;
+	}
+
+	uint32_t bins_start = (uint32_t)offsetof(drv_ssd_block, data) +
+			block->bins_offset;
+	uint32_t packed_size = block->length + LENGTH_BASE;
+	uint32_t flat_size = block->flat_length + LENGTH_BASE;
+
+	if (flat_size < bins_start || flat_size > MAX_WRITE_BLOCK_SIZE ||
+			packed_size < bins_start) {
+		cf_warning(AS_DRV_SSD, "read: bad block flat-length %u",
+				block->flat_length);
+		return NULL;
+	}
+
+	z_stream *strm = ssd_inflate_stream();
+
+	if (! strm) {
+		cf_warning(AS_DRV_SSD, "read: failed inflate init");
+		return NULL;
+	}
+
+	uint8_t *flat = cf_malloc(flat_size);
+
+	memcpy(flat, block, bins_start);
+
+	uint64_t start_ns = cf_getns();
+
+	strm->next_in = (uint8_t*)block + bins_start;
+	strm->avail_in = packed_size - bins_start;
+	strm->next_out = flat + bins_start;
+	strm->avail_out = flat_size - bins_start;
+
+	int rv = inflate(strm, Z_FINISH);
+
+	if (rv == Z_NEED_DICT && dict) {
+		// Note - fails with Z_DATA_ERROR if stream wants another dictionary.
+		if ((rv = inflateSetDictionary(strm, dict->data, dict->size)) ==
+				Z_OK) {
+			rv = inflate(strm, Z_FINISH);
+		}
+	}
+
+	cf_atomic64_add(&ns->n_decompression_ns, (int64_t)(cf_getns() - start_ns));
+
+	if (rv != Z_STREAM_END) {
+		cf_warning(AS_DRV_SSD, "read: failed decompressing bins: %d", rv);
+		cf_free(flat);
+		return NULL;
+	}
+
+	uint32_t flat_used = bins_start + (uint32_t)strm->total_out;
+
+	memset(flat + flat_used, 0, flat_size - flat_used);
+
+	drv_ssd_block *flat_block = (drv_ssd_block*)flat;
+
+	flat_block->compression = AS_COMPRESSION_NONE;
+	flat_block->dict_id = 0;
+	flat_block->flat_length = 0;
+	flat_block->length = block->flat_length;
+
+	return flat_block;
+}
+
+
+// Re-encode a block compressed with a superseded dictionary, so the old
+// dictionary can eventually be retired. Returns an allocated block which caller
+// frees, setting *p_write_size, or NULL if the block should be kept as is.
+static drv_ssd_block *
+ssd_recompress_block(as_namespace *ns, const drv_ssd_block *block,
+		uint16_t set_id, uint32_t *p_write_size)
+{
+	if (block->compression != AS_COMPRESSION_ZLIB_DICT) {
+		return NULL;
+	}
+
+	const as_compression_dict *dict = ssd_set_compression_dict(ns, set_id);
+
+	if (dict && dict->id == block->dict_id) {
+		return NULL;
+	}
+
+	drv_ssd_block *flat_block = ssd_decompress_block(ns, block);
+
+	if (! flat_block) {
+		return NULL;
+	}
+
+	uint32_t flat_size = flat_block->length + LENGTH_BASE;
+	uint32_t packed_size;
+	uint8_t *packed = ssd_compress_flat(ns, (const uint8_t*)flat_block,
+			flat_size, flat_size, dict, &packed_size);
+
+	if (packed) {
+		cf_free(flat_block);
+		*p_write_size = packed_size;
+		return (drv_ssd_block*)packed;
+	}
+
+	// Didn't pay to compress without the old dictionary - store it flat.
+	*p_write_size = flat_size;
+
+	return flat_block;
+}
+
 
 //==========================================================
 // Miscellaneous utility functions.
@@ -175,12 +484,32 @@ push_wblock_to_free_q(drv_ssd *ssd, uint32_t wblock_id, e_free_to free_to)
 		return;
 	}
 
-	if (free_to == FREE_TO_HEAD) {
+	ssd_wblock_state *p_wblock_state = &ssd->alloc_table->wblock_state[wblock_id];
+
+	// Nothing left in the wblock to reference a dictionary.
+	p_wblock_state->dict_mask = 0;
+
+	// A TTL-classed wblock still tagged emptied without having to be copied.
+	if (p_wblock_state->ttl_bucket != SSD_TTL_BUCKET_NONE) {
+		cf_atomic64_incr(&ssd->ns->n_ttl_bucket_wblocks_emptied[
+				p_wblock_state->ttl_bucket]);
+		p_wblock_state->ttl_bucket = SSD_TTL_BUCKET_NONE;
+	}
+
+	pthread_rwlock_rdlock(&ssd->free_wblock_lock);
+
+	// An index checkpoint may still reference what's in the wblock.
+	if (ssd->held_wblock_q) {
+		ssd_checkpoint_hold_wblock(ssd, wblock_id);
+	}
+	else if (free_to == FREE_TO_HEAD) {
 		cf_queue_push_head(ssd->free_wblock_q, &wblock_id);
 	}
 	else {
 		cf_queue_push(ssd->free_wblock_q, &wblock_id);
 	}
+
+	pthread_rwlock_unlock(&ssd->free_wblock_lock);
 }
 
 
@@ -385,9 +714,13 @@ swb_get(drv_ssd *ssd)
 		swb->pos = 0;
 	}
 
+	// Index checkpoints must see the wblock either free or in an swb.
+	pthread_rwlock_rdlock(&ssd->free_wblock_lock);
+
 	// Find a device block to write to.
 	if (CF_QUEUE_OK != cf_queue_pop(ssd->free_wblock_q, &swb->wblock_id,
 			CF_QUEUE_NOWAIT)) {
+		pthread_rwlock_unlock(&ssd->free_wblock_lock);
 		cf_queue_push(ssd->swb_free_q, &swb);
 		return NULL;
 	}
@@ -414,9 +747,13 @@ swb_get(drv_ssd *ssd)
 
 	swb_reserve(swb);
 	p_wblock_state->swb = swb;
+	p_wblock_state->write_time = as_record_void_time_get();
+	p_wblock_state->ttl_bucket = SSD_TTL_BUCKET_NONE;
 
 	cf_mutex_unlock(&p_wblock_state->LOCK);
 
+	pthread_rwlock_unlock(&ssd->free_wblock_lock);
+
 	return swb;
 }
 
@@ -596,6 +933,23 @@ is_valid_record(const drv_ssd_block* block, const char* ns_name)
 }
 
 
+// Get a defrag destination swb - unlike client writes, its write time is that
+// of the newest record relocated into it. Called with defrag_lock locked.
+static ssd_write_buf *
+defrag_swb_get(drv_ssd *ssd)
+{
+	ssd_write_buf *swb = swb_get(ssd);
+
+	ssd->defrag_swb = swb;
+
+	if (swb) {
+		ssd->alloc_table->wblock_state[swb->wblock_id].write_time = 0;
+	}
+
+	return swb;
+}
+
+
 void
 defrag_move_record(drv_ssd *src_ssd, uint32_t src_wblock_id,
 		drv_ssd_block *block, as_index *r)
@@ -618,17 +972,29 @@ defrag_move_record(drv_ssd *src_ssd, uint32_t src_wblock_id,
 
 	uint32_t write_size = block->length + LENGTH_BASE;
 
+	// If the record's set has a newer dictionary, move it to that one.
+	drv_ssd_block *rewritten_block = ssd_recompress_block(ssds->ns, block,
+			as_index_get_set_id(r), &write_size);
+
+	if (rewritten_block) {
+		block = rewritten_block;
+	}
+
 	pthread_mutex_lock(&ssd->defrag_lock);
 
 	ssd_write_buf *swb = ssd->defrag_swb;
 
 	if (! swb) {
-		swb = swb_get(ssd);
-		ssd->defrag_swb = swb;
+		swb = defrag_swb_get(ssd);
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "defrag_move_record: couldn't get swb");
 			pthread_mutex_unlock(&ssd->defrag_lock);
+
+			if (rewritten_block) {
+				cf_free(rewritten_block);
+			}
+
 			return;
 		}
 	}
@@ -648,18 +1014,43 @@ defrag_move_record(drv_ssd *src_ssd, uint32_t src_wblock_id,
 		cf_atomic64_incr(&ssd->n_defrag_wblock_writes);
 
 		// Get the new buffer.
-		swb = swb_get(ssd);
-		ssd->defrag_swb = swb;
+		swb = defrag_swb_get(ssd);
 
 		if (! swb) {
 			cf_warning(AS_DRV_SSD, "defrag_move_record: couldn't get swb");
 			pthread_mutex_unlock(&ssd->defrag_lock);
+
+			if (rewritten_block) {
+				cf_free(rewritten_block);
+			}
+
 			return;
 		}
 	}
 
 	memcpy(swb->buf + swb->pos, (const uint8_t*)block, write_size);
 
+	((drv_ssd_block*)(swb->buf + swb->pos))->ckpt_epoch = ssds->ckpt.epoch;
+
+	ssd_wblock_state *p_dest_wblock_state =
+			&ssd->alloc_table->wblock_state[swb->wblock_id];
+	uint32_t lut_sec = (uint32_t)(block->last_update_time / 1000);
+
+	// Relocated data keeps its age, so cold data stays together.
+	if (lut_sec > p_dest_wblock_state->write_time) {
+		p_dest_wblock_state->write_time = lut_sec;
+	}
+
+	if (block->dict_id != 0) {
+		__sync_fetch_and_or(
+				&ssd->alloc_table->wblock_state[swb->wblock_id].dict_mask,
+				as_compression_dict_ref_bit(block->dict_id));
+	}
+
+	if (rewritten_block) {
+		cf_free(rewritten_block);
+	}
+
 	uint64_t write_offset = WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id) + swb->pos;
 
 	ssd_encrypt(ssd, write_offset, (drv_ssd_block *)(swb->buf + swb->pos));
@@ -670,6 +1061,7 @@ defrag_move_record(drv_ssd *src_ssd, uint32_t src_wblock_id,
 
 	swb->pos += write_size;
 
+	cf_atomic64_add(&ssds->ns->n_defrag_write_bytes, write_size);
 	cf_atomic64_add(&ssd->inuse_size, (int64_t)write_size);
 	cf_atomic32_add(&ssd->alloc_table->wblock_state[swb->wblock_id].inuse_sz, (int32_t)write_size);
 
@@ -683,6 +1075,9 @@ defrag_move_record(drv_ssd *src_ssd, uint32_t src_wblock_id,
 
 	pthread_mutex_unlock(&ssd->defrag_lock);
 
+	ssd_sweeps_note_move(ssds, &r->keyd, src_ssd, old_rblock_id, ssd,
+			r->rblock_id);
+
 	ssd_block_free(src_ssd, old_rblock_id, old_n_rblocks, "defrag-write");
 }
 
@@ -796,6 +1191,15 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 		goto Finished;
 	}
 
+	// Live data must be copied - the TTL class didn't empty this wblock.
+	if (p_wblock_state->ttl_bucket != SSD_TTL_BUCKET_NONE) {
+		cf_atomic64_incr(&ssd->ns->n_ttl_bucket_wblocks_defragged[
+				p_wblock_state->ttl_bucket]);
+		p_wblock_state->ttl_bucket = SSD_TTL_BUCKET_NONE;
+	}
+
+	ssd_io_sched_acquire(ssd, AS_STORAGE_IO_DEFRAG, ssd->write_block_size);
+
 	int fd = ssd_fd_get(ssd);
 	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
 
@@ -892,13 +1296,157 @@ Finished:
 }
 
 
-// Thread "run" function to service a device's defrag queue.
-void*
-run_defrag(void *pv_data)
+//------------------------------------------------
+// Cost-benefit defrag - wblocks queued for defrag
+// are pooled, and those with the best ratio of
+// space reclaimed to cost of copying, weighted by
+// how long their data has stayed unchanged, are
+// defragged first. (LFS cleaning policy.)
+//
+
+// Pooled wblocks are re-scored, and this fraction of the best defragged, per
+// round - fresh queue arrivals are considered between rounds.
+#define DEFRAG_POOL_ROUND_FRACTION 16
+#define DEFRAG_POOL_MAX_ROUND 1024
+
+typedef struct defrag_candidate_s {
+	float		score;
+	uint32_t	wblock_id;
+} defrag_candidate;
+
+typedef struct defrag_pool_s {
+	uint32_t			n_candidates;
+	uint32_t			capacity;
+	defrag_candidate	*candidates;
+} defrag_pool;
+
+static void
+defrag_pool_add(defrag_pool *pool, uint32_t wblock_id)
+{
+	if (pool->n_candidates == pool->capacity) {
+		pool->capacity = pool->capacity == 0 ? 1024 : pool->capacity * 2;
+		pool->candidates = cf_realloc(pool->candidates,
+				pool->capacity * sizeof(defrag_candidate));
+	}
+
+	pool->candidates[pool->n_candidates++].wblock_id = wblock_id;
+}
+
+// Drain the defrag queue into the pool - if wait is set, block until there's
+// at least one wblock. Returns false on queue error.
+static bool
+defrag_pool_fill(defrag_pool *pool, drv_ssd *ssd, bool wait)
+{
+	uint32_t wblock_id;
+
+	if (wait && CF_QUEUE_OK != cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
+			CF_QUEUE_FOREVER)) {
+		return false;
+	}
+
+	if (wait) {
+		defrag_pool_add(pool, wblock_id);
+	}
+
+	while (CF_QUEUE_OK == cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
+			CF_QUEUE_NOWAIT)) {
+		defrag_pool_add(pool, wblock_id);
+	}
+
+	return true;
+}
+
+static int
+defrag_candidate_compare(const void *pa, const void *pb)
+{
+	float a = ((const defrag_candidate*)pa)->score;
+	float b = ((const defrag_candidate*)pb)->score;
+
+	return a > b ? -1 : (a < b ? 1 : 0); // best first
+}
+
+// Score (1 - u) * age / (1 + u), where u is the fraction of the wblock in use.
+static void
+defrag_pool_score(defrag_pool *pool, drv_ssd *ssd)
+{
+	uint32_t now = as_record_void_time_get();
+	float wblock_size = (float)ssd->write_block_size;
+
+	for (uint32_t i = 0; i < pool->n_candidates; i++) {
+		defrag_candidate *c = &pool->candidates[i];
+		ssd_wblock_state *p_wblock_state =
+				&ssd->alloc_table->wblock_state[c->wblock_id];
+
+		uint32_t inuse_sz = cf_atomic32_get(p_wblock_state->inuse_sz);
+		uint32_t write_time = p_wblock_state->write_time;
+
+		float u = (float)inuse_sz / wblock_size;
+		float age = (float)(now > write_time ? now - write_time : 0) + 1.0f;
+
+		// Empty wblocks cost nothing to reclaim - always first.
+		c->score = inuse_sz == 0 ? FLT_MAX : (1.0f - u) * age / (1.0f + u);
+	}
+
+	qsort(pool->candidates, pool->n_candidates, sizeof(defrag_candidate),
+			defrag_candidate_compare);
+}
+
+static void
+run_defrag_cost_benefit(drv_ssd *ssd, uint8_t *read_buf)
+{
+	defrag_pool pool = { 0 };
+
+	while (true) {
+		if (! defrag_pool_fill(&pool, ssd, pool.n_candidates == 0)) {
+			break;
+		}
+
+		uint32_t q_min = ssd->ns->storage_defrag_queue_min;
+
+		if (q_min != 0 && pool.n_candidates <= q_min) {
+			usleep(1000 * 50);
+			continue;
+		}
+
+		defrag_pool_score(&pool, ssd);
+
+		uint32_t n_round = pool.n_candidates / DEFRAG_POOL_ROUND_FRACTION;
+
+		if (n_round == 0) {
+			n_round = 1;
+		}
+		else if (n_round > DEFRAG_POOL_MAX_ROUND) {
+			n_round = DEFRAG_POOL_MAX_ROUND;
+		}
+
+		if (q_min != 0 && n_round > pool.n_candidates - q_min) {
+			n_round = pool.n_candidates - q_min;
+		}
+
+		for (uint32_t i = 0; i < n_round; i++) {
+			ssd_defrag_wblock(ssd, pool.candidates[i].wblock_id, read_buf);
+
+			uint32_t sleep_us = ssd->ns->storage_defrag_sleep;
+
+			if (sleep_us != 0) {
+				usleep(sleep_us);
+			}
+		}
+
+		pool.n_candidates -= n_round;
+		memmove(pool.candidates, pool.candidates + n_round,
+				pool.n_candidates * sizeof(defrag_candidate));
+	}
+
+	cf_free(pool.candidates);
+}
+
+
+// Service the defrag queue in order.
+static void
+run_defrag_fifo(drv_ssd *ssd, uint8_t *read_buf)
 {
-	drv_ssd *ssd = (drv_ssd*)pv_data;
 	uint32_t wblock_id;
-	uint8_t *read_buf = cf_valloc(ssd->write_block_size);
 
 	while (true) {
 		uint32_t q_min = ssd->ns->storage_defrag_queue_min;
@@ -934,6 +1482,22 @@ run_defrag(void *pv_data)
 			usleep(sleep_us);
 		}
 	}
+}
+
+
+// Thread "run" function to service a device's defrag queue.
+void*
+run_defrag(void *pv_data)
+{
+	drv_ssd *ssd = (drv_ssd*)pv_data;
+	uint8_t *read_buf = cf_valloc(ssd->write_block_size);
+
+	if (ssd->ns->storage_defrag_policy == AS_STORAGE_DEFRAG_POLICY_COST_BENEFIT) {
+		run_defrag_cost_benefit(ssd, read_buf);
+	}
+	else {
+		run_defrag_fifo(ssd, read_buf);
+	}
 
 	// Although we ever expect to get here...
 	cf_free(read_buf);
@@ -1140,6 +1704,9 @@ ssd_wblock_init(drv_ssd *ssd)
 		p_wblock_state->swb = NULL;
 		p_wblock_state->state = WBLOCK_STATE_NONE;
 		p_wblock_state->n_vac_dests = 0;
+		p_wblock_state->dict_mask = 0;
+		p_wblock_state->write_time = 0;
+		p_wblock_state->ttl_bucket = SSD_TTL_BUCKET_NONE;
 	}
 
 	ssd->alloc_table = at;
@@ -1150,10 +1717,67 @@ ssd_wblock_init(drv_ssd *ssd)
 // Record reading utilities.
 //
 
-int
-ssd_read_record(as_storage_rd *rd)
+static bool
+ssd_block_is_sane(const drv_ssd_block *block, const cf_digest *keyd,
+		uint64_t read_offset, size_t read_size)
 {
-	as_namespace *ns = rd->ns;
+	if (block->magic != SSD_BLOCK_MAGIC) {
+		cf_warning(AS_DRV_SSD, "read: bad block magic offset %lu",
+				read_offset);
+		return false;
+	}
+
+	if (block->length + LENGTH_BASE > read_size) {
+		cf_warning(AS_DRV_SSD, "read: bad block length %u", block->length);
+		return false;
+	}
+
+	if (0 != cf_digest_compare(&block->keyd, keyd)) {
+		cf_warning(AS_DRV_SSD, "read: read wrong key: expecting %lx got %lx",
+				*(uint64_t*)keyd, *(uint64_t*)&block->keyd);
+		return false;
+	}
+
+	if (block->n_bins > BIN_NAMES_QUOTA) {
+		cf_warning(AS_DRV_SSD, "read: bad block n_bins %u", block->n_bins);
+		return false;
+	}
+
+	if (block->bins_offset + offsetof(drv_ssd_block, data) > read_size) {
+		cf_warning(AS_DRV_SSD, "read: bad block bins_offset %u", block->bins_offset);
+		return false;
+	}
+
+	return true;
+}
+
+
+static inline void
+ssd_read_cache_key(const as_record *r, as_record_cache_key *key)
+{
+	key->keyd = r->keyd;
+	key->last_update_time = r->last_update_time;
+	key->generation = r->generation;
+}
+
+
+// Cache a flat block just read from device, for the record version in the
+// index.
+static inline void
+ssd_read_cache_put(as_record_cache *cache, const as_record *r,
+		const drv_ssd_block *block)
+{
+	as_record_cache_key key;
+
+	ssd_read_cache_key(r, &key);
+	as_record_cache_put(cache, &key, block, block->length + LENGTH_BASE);
+}
+
+
+int
+ssd_read_record(as_storage_rd *rd)
+{
+	as_namespace *ns = rd->ns;
 	as_record *r = rd->r;
 
 	if (STORAGE_RBLOCK_IS_INVALID(r->rblock_id)) {
@@ -1162,6 +1786,28 @@ ssd_read_record(as_storage_rd *rd)
 		return -1;
 	}
 
+	as_record_cache *read_cache = ((drv_ssds*)ns->storage_private)->read_cache;
+
+	if (read_cache) {
+		as_record_cache_key key;
+		uint32_t size;
+
+		ssd_read_cache_key(r, &key);
+
+		uint8_t *cached = as_record_cache_get(read_cache, &key, &size);
+
+		if (cached) {
+			cf_atomic32_incr(&ns->n_read_cache_hits);
+
+			rd->block = (drv_ssd_block*)cached;
+			rd->must_free_block = cached;
+
+			return 0;
+		}
+
+		cf_atomic32_incr(&ns->n_read_cache_misses);
+	}
+
 	uint64_t record_offset = RBLOCKS_TO_BYTES(r->rblock_id);
 	uint64_t record_size = RBLOCKS_TO_BYTES(r->n_rblocks);
 
@@ -1199,6 +1845,9 @@ ssd_read_record(as_storage_rd *rd)
 
 		read_buf = cf_valloc(read_size);
 
+		// Background reads may wait their turn - client reads are just timed.
+		ssd_io_sched_acquire(ssd, rd->io_class, read_size);
+
 		int fd = ssd_fd_get(ssd);
 
 		uint64_t start_ns = ns->storage_benchmarks_enabled ? cf_getns() : 0;
@@ -1211,8 +1860,13 @@ ssd_read_record(as_storage_rd *rd)
 			return -1;
 		}
 
+		uint64_t sched_start_ns = rd->io_class == AS_STORAGE_IO_CLIENT ?
+				ssd_io_sched_client_start(ssd) : 0;
+
 		ssize_t rv = read(fd, read_buf, read_size);
 
+		ssd_io_sched_client_done(ssd, sched_start_ns);
+
 		if (rv != (ssize_t)read_size) {
 			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): size %lu: errno %d (%s)",
 					ssd->name, rv, read_size, errno, cf_strerror(errno));
@@ -1227,135 +1881,745 @@ ssd_read_record(as_storage_rd *rd)
 
 		ssd_fd_put(ssd, fd);
 
-		block = (drv_ssd_block*)(read_buf + record_buf_indent);
-		ssd_decrypt(ssd, record_offset, block);
+		block = (drv_ssd_block*)(read_buf + record_buf_indent);
+		ssd_decrypt(ssd, record_offset, block);
+
+		if (! ssd_block_is_sane(block, &r->keyd, read_offset, read_size)) {
+			cf_free(read_buf);
+			return -1;
+		}
+
+		if (ns->storage_benchmarks_enabled) {
+			histogram_insert_raw(ns->device_read_size_hist, read_size);
+		}
+	}
+
+	if (block->compression != AS_COMPRESSION_NONE) {
+		drv_ssd_block *flat_block = ssd_decompress_block(ns, block);
+
+		cf_free(read_buf);
+
+		if (! flat_block) {
+			return -1;
+		}
+
+		block = flat_block;
+		read_buf = (uint8_t*)flat_block;
+	}
+
+	// Records still in a write buffer are cheap to read - don't cache them.
+	if (read_cache && ! swb) {
+		ssd_read_cache_put(read_cache, r, block);
+	}
+
+	rd->block = block;
+	rd->must_free_block = read_buf;
+
+	return 0;
+}
+
+
+// Start an asynchronous device read. Returns false if the record should be
+// read synchronously instead - e.g. it's still in a write buffer, or the ring
+// is full.
+bool
+ssd_read_record_async(as_storage_rd *rd, as_storage_read_done_fn cb,
+		void *udata)
+{
+	drv_ssd *ssd = rd->ssd;
+
+	// Background reads go through the synchronous path, which schedules them.
+	if (! ssd->read_ring || rd->io_class != AS_STORAGE_IO_CLIENT) {
+		return false;
+	}
+
+	as_namespace *ns = rd->ns;
+	as_record *r = rd->r;
+
+	if (STORAGE_RBLOCK_IS_INVALID(r->rblock_id)) {
+		return false; // let synchronous path complain
+	}
+
+	ssd_write_buf *swb = NULL;
+	uint32_t wblock = RBLOCK_ID_TO_WBLOCK_ID(ssd, r->rblock_id);
+
+	swb_check_and_reserve(&ssd->alloc_table->wblock_state[wblock], &swb);
+
+	if (swb) {
+		// Cache hit - a memcpy, not worth going async.
+		swb_release(swb);
+		return false;
+	}
+
+	as_record_cache *read_cache = ((drv_ssds*)ns->storage_private)->read_cache;
+
+	if (read_cache) {
+		as_record_cache_key key;
+
+		ssd_read_cache_key(r, &key);
+
+		if (as_record_cache_contains(read_cache, &key)) {
+			return false; // synchronous path will hit
+		}
+	}
+
+	uint64_t record_offset = RBLOCKS_TO_BYTES(r->rblock_id);
+	uint64_t record_end_offset = record_offset + RBLOCKS_TO_BYTES(r->n_rblocks);
+	uint64_t read_offset = BYTES_DOWN_TO_IO_MIN(ssd, record_offset);
+	uint64_t read_end_offset = BYTES_UP_TO_IO_MIN(ssd, record_end_offset);
+
+	ssd_read_req *req = cf_malloc(sizeof(ssd_read_req));
+
+	req->tsvc_cb.fn = ssd_read_complete;
+	req->ssd = ssd;
+	req->keyd = r->keyd;
+	req->rblock_id = r->rblock_id;
+	req->n_rblocks = r->n_rblocks;
+	req->generation = r->generation;
+	req->result = -1;
+	req->res = 0;
+	req->read_size = read_end_offset - read_offset;
+	req->read_buf = cf_valloc(req->read_size);
+	req->block = (drv_ssd_block*)
+			(req->read_buf + (record_offset - read_offset));
+	req->read_offset = read_offset;
+	req->cb = cb;
+	req->udata = udata;
+
+	// Device read histogram covers submit to completion.
+	req->start_ns = ns->storage_benchmarks_enabled ? cf_getns() : 0;
+	req->sched_start_ns = ssd_io_sched_client_start(ssd);
+
+	if (! cf_uring_read(ssd->read_ring, ssd->read_ring_fd, req->read_buf,
+			(uint32_t)req->read_size, read_offset, req)) {
+		ssd_io_sched_client_done(ssd, req->sched_start_ns);
+		cf_free(req->read_buf);
+		cf_free(req);
+		return false;
+	}
+
+	cf_atomic32_incr(&ns->n_reads_from_device);
+
+	return true;
+}
+
+
+// Runs on a transaction thread - finishes the read and hands it to its owner,
+// which may block (record locks, client send) without holding up the device.
+void
+ssd_read_complete(as_tsvc_cb *cb)
+{
+	ssd_read_req *req = (ssd_read_req*)cb;
+	drv_ssd *ssd = req->ssd;
+	as_namespace *ns = ssd->ns;
+
+	if (req->res != (int32_t)req->read_size) {
+		cf_warning(AS_DRV_SSD, "%s: async read failed (%d): size %lu",
+				ssd->name, req->res, req->read_size);
+	}
+	else {
+		ssd_decrypt(ssd, RBLOCKS_TO_BYTES(req->rblock_id), req->block);
+
+		if (ssd_block_is_sane(req->block, &req->keyd, req->read_offset,
+				req->read_size)) {
+			req->result = 0;
+
+			if (ns->storage_benchmarks_enabled) {
+				histogram_insert_raw(ns->device_read_size_hist, req->read_size);
+			}
+		}
+
+		if (req->result == 0 &&
+				req->block->compression != AS_COMPRESSION_NONE) {
+			drv_ssd_block *flat_block = ssd_decompress_block(ns, req->block);
+
+			cf_free(req->read_buf);
+
+			if (flat_block) {
+				req->block = flat_block;
+				req->read_buf = (uint8_t*)flat_block;
+			}
+			else {
+				req->read_buf = NULL;
+				req->result = -1;
+			}
+		}
+	}
+
+	req->cb(req, req->udata);
+}
+
+
+// Thread "run" function that reaps completed asynchronous reads - only does
+// device accounting, and queues the rest of the work for transaction threads.
+void *
+run_ssd_read_reaper(void *arg)
+{
+	drv_ssd *ssd = (drv_ssd*)arg;
+	cf_uring_cqe cqes[READ_REAP_MAX];
+
+	while (true) {
+		uint32_t n_cqes = cf_uring_reap(ssd->read_ring, cqes, READ_REAP_MAX,
+				true);
+
+		for (uint32_t i = 0; i < n_cqes; i++) {
+			ssd_read_req *req = (ssd_read_req*)cqes[i].udata;
+
+			req->res = cqes[i].res;
+			ssd_io_sched_client_done(ssd, req->sched_start_ns);
+
+			if (req->res == (int32_t)req->read_size && req->start_ns != 0) {
+				histogram_insert_data_point(ssd->hist_read, req->start_ns);
+			}
+
+			as_tsvc_enqueue_cb(&req->tsvc_cb);
+		}
+	}
+
+	return NULL;
+}
+
+
+void
+ssd_init_read_ring(drv_ssd *ssd)
+{
+	ssd->read_ring = cf_uring_create(READ_RING_DEPTH);
+
+	if (ssd->read_ring && ! cf_uring_supports_read(ssd->read_ring)) {
+		cf_warning(AS_DRV_SSD, "%s: kernel lacks io_uring read", ssd->name);
+		cf_uring_destroy(ssd->read_ring);
+		ssd->read_ring = NULL;
+	}
+
+	if (! ssd->read_ring) {
+		cf_warning(AS_DRV_SSD, "%s: can't use io-uring read-engine - using fd-pool",
+				ssd->name);
+		return;
+	}
+
+	ssd->read_ring_fd = open(ssd->name, ssd->open_flag, S_IRUSR | S_IWUSR);
+
+	if (ssd->read_ring_fd == -1) {
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED open: errno %d (%s)",
+				ssd->name, errno, cf_strerror(errno));
+	}
+
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&ssd->read_reaper_thread, &attrs, run_ssd_read_reaper,
+			(void*)ssd) != 0) {
+		cf_crash(AS_DRV_SSD, "%s: could not create read reaper thread: %s",
+				ssd->name, cf_strerror(errno));
+	}
+}
+
+
+//==========================================================
+// Storage API implementation: reading records.
+//
+
+int
+as_storage_record_load_n_bins_ssd(as_storage_rd *rd)
+{
+	if (! as_record_is_live(rd->r)) {
+		rd->n_bins = 0;
+		return 0; // no need to read device
+	}
+
+	// If the record hasn't been read, read it.
+	if (! rd->block && ssd_read_record(rd) != 0) {
+		cf_warning(AS_DRV_SSD, "load_n_bins: failed ssd_read_record()");
+		return -1;
+	}
+
+	rd->n_bins = rd->block->n_bins;
+	return 0;
+}
+
+
+int
+as_storage_record_load_bins_ssd(as_storage_rd *rd)
+{
+	if (! as_record_is_live(rd->r)) {
+		return 0; // no need to read device
+	}
+
+	// If the record hasn't been read, read it.
+	if (! rd->block && ssd_read_record(rd) != 0) {
+		cf_warning(AS_DRV_SSD, "load_bins: failed ssd_read_record()");
+		return -1;
+	}
+
+	drv_ssd_block *block = rd->block;
+	uint8_t *block_head = (uint8_t*)rd->block;
+
+	drv_ssd_bin *ssd_bin = (drv_ssd_bin*)(block->data + block->bins_offset);
+
+	for (uint16_t i = 0; i < block->n_bins; i++) {
+		as_bin_set_id_from_name(rd->ns, &rd->bins[i], ssd_bin->name);
+
+		int rv = as_bin_particle_cast_from_flat(&rd->bins[i],
+				block_head + ssd_bin->offset, ssd_bin->len);
+
+		if (0 != rv) {
+			return rv;
+		}
+
+		ssd_bin = (drv_ssd_bin*)(block_head + ssd_bin->next);
+	}
+
+	return 0;
+}
+
+
+bool
+as_storage_record_read_async_ssd(as_storage_rd *rd, as_storage_read_done_fn cb,
+		void *udata)
+{
+	return as_record_is_live(rd->r) && ssd_read_record_async(rd, cb, udata);
+}
+
+
+// Caller has the record locked again - use what we read only if the record
+// hasn't been moved or replaced since, otherwise leave rd to read it afresh.
+void
+as_storage_record_adopt_read_ssd(as_storage_rd *rd, ssd_read_req *req)
+{
+	as_record *r = rd->r;
+
+	if (req->result == 0 && ! rd->block && rd->ssd == req->ssd &&
+			r->rblock_id == req->rblock_id &&
+			r->n_rblocks == req->n_rblocks &&
+			r->generation == req->generation) {
+		rd->block = req->block;
+		rd->must_free_block = req->read_buf;
+
+		as_record_cache *read_cache =
+				((drv_ssds*)rd->ns->storage_private)->read_cache;
+
+		if (read_cache) {
+			cf_atomic32_incr(&rd->ns->n_read_cache_misses);
+			ssd_read_cache_put(read_cache, r, rd->block);
+		}
+	}
+	else {
+		cf_free(req->read_buf);
+	}
+
+	cf_free(req);
+}
+
+
+void
+as_storage_read_discard_ssd(ssd_read_req *req)
+{
+	cf_free(req->read_buf);
+	cf_free(req);
+}
+
+
+bool
+as_storage_record_get_key_ssd(as_storage_rd *rd)
+{
+	// If the record hasn't been read, read it.
+	if (! rd->block && ssd_read_record(rd) != 0) {
+		cf_warning(AS_DRV_SSD, "get_key: failed ssd_read_record()");
+		return false;
+	}
+
+	drv_ssd_block *block = rd->block;
+	as_rec_props props;
+
+	props.size = block->bins_offset;
+
+	if (props.size == 0) {
+		return false;
+	}
+
+	props.p_data = block->data;
+
+	return as_rec_props_get_value(&props, CL_REC_PROPS_FIELD_KEY,
+			&rd->key_size, &rd->key) == 0;
+}
+
+
+//------------------------------------------------
+// Device-order sweeps - like the cold start sweep,
+// but records are only passed on if the index
+// still points at them, and they haven't moved
+// since the sweep started.
+//
+
+static inline uint64_t
+sweep_rblocks_per_wblock(const as_storage_sweep *sweep)
+{
+	return sweep->ssds->ns->storage_write_block_size / RBLOCK_SIZE;
+}
+
+// Inverse of the slice bounds in as_storage_device_sweep_ssd().
+static inline uint32_t
+sweep_slice(const as_storage_sweep *sweep, uint64_t wblock)
+{
+	return (uint32_t)(((wblock + 1) * sweep->n_slices - 1) / sweep->n_wblocks);
+}
+
+// Has the sweep gone past this copy? If the copy was current then, it was
+// visited.
+static bool
+sweep_passed(const as_storage_sweep *sweep, drv_ssd *ssd, uint64_t rblock_id)
+{
+	uint64_t wblock = sweep->bases[ssd->file_id] +
+			RBLOCK_ID_TO_WBLOCK_ID(ssd, rblock_id);
+	uint64_t pos = sweep->bases[ssd->file_id] * sweep_rblocks_per_wblock(sweep) +
+			rblock_id;
+
+	return pos < cf_atomic64_get(sweep->cursors[sweep_slice(sweep, wblock)]);
+}
+
+
+// Called with the record locked, after a write or defrag moved it.
+void
+ssd_sweeps_note_move(drv_ssds *ssds, const cf_digest *keyd, drv_ssd *old_ssd,
+		uint64_t old_rblock_id, drv_ssd *new_ssd, uint64_t new_rblock_id)
+{
+	if (cf_atomic32_get(ssds->n_sweeps) == 0) {
+		return;
+	}
+
+	uint32_t pid = as_partition_getid(keyd);
+
+	pthread_rwlock_rdlock(&ssds->sweeps_lock);
+
+	for (as_storage_sweep *sweep = ssds->sweeps; sweep; sweep = sweep->next) {
+		if (! sweep->trees[pid]) {
+			continue;
+		}
+
+		uint8_t verdict;
+
+		if (! sweep_passed(sweep, old_ssd, old_rblock_id)) {
+			// The old copy will be stale when swept, and the new copy may be
+			// somewhere already swept.
+			verdict = SWEEP_MOVED;
+		}
+		else if (! sweep_passed(sweep, new_ssd, new_rblock_id)) {
+			verdict = SWEEP_DONE;
+		}
+		else {
+			continue;
+		}
+
+		// The verdict on a record's first move stands.
+		cf_shash_put_unique(sweep->moved, keyd, &verdict);
+	}
+
+	pthread_rwlock_unlock(&ssds->sweeps_lock);
+}
+
+
+// Returns false if the callback says to stop.
+static bool
+ssd_sweep_record(as_storage_sweep *sweep, drv_ssd *ssd, drv_ssd_block *block,
+		uint64_t rblock_id, uint32_t n_rblocks, bool from_swb,
+		cf_atomic64 *cursor, as_storage_sweep_fn cb, void *udata)
+{
+	as_index_tree *tree = sweep->trees[as_partition_getid(&block->keyd)];
+
+	if (! tree) {
+		return true; // partition not being swept
+	}
+
+	as_namespace *ns = ssd->ns;
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	if (as_record_get(tree, &block->keyd, &r_ref) != 0) {
+		return true; // deleted since
+	}
+
+	as_record *r = r_ref.r;
+
+	// Only the copy the index points at is current - and if the record moved
+	// during the sweep, it's visited at the end (or already was).
+	if (r->file_id != (uint32_t)ssd->file_id || r->rblock_id != rblock_id ||
+			r->n_rblocks != n_rblocks || r->generation != block->generation ||
+			cf_shash_get(sweep->moved, &block->keyd, NULL) == CF_SHASH_OK) {
+		as_record_done(&r_ref, ns);
+		return true;
+	}
+
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r, &rd);
+	rd.io_class = AS_STORAGE_IO_SCAN;
+
+	// An image copied from an swb may have been mid-write - leave rd->block
+	// unset so the record is read as usual.
+	if (! from_swb) {
+		if (block->compression == AS_COMPRESSION_NONE) {
+			rd.block = block;
+		}
+		else if ((rd.block = ssd_decompress_block(ns, block)) != NULL) {
+			rd.must_free_block = (uint8_t*)rd.block;
+		}
+	}
+
+	bool more = cb(&rd, udata);
+
+	as_storage_record_close(&rd);
+
+	// Advance while locked, so a move of this record sees it was visited.
+	cf_atomic64_set(cursor, cf_atomic64_get(*cursor) + n_rblocks);
+
+	as_record_done(&r_ref, ns);
+
+	return more;
+}
+
+
+// Returns false if the callback says to stop.
+static bool
+ssd_sweep_wblock(as_storage_sweep *sweep, drv_ssd *ssd, uint32_t wblock_id,
+		uint8_t *buf, cf_atomic64 *cursor, as_storage_sweep_fn cb, void *udata)
+{
+	ssd_wblock_state *p_wblock_state = &ssd->alloc_table->wblock_state[wblock_id];
+
+	// Free or emptied - nothing to read.
+	if (cf_atomic32_get(p_wblock_state->inuse_sz) == 0) {
+		return true;
+	}
+
+	size_t wblock_size = ssd->write_block_size;
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+	ssd_write_buf *swb = NULL;
+
+	swb_check_and_reserve(p_wblock_state, &swb);
+
+	bool from_swb = swb != NULL;
+
+	if (from_swb) {
+		// May not be on the device yet.
+		memcpy(buf, swb->buf, wblock_size);
+		swb_release(swb);
+	}
+	else {
+		ssd_io_sched_acquire(ssd, AS_STORAGE_IO_SCAN, wblock_size);
+
+		int fd = ssd_fd_get(ssd);
+
+		uint64_t start_ns = ssd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
+
+		if (pread(fd, buf, wblock_size, (off_t)file_offset) !=
+				(ssize_t)wblock_size) {
+			cf_warning(AS_DRV_SSD, "%s: read failed: offset %lu: errno %d (%s)",
+					ssd->name, file_offset, errno, cf_strerror(errno));
+			close(fd);
+			return true; // skip this wblock
+		}
+
+		if (start_ns != 0) {
+			histogram_insert_data_point(ssd->hist_large_block_read, start_ns);
+		}
+
+		ssd_fd_put(ssd, fd);
+	}
+
+	uint64_t wblock_pos = cf_atomic64_get(*cursor);
+	size_t indent = 0; // current offset within wblock, in bytes
+
+	while (indent < wblock_size) {
+		drv_ssd_block *block = (drv_ssd_block*)&buf[indent];
+
+		ssd_decrypt(ssd, file_offset + indent, block);
+
+		if (block->magic != SSD_BLOCK_MAGIC) {
+			indent += RBLOCK_SIZE;
+			cf_atomic64_set(cursor, wblock_pos + BYTES_TO_RBLOCKS(indent));
+			continue; // try next rblock
+		}
+
+		size_t next_indent = indent +
+				BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+		if (next_indent > wblock_size) {
+			break; // partly written, or corrupt - skip rest of wblock
+		}
+
+		if (! ssd_sweep_record(sweep, ssd, block,
+				BYTES_TO_RBLOCKS(file_offset + indent),
+				(uint32_t)BYTES_TO_RBLOCKS(next_indent - indent), from_swb,
+				cursor, cb, udata)) {
+			return false;
+		}
+
+		indent = next_indent;
+
+		// Record may have been skipped without advancing.
+		cf_atomic64_set(cursor, wblock_pos + BYTES_TO_RBLOCKS(indent));
+	}
+
+	return true;
+}
+
+
+struct as_storage_sweep_s *
+as_storage_device_sweep_start_ssd(as_namespace *ns, as_index_tree *const *trees,
+		uint32_t n_slices)
+{
+	drv_ssds *ssds = (drv_ssds*)ns->storage_private;
+	as_storage_sweep *sweep = cf_malloc(sizeof(as_storage_sweep));
+
+	sweep->ssds = ssds;
+	sweep->trees = trees;
+	sweep->n_slices = n_slices;
+	sweep->n_wblocks = 0;
+	sweep->bases = cf_malloc(ssds->n_ssds * sizeof(uint64_t));
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		sweep->bases[i] = sweep->n_wblocks;
+		sweep->n_wblocks += ssds->ssds[i].alloc_table->n_wblocks;
+	}
+
+	sweep->cursors = cf_malloc(n_slices * sizeof(cf_atomic64));
+
+	for (uint32_t n = 0; n < n_slices; n++) {
+		sweep->cursors[n] = (sweep->n_wblocks * n / n_slices) *
+				sweep_rblocks_per_wblock(sweep);
+	}
+
+	sweep->moved = cf_shash_create(cf_shash_fn_u32, sizeof(cf_digest),
+			sizeof(uint8_t), SWEEP_MOVED_N_BUCKETS, CF_SHASH_MANY_LOCK);
+
+	pthread_rwlock_wrlock(&ssds->sweeps_lock);
+
+	sweep->next = ssds->sweeps;
+	ssds->sweeps = sweep;
+	cf_atomic32_incr(&ssds->n_sweeps);
+
+	pthread_rwlock_unlock(&ssds->sweeps_lock);
+
+	return sweep;
+}
+
 
-		// Sanity checks.
+// Slices are contiguous runs of wblocks, counting across devices in order, so
+// each slice is a sequential read of (part of) one or two devices.
+void
+as_storage_device_sweep_ssd(as_storage_sweep *sweep, uint32_t slice,
+		as_storage_sweep_fn cb, void *udata)
+{
+	drv_ssds *ssds = sweep->ssds;
+	uint64_t rblocks_per_wblock = sweep_rblocks_per_wblock(sweep);
+	cf_atomic64 *cursor = &sweep->cursors[slice];
 
-		if (block->magic != SSD_BLOCK_MAGIC) {
-			cf_warning(AS_DRV_SSD, "read: bad block magic offset %lu",
-					read_offset);
-			cf_free(read_buf);
-			return -1;
-		}
+	uint64_t begin = sweep->n_wblocks * slice / sweep->n_slices;
+	uint64_t end = sweep->n_wblocks * (slice + 1) / sweep->n_slices;
+	uint8_t *buf = cf_valloc(ssds->ns->storage_write_block_size);
 
-		if (block->length + LENGTH_BASE > read_size) {
-			cf_warning(AS_DRV_SSD, "read: bad block length %u", block->length);
-			cf_free(read_buf);
-			return -1;
-		}
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+		uint64_t base = sweep->bases[i];
 
-		if (0 != cf_digest_compare(&block->keyd, &r->keyd)) {
-			cf_warning(AS_DRV_SSD, "read: read wrong key: expecting %lx got %lx",
-					*(uint64_t*)&r->keyd, *(uint64_t*)&block->keyd);
-			cf_free(read_buf);
-			return -1;
+		if (base >= end) {
+			break;
 		}
 
-		if (block->n_bins > BIN_NAMES_QUOTA) {
-			cf_warning(AS_DRV_SSD, "read: bad block n_bins %u", block->n_bins);
-			cf_free(read_buf);
-			return -1;
-		}
+		uint64_t first = base + SSD_HEADER_SIZE / ssd->write_block_size;
+		uint64_t from = begin > first ? begin : first;
+		uint64_t to = end < base + ssd->alloc_table->n_wblocks ?
+				end : base + ssd->alloc_table->n_wblocks;
 
-		if (block->bins_offset + offsetof(drv_ssd_block, data) > read_size) {
-			cf_warning(AS_DRV_SSD, "read: bad block bins_offset %u", block->bins_offset);
-			cf_free(read_buf);
-			return -1;
-		}
+		for (uint64_t g = from; g < to; g++) {
+			cf_atomic64_set(cursor, g * rblocks_per_wblock);
 
-		if (ns->storage_benchmarks_enabled) {
-			histogram_insert_raw(ns->device_read_size_hist, read_size);
+			if (! ssd_sweep_wblock(sweep, ssd, (uint32_t)(g - base), buf,
+					cursor, cb, udata)) {
+				cf_free(buf);
+				return;
+			}
 		}
 	}
 
-	rd->block = block;
-	rd->must_free_block = read_buf;
-
-	return 0;
+	cf_atomic64_set(cursor, end * rblocks_per_wblock);
+	cf_free(buf);
 }
 
 
-//==========================================================
-// Storage API implementation: reading records.
-//
+typedef struct sweep_moved_info_s {
+	as_storage_sweep *sweep;
+	as_storage_sweep_fn cb;
+	void *udata;
+} sweep_moved_info;
 
-int
-as_storage_record_load_n_bins_ssd(as_storage_rd *rd)
+static int
+ssd_sweep_moved_reduce_fn(const void *key, void *value, void *udata)
 {
-	if (! as_record_is_live(rd->r)) {
-		rd->n_bins = 0;
-		return 0; // no need to read device
+	if (*(uint8_t*)value != SWEEP_MOVED) {
+		return CF_SHASH_OK;
 	}
 
-	// If the record hasn't been read, read it.
-	if (! rd->block && ssd_read_record(rd) != 0) {
-		cf_warning(AS_DRV_SSD, "load_n_bins: failed ssd_read_record()");
-		return -1;
-	}
-
-	rd->n_bins = rd->block->n_bins;
-	return 0;
-}
-
+	sweep_moved_info *info = (sweep_moved_info*)udata;
+	as_namespace *ns = info->sweep->ssds->ns;
+	cf_digest *keyd = (cf_digest*)key;
+	as_index_ref r_ref;
 
-int
-as_storage_record_load_bins_ssd(as_storage_rd *rd)
-{
-	if (! as_record_is_live(rd->r)) {
-		return 0; // no need to read device
-	}
+	r_ref.skip_lock = false;
 
-	// If the record hasn't been read, read it.
-	if (! rd->block && ssd_read_record(rd) != 0) {
-		cf_warning(AS_DRV_SSD, "load_bins: failed ssd_read_record()");
-		return -1;
+	if (as_record_get(info->sweep->trees[as_partition_getid(keyd)], keyd,
+			&r_ref) != 0) {
+		return CF_SHASH_OK; // deleted since
 	}
 
-	drv_ssd_block *block = rd->block;
-	uint8_t *block_head = (uint8_t*)rd->block;
+	as_storage_rd rd;
 
-	drv_ssd_bin *ssd_bin = (drv_ssd_bin*)(block->data + block->bins_offset);
+	as_storage_record_open(ns, r_ref.r, &rd);
+	rd.io_class = AS_STORAGE_IO_SCAN;
 
-	for (uint16_t i = 0; i < block->n_bins; i++) {
-		as_bin_set_id_from_name(rd->ns, &rd->bins[i], ssd_bin->name);
+	bool more = info->cb(&rd, info->udata);
 
-		int rv = as_bin_particle_cast_from_flat(&rd->bins[i],
-				block_head + ssd_bin->offset, ssd_bin->len);
+	as_storage_record_close(&rd);
+	as_record_done(&r_ref, ns);
 
-		if (0 != rv) {
-			return rv;
-		}
+	return more ? CF_SHASH_OK : CF_SHASH_ERR;
+}
 
-		ssd_bin = (drv_ssd_bin*)(block_head + ssd_bin->next);
-	}
+// Call once all slices are swept - visits (if cb is given) the records moved
+// before the sweep reached them, then frees the sweep.
+void
+as_storage_device_sweep_end_ssd(as_storage_sweep *sweep, as_storage_sweep_fn cb,
+		void *udata)
+{
+	drv_ssds *ssds = sweep->ssds;
 
-	return 0;
-}
+	pthread_rwlock_wrlock(&ssds->sweeps_lock);
 
+	as_storage_sweep **p_sweep = &ssds->sweeps;
 
-bool
-as_storage_record_get_key_ssd(as_storage_rd *rd)
-{
-	// If the record hasn't been read, read it.
-	if (! rd->block && ssd_read_record(rd) != 0) {
-		cf_warning(AS_DRV_SSD, "get_key: failed ssd_read_record()");
-		return false;
+	while (*p_sweep != sweep) {
+		p_sweep = &(*p_sweep)->next;
 	}
 
-	drv_ssd_block *block = rd->block;
-	as_rec_props props;
+	*p_sweep = sweep->next;
+	cf_atomic32_decr(&ssds->n_sweeps);
 
-	props.size = block->bins_offset;
+	pthread_rwlock_unlock(&ssds->sweeps_lock);
 
-	if (props.size == 0) {
-		return false;
-	}
+	// Everything is swept, so later moves needn't be tracked - each record
+	// marked moved is visited in whatever state it's now in.
+	if (cb) {
+		sweep_moved_info info = { sweep, cb, udata };
 
-	props.p_data = block->data;
+		cf_shash_reduce(sweep->moved, ssd_sweep_moved_reduce_fn, &info);
+	}
 
-	return as_rec_props_get_value(&props, CL_REC_PROPS_FIELD_KEY,
-			&rd->key_size, &rd->key) == 0;
+	cf_shash_destroy(sweep->moved);
+	cf_free((void*)sweep->cursors);
+	cf_free(sweep->bases);
+	cf_free(sweep);
 }
 
 
@@ -1606,84 +2870,85 @@ as_storage_record_size(as_storage_rd *rd)
 }
 
 
+// Classify a record by remaining TTL, so records that will expire at about the
+// same time fill the same wblocks, which then empty without defrag. Class 0 is
+// no expiration - others each span a factor of 4 in TTL, from under an hour,
+// and the last takes all longer TTLs.
 static inline uint32_t
-ssd_write_calculate_size(as_storage_rd *rd)
+ssd_ttl_bucket(const drv_ssd *ssd, uint32_t void_time)
 {
-	// Note - this function is the only place where rounding size (up to a
-	// multiple of RBLOCK_SIZE) is really necessary.
+	if (ssd->n_ttl_buckets == 1 || void_time == 0) {
+		return 0;
+	}
 
-	return BYTES_TO_RBLOCK_BYTES(as_storage_record_size(rd));
+	uint32_t now = as_record_void_time_get();
+	uint32_t ttl = void_time > now ? void_time - now : 0;
+	uint32_t bucket = 1;
+
+	for (uint32_t limit = 3600; bucket < ssd->n_ttl_buckets - 1 &&
+			ttl >= limit; limit *= 4) {
+		bucket++;
+	}
+
+	return bucket;
 }
 
 
-int
-ssd_write_bins(as_storage_rd *rd)
+// Spread writers over the TTL class's write stripes by CPU - writers on the
+// same CPU rarely overlap, so the stripe's lock is mostly uncontended.
+static inline ssd_write_stripe *
+ssd_write_stripe_get(drv_ssd *ssd, uint32_t ttl_bucket)
 {
-	as_namespace *ns = rd->ns;
-	as_record *r = rd->r;
-	drv_ssd *ssd = rd->ssd;
-
-	uint32_t write_size = ssd_write_calculate_size(rd);
+	ssd_write_stripe *stripes =
+			&ssd->write_stripes[ttl_bucket * ssd->n_write_stripes];
 
-	if (write_size > ssd->write_block_size) {
-		cf_detail_digest(AS_DRV_SSD, &r->keyd, "write: size %u - rejecting ",
-				write_size);
-		return -AS_PROTO_RESULT_FAIL_RECORD_TOO_BIG;
+	if (ssd->n_write_stripes == 1) {
+		return &stripes[0];
 	}
 
-	// Reserve the portion of the current swb where this record will be written.
-	pthread_mutex_lock(&ssd->write_lock);
+	int cpu = sched_getcpu();
 
-	ssd_write_buf *swb = ssd->current_swb;
+	return &stripes[(uint32_t)(cpu < 0 ? 0 : cpu) % ssd->n_write_stripes];
+}
 
-	if (! swb) {
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
 
-		if (! swb) {
-			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
-			return -AS_PROTO_RESULT_FAIL_OUT_OF_SPACE;
-		}
-	}
+// Get an swb for a stripe, tagging its wblock with the TTL class. Called with
+// the stripe locked.
+static ssd_write_buf *
+ssd_stripe_swb_get(drv_ssd *ssd, ssd_write_stripe *stripe, uint32_t ttl_bucket)
+{
+	ssd_write_buf *swb = swb_get(ssd);
 
-	// Check if there's enough space in current buffer - if not, free and zero
-	// any remaining unused space, enqueue it to be flushed to device, and grab
-	// a new buffer.
-	if (write_size > ssd->write_block_size - swb->pos) {
-		if (ssd->write_block_size != swb->pos) {
-			// Clean the end of the buffer before pushing to write queue.
-			memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
-		}
+	stripe->swb = swb;
 
-		// Enqueue the buffer, to be flushed to device.
-		cf_queue_push(ssd->swb_write_q, &swb);
-		cf_atomic64_incr(&ssd->n_wblock_writes);
+	if (swb && ssd->n_ttl_buckets > 1) {
+		ssd->alloc_table->wblock_state[swb->wblock_id].ttl_bucket =
+				(uint8_t)ttl_bucket;
+		cf_atomic64_incr(&ssd->ns->n_ttl_bucket_wblocks[ttl_bucket]);
+	}
 
-		// Get the new buffer.
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
+	return swb;
+}
 
-		if (! swb) {
-			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
-			return -AS_PROTO_RESULT_FAIL_OUT_OF_SPACE;
-		}
-	}
 
-	// There's enough space - save the position where this record will be
-	// written, and advance swb->pos for the next writer.
-	uint32_t swb_pos = swb->pos;
+static inline uint32_t
+ssd_write_calculate_size(as_storage_rd *rd)
+{
+	// Note - this function is the only place where rounding size (up to a
+	// multiple of RBLOCK_SIZE) is really necessary.
 
-	swb->pos += write_size;
-	cf_atomic32_incr(&swb->n_writers);
+	return BYTES_TO_RBLOCK_BYTES(as_storage_record_size(rd));
+}
 
-	pthread_mutex_unlock(&ssd->write_lock);
-	// May now write this record concurrently with others in this swb.
 
-	// Flatten data into the block.
+// Flatten a record into buf - header, rec-props and bins, but not device
+// location. Returns number of bytes used, which may be less than write_size.
+static uint32_t
+ssd_flatten_record(as_storage_rd *rd, uint8_t *buf, uint32_t write_size)
+{
+	as_namespace *ns = rd->ns;
+	as_record *r = rd->r;
 
-	uint8_t *buf = &swb->buf[swb_pos];
 	uint8_t *buf_start = buf;
 
 	drv_ssd_block *block = (drv_ssd_block*)buf;
@@ -1727,7 +2992,10 @@ ssd_write_bins(as_storage_rd *rd)
 		ssd_bin->next = buf - buf_start;
 	}
 
-	block->sig = 0; // deprecated
+	block->compression = AS_COMPRESSION_NONE;
+	block->ckpt_epoch = 0;
+	block->dict_id = 0;
+	block->flat_length = 0;
 	block->length = write_size - LENGTH_BASE;
 	block->magic = SSD_BLOCK_MAGIC;
 	block->keyd = r->keyd;
@@ -1737,6 +3005,154 @@ ssd_write_bins(as_storage_rd *rd)
 	block->n_bins = n_bins_written;
 	block->last_update_time = r->last_update_time;
 
+	return (uint32_t)(buf - buf_start);
+}
+
+
+// Flatten a record into an allocated buffer and compress its bins. If that
+// doesn't save at least an rblock, the flat record is returned instead.
+// Either way, *p_write_size is set to the size to write, and caller frees.
+static uint8_t *
+ssd_compress_record(as_storage_rd *rd, uint32_t *p_write_size)
+{
+	as_namespace *ns = rd->ns;
+	uint32_t flat_size = *p_write_size;
+	uint8_t *flat = cf_malloc(flat_size);
+	uint32_t flat_used = ssd_flatten_record(rd, flat, flat_size);
+
+	const as_compression_dict *dict =
+			ns->storage_compression == AS_COMPRESSION_ZLIB_DICT ?
+					ssd_set_compression_dict(ns, as_index_get_set_id(rd->r)) :
+					NULL;
+
+	uint32_t packed_size;
+	uint8_t *packed = ssd_compress_flat(ns, flat, flat_used, flat_size, dict,
+			&packed_size);
+
+	cf_atomic64_add(&ns->n_compression_orig_bytes, flat_size);
+
+	if (! packed) {
+		cf_atomic64_add(&ns->n_compression_bytes, flat_size);
+		return flat;
+	}
+
+	cf_atomic64_add(&ns->n_compression_bytes, packed_size);
+
+	cf_free(flat);
+
+	*p_write_size = packed_size;
+
+	return packed;
+}
+
+
+int
+ssd_write_bins(as_storage_rd *rd)
+{
+	as_namespace *ns = rd->ns;
+	as_record *r = rd->r;
+	drv_ssd *ssd = rd->ssd;
+
+	uint32_t write_size = ssd_write_calculate_size(rd);
+
+	if (write_size > ssd->write_block_size) {
+		cf_detail_digest(AS_DRV_SSD, &r->keyd, "write: size %u - rejecting ",
+				write_size);
+		return -AS_PROTO_RESULT_FAIL_RECORD_TOO_BIG;
+	}
+
+	uint8_t *packed = NULL;
+
+	if (ns->storage_compression != AS_COMPRESSION_NONE &&
+			write_size >= ns->storage_compression_min_size) {
+		// Flattens (and compresses, if worthwhile) the record up front.
+		packed = ssd_compress_record(rd, &write_size);
+	}
+
+	uint32_t ttl_bucket = ssd_ttl_bucket(ssd, r->void_time);
+	ssd_write_stripe *stripe = ssd_write_stripe_get(ssd, ttl_bucket);
+
+	// Reserve the portion of the current swb where this record will be written.
+	pthread_mutex_lock(&stripe->lock);
+
+	ssd_write_buf *swb = stripe->swb;
+
+	if (! swb) {
+		swb = ssd_stripe_swb_get(ssd, stripe, ttl_bucket);
+
+		if (! swb) {
+			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
+			pthread_mutex_unlock(&stripe->lock);
+
+			if (packed) {
+				cf_free(packed);
+			}
+
+			return -AS_PROTO_RESULT_FAIL_OUT_OF_SPACE;
+		}
+	}
+
+	// Check if there's enough space in current buffer - if not, free and zero
+	// any remaining unused space, enqueue it to be flushed to device, and grab
+	// a new buffer.
+	if (write_size > ssd->write_block_size - swb->pos) {
+		if (ssd->write_block_size != swb->pos) {
+			// Clean the end of the buffer before pushing to write queue.
+			memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
+		}
+
+		// Enqueue the buffer, to be flushed to device.
+		cf_queue_push(ssd->swb_write_q, &swb);
+		cf_atomic64_incr(&ssd->n_wblock_writes);
+		stripe->n_swb_pushes++;
+
+		// Get the new buffer.
+		swb = ssd_stripe_swb_get(ssd, stripe, ttl_bucket);
+
+		if (! swb) {
+			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
+			pthread_mutex_unlock(&stripe->lock);
+
+			if (packed) {
+				cf_free(packed);
+			}
+
+			return -AS_PROTO_RESULT_FAIL_OUT_OF_SPACE;
+		}
+	}
+
+	// There's enough space - save the position where this record will be
+	// written, and advance swb->pos for the next writer.
+	uint32_t swb_pos = swb->pos;
+
+	swb->pos += write_size;
+	cf_atomic32_incr(&swb->n_writers);
+
+	pthread_mutex_unlock(&stripe->lock);
+
+	cf_atomic64_add(&ns->n_device_write_bytes, write_size);
+	// May now write this record concurrently with others in this swb.
+
+	uint8_t *buf = &swb->buf[swb_pos];
+
+	if (packed) {
+		memcpy(buf, packed, write_size);
+		cf_free(packed);
+	}
+	else {
+		ssd_flatten_record(rd, buf, write_size);
+	}
+
+	drv_ssd_block *block = (drv_ssd_block*)buf;
+
+	block->ckpt_epoch = ((drv_ssds*)ns->storage_private)->ckpt.epoch;
+
+	if (block->dict_id != 0) {
+		__sync_fetch_and_or(
+				&ssd->alloc_table->wblock_state[swb->wblock_id].dict_mask,
+				as_compression_dict_ref_bit(block->dict_id));
+	}
+
 	uint64_t write_offset = WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id) + swb_pos;
 
 	ssd_encrypt(ssd, write_offset, block);
@@ -1793,7 +3209,15 @@ ssd_write(as_storage_rd *rd)
 	int rv = ssd_write_bins(rd);
 
 	if (rv == 0 && old_ssd) {
+		ssd_sweeps_note_move(ssds, &r->keyd, old_ssd, old_rblock_id, ssd,
+				r->rblock_id);
+
 		ssd_block_free(old_ssd, old_rblock_id, old_n_rblocks, "ssd-write");
+
+		// Old image would be ignored anyway - free its space sooner.
+		if (ssds->read_cache) {
+			as_record_cache_remove(ssds->read_cache, &r->keyd);
+		}
 	}
 
 	return rv;
@@ -2192,39 +3616,34 @@ ssd_free_swbs(drv_ssd *ssd)
 
 
 void
-ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
-		uint32_t *p_prev_size)
+ssd_flush_stripe_swb(drv_ssd *ssd, ssd_write_stripe *stripe)
 {
-	uint64_t n_writes = cf_atomic64_get(ssd->n_wblock_writes);
-
-	// If there's an active write load, we don't need to flush.
-	if (n_writes != *p_prev_n_writes) {
-		*p_prev_n_writes = n_writes;
-		*p_prev_size = 0;
+	// If there's an active write load, we don't need to flush. (Racy check,
+	// but repeated under the lock.)
+	if (stripe->n_swb_pushes != stripe->prev_n_swb_pushes) {
+		stripe->prev_n_swb_pushes = stripe->n_swb_pushes;
+		stripe->prev_flush_pos = 0;
 		return;
 	}
 
-	pthread_mutex_lock(&ssd->write_lock);
-
-	n_writes = cf_atomic64_get(ssd->n_wblock_writes);
+	pthread_mutex_lock(&stripe->lock);
 
 	// Must check under the lock, could be racing a current swb just queued.
-	if (n_writes != *p_prev_n_writes) {
-
-		pthread_mutex_unlock(&ssd->write_lock);
+	if (stripe->n_swb_pushes != stripe->prev_n_swb_pushes) {
+		stripe->prev_n_swb_pushes = stripe->n_swb_pushes;
+		stripe->prev_flush_pos = 0;
 
-		*p_prev_n_writes = n_writes;
-		*p_prev_size = 0;
+		pthread_mutex_unlock(&stripe->lock);
 		return;
 	}
 
 	// Flush the current swb if it isn't empty, and has been written to since
 	// last flushed.
 
-	ssd_write_buf *swb = ssd->current_swb;
+	ssd_write_buf *swb = stripe->swb;
 
-	if (swb && swb->pos != *p_prev_size) {
-		*p_prev_size = swb->pos;
+	if (swb && swb->pos != stripe->prev_flush_pos) {
+		stripe->prev_flush_pos = swb->pos;
 
 		// Clean the end of the buffer before flushing.
 		if (ssd->write_block_size != swb->pos) {
@@ -2239,7 +3658,16 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 		}
 	}
 
-	pthread_mutex_unlock(&ssd->write_lock);
+	pthread_mutex_unlock(&stripe->lock);
+}
+
+
+void
+ssd_flush_current_swbs(drv_ssd *ssd)
+{
+	for (uint32_t i = 0; i < ssd->n_stripes; i++) {
+		ssd_flush_stripe_swb(ssd, &ssd->write_stripes[i]);
+	}
 }
 
 
@@ -2293,6 +3721,31 @@ ssd_defrag_sweep(drv_ssd *ssd)
 }
 
 
+// Gather which dictionaries blocks on the namespace's devices may reference,
+// so superseded ones nothing references can be retired.
+static void
+ssd_compression_dict_census(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+
+	if (ns->compression_dicts.max_id == 0) {
+		return;
+	}
+
+	uint64_t ref_mask = 0;
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		ssd_alloc_table *at = ssds->ssds[i].alloc_table;
+
+		for (uint32_t wblock_id = 0; wblock_id < at->n_wblocks; wblock_id++) {
+			ref_mask |= at->wblock_state[wblock_id].dict_mask;
+		}
+	}
+
+	as_compression_dict_census(ns, ref_mask);
+}
+
+
 static inline uint64_t
 next_time(uint64_t now, uint64_t job_interval, uint64_t next)
 {
@@ -2306,6 +3759,7 @@ next_time(uint64_t now, uint64_t job_interval, uint64_t next)
 #define MAX_INTERVAL		(1000 * 1000)
 #define LOG_STATS_INTERVAL	(1000 * 1000 * LOG_STATS_INTERVAL_sec)
 #define FREE_SWBS_INTERVAL	(1000 * 1000 * 20)
+#define DICT_CENSUS_INTERVAL	(1000 * 1000 * 60)
 
 // Thread "run" function to perform various background jobs per device.
 void *
@@ -2319,9 +3773,6 @@ run_ssd_maintenance(void *udata)
 	uint64_t prev_n_defrag_writes = 0;
 	uint64_t prev_n_tomb_raider_reads = 0;
 
-	uint64_t prev_n_writes_flush = 0;
-	uint32_t prev_size_flush = 0;
-
 	uint64_t now = cf_getus();
 	uint64_t next = now + MAX_INTERVAL;
 
@@ -2329,6 +3780,12 @@ run_ssd_maintenance(void *udata)
 	uint64_t prev_free_swbs = now;
 	uint64_t prev_flush = now;
 	uint64_t prev_fsync = now;
+	uint64_t prev_dict_census = now;
+
+	drv_ssds *ssds = (drv_ssds*)ns->storage_private;
+
+	// The census covers all the namespace's devices - first one's thread does it.
+	bool do_dict_census = ssd == &ssds->ssds[0];
 
 	// If any job's (initial) interval is less than MAX_INTERVAL and we want it
 	// done on its interval the first time through, add a next_time() call for
@@ -2358,7 +3815,7 @@ run_ssd_maintenance(void *udata)
 		uint64_t flush_max_us = ns->storage_flush_max_us;
 
 		if (flush_max_us != 0 && now >= prev_flush + flush_max_us) {
-			ssd_flush_current_swb(ssd, &prev_n_writes_flush, &prev_size_flush);
+			ssd_flush_current_swbs(ssd);
 			prev_flush = now;
 			next = next_time(now, flush_max_us, next);
 		}
@@ -2371,6 +3828,12 @@ run_ssd_maintenance(void *udata)
 			next = next_time(now, fsync_max_us, next);
 		}
 
+		if (do_dict_census && now >= prev_dict_census + DICT_CENSUS_INTERVAL) {
+			ssd_compression_dict_census(ssds);
+			prev_dict_census = now;
+			next = next_time(now, DICT_CENSUS_INTERVAL, next);
+		}
+
 		if (cf_atomic32_get(ssd->defrag_sweep) != 0) {
 			// May take long enough to mess up other jobs' schedules, but it's a
 			// very rare manually-triggered intervention.
@@ -2715,15 +4178,19 @@ is_record_expired(as_namespace* ns, const drv_ssd_block* block,
 
 
 void
-apply_rec_props(as_record* r, as_namespace* ns, const as_rec_props* p_props)
+apply_rec_props(as_index_tree* tree, as_index_ref* r_ref, as_namespace* ns,
+		const as_rec_props* p_props)
 {
+	as_record* r = r_ref->r;
+
 	// Set record's set-id. (If it already has one, assume they're the same.)
 	if (! as_index_has_set(r) && p_props->size != 0) {
 		const char* set_name;
 
 		if (as_rec_props_get_value(p_props, CL_REC_PROPS_FIELD_SET_NAME, NULL,
-				(uint8_t**)&set_name) == 0) {
-			as_index_set_set(r, ns, set_name, false);
+				(uint8_t**)&set_name) == 0 &&
+				as_index_set_set(r, ns, set_name, false) == 0) {
+			as_index_set_index_insert(tree, r_ref);
 		}
 	}
 
@@ -2820,7 +4287,7 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		if (prefer_existing_record(ssd, wblock_id, block, r)) {
 			ssd_cold_start_adjust_cenotaph(ns, block, r);
 			as_record_done(&r_ref, ns);
-			ssd->record_add_older_counter++;
+			cf_atomic64_incr(&ssd->record_add_older_counter);
 			return;
 		}
 	}
@@ -2830,7 +4297,7 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 	if (is_record_expired(ns, block, &props)) {
 		as_index_delete(p_partition->vp, &block->keyd);
 		as_record_done(&r_ref, ns);
-		ssd->record_add_expired_counter++;
+		cf_atomic64_incr(&ssd->record_add_expired_counter);
 		return;
 	}
 
@@ -2846,7 +4313,7 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 				block->void_time, ns->cold_start_max_void_time);
 
 		r->void_time = ns->cold_start_max_void_time;
-		ssd->record_add_max_ttl_counter++;
+		cf_atomic64_incr(&ssd->record_add_max_ttl_counter);
 	}
 	else {
 		r->void_time = block->void_time;
@@ -2874,7 +4341,7 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		uint64_t bytes_memory = as_storage_record_get_n_bytes_memory(&rd);
 
 		// Do this early since set-id is needed for the secondary index update.
-		apply_rec_props(r, ns, &props);
+		apply_rec_props(p_partition->vp, &r_ref, ns, &props);
 
 		uint16_t old_n_bins = rd.n_bins;
 
@@ -2955,17 +4422,17 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		as_storage_record_close(&rd);
 	}
 	else {
-		apply_rec_props(r, ns, &props);
+		apply_rec_props(p_partition->vp, &r_ref, ns, &props);
 	}
 
 	if (is_create) {
-		ssd->record_add_unique_counter++;
+		cf_atomic64_incr(&ssd->record_add_unique_counter);
 	}
 	else if (STORAGE_RBLOCK_IS_VALID(r->rblock_id)) {
 		// Replacing an existing record, undo its previous storage accounting.
 		ssd_block_free(&ssds->ssds[r->file_id], r->rblock_id, r->n_rblocks,
 				"record-add");
-		ssd->record_add_replace_counter++;
+		cf_atomic64_incr(&ssd->record_add_replace_counter);
 	}
 	else {
 		cf_warning(AS_DRV_SSD, "replacing record with invalid rblock-id");
@@ -2977,8 +4444,8 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 	// TODO - pass in size instead of n_rblocks.
 	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(n_rblocks);
 
-	ssd->inuse_size += size;
-	ssd->alloc_table->wblock_state[wblock_id].inuse_sz += size;
+	cf_atomic64_add(&ssd->inuse_size, size);
+	cf_atomic32_add(&ssd->alloc_table->wblock_state[wblock_id].inuse_sz, size);
 
 	// Set/reset the record's storage information.
 	r->file_id = ssd->file_id;
@@ -2989,116 +4456,342 @@ ssd_cold_start_add_record(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 }
 
 
-// Sweep through a storage device to rebuild the index.
-void
-ssd_cold_start_sweep(drv_ssds *ssds, drv_ssd *ssd)
+// Results of sweeping a wblock.
+typedef enum {
+	SWEEP_WBLOCK_UNUSED,
+	SWEEP_WBLOCK_USED,
+	SWEEP_WBLOCK_STALE // replaying checkpoint - not written since
+} sweep_wblock_result;
+
+// Sweep a wblock, adding its records to the index. If check_epoch is set,
+// we're replaying after loading an index checkpoint, and skip the wblock if
+// it wasn't written since the checkpoint.
+static sweep_wblock_result
+ssd_cold_start_sweep_wblock(drv_ssds *ssds, drv_ssd *ssd, uint8_t *buf,
+		uint32_t wblock_id, bool check_epoch)
 {
 	size_t wblock_size = ssd->write_block_size;
+	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+	size_t indent = 0; // current offset within wblock, in bytes
 
-	uint8_t *buf = cf_valloc(wblock_size);
+	while (indent < wblock_size) {
+		drv_ssd_block *block = (drv_ssd_block*)&buf[indent];
+
+		ssd_decrypt(ssd, file_offset + indent, block);
+
+		// Look for record magic.
+		if (block->magic != SSD_BLOCK_MAGIC) {
+			// Should always find a record at beginning of used wblock. if
+			// not, we've likely encountered the unused part of the device.
+			if (indent == 0) {
+				return SWEEP_WBLOCK_UNUSED;
+			}
+			// else - nothing more in this wblock, but keep looking for
+			// magic - necessary if we want to be able to increase
+			// write-block-size across restarts.
+
+			indent += RBLOCK_SIZE;
+			continue; // try next rblock
+		}
+
+		// A wblock taken from the free queue since the checkpoint starts with
+		// a record stamped with its epoch, or the next one's.
+		if (indent == 0 && check_epoch) {
+			uint32_t gen = ssds->ckpt.replay_gen;
+
+			if (block->ckpt_epoch != ssd_checkpoint_epoch(gen) &&
+					block->ckpt_epoch != ssd_checkpoint_epoch(gen + 1)) {
+				return SWEEP_WBLOCK_STALE;
+			}
+		}
+
+		// Note - if block->length is sane, we don't need to round up to a
+		// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
+		size_t next_indent = indent +
+				BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+		// Sanity-check for wblock overruns.
+		if (next_indent > wblock_size) {
+			cf_warning(AS_DRV_SSD, "%s: record crosses wblock boundary: block-length %u",
+					ssd->name, block->length);
+			break; // skip this record, try next wblock
+		}
+
+		ssd_wblock_state *p_wblock_state =
+				&ssd->alloc_table->wblock_state[wblock_id];
+
+		if (block->dict_id != 0) {
+			p_wblock_state->dict_mask |=
+					as_compression_dict_ref_bit(block->dict_id);
+		}
+
+		uint32_t lut_sec = (uint32_t)(block->last_update_time / 1000);
+
+		if (lut_sec > p_wblock_state->write_time) {
+			p_wblock_state->write_time = lut_sec;
+		}
+
+		drv_ssd_block *flat_block = block;
+
+		if (block->compression != AS_COMPRESSION_NONE &&
+				! (flat_block = ssd_decompress_block(ssds->ns, block))) {
+			cf_warning_digest(AS_DRV_SSD, &block->keyd, "invalid data on device - ignoring record ");
+			indent = next_indent;
+			continue;
+		}
+
+		// Found a record - try to add it to the index.
+		ssd_cold_start_add_record(ssds, ssd, flat_block,
+				BYTES_TO_RBLOCKS(file_offset + indent),
+				(uint32_t)BYTES_TO_RBLOCKS(next_indent - indent));
+
+		if (flat_block != block) {
+			cf_free(flat_block);
+		}
+
+		indent = next_indent;
+	}
+
+	return SWEEP_WBLOCK_USED;
+}
+
+
+// Sweep one read's worth of wblocks, adding records to the index. Returns false
+// if we hit the run of unused wblocks marking the end of used space.
+static bool
+ssd_cold_start_sweep_wblocks(ssd_sweep *sweep, uint8_t *buf,
+		uint32_t start_wblock_id, uint32_t n_wblocks)
+{
+	drv_ssd *ssd = sweep->ssd;
+	uint32_t n_unused_wblocks = 0;
+
+	for (uint32_t i = 0; i < n_wblocks; i++) {
+		uint32_t wblock_id = start_wblock_id + i;
+
+		// Another thread may have found the end of used space.
+		if (wblock_id >= cf_atomic32_get(sweep->end_wblock_id)) {
+			return false;
+		}
+
+		uint8_t *wblock_buf = buf + (i * ssd->write_block_size);
+
+		if (ssd_cold_start_sweep_wblock(sweep->ssds, ssd, wblock_buf, wblock_id,
+				false) == SWEEP_WBLOCK_UNUSED) {
+			// Stop at 10 contiguous unused wblocks. Reads are at least this
+			// many wblocks, though a run straddling two reads isn't noticed.
+			if (++n_unused_wblocks == 10) {
+				uint32_t end_wblock_id = wblock_id + 1 - 10;
+				uint32_t cur;
+
+				while (end_wblock_id < (cur = sweep->end_wblock_id) &&
+						! __sync_bool_compare_and_swap(&sweep->end_wblock_id,
+								cur, end_wblock_id)) {
+					;
+				}
+
+				return false;
+			}
+
+			continue;
+		}
+
+		if (n_unused_wblocks != 0) {
+			cf_warning(AS_DRV_SSD, "%s: found used wblock after skipping %u unused",
+					ssd->name, n_unused_wblocks);
+
+			n_unused_wblocks = 0; // restart contiguous count
+		}
+	}
+
+	return true;
+}
+
+
+// Thread "run" function for one of several threads sweeping a device. Threads
+// take turns claiming the next read, so the device sees (mostly) sequential
+// large reads, and index insertion is spread across threads.
+void *
+run_ssd_cold_start_sweep(void *udata)
+{
+	ssd_sweep *sweep = (ssd_sweep*)udata;
+	drv_ssd *ssd = sweep->ssd;
+
+	CF_ALLOC_SET_NS_ARENA(sweep->ssds->ns);
+
+	size_t wblock_size = ssd->write_block_size;
+	size_t max_read_size = sweep->n_wblocks_per_read * wblock_size;
+	uint8_t *buf = cf_valloc(max_read_size);
 
 	bool read_shadow = ssd->shadow_name;
 	char *read_ssd_name = read_shadow ? ssd->shadow_name : ssd->name;
 	int fd = read_shadow ? ssd_shadow_fd_get(ssd) : ssd_fd_get(ssd);
 	int write_fd = read_shadow ? ssd_fd_get(ssd) : -1;
 
-	// Seek past the header.
-
-	if (lseek(fd, SSD_HEADER_SIZE, SEEK_SET) != SSD_HEADER_SIZE) {
-		cf_crash(AS_DRV_SSD, "%s: seek failed: errno %d (%s)", read_ssd_name,
-				errno, cf_strerror(errno));
-	}
+	while (true) {
+		uint32_t start_wblock_id = sweep->first_wblock_id +
+				((cf_atomic32_incr(&sweep->n_reads_claimed) - 1) *
+						sweep->n_wblocks_per_read);
 
-	if (read_shadow &&
-			lseek(write_fd, SSD_HEADER_SIZE, SEEK_SET) != SSD_HEADER_SIZE) {
-		cf_crash(AS_DRV_SSD, "%s: seek failed: errno %d (%s)", ssd->name,
-				errno, cf_strerror(errno));
-	}
+		if (start_wblock_id >= cf_atomic32_get(sweep->end_wblock_id)) {
+			break;
+		}
 
-	// Loop over all wblocks, unless we encounter 10 contiguous unused wblocks.
+		uint32_t n_wblocks = sweep->n_wblocks_per_read;
 
-	ssd->sweep_wblock_id = SSD_HEADER_SIZE / (uint32_t)wblock_size;
+		if (start_wblock_id + n_wblocks > sweep->n_wblocks) {
+			n_wblocks = sweep->n_wblocks - start_wblock_id;
+		}
 
-	uint64_t file_offset = SSD_HEADER_SIZE;
-	uint32_t n_unused_wblocks = 0;
+		size_t read_size = n_wblocks * wblock_size;
+		off_t offset = (off_t)start_wblock_id * wblock_size;
 
-	while (file_offset < ssd->file_size && n_unused_wblocks < 10) {
-		if (read(fd, buf, wblock_size) != wblock_size) {
+		if (pread(fd, buf, read_size, offset) != (ssize_t)read_size) {
 			cf_crash(AS_DRV_SSD, "%s: read failed: errno %d (%s)",
 					read_ssd_name, errno, cf_strerror(errno));
 		}
 
 		if (read_shadow &&
-				write(write_fd, (void*)buf, wblock_size) != wblock_size) {
+				pwrite(write_fd, buf, read_size, offset) != (ssize_t)read_size) {
 			cf_crash(AS_DRV_SSD, "%s: write failed: errno %d (%s)", ssd->name,
 					errno, cf_strerror(errno));
 		}
 
-		size_t indent = 0; // current offset within wblock, in bytes
+		bool more = ssd_cold_start_sweep_wblocks(sweep, buf, start_wblock_id,
+				n_wblocks);
 
-		while (indent < wblock_size) {
-			drv_ssd_block *block = (drv_ssd_block*)&buf[indent];
+		cf_atomic32_add(&ssd->sweep_wblock_id, n_wblocks);
 
-			ssd_decrypt(ssd, file_offset + indent, block);
+		if (! more) {
+			break;
+		}
+	}
 
-			// Look for record magic.
-			if (block->magic != SSD_BLOCK_MAGIC) {
-				// Should always find a record at beginning of used wblock. if
-				// not, we've likely encountered the unused part of the device.
-				if (indent == 0) {
-					n_unused_wblocks++;
-					break; // try next wblock
-				}
-				// else - nothing more in this wblock, but keep looking for
-				// magic - necessary if we want to be able to increase
-				// write-block-size across restarts.
+	if (fd != -1) {
+		read_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
+	}
 
-				indent += RBLOCK_SIZE;
-				continue; // try next rblock
-			}
+	if (write_fd != -1) {
+		ssd_fd_put(ssd, write_fd);
+	}
 
-			if (n_unused_wblocks != 0) {
-				cf_warning(AS_DRV_SSD, "%s: found used wblock after skipping %u unused",
-						ssd->name, n_unused_wblocks);
+	cf_free(buf);
 
-				n_unused_wblocks = 0; // restart contiguous count
-			}
+	return NULL;
+}
 
-			// Note - if block->length is sane, we don't need to round up to a
-			// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
-			size_t next_indent = indent +
-					BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
 
-			// Sanity-check for wblock overruns.
-			if (next_indent > wblock_size) {
-				cf_warning(AS_DRV_SSD, "%s: record crosses wblock boundary: block-length %u",
-						ssd->name, block->length);
-				break; // skip this record, try next wblock
-			}
+// Sweep through a storage device to rebuild the index.
+void
+ssd_cold_start_sweep(drv_ssds *ssds, drv_ssd *ssd)
+{
+	uint32_t wblock_size = ssd->write_block_size;
 
-			// Found a record - try to add it to the index.
-			ssd_cold_start_add_record(ssds, ssd, block,
-					BYTES_TO_RBLOCKS(file_offset + indent),
-					(uint32_t)BYTES_TO_RBLOCKS(next_indent - indent));
+	ssd_sweep sweep = {
+			.ssds = ssds,
+			.ssd = ssd,
+			.first_wblock_id = SSD_HEADER_SIZE / wblock_size,
+			.n_wblocks = (uint32_t)(ssd->file_size / wblock_size),
+			// At least 10 wblocks per read, to notice the end of used space.
+			.n_wblocks_per_read = MAX(COLD_START_READ_SIZE / wblock_size, 10),
+			.n_reads_claimed = 0
+	};
 
-			indent = next_indent;
-		}
+	sweep.end_wblock_id = sweep.n_wblocks;
+
+	ssd->sweep_wblock_id = sweep.first_wblock_id;
+
+	// Share the CPUs among devices - they're all swept at once.
+	uint32_t n_threads = cf_topo_count_cpus() / (uint32_t)ssds->n_ssds;
 
-		file_offset += wblock_size;
-		ssd->sweep_wblock_id++;
+	if (n_threads == 0) {
+		n_threads = 1;
+	}
+	else if (n_threads > MAX_COLD_START_SWEEP_THREADS) {
+		n_threads = MAX_COLD_START_SWEEP_THREADS;
 	}
 
-	ssd->sweep_wblock_id = (uint32_t)(ssd->file_size / wblock_size);
+	pthread_t threads[n_threads];
 
-	if (fd != -1) {
-		read_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
+	for (uint32_t i = 0; i < n_threads; i++) {
+		if (pthread_create(&threads[i], NULL, run_ssd_cold_start_sweep,
+				(void*)&sweep) != 0) {
+			cf_crash(AS_DRV_SSD, "%s: failed to create sweep thread", ssd->name);
+		}
 	}
 
-	if (write_fd != -1) {
-		ssd_fd_put(ssd, write_fd);
+	for (uint32_t i = 0; i < n_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	ssd->sweep_wblock_id = sweep.n_wblocks;
+}
+
+
+// After loading an index checkpoint, sweep only wblocks that may have been
+// written since - those in swbs at the time, and then a prefix of those free
+// at the time, in the order they'd have been allocated.
+static void
+ssd_cold_start_replay(drv_ssds *ssds, drv_ssd *ssd)
+{
+	as_namespace *ns = ssds->ns;
+	size_t wblock_size = ssd->write_block_size;
+	uint8_t *buf = cf_valloc(wblock_size);
+	int fd = ssd_fd_get(ssd);
+
+	uint32_t n_open = ssd->n_replay_open;
+	uint32_t n_total = n_open + ssd->n_replay_free;
+	uint32_t n_wblocks = (uint32_t)(ssd->file_size / wblock_size);
+
+	// Allocated wblocks not yet flushed at a crash leave gaps in the prefix -
+	// tolerate as many as could have been buffered.
+	uint32_t max_stale_run = (uint32_t)(ns->storage_max_write_cache /
+			wblock_size) + ssd->n_stripes + 64;
+	uint32_t n_stale_run = 0;
+	uint32_t n_replayed = 0;
+
+	ssd->sweep_wblock_id = n_total < n_wblocks ? n_wblocks - n_total : 0;
+
+	for (uint32_t i = 0; i < n_total; i++) {
+		uint32_t wblock_id = ssd->replay_wblock_ids[i];
+		off_t offset = (off_t)WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+
+		if (pread(fd, buf, wblock_size, offset) != (ssize_t)wblock_size) {
+			cf_crash(AS_DRV_SSD, "%s: read failed: errno %d (%s)",
+					ssd->name, errno, cf_strerror(errno));
+		}
+
+		bool is_open = i < n_open;
+		sweep_wblock_result result = ssd_cold_start_sweep_wblock(ssds, ssd,
+				buf, wblock_id, ! is_open);
+
+		cf_atomic32_incr(&ssd->sweep_wblock_id);
+
+		if (result == SWEEP_WBLOCK_USED) {
+			n_replayed++;
+		}
+
+		if (is_open) {
+			continue;
+		}
+
+		if (result == SWEEP_WBLOCK_USED) {
+			n_stale_run = 0;
+		}
+		else if (++n_stale_run == max_stale_run) {
+			break;
+		}
 	}
 
+	cf_info(AS_DRV_SSD, "device %s: replayed %u of %u candidate wblocks since checkpoint",
+			ssd->name, n_replayed, n_total);
+
+	ssd->sweep_wblock_id = n_wblocks;
+
+	ssd_fd_put(ssd, fd);
 	cf_free(buf);
+
+	cf_free(ssd->replay_wblock_ids);
+	ssd->replay_wblock_ids = NULL;
 }
 
 
@@ -3117,11 +4810,20 @@ run_ssd_cold_start(void *udata)
 
 	as_namespace* ns = ssds->ns;
 
-	cf_info(AS_DRV_SSD, "device %s: reading device to load index", ssd->name);
-
 	CF_ALLOC_SET_NS_ARENA(ns);
 
-	ssd_cold_start_sweep(ssds, ssd);
+	if (ssd->replay_wblock_ids) {
+		cf_info(AS_DRV_SSD, "device %s: reading wblocks written since index checkpoint",
+				ssd->name);
+
+		ssd_cold_start_replay(ssds, ssd);
+	}
+	else {
+		cf_info(AS_DRV_SSD, "device %s: reading device to load index",
+				ssd->name);
+
+		ssd_cold_start_sweep(ssds, ssd);
+	}
 
 	cf_info(AS_DRV_SSD, "device %s: read complete: UNIQUE %lu (REPLACED %lu) (OLDER %lu) (EXPIRED %lu) (MAX-TTL %lu) records",
 			ssd->name, ssd->record_add_unique_counter,
@@ -3146,19 +4848,18 @@ run_ssd_cold_start(void *udata)
 		ssd_start_maintenance_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
+		ssd_start_checkpoint_thread(ssds);
 	}
 
 	return NULL;
 }
 
 
-void
-start_loading_records(drv_ssds *ssds, cf_queue *complete_q, void *udata)
+static void
+start_device_loading_threads(drv_ssds *ssds, cf_queue *complete_q, void *udata)
 {
 	as_namespace *ns = ssds->ns;
 
-	ns->loading_records = true;
-
 	void *p = cf_rc_alloc(1);
 
 	for (int i = 1; i < ssds->n_ssds; i++) {
@@ -3187,6 +4888,60 @@ start_loading_records(drv_ssds *ssds, cf_queue *complete_q, void *udata)
 }
 
 
+// Thread "run" function to load an index checkpoint, then start the device
+// threads which replay what was written since.
+static void *
+run_ssd_checkpoint_load(void *udata)
+{
+	ssd_load_records_info *lri = (ssd_load_records_info*)udata;
+	drv_ssds *ssds = lri->ssds;
+	cf_queue *complete_q = lri->complete_q;
+	void *complete_udata = lri->complete_udata;
+
+	cf_free(lri);
+
+	CF_ALLOC_SET_NS_ARENA(ssds->ns);
+
+	ssd_checkpoint_load(ssds);
+	start_device_loading_threads(ssds, complete_q, complete_udata);
+
+	return NULL;
+}
+
+
+void
+start_loading_records(drv_ssds *ssds, cf_queue *complete_q, void *udata)
+{
+	as_namespace *ns = ssds->ns;
+
+	ns->loading_records = true;
+
+	if (! ns->cold_start || ! ssd_checkpoint_open(ssds)) {
+		start_device_loading_threads(ssds, complete_q, udata);
+		return;
+	}
+
+	ssd_load_records_info *lri = cf_malloc(sizeof(ssd_load_records_info));
+
+	lri->ssds = ssds;
+	lri->ssd = NULL;
+	lri->complete_q = complete_q;
+	lri->complete_udata = udata;
+	lri->complete_rc = NULL;
+
+	pthread_t thread;
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&thread, &attrs, run_ssd_checkpoint_load, lri) != 0) {
+		cf_crash(AS_DRV_SSD, "{%s} failed to create checkpoint load thread",
+				ns->name);
+	}
+}
+
+
 //==========================================================
 // Generic startup utilities.
 //
@@ -3307,6 +5062,9 @@ ssd_load_records(drv_ssds *ssds, cf_queue *complete_q, void *udata)
 		}
 	}
 
+	// An index checkpoint from the previous run is tagged with its signature.
+	ssds->ckpt.prev_random = ssds->header->random;
+
 	ssds->header->random = random;
 	ssds->header->devices_n = n_ssds; // may have added fresh drives
 	as_storage_info_flush_ssd(ns);
@@ -3770,6 +5528,15 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 
 	ns->storage_private = (void*)ssds;
 
+	ssd_checkpoint_init(ssds);
+
+	pthread_rwlock_init(&ssds->sweeps_lock, NULL);
+
+	// Pointless to cache records read from device if data is in memory.
+	ssds->read_cache = ns->storage_read_cache_size != 0 &&
+			! ns->storage_data_in_memory ?
+					as_record_cache_create(ns->storage_read_cache_size) : NULL;
+
 	char histname[HISTOGRAM_NAME_SIZE];
 
 	snprintf(histname, sizeof(histname), "{%s}-device-read-size", ns->name);
@@ -3785,8 +5552,16 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		ssd->ns = ns;
 		ssd->file_id = i;
 
-		pthread_mutex_init(&ssd->write_lock, 0);
+		ssd->n_ttl_buckets = ns->storage_write_ttl_buckets;
+		ssd->n_write_stripes = ns->storage_write_stripes;
+		ssd->n_stripes = ssd->n_ttl_buckets * ssd->n_write_stripes;
+
+		for (uint32_t j = 0; j < ssd->n_stripes; j++) {
+			pthread_mutex_init(&ssd->write_stripes[j].lock, 0);
+		}
+
 		pthread_mutex_init(&ssd->defrag_lock, 0);
+		pthread_rwlock_init(&ssd->free_wblock_lock, NULL);
 
 		ssd->running = true;
 
@@ -3811,6 +5586,13 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 
 		ssd->swb_free_q = cf_queue_create(sizeof(void*), true);
 
+		if (ns->storage_read_engine == AS_STORAGE_READ_ENGINE_IO_URING &&
+				! ns->storage_data_in_memory) {
+			ssd_init_read_ring(ssd);
+		}
+
+		ssd_io_sched_init(ssd);
+
 		if (! ns->storage_data_in_memory) {
 			ssd->post_write_q = cf_queue_create(sizeof(void*), false);
 		}
@@ -3847,6 +5629,7 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		ssd_start_maintenance_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
+		ssd_start_checkpoint_thread(ssds);
 	}
 
 	return 0;
@@ -3906,6 +5689,10 @@ as_storage_record_destroy_ssd(as_namespace *ns, as_record *r)
 
 		ssd_block_free(ssd, r->rblock_id, r->n_rblocks, "destroy");
 
+		if (ssds->read_cache) {
+			as_record_cache_remove(ssds->read_cache, &r->keyd);
+		}
+
 		r->rblock_id = 0;
 		r->n_rblocks = 0;
 	}
@@ -4211,6 +5998,8 @@ as_storage_ticker_stats_ssd(as_namespace *ns)
 		}
 
 		histogram_dump(ssd->hist_fsync);
+
+		ssd_io_sched_ticker(ssd);
 	}
 
 	return 0;
@@ -4253,19 +6042,28 @@ as_storage_shutdown_ssd(as_namespace *ns)
 		drv_ssd *ssd = &ssds->ssds[i];
 
 		// Stop the maintenance thread from (also) flushing the swbs.
-		pthread_mutex_lock(&ssd->write_lock);
+		for (uint32_t j = 0; j < ssd->n_stripes; j++) {
+			pthread_mutex_lock(&ssd->write_stripes[j].lock);
+		}
+
 		pthread_mutex_lock(&ssd->defrag_lock);
 
-		// Flush current swb by pushing it to write-q.
-		if (ssd->current_swb) {
+		// Flush current swbs by pushing them to write-q.
+		for (uint32_t j = 0; j < ssd->n_stripes; j++) {
+			ssd_write_stripe *stripe = &ssd->write_stripes[j];
+
+			if (! stripe->swb) {
+				continue;
+			}
+
 			// Clean the end of the buffer before pushing to write-q.
-			if (ssd->write_block_size > ssd->current_swb->pos) {
-				memset(&ssd->current_swb->buf[ssd->current_swb->pos], 0,
-						ssd->write_block_size - ssd->current_swb->pos);
+			if (ssd->write_block_size > stripe->swb->pos) {
+				memset(&stripe->swb->buf[stripe->swb->pos], 0,
+						ssd->write_block_size - stripe->swb->pos);
 			}
 
-			cf_queue_push(ssd->swb_write_q, &ssd->current_swb);
-			ssd->current_swb = NULL;
+			cf_queue_push(ssd->swb_write_q, &stripe->swb);
+			stripe->swb = NULL;
 		}
 
 		// Flush defrag swb by pushing it to write-q.
@@ -4309,4 +6107,8 @@ as_storage_shutdown_ssd(as_namespace *ns)
 			pthread_join(ssd->shadow_worker_thread, &p_void);
 		}
 	}
+
+	// Everything is on device - a final checkpoint makes the next cold start
+	// fast. (Does nothing if not configured.)
+	ssd_checkpoint_write(ssds);
 }
@@ -0,0 +1,902 @@
+/*
+ * drv_ssd_checkpoint.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Index checkpoints - periodically dump the index of a namespace whose data is
+ * not in memory to a file, so a cold start can load the file and then only
+ * read the wblocks written since, instead of sweeping entire devices.
+ *
+ * A checkpoint snapshots, per device, the wblocks in swbs and the free wblocks
+ * in the order they'll be allocated. Wblocks freed after a checkpoint starts
+ * are held back from the free queue until a later checkpoint is durable, so
+ * records the file points to are never overwritten, and the free wblocks are
+ * allocated in the snapshot order. Records are stamped with an epoch derived
+ * from the checkpoint generation - at startup, a free-at-checkpoint wblock
+ * whose first record has the right epoch was written since.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+#include "citrusleaf/cf_digest.h"
+#include "citrusleaf/cf_queue.h"
+
+#include "fault.h"
+#include "vmapx.h"
+
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "fabric/partition.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define CKPT_MAGIC		0x54504b4358444e49UL // "INDXCKPT"
+#define CKPT_VERSION	1
+
+#define CKPT_DEVICE_NAME_SIZE	256
+
+#define CKPT_FILE_BUF_SIZE		(4 * 1024 * 1024)
+#define CKPT_LOAD_BATCH			4096
+
+typedef struct ckpt_header_s {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	gen;
+	uint64_t	random;			// device header signature when written
+	uint64_t	dict_mask;		// union of all wblocks' dictionary masks
+	char		ns_name[AS_ID_NAMESPACE_SZ];
+	uint32_t	n_ssds;
+	uint32_t	unused;
+} __attribute__ ((__packed__)) ckpt_header;
+
+// Followed by n_open + n_free wblock ids - open first, then free in allocation
+// order.
+typedef struct ckpt_device_s {
+	char		name[CKPT_DEVICE_NAME_SIZE];
+	uint64_t	file_size;
+	uint32_t	write_block_size;
+	uint32_t	n_open;
+	uint32_t	n_free;
+} __attribute__ ((__packed__)) ckpt_device;
+
+typedef struct ckpt_record_s {
+	cf_digest	keyd;
+	uint64_t	last_update_time: 40;
+	uint64_t	generation: 16;
+	uint64_t	file_id: 6;
+	uint64_t	key_stored: 1;
+	uint64_t	unused: 1;
+	uint64_t	rblock_id: 34;
+	uint64_t	n_rblocks: 14;
+	uint64_t	set_id: 10;		// index into set-name table, 0 means no set
+	uint64_t	unused2: 6;
+	uint32_t	void_time;
+} __attribute__ ((__packed__)) ckpt_record;
+
+// Records are followed by n_sets set names, then this.
+typedef struct ckpt_trailer_s {
+	uint64_t	n_records;
+	uint64_t	sets_offset;
+	uint32_t	n_sets;
+	uint32_t	gen;
+	uint64_t	magic;
+} __attribute__ ((__packed__)) ckpt_trailer;
+
+typedef struct held_wblock_s {
+	uint32_t	wblock_id;
+	uint32_t	gen;			// checkpoint generation when freed
+} held_wblock;
+
+typedef struct snapshot_s {
+	uint32_t	*ids;
+	uint32_t	n_ids;
+} snapshot;
+
+typedef struct dump_info_s {
+	drv_ssds	*ssds;
+	FILE		*file;
+	uint64_t	n_records;
+	bool		failed;
+} dump_info;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+extern bool as_cold_start_evict_if_needed(as_namespace *ns);
+
+static void release_held_wblocks(drv_ssds *ssds);
+static bool write_device(drv_ssd *ssd, FILE *file);
+static int snapshot_free_reduce_cb(void *buf, void *udata);
+static int snapshot_held_reduce_cb(void *buf, void *udata);
+static void dump_reduce_cb(as_index_ref *r_ref, void *udata);
+static bool read_devices(drv_ssds *ssds, FILE *file, bool keep);
+static void load_record(drv_ssds *ssds, const ckpt_record *rec, const char *set_names, uint32_t n_sets, uint64_t dict_mask);
+static bool is_expired(as_namespace *ns, uint32_t void_time, const char *set_name);
+static void *run_checkpoint(void *udata);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline bool
+file_read(FILE *file, void *buf, size_t size)
+{
+	return fread(buf, size, 1, file) == 1;
+}
+
+static inline bool
+file_write(FILE *file, const void *buf, size_t size)
+{
+	return fwrite(buf, size, 1, file) == 1;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+void
+ssd_checkpoint_init(drv_ssds *ssds)
+{
+	ssd_checkpoint *ckpt = &ssds->ckpt;
+
+	pthread_mutex_init(&ckpt->lock, NULL);
+	ckpt->enabled = false;
+	ckpt->load_file = NULL;
+	ckpt->gen = 0;
+	ckpt->durable_gen = 0;
+	ckpt->replay_gen = 0;
+	ckpt->epoch = 0;
+}
+
+
+// Called at cold start, once device headers are read. If there's a valid
+// checkpoint from the previous run, opens it and returns true.
+bool
+ssd_checkpoint_open(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+	const char *path = ns->storage_index_checkpoint_file;
+
+	if (! path || ns->storage_data_in_memory) {
+		return false;
+	}
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		// A shadowed device may need all its wblocks copied to the primary.
+		if (ssd->shadow_name) {
+			cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint - device %s has shadow",
+					ns->name, ssd->name);
+			return false;
+		}
+
+		if (ssd->started_fresh) {
+			cf_info(AS_DRV_SSD, "{%s} ignoring index checkpoint - device %s is fresh",
+					ns->name, ssd->name);
+			return false;
+		}
+	}
+
+	FILE *file = fopen(path, "r");
+
+	if (! file) {
+		if (errno != ENOENT) {
+			cf_warning(AS_DRV_SSD, "{%s} can't open index checkpoint %s: %s",
+					ns->name, path, cf_strerror(errno));
+		}
+
+		return false;
+	}
+
+	ckpt_header header;
+	ckpt_trailer trailer;
+
+	if (! file_read(file, &header, sizeof(header)) ||
+			header.magic != CKPT_MAGIC || header.version != CKPT_VERSION ||
+			strncmp(header.ns_name, ns->name, AS_ID_NAMESPACE_SZ) != 0) {
+		cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint %s - bad header",
+				ns->name, path);
+		fclose(file);
+		return false;
+	}
+
+	if (header.random != ssds->ckpt.prev_random) {
+		cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint %s - devices written since",
+				ns->name, path);
+		fclose(file);
+		return false;
+	}
+
+	if (header.n_ssds != (uint32_t)ssds->n_ssds || ! read_devices(ssds, file,
+			false)) {
+		cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint %s - device configuration changed",
+				ns->name, path);
+		fclose(file);
+		return false;
+	}
+
+	// Checkpoint files are written whole and renamed, but be sure.
+	if (fseeko(file, -(off_t)sizeof(trailer), SEEK_END) != 0 ||
+			! file_read(file, &trailer, sizeof(trailer)) ||
+			trailer.magic != CKPT_MAGIC || trailer.gen != header.gen) {
+		cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint %s - bad trailer",
+				ns->name, path);
+		fclose(file);
+		return false;
+	}
+
+	// If we fail to load it, the next start must not try again.
+	if (unlink(path) != 0) {
+		cf_warning(AS_DRV_SSD, "{%s} ignoring index checkpoint %s - can't remove: %s",
+				ns->name, path, cf_strerror(errno));
+		fclose(file);
+		return false;
+	}
+
+	setvbuf(file, NULL, _IOFBF, CKPT_FILE_BUF_SIZE);
+
+	ssds->ckpt.load_file = file;
+
+	cf_info(AS_DRV_SSD, "{%s} found index checkpoint %u with %lu records",
+			ns->name, header.gen, trailer.n_records);
+
+	return true;
+}
+
+
+// Load the index from the checkpoint opened above, and set up devices to replay
+// wblocks written since.
+void
+ssd_checkpoint_load(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+	ssd_checkpoint *ckpt = &ssds->ckpt;
+	FILE *file = ckpt->load_file;
+
+	ckpt_header header;
+	ckpt_trailer trailer;
+
+	rewind(file);
+
+	if (! file_read(file, &header, sizeof(header)) ||
+			! read_devices(ssds, file, true)) {
+		cf_crash(AS_DRV_SSD, "{%s} failed reading index checkpoint", ns->name);
+	}
+
+	off_t records_offset = ftello(file);
+
+	if (fseeko(file, -(off_t)sizeof(trailer), SEEK_END) != 0 ||
+			! file_read(file, &trailer, sizeof(trailer))) {
+		cf_crash(AS_DRV_SSD, "{%s} failed reading index checkpoint", ns->name);
+	}
+
+	char *set_names = NULL;
+
+	if (trailer.n_sets != 0) {
+		set_names = cf_malloc(trailer.n_sets * AS_SET_NAME_MAX_SIZE);
+
+		if (fseeko(file, (off_t)trailer.sets_offset, SEEK_SET) != 0 ||
+				! file_read(file, set_names,
+						trailer.n_sets * AS_SET_NAME_MAX_SIZE)) {
+			cf_crash(AS_DRV_SSD, "{%s} failed reading index checkpoint",
+					ns->name);
+		}
+
+		for (uint32_t i = 0; i < trailer.n_sets; i++) {
+			set_names[((i + 1) * AS_SET_NAME_MAX_SIZE) - 1] = '\0';
+		}
+	}
+
+	if (fseeko(file, records_offset, SEEK_SET) != 0) {
+		cf_crash(AS_DRV_SSD, "{%s} failed reading index checkpoint", ns->name);
+	}
+
+	uint64_t start_ms = cf_getms();
+	ckpt_record *batch = cf_malloc(CKPT_LOAD_BATCH * sizeof(ckpt_record));
+	uint64_t n_left = trailer.n_records;
+
+	while (n_left != 0) {
+		size_t n = n_left < CKPT_LOAD_BATCH ? (size_t)n_left : CKPT_LOAD_BATCH;
+
+		if (fread(batch, sizeof(ckpt_record), n, file) != n) {
+			cf_crash(AS_DRV_SSD, "{%s} failed reading index checkpoint",
+					ns->name);
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			load_record(ssds, &batch[i], set_names, trailer.n_sets,
+					header.dict_mask);
+		}
+
+		n_left -= n;
+	}
+
+	cf_free(batch);
+
+	if (set_names) {
+		cf_free(set_names);
+	}
+
+	fclose(file);
+	ckpt->load_file = NULL;
+
+	// Carry on from the loaded generation, skipping the one that may have
+	// been in progress - its epoch may be stamped on device.
+	ckpt->replay_gen = header.gen;
+	ckpt->gen = header.gen + 1;
+	ckpt->durable_gen = ckpt->gen;
+
+	cf_info(AS_DRV_SSD, "{%s} loaded %lu records from index checkpoint %u in %lu ms",
+			ns->name, trailer.n_records, header.gen, cf_getms() - start_ms);
+}
+
+
+// Hold a freed wblock until a checkpoint that doesn't reference it is durable.
+// Called with free_wblock_lock read-locked.
+void
+ssd_checkpoint_hold_wblock(drv_ssd *ssd, uint32_t wblock_id)
+{
+	drv_ssds *ssds = (drv_ssds*)ssd->ns->storage_private;
+	held_wblock held = {
+			.wblock_id = wblock_id,
+			.gen = ssds->ckpt.gen
+	};
+
+	cf_queue_push(ssd->held_wblock_q, &held);
+}
+
+
+void
+ssd_checkpoint_write(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+	ssd_checkpoint *ckpt = &ssds->ckpt;
+
+	if (! ckpt->enabled) {
+		return;
+	}
+
+	pthread_mutex_lock(&ckpt->lock);
+
+	uint64_t start_ms = cf_getms();
+
+	release_held_wblocks(ssds);
+
+	uint32_t gen = ckpt->gen + 1;
+
+	// From here, records written are stamped with the new epoch.
+	ckpt->gen = gen;
+	ckpt->epoch = ssd_checkpoint_epoch(gen);
+
+	const char *path = ns->storage_index_checkpoint_file;
+	char tmp_path[strlen(path) + 5];
+
+	sprintf(tmp_path, "%s.tmp", path);
+
+	FILE *file = fopen(tmp_path, "w");
+
+	if (! file) {
+		cf_warning(AS_DRV_SSD, "{%s} can't create index checkpoint %s: %s",
+				ns->name, tmp_path, cf_strerror(errno));
+		pthread_mutex_unlock(&ckpt->lock);
+		return;
+	}
+
+	setvbuf(file, NULL, _IOFBF, CKPT_FILE_BUF_SIZE);
+
+	ckpt_header header = {
+			.magic = CKPT_MAGIC,
+			.version = CKPT_VERSION,
+			.gen = gen,
+			.random = ssds->header->random,
+			.n_ssds = (uint32_t)ssds->n_ssds
+	};
+
+	strncpy(header.ns_name, ns->name, AS_ID_NAMESPACE_SZ);
+
+	// Loaded records don't know which dictionaries they use - be conservative.
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		ssd_alloc_table *at = ssds->ssds[i].alloc_table;
+
+		for (uint32_t j = 0; j < at->n_wblocks; j++) {
+			header.dict_mask |= at->wblock_state[j].dict_mask;
+		}
+	}
+
+	bool ok = file_write(file, &header, sizeof(header));
+
+	for (int i = 0; ok && i < ssds->n_ssds; i++) {
+		ok = write_device(&ssds->ssds[i], file);
+	}
+
+	dump_info info = {
+			.ssds = ssds,
+			.file = file,
+			.n_records = 0,
+			.failed = ! ok
+	};
+
+	for (uint32_t pid = 0; ! info.failed && pid < AS_PARTITIONS; pid++) {
+		as_partition_reservation rsv;
+		as_partition_reserve(ns, pid, &rsv);
+
+		as_index_reduce_live(rsv.tree, dump_reduce_cb, (void*)&info);
+		as_partition_release(&rsv);
+	}
+
+	ok = ! info.failed;
+
+	// Sets created during the dump are included.
+	ckpt_trailer trailer = {
+			.n_records = info.n_records,
+			.sets_offset = (uint64_t)ftello(file),
+			.n_sets = cf_vmapx_count(ns->p_sets_vmap),
+			.gen = gen,
+			.magic = CKPT_MAGIC
+	};
+
+	for (uint32_t set_id = 1; ok && set_id <= trailer.n_sets; set_id++) {
+		char name[AS_SET_NAME_MAX_SIZE] = { 0 };
+		const char *set_name = as_namespace_get_set_name(ns, (uint16_t)set_id);
+
+		if (set_name) {
+			strncpy(name, set_name, AS_SET_NAME_MAX_SIZE - 1);
+		}
+
+		ok = file_write(file, name, sizeof(name));
+	}
+
+	ok = ok && file_write(file, &trailer, sizeof(trailer)) &&
+			fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+
+	if (! ok || rename(tmp_path, path) != 0) {
+		cf_warning(AS_DRV_SSD, "{%s} failed writing index checkpoint %s: %s",
+				ns->name, path, cf_strerror(errno));
+		unlink(tmp_path);
+		pthread_mutex_unlock(&ckpt->lock);
+		return;
+	}
+
+	ckpt->durable_gen = gen;
+
+	pthread_mutex_unlock(&ckpt->lock);
+
+	cf_info(AS_DRV_SSD, "{%s} wrote index checkpoint %u: %lu records in %lu ms",
+			ns->name, gen, info.n_records, cf_getms() - start_ms);
+}
+
+
+void
+ssd_start_checkpoint_thread(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+
+	if (! ns->storage_index_checkpoint_file || ns->storage_data_in_memory) {
+		return;
+	}
+
+	ssds->ckpt.enabled = true;
+
+	// Period 0 means only checkpoint at shutdown.
+	if (ns->storage_index_checkpoint_period == 0) {
+		return;
+	}
+
+	cf_info(AS_DRV_SSD, "{%s} starting index checkpoint thread", ns->name);
+
+	pthread_t thread;
+	pthread_attr_t attrs;
+
+	pthread_attr_init(&attrs);
+	pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&thread, &attrs, run_checkpoint, (void*)ssds) != 0) {
+		cf_crash(AS_DRV_SSD, "{%s} failed to create index checkpoint thread",
+				ns->name);
+	}
+}
+
+
+//==========================================================
+// Local helpers - writing.
+//
+
+// Release held wblocks no durable checkpoint references any more. Their order
+// was captured in the latest durable checkpoint, so it's preserved.
+static void
+release_held_wblocks(drv_ssds *ssds)
+{
+	uint32_t durable_gen = ssds->ckpt.durable_gen;
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		if (! ssd->held_wblock_q) {
+			continue;
+		}
+
+		held_wblock held;
+
+		// Only this thread pops, and tags only grow towards the tail.
+		while (cf_queue_pop(ssd->held_wblock_q, &held, CF_QUEUE_NOWAIT) ==
+				CF_QUEUE_OK) {
+			if (held.gen >= durable_gen) {
+				cf_queue_push_head(ssd->held_wblock_q, &held);
+				break;
+			}
+
+			cf_queue_push(ssd->free_wblock_q, &held.wblock_id);
+		}
+	}
+}
+
+
+static bool
+write_device(drv_ssd *ssd, FILE *file)
+{
+	ssd_alloc_table *at = ssd->alloc_table;
+	snapshot snap = {
+			.ids = cf_malloc(at->n_wblocks * sizeof(uint32_t)),
+			.n_ids = 0
+	};
+
+	// Block swb_get() and frees while we see what's open and what's free.
+	pthread_rwlock_wrlock(&ssd->free_wblock_lock);
+
+	if (! ssd->held_wblock_q) {
+		ssd->held_wblock_q = cf_queue_create(sizeof(held_wblock), true);
+	}
+
+	for (uint32_t wblock_id = 0; wblock_id < at->n_wblocks; wblock_id++) {
+		if (at->wblock_state[wblock_id].swb) {
+			snap.ids[snap.n_ids++] = wblock_id;
+		}
+	}
+
+	uint32_t n_open = snap.n_ids;
+
+	cf_queue_reduce(ssd->free_wblock_q, snapshot_free_reduce_cb, &snap);
+	cf_queue_reduce(ssd->held_wblock_q, snapshot_held_reduce_cb, &snap);
+
+	pthread_rwlock_unlock(&ssd->free_wblock_lock);
+
+	ckpt_device device = {
+			.file_size = ssd->file_size,
+			.write_block_size = ssd->write_block_size,
+			.n_open = n_open,
+			.n_free = snap.n_ids - n_open
+	};
+
+	strncpy(device.name, ssd->name, CKPT_DEVICE_NAME_SIZE - 1);
+
+	bool ok = file_write(file, &device, sizeof(device)) &&
+			(snap.n_ids == 0 ||
+					file_write(file, snap.ids, snap.n_ids * sizeof(uint32_t)));
+
+	cf_free(snap.ids);
+
+	return ok;
+}
+
+
+static int
+snapshot_free_reduce_cb(void *buf, void *udata)
+{
+	snapshot *snap = (snapshot*)udata;
+
+	snap->ids[snap->n_ids++] = *(uint32_t*)buf;
+
+	return 0;
+}
+
+
+static int
+snapshot_held_reduce_cb(void *buf, void *udata)
+{
+	snapshot *snap = (snapshot*)udata;
+
+	snap->ids[snap->n_ids++] = ((held_wblock*)buf)->wblock_id;
+
+	return 0;
+}
+
+
+static void
+dump_reduce_cb(as_index_ref *r_ref, void *udata)
+{
+	dump_info *info = (dump_info*)udata;
+	as_record *r = r_ref->r;
+
+	if (info->failed || STORAGE_RBLOCK_IS_INVALID(r->rblock_id)) {
+		as_record_done(r_ref, info->ssds->ns);
+		return;
+	}
+
+	drv_ssd *ssd = &info->ssds->ssds[r->file_id];
+	uint32_t wblock_id = RBLOCK_ID_TO_WBLOCK_ID(ssd, r->rblock_id);
+
+	// Replay will read wblocks not yet flushed.
+	if (ssd->alloc_table->wblock_state[wblock_id].swb) {
+		as_record_done(r_ref, info->ssds->ns);
+		return;
+	}
+
+	ckpt_record rec = {
+			.keyd = r->keyd,
+			.last_update_time = r->last_update_time,
+			.generation = r->generation,
+			.file_id = r->file_id,
+			.key_stored = r->key_stored,
+			.rblock_id = r->rblock_id,
+			.n_rblocks = r->n_rblocks,
+			.set_id = as_index_get_set_id(r),
+			.void_time = r->void_time
+	};
+
+	as_record_done(r_ref, info->ssds->ns);
+
+	if (file_write(info->file, &rec, sizeof(rec))) {
+		info->n_records++;
+	}
+	else {
+		info->failed = true;
+	}
+}
+
+
+//==========================================================
+// Local helpers - loading.
+//
+
+// Check devices match the checkpoint and, if keep is set, pick up the wblocks
+// to replay.
+static bool
+read_devices(drv_ssds *ssds, FILE *file, bool keep)
+{
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+		ckpt_device device;
+
+		if (! file_read(file, &device, sizeof(device))) {
+			return false;
+		}
+
+		device.name[CKPT_DEVICE_NAME_SIZE - 1] = '\0';
+
+		if (strcmp(device.name, ssd->name) != 0 ||
+				device.file_size != ssd->file_size ||
+				device.write_block_size != ssd->write_block_size) {
+			return false;
+		}
+
+		uint32_t n_ids = device.n_open + device.n_free;
+
+		if (n_ids > ssd->alloc_table->n_wblocks) {
+			return false;
+		}
+
+		if (! keep) {
+			if (fseeko(file, (off_t)n_ids * sizeof(uint32_t), SEEK_CUR) != 0) {
+				return false;
+			}
+
+			continue;
+		}
+
+		uint32_t *ids = cf_malloc((n_ids + 1) * sizeof(uint32_t));
+
+		if (n_ids != 0 && ! file_read(file, ids, n_ids * sizeof(uint32_t))) {
+			cf_free(ids);
+			return false;
+		}
+
+		for (uint32_t j = 0; j < n_ids; j++) {
+			if (ids[j] >= ssd->alloc_table->n_wblocks) {
+				cf_free(ids);
+				return false;
+			}
+		}
+
+		ssd->replay_wblock_ids = ids;
+		ssd->n_replay_open = device.n_open;
+		ssd->n_replay_free = device.n_free;
+	}
+
+	return true;
+}
+
+
+static void
+load_record(drv_ssds *ssds, const ckpt_record *rec, const char *set_names,
+		uint32_t n_sets, uint64_t dict_mask)
+{
+	as_namespace *ns = ssds->ns;
+	uint32_t pid = as_partition_getid(&rec->keyd);
+
+	// If this isn't a partition we're interested in, skip this record.
+	if (! ssds->get_state_from_storage[pid]) {
+		return;
+	}
+
+	if (rec->file_id >= (uint32_t)ssds->n_ssds) {
+		cf_warning_digest(AS_DRV_SSD, &rec->keyd, "index checkpoint bad file-id - ignoring record ");
+		return;
+	}
+
+	drv_ssd *ssd = &ssds->ssds[rec->file_id];
+	uint32_t wblock_id = RBLOCK_ID_TO_WBLOCK_ID(ssd, rec->rblock_id);
+
+	if (STORAGE_RBLOCK_IS_INVALID(rec->rblock_id) ||
+			wblock_id >= ssd->alloc_table->n_wblocks) {
+		cf_warning_digest(AS_DRV_SSD, &rec->keyd, "index checkpoint bad rblock-id - ignoring record ");
+		return;
+	}
+
+	// As for a device sweep - this may block for a long time, and may update
+	// the cold start threshold void-time.
+	if (! as_cold_start_evict_if_needed(ns)) {
+		cf_crash(AS_DRV_SSD, "hit stop-writes limit before index checkpoint load completed");
+	}
+
+	const char *set_name = rec->set_id != 0 && rec->set_id <= n_sets ?
+			&set_names[(rec->set_id - 1) * AS_SET_NAME_MAX_SIZE] : NULL;
+
+	if (set_name && *set_name == '\0') {
+		set_name = NULL;
+	}
+
+	if (is_expired(ns, rec->void_time, set_name)) {
+		cf_atomic64_incr(&ssd->record_add_expired_counter);
+		return;
+	}
+
+	// Don't bother with reservations - partition trees aren't going anywhere.
+	as_partition *p_partition = &ns->partitions[pid];
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	int rv = as_record_get_create(p_partition->vp, (cf_digest*)&rec->keyd,
+			&r_ref, ns);
+
+	if (rv < 0) {
+		cf_warning_digest(AS_DRV_SSD, &rec->keyd, "index checkpoint as_record_get_create() failed ");
+		return;
+	}
+
+	if (rv != 1) {
+		as_record_done(&r_ref, ns);
+		cf_atomic64_incr(&ssd->record_add_older_counter);
+		return;
+	}
+
+	as_record *r = r_ref.r;
+
+	r->last_update_time = rec->last_update_time;
+	r->generation = rec->generation;
+
+	// Set the record's void-time, truncating it if beyond max-ttl.
+	if (rec->void_time > ns->cold_start_max_void_time) {
+		r->void_time = ns->cold_start_max_void_time;
+		cf_atomic64_incr(&ssd->record_add_max_ttl_counter);
+	}
+	else {
+		r->void_time = rec->void_time;
+	}
+
+	cf_atomic64_setmax(&p_partition->max_void_time, r->void_time);
+
+	if (set_name && as_index_set_set(r, ns, set_name, false) == 0) {
+		as_index_set_index_insert(p_partition->vp, &r_ref);
+	}
+
+	r->key_stored = rec->key_stored;
+
+	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(rec->n_rblocks);
+	ssd_wblock_state *p_wblock_state =
+			&ssd->alloc_table->wblock_state[wblock_id];
+
+	cf_atomic64_add(&ssd->inuse_size, size);
+	cf_atomic32_add(&p_wblock_state->inuse_sz, size);
+	p_wblock_state->dict_mask = dict_mask;
+
+	uint32_t lut_sec = (uint32_t)(rec->last_update_time / 1000);
+
+	if (lut_sec > p_wblock_state->write_time) {
+		p_wblock_state->write_time = lut_sec;
+	}
+
+	r->file_id = rec->file_id;
+	r->rblock_id = rec->rblock_id;
+	r->n_rblocks = rec->n_rblocks;
+
+	as_record_done(&r_ref, ns);
+
+	cf_atomic64_incr(&ssd->record_add_unique_counter);
+}
+
+
+// Same test as for records read from device.
+static bool
+is_expired(as_namespace *ns, uint32_t void_time, const char *set_name)
+{
+	if (void_time == 0 || void_time > ns->cold_start_threshold_void_time) {
+		return false;
+	}
+
+	if (void_time < as_record_void_time_get() || ! set_name) {
+		return true;
+	}
+
+	// If set is not evictable, may have expired but wasn't evicted.
+	as_set *p_set;
+
+	return cf_vmapx_get_by_name(ns->p_sets_vmap, set_name, (void**)&p_set) !=
+			CF_VMAPX_OK || ! IS_SET_EVICTION_DISABLED(p_set);
+}
+
+
+//==========================================================
+// Local helpers - thread.
+//
+
+static void *
+run_checkpoint(void *udata)
+{
+	drv_ssds *ssds = (drv_ssds*)udata;
+	as_namespace *ns = ssds->ns;
+
+	while (true) {
+		sleep(ns->storage_index_checkpoint_period);
+
+		ssd_checkpoint_write(ssds);
+	}
+
+	return NULL;
+}
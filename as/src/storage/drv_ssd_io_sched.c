@@ -0,0 +1,363 @@
+/*
+ * drv_ssd_io_sched.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Device I/O scheduler - keeps defrag, migration and scan reads from pushing up
+ * client read latency.
+ *
+ * Client reads are never delayed - they're only timed. Each background class
+ * has a token bucket, refilled at its weighted share of a per-device budget in
+ * bytes/sec, which is split among classes that have read recently. The budget
+ * adapts AIMD-style to the moving average of client read latency - halved when
+ * over target, raised a step when under. While client latency is over target,
+ * background reads also defer (briefly) to client reads in flight.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+
+#include "fault.h"
+
+#include "base/datamodel.h"
+#include "storage/storage.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define MIN_BUDGET		(8UL * 1024 * 1024) // bytes/sec - background work never stops
+#define MAX_BUDGET		(4UL * 1024 * 1024 * 1024)
+#define BUDGET_STEP		(16UL * 1024 * 1024)
+
+#define ADAPT_INTERVAL_NS	(100UL * 1000 * 1000)
+#define IDLE_NS				(1000UL * 1000 * 1000)
+#define BURST_NS			(100UL * 1000 * 1000) // max tokens saved, as time at rate
+
+#define MAX_SLEEP_US		(10 * 1000)
+#define DEFER_POLL_US		100
+#define MAX_DEFER_NS		(2UL * 1000 * 1000)
+
+// Moving average weight of new client latency samples is 1/8.
+#define LAT_SHIFT	3
+
+// Defrag gets the most - if it falls behind, writes eventually stop.
+static const uint32_t CLASS_WEIGHTS[AS_STORAGE_N_IO_CLASSES] = {
+		[AS_STORAGE_IO_CLIENT]	= 0,
+		[AS_STORAGE_IO_DEFRAG]	= 4,
+		[AS_STORAGE_IO_MIGRATE]	= 2,
+		[AS_STORAGE_IO_SCAN]	= 1
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void refill(ssd_io_sched *sched, uint64_t now);
+static void adapt(ssd_io_sched *sched, uint64_t now);
+static uint64_t class_rate(const ssd_io_sched *sched, as_storage_io_class io_class, uint64_t now);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline bool
+client_lat_over_target(const ssd_io_sched *sched)
+{
+	return (uint64_t)cf_atomic64_get(sched->client_lat_ns) > sched->target_ns;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+void
+ssd_io_sched_init(drv_ssd *ssd)
+{
+	ssd_io_sched *sched = &ssd->io_sched;
+	uint64_t now = cf_getns();
+
+	pthread_mutex_init(&sched->lock, NULL);
+
+	sched->target_ns = (uint64_t)ssd->ns->storage_io_sched_target_us * 1000;
+	sched->budget = MAX_BUDGET; // as if unscheduled until client reads suffer
+	sched->refill_ns = now;
+	sched->adapt_ns = now;
+	sched->adapt_n_client_reads = 0;
+	sched->n_client_in_flight = 0;
+	sched->n_client_reads = 0;
+	sched->client_lat_ns = 0;
+
+	for (uint32_t i = 0; i < AS_STORAGE_N_IO_CLASSES; i++) {
+		ssd_io_class *c = &sched->classes[i];
+
+		c->weight = CLASS_WEIGHTS[i];
+		c->tokens = 0;
+		c->last_ns = 0;
+	}
+}
+
+
+// Called before a background device read - may sleep.
+void
+ssd_io_sched_acquire(drv_ssd *ssd, as_storage_io_class io_class, uint64_t size)
+{
+	ssd_io_sched *sched = &ssd->io_sched;
+
+	if (sched->target_ns == 0 || io_class == AS_STORAGE_IO_CLIENT) {
+		return;
+	}
+
+	uint64_t start_ns = cf_getns();
+	bool waited = false;
+
+	// Client reads go first while they're suffering - but don't defer long, so
+	// background work can't starve.
+	while (client_lat_over_target(sched) &&
+			cf_atomic32_get(sched->n_client_in_flight) != 0 &&
+			cf_getns() - start_ns < MAX_DEFER_NS) {
+		usleep(DEFER_POLL_US);
+		waited = true;
+	}
+
+	ssd_io_class *c = &sched->classes[io_class];
+
+	pthread_mutex_lock(&sched->lock);
+
+	uint64_t now = cf_getns();
+
+	c->last_ns = now;
+	refill(sched, now);
+
+	while (c->tokens <= 0) {
+		uint64_t rate = class_rate(sched, io_class, now);
+		uint64_t sleep_us = ((uint64_t)(-c->tokens) + 1) * 1000000 / rate;
+
+		pthread_mutex_unlock(&sched->lock);
+
+		usleep(sleep_us < MAX_SLEEP_US ? (uint32_t)sleep_us + 1 : MAX_SLEEP_US);
+		waited = true;
+
+		pthread_mutex_lock(&sched->lock);
+
+		now = cf_getns();
+		c->last_ns = now;
+		refill(sched, now);
+	}
+
+	c->tokens -= (int64_t)size;
+
+	pthread_mutex_unlock(&sched->lock);
+
+	if (waited) {
+		as_namespace *ns = ssd->ns;
+
+		cf_atomic64_incr(&ns->n_io_sched_waits[io_class]);
+		cf_atomic64_add(&ns->n_io_sched_wait_us[io_class],
+				(int64_t)((cf_getns() - start_ns) / 1000));
+	}
+}
+
+
+// Called before a client device read - returns 0 if not scheduling.
+uint64_t
+ssd_io_sched_client_start(drv_ssd *ssd)
+{
+	ssd_io_sched *sched = &ssd->io_sched;
+
+	if (sched->target_ns == 0) {
+		return 0;
+	}
+
+	cf_atomic32_incr(&sched->n_client_in_flight);
+
+	return cf_getns();
+}
+
+
+// Called after a client device read, with what ssd_io_sched_client_start()
+// returned.
+void
+ssd_io_sched_client_done(drv_ssd *ssd, uint64_t start_ns)
+{
+	if (start_ns == 0) {
+		return;
+	}
+
+	ssd_io_sched *sched = &ssd->io_sched;
+	int64_t lat_ns = (int64_t)(cf_getns() - start_ns);
+
+	cf_atomic32_decr(&sched->n_client_in_flight);
+	cf_atomic64_incr(&sched->n_client_reads);
+
+	// Racing updates may lose a sample - fine for an average.
+	int64_t avg_ns = cf_atomic64_get(sched->client_lat_ns);
+
+	cf_atomic64_set(&sched->client_lat_ns,
+			avg_ns + ((lat_ns - avg_ns) >> LAT_SHIFT));
+}
+
+
+void
+ssd_io_sched_ticker(drv_ssd *ssd)
+{
+	ssd_io_sched *sched = &ssd->io_sched;
+
+	if (sched->target_ns == 0) {
+		return;
+	}
+
+	uint64_t now = cf_getns();
+
+	pthread_mutex_lock(&sched->lock);
+
+	uint64_t budget = sched->budget;
+	uint64_t rates[AS_STORAGE_N_IO_CLASSES];
+
+	for (uint32_t i = 0; i < AS_STORAGE_N_IO_CLASSES; i++) {
+		rates[i] = i == AS_STORAGE_IO_CLIENT ?
+				0 : class_rate(sched, (as_storage_io_class)i, now);
+	}
+
+	pthread_mutex_unlock(&sched->lock);
+
+	cf_info(AS_DRV_SSD, "{%s} %s: io-sched: client-read-lat-us %lu budget-kbps %lu defrag-kbps %lu migrate-kbps %lu scan-kbps %lu",
+			ssd->ns->name, ssd->name,
+			(uint64_t)cf_atomic64_get(sched->client_lat_ns) / 1000,
+			budget / 1024,
+			rates[AS_STORAGE_IO_DEFRAG] / 1024,
+			rates[AS_STORAGE_IO_MIGRATE] / 1024,
+			rates[AS_STORAGE_IO_SCAN] / 1024);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Called with scheduler locked.
+static void
+refill(ssd_io_sched *sched, uint64_t now)
+{
+	if (now - sched->adapt_ns >= ADAPT_INTERVAL_NS) {
+		adapt(sched, now);
+	}
+
+	uint64_t elapsed_ns = now - sched->refill_ns;
+
+	if (elapsed_ns == 0) {
+		return;
+	}
+
+	if (elapsed_ns > BURST_NS) {
+		elapsed_ns = BURST_NS;
+	}
+
+	sched->refill_ns = now;
+
+	for (uint32_t i = 0; i < AS_STORAGE_N_IO_CLASSES; i++) {
+		if (i == AS_STORAGE_IO_CLIENT) {
+			continue;
+		}
+
+		ssd_io_class *c = &sched->classes[i];
+		uint64_t rate = class_rate(sched, (as_storage_io_class)i, now);
+		int64_t max_tokens = (int64_t)(rate * BURST_NS / 1000000000);
+
+		// Budget * elapsed can't overflow - both are capped.
+		c->tokens += (int64_t)(rate * elapsed_ns / 1000000000);
+
+		if (c->tokens > max_tokens) {
+			c->tokens = max_tokens;
+		}
+	}
+}
+
+
+// Called with scheduler locked.
+static void
+adapt(ssd_io_sched *sched, uint64_t now)
+{
+	sched->adapt_ns = now;
+
+	uint64_t n_client_reads = (uint64_t)cf_atomic64_get(sched->n_client_reads);
+	bool idle = n_client_reads == sched->adapt_n_client_reads;
+
+	sched->adapt_n_client_reads = n_client_reads;
+
+	// No client reads this interval - forget stale latency.
+	if (idle) {
+		cf_atomic64_set(&sched->client_lat_ns, 0);
+	}
+
+	if (! idle && client_lat_over_target(sched)) {
+		sched->budget /= 2;
+
+		if (sched->budget < MIN_BUDGET) {
+			sched->budget = MIN_BUDGET;
+		}
+	}
+	else {
+		sched->budget += BUDGET_STEP;
+
+		if (sched->budget > MAX_BUDGET) {
+			sched->budget = MAX_BUDGET;
+		}
+	}
+}
+
+
+// Called with scheduler locked. A class's share is relative to the classes
+// reading recently, so an idle class's share isn't wasted.
+static uint64_t
+class_rate(const ssd_io_sched *sched, as_storage_io_class io_class,
+		uint64_t now)
+{
+	uint32_t total_weight = 0;
+
+	for (uint32_t i = 0; i < AS_STORAGE_N_IO_CLASSES; i++) {
+		const ssd_io_class *c = &sched->classes[i];
+
+		if (i == (uint32_t)io_class || now - c->last_ns < IDLE_NS) {
+			total_weight += c->weight;
+		}
+	}
+
+	uint64_t rate = sched->budget * sched->classes[io_class].weight /
+			total_weight;
+
+	return rate == 0 ? 1 : rate;
+}
@@ -0,0 +1,444 @@
+/*
+ * record_cache.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/record_cache.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "cf_mutex.h"
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define N_SHARDS 64
+
+// S3-FIFO - new entries go to a small queue holding this fraction of the
+// capacity, and only graduate to the main queue if they're hit there.
+#define SMALL_QUEUE_PCT 10
+
+#define MAX_FREQ 3
+
+// Used only to size hash and ghost tables.
+#define EXPECTED_ENTRY_SIZE 1024
+#define MIN_BUCKETS 256
+
+typedef struct cache_entry_s {
+	struct cache_entry_s* hash_next;
+	struct cache_entry_s* newer;
+	struct cache_entry_s* older;
+	as_record_cache_key key;
+	uint32_t size;
+	uint8_t freq;
+	uint8_t in_main;
+	uint8_t data[];
+} cache_entry;
+
+typedef struct cache_queue_s {
+	cache_entry* head; // newest
+	cache_entry* tail; // oldest
+	uint64_t n_bytes;
+} cache_queue;
+
+typedef struct cache_shard_s {
+	cf_mutex lock;
+	uint64_t max_bytes;
+	uint64_t max_small_bytes;
+
+	cache_entry** buckets;
+	uint32_t bucket_mask;
+
+	cache_queue small;
+	cache_queue main;
+
+	// Ghosts - fingerprints of entries recently evicted from the small queue,
+	// so a quick return goes straight to the main queue. Direct-mapped, so a
+	// collision just forgets a ghost.
+	uint64_t* ghosts;
+	uint32_t ghost_mask;
+} cache_shard;
+
+struct as_record_cache_s {
+	uint64_t max_bytes;
+	cf_atomic64 n_bytes;
+	cache_shard shards[N_SHARDS];
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static cache_entry* find_entry(cache_shard* shard, const cf_digest* keyd, cache_entry*** p_link);
+static void delete_entry(as_record_cache* cache, cache_shard* shard, cache_entry* e);
+static void evict(as_record_cache* cache, cache_shard* shard);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline uint64_t
+fingerprint(const cf_digest* keyd)
+{
+	// Avoid the leading bytes - they pick partition, and bits picking device.
+	return *(uint64_t*)&keyd->digest[12] | 1; // 0 means empty ghost slot
+}
+
+static inline cache_shard*
+get_shard(as_record_cache* cache, uint64_t fp)
+{
+	return &cache->shards[(fp >> 1) % N_SHARDS];
+}
+
+static inline uint32_t
+bucket_ix(const cache_shard* shard, uint64_t fp)
+{
+	return (uint32_t)(fp >> 8) & shard->bucket_mask;
+}
+
+static inline uint32_t
+entry_bytes(const cache_entry* e)
+{
+	return (uint32_t)sizeof(cache_entry) + e->size;
+}
+
+static inline bool
+key_matches(const as_record_cache_key* a, const as_record_cache_key* b)
+{
+	return a->generation == b->generation &&
+			a->last_update_time == b->last_update_time;
+}
+
+static inline void
+queue_push_head(cache_queue* q, cache_entry* e)
+{
+	e->older = q->head;
+	e->newer = NULL;
+
+	if (q->head) {
+		q->head->newer = e;
+	}
+	else {
+		q->tail = e;
+	}
+
+	q->head = e;
+	q->n_bytes += entry_bytes(e);
+}
+
+static inline void
+queue_unlink(cache_queue* q, cache_entry* e)
+{
+	if (e->newer) {
+		e->newer->older = e->older;
+	}
+	else {
+		q->head = e->older;
+	}
+
+	if (e->older) {
+		e->older->newer = e->newer;
+	}
+	else {
+		q->tail = e->newer;
+	}
+
+	q->n_bytes -= entry_bytes(e);
+}
+
+static inline uint32_t
+pow2_at_least(uint64_t n)
+{
+	uint32_t p = MIN_BUCKETS;
+
+	while (p < n && p < (1U << 30)) {
+		p <<= 1;
+	}
+
+	return p;
+}
+
+
+//==========================================================
+// Public API.
+//
+
+as_record_cache*
+as_record_cache_create(uint64_t max_bytes)
+{
+	as_record_cache* cache = cf_malloc(sizeof(as_record_cache));
+
+	cache->max_bytes = max_bytes;
+	cache->n_bytes = 0;
+
+	uint64_t shard_max_bytes = max_bytes / N_SHARDS;
+	uint32_t n_buckets = pow2_at_least(shard_max_bytes / EXPECTED_ENTRY_SIZE);
+
+	for (uint32_t i = 0; i < N_SHARDS; i++) {
+		cache_shard* shard = &cache->shards[i];
+
+		cf_mutex_init(&shard->lock);
+		shard->max_bytes = shard_max_bytes;
+		shard->max_small_bytes = shard_max_bytes * SMALL_QUEUE_PCT / 100;
+
+		shard->buckets = cf_calloc(n_buckets, sizeof(cache_entry*));
+		shard->bucket_mask = n_buckets - 1;
+
+		memset(&shard->small, 0, sizeof(cache_queue));
+		memset(&shard->main, 0, sizeof(cache_queue));
+
+		shard->ghosts = cf_calloc(n_buckets, sizeof(uint64_t));
+		shard->ghost_mask = n_buckets - 1;
+	}
+
+	return cache;
+}
+
+
+void*
+as_record_cache_get(as_record_cache* cache, const as_record_cache_key* key,
+		uint32_t* p_size)
+{
+	uint64_t fp = fingerprint(&key->keyd);
+	cache_shard* shard = get_shard(cache, fp);
+
+	cf_mutex_lock(&shard->lock);
+
+	cache_entry* e = find_entry(shard, &key->keyd, NULL);
+
+	if (! e) {
+		cf_mutex_unlock(&shard->lock);
+		return NULL;
+	}
+
+	if (! key_matches(&e->key, key)) {
+		// Stale - record has been rewritten since.
+		delete_entry(cache, shard, e);
+		cf_mutex_unlock(&shard->lock);
+		return NULL;
+	}
+
+	if (e->freq < MAX_FREQ) {
+		e->freq++;
+	}
+
+	void* buf = cf_malloc(e->size);
+
+	memcpy(buf, e->data, e->size);
+	*p_size = e->size;
+
+	cf_mutex_unlock(&shard->lock);
+
+	return buf;
+}
+
+
+bool
+as_record_cache_contains(as_record_cache* cache, const as_record_cache_key* key)
+{
+	uint64_t fp = fingerprint(&key->keyd);
+	cache_shard* shard = get_shard(cache, fp);
+
+	cf_mutex_lock(&shard->lock);
+
+	cache_entry* e = find_entry(shard, &key->keyd, NULL);
+	bool found = e && key_matches(&e->key, key);
+
+	cf_mutex_unlock(&shard->lock);
+
+	return found;
+}
+
+
+void
+as_record_cache_put(as_record_cache* cache, const as_record_cache_key* key,
+		const void* buf, uint32_t size)
+{
+	uint64_t fp = fingerprint(&key->keyd);
+	cache_shard* shard = get_shard(cache, fp);
+
+	// Don't let one record churn a big fraction of a shard.
+	if (sizeof(cache_entry) + size > shard->max_small_bytes) {
+		return;
+	}
+
+	cache_entry* e = cf_malloc(sizeof(cache_entry) + size);
+
+	e->key = *key;
+	e->size = size;
+	e->freq = 0;
+	memcpy(e->data, buf, size);
+
+	cf_mutex_lock(&shard->lock);
+
+	cache_entry* existing = find_entry(shard, &key->keyd, NULL);
+
+	if (existing) {
+		delete_entry(cache, shard, existing);
+	}
+
+	uint64_t* p_ghost = &shard->ghosts[bucket_ix(shard, fp) &
+			shard->ghost_mask];
+
+	// Recently evicted from the small queue - give it a place in main.
+	if (*p_ghost == fp) {
+		*p_ghost = 0;
+		e->in_main = 1;
+		queue_push_head(&shard->main, e);
+	}
+	else {
+		e->in_main = 0;
+		queue_push_head(&shard->small, e);
+	}
+
+	cache_entry** p_bucket = &shard->buckets[bucket_ix(shard, fp)];
+
+	e->hash_next = *p_bucket;
+	*p_bucket = e;
+
+	cf_atomic64_add(&cache->n_bytes, entry_bytes(e));
+
+	evict(cache, shard);
+
+	cf_mutex_unlock(&shard->lock);
+}
+
+
+void
+as_record_cache_remove(as_record_cache* cache, const cf_digest* keyd)
+{
+	uint64_t fp = fingerprint(keyd);
+	cache_shard* shard = get_shard(cache, fp);
+
+	cf_mutex_lock(&shard->lock);
+
+	cache_entry* e = find_entry(shard, keyd, NULL);
+
+	if (e) {
+		delete_entry(cache, shard, e);
+	}
+
+	cf_mutex_unlock(&shard->lock);
+}
+
+
+uint64_t
+as_record_cache_bytes(const as_record_cache* cache)
+{
+	return cf_atomic64_get(cache->n_bytes);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static cache_entry*
+find_entry(cache_shard* shard, const cf_digest* keyd, cache_entry*** p_link)
+{
+	cache_entry** link =
+			&shard->buckets[bucket_ix(shard, fingerprint(keyd))];
+
+	while (*link) {
+		cache_entry* e = *link;
+
+		if (cf_digest_compare(&e->key.keyd, keyd) == 0) {
+			if (p_link) {
+				*p_link = link;
+			}
+
+			return e;
+		}
+
+		link = &e->hash_next;
+	}
+
+	return NULL;
+}
+
+
+static void
+delete_entry(as_record_cache* cache, cache_shard* shard, cache_entry* e)
+{
+	cache_entry** link;
+
+	find_entry(shard, &e->key.keyd, &link);
+	*link = e->hash_next;
+
+	queue_unlink(e->in_main ? &shard->main : &shard->small, e);
+	cf_atomic64_sub(&cache->n_bytes, entry_bytes(e));
+
+	cf_free(e);
+}
+
+
+static void
+evict(as_record_cache* cache, cache_shard* shard)
+{
+	while (shard->small.n_bytes + shard->main.n_bytes > shard->max_bytes) {
+		if (shard->small.tail && (shard->small.n_bytes >
+				shard->max_small_bytes || ! shard->main.tail)) {
+			cache_entry* e = shard->small.tail;
+
+			if (e->freq != 0) {
+				// Hit while on probation - promote.
+				queue_unlink(&shard->small, e);
+				e->freq = 0;
+				e->in_main = 1;
+				queue_push_head(&shard->main, e);
+				continue;
+			}
+
+			uint64_t fp = fingerprint(&e->key.keyd);
+
+			shard->ghosts[bucket_ix(shard, fp) & shard->ghost_mask] = fp;
+			delete_entry(cache, shard, e);
+			continue;
+		}
+
+		cache_entry* e = shard->main.tail;
+
+		if (e->freq != 0) {
+			// Second chance, CLOCK-style.
+			queue_unlink(&shard->main, e);
+			e->freq--;
+			queue_push_head(&shard->main, e);
+			continue;
+		}
+
+		delete_entry(cache, shard, e);
+	}
+}
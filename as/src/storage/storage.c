@@ -175,6 +175,7 @@ as_storage_record_create(as_namespace *ns, as_record *r, as_storage_rd *rd)
 	rd->key_size = 0;
 	rd->key = NULL;
 	rd->is_durable_delete = false;
+	rd->io_class = AS_STORAGE_IO_CLIENT;
 
 	if (as_storage_record_create_table[ns->storage_type]) {
 		return as_storage_record_create_table[ns->storage_type](rd);
@@ -206,6 +207,7 @@ as_storage_record_open(as_namespace *ns, as_record *r, as_storage_rd *rd)
 	rd->key_size = 0;
 	rd->key = NULL;
 	rd->is_durable_delete = false;
+	rd->io_class = AS_STORAGE_IO_CLIENT;
 
 	if (as_storage_record_open_table[ns->storage_type]) {
 		return as_storage_record_open_table[ns->storage_type](rd);
@@ -653,6 +655,62 @@ as_storage_record_set_rec_props(as_storage_rd *rd, uint8_t* rec_props_data)
 	}
 }
 
+bool
+as_storage_record_read_async(as_storage_rd *rd, as_storage_read_done_fn cb,
+		void *udata)
+{
+	if (rd->ns->storage_type != AS_STORAGE_ENGINE_SSD ||
+			rd->ns->storage_data_in_memory) {
+		return false;
+	}
+
+	if (rd->block || ! rd->record_on_device || rd->ignore_record_on_device) {
+		return false;
+	}
+
+	return as_storage_record_read_async_ssd(rd, cb, udata);
+}
+
+void
+as_storage_record_adopt_read(as_storage_rd *rd, struct ssd_read_req_s *req)
+{
+	as_storage_record_adopt_read_ssd(rd, req);
+}
+
+void
+as_storage_read_discard(struct ssd_read_req_s *req)
+{
+	as_storage_read_discard_ssd(req);
+}
+
+bool
+as_storage_has_device_sweep(as_namespace *ns)
+{
+	return ns->storage_type == AS_STORAGE_ENGINE_SSD &&
+			! ns->storage_data_in_memory;
+}
+
+struct as_storage_sweep_s *
+as_storage_device_sweep_start(as_namespace *ns,
+		struct as_index_tree_s *const *trees, uint32_t n_slices)
+{
+	return as_storage_device_sweep_start_ssd(ns, trees, n_slices);
+}
+
+void
+as_storage_device_sweep(struct as_storage_sweep_s *sweep, uint32_t slice,
+		as_storage_sweep_fn cb, void *udata)
+{
+	as_storage_device_sweep_ssd(sweep, slice, cb, udata);
+}
+
+void
+as_storage_device_sweep_end(struct as_storage_sweep_s *sweep,
+		as_storage_sweep_fn cb, void *udata)
+{
+	as_storage_device_sweep_end_ssd(sweep, cb, udata);
+}
+
 void
 as_storage_shutdown(void)
 {
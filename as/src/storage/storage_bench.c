@@ -0,0 +1,749 @@
+/*
+ * storage_bench.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Standalone storage engine benchmark - built from the server's objects (minus
+ * as.c), but starts only what a namespace's storage needs. Threads write and
+ * read single-bin records directly through the storage API, against the devices
+ * (typically regular files) of a storage-engine device namespace. No network,
+ * no cluster, no transaction layer.
+ *
+ * Build with 'make storage-bench', run from the source tree after 'make init':
+ *
+ *   asd-storage-bench --config-file as/etc/aerospike_bench.conf ...
+ *
+ * Defrag pressure is set by the live fraction of the devices - the key count
+ * and record sizes against the configured filesize - and by defrag-lwm-pct.
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "aerospike/as_bytes.h"
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+#include "citrusleaf/cf_digest.h"
+#include "citrusleaf/cf_random.h"
+
+#include "fault.h"
+#include "hardware.h"
+#include "hist.h"
+
+#include "base/cfg.h"
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "base/json_init.h"
+#include "base/system_metadata.h"
+#include "base/thr_info.h"
+#include "fabric/partition.h"
+#include "storage/storage.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef enum {
+	SIZE_DIST_FIXED,
+	SIZE_DIST_UNIFORM,
+	SIZE_DIST_LOG // log-uniform - most records small, a long tail of big ones
+} size_dist;
+
+typedef struct bench_cfg_s {
+	const char *config_file;
+	const char *ns_name;
+	uint32_t n_threads;
+	uint32_t duration_sec;
+	uint32_t report_sec;
+	uint64_t n_keys;
+	uint32_t read_pct;
+	size_dist dist;
+	uint32_t min_size;
+	uint32_t max_size;
+	int32_t defrag_lwm_pct; // < 0 means as configured
+	bool skip_load;
+} bench_cfg;
+
+typedef struct bench_stats_s {
+	cf_atomic64 n_writes;
+	cf_atomic64 n_write_fails;
+	cf_atomic64 n_write_data_bytes;
+	cf_atomic64 n_reads;
+	cf_atomic64 n_read_misses;
+	cf_atomic64 n_read_fails;
+} bench_stats;
+
+// Snapshot taken at each report, to compute rates.
+typedef struct bench_snap_s {
+	uint64_t now_ms;
+	uint64_t n_writes;
+	uint64_t n_reads;
+	uint64_t n_device_write_bytes;
+	uint64_t n_defrag_write_bytes;
+} bench_snap;
+
+#define BIN_NAME "b"
+
+// Bin data - the write-block-size caps the record size anyway.
+#define MAX_DATA_SIZE (8 * 1024 * 1024)
+
+static const struct option CMD_OPTS[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "config-file", required_argument, NULL, 'f' },
+		{ "namespace", required_argument, NULL, 'n' },
+		{ "threads", required_argument, NULL, 't' },
+		{ "duration", required_argument, NULL, 'd' },
+		{ "report-interval", required_argument, NULL, 'i' },
+		{ "keys", required_argument, NULL, 'k' },
+		{ "read-pct", required_argument, NULL, 'r' },
+		{ "size-dist", required_argument, NULL, 's' },
+		{ "min-size", required_argument, NULL, 'm' },
+		{ "max-size", required_argument, NULL, 'M' },
+		{ "defrag-lwm-pct", required_argument, NULL, 'l' },
+		{ "skip-load", no_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 }
+};
+
+static const char USAGE[] =
+		"\n"
+		"asd-storage-bench options:\n"
+		"\n"
+		"--config-file <file>      server config file (default as/etc/aerospike_bench.conf)\n"
+		"--namespace <name>        storage-engine device namespace (default first)\n"
+		"--threads <n>             benchmark threads (default 8)\n"
+		"--duration <sec>          length of read/write phase (default 60)\n"
+		"--report-interval <sec>   seconds between progress reports (default 5)\n"
+		"--keys <n>                key space size (default 1000000)\n"
+		"--read-pct <0-100>        percent of read/write phase ops that are reads (default 50)\n"
+		"--size-dist <dist>        record data sizes - fixed, uniform or log (default fixed)\n"
+		"--min-size <bytes>        smallest (or fixed) record data size (default 1024)\n"
+		"--max-size <bytes>        largest record data size (default 1024)\n"
+		"--defrag-lwm-pct <pct>    override namespace defrag-lwm-pct\n"
+		"--skip-load               don't write all keys before read/write phase\n"
+		;
+
+static const char DEFAULT_CONFIG_FILE[] = "as/etc/aerospike_bench.conf";
+
+static const char SMD_DIR_NAME[] = "/smd";
+
+
+//==========================================================
+// Globals.
+//
+
+// Needed by server objects - normally defined in as.c.
+pthread_mutex_t g_main_deadlock = PTHREAD_MUTEX_INITIALIZER;
+bool g_startup_complete = false;
+bool g_shutdown_started = false;
+
+static bench_cfg g_bench = {
+		.config_file = DEFAULT_CONFIG_FILE,
+		.ns_name = NULL,
+		.n_threads = 8,
+		.duration_sec = 60,
+		.report_sec = 5,
+		.n_keys = 1000000,
+		.read_pct = 50,
+		.dist = SIZE_DIST_FIXED,
+		.min_size = 1024,
+		.max_size = 1024,
+		.defrag_lwm_pct = -1,
+		.skip_load = false
+};
+
+static as_namespace *g_ns;
+static bench_stats g_bench_stats;
+
+static histogram *g_write_hist;
+static histogram *g_read_hist;
+
+static cf_atomic64 g_next_load_key;
+static cf_atomic32 g_n_running;
+static volatile bool g_loading;
+static volatile bool g_stop;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static bool parse_args(int argc, char **argv);
+static void make_smd_directory(const char *work_dir);
+static as_namespace *find_namespace();
+static void run_phase(const char *label, bool loading);
+static void *run_bench(void *udata);
+static void bench_write(uint64_t key, const uint8_t *data, uint32_t size, uint8_t *particle_buf);
+static void bench_read(uint64_t key);
+static uint32_t pick_size();
+static void take_snap(bench_snap *snap);
+static void report(const char *label, const bench_snap *prev, const bench_snap *now);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline as_index_tree *
+key_tree(uint64_t key, cf_digest *keyd)
+{
+	cf_digest_compute(&key, sizeof(key), keyd);
+
+	return g_ns->partitions[as_partition_getid(keyd)].vp;
+}
+
+static inline double
+per_sec(uint64_t count, uint64_t ms)
+{
+	return ms == 0 ? 0.0 : (double)count * 1000.0 / (double)ms;
+}
+
+
+//==========================================================
+// Storage benchmark entry point.
+//
+
+int
+main(int argc, char **argv)
+{
+	g_start_ms = cf_getms();
+
+	cf_alloc_init();
+	cf_fault_init();
+
+	if (! parse_args(argc, argv)) {
+		// fprintf() since we don't want cf_fault's prefix.
+		fprintf(stderr, "%s\n", USAGE);
+		return 1;
+	}
+
+	as_config *c = as_config_init(g_bench.config_file);
+
+	cf_topo_config(c->auto_pin, 0, &c->service.bind);
+
+	if (cf_fault_sink_activate_all_held() != 0) {
+		cf_crash_nostack(AS_AS, "can't open log sink(s)");
+	}
+
+	as_config_post_process(c, g_bench.config_file);
+
+	make_smd_directory(c->work_directory);
+
+	g_ns = find_namespace();
+
+	if (g_bench.defrag_lwm_pct >= 0) {
+		g_ns->storage_defrag_lwm_pct = (uint32_t)g_bench.defrag_lwm_pct;
+	}
+
+	// Same order as the server - see as.c.
+	as_json_init();
+	as_smd_init();
+	as_index_tree_gc_init();
+	as_namespaces_init(true, 0);
+	as_storage_init();
+	as_storage_wait_for_defrag();
+
+	char hist_name[HISTOGRAM_NAME_SIZE];
+
+	sprintf(hist_name, "{%s}-bench-write", g_ns->name);
+	g_write_hist = histogram_create(hist_name, HIST_MICROSECONDS);
+
+	sprintf(hist_name, "{%s}-bench-read", g_ns->name);
+	g_read_hist = histogram_create(hist_name, HIST_MICROSECONDS);
+
+	cf_info(AS_AS, "{%s} storage bench: threads %u keys %lu read-pct %u sizes %u-%u defrag-lwm-pct %u",
+			g_ns->name, g_bench.n_threads, g_bench.n_keys, g_bench.read_pct,
+			g_bench.min_size, g_bench.max_size, g_ns->storage_defrag_lwm_pct);
+
+	if (! g_bench.skip_load) {
+		run_phase("load", true);
+	}
+
+	run_phase("read-write", false);
+
+	// Exit without shutting storage down - it's a benchmark, not a database.
+	return 0;
+}
+
+
+//==========================================================
+// Local helpers - setup.
+//
+
+static bool
+parse_args(int argc, char **argv)
+{
+	int opt;
+	int opt_i;
+
+	while ((opt = getopt_long(argc, argv, "", CMD_OPTS, &opt_i)) != -1) {
+		switch (opt) {
+		case 'h':
+			return false;
+		case 'f':
+			g_bench.config_file = optarg;
+			break;
+		case 'n':
+			g_bench.ns_name = optarg;
+			break;
+		case 't':
+			g_bench.n_threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_bench.duration_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			g_bench.report_sec = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			g_bench.n_keys = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			g_bench.read_pct = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			if (strcmp(optarg, "fixed") == 0) {
+				g_bench.dist = SIZE_DIST_FIXED;
+			}
+			else if (strcmp(optarg, "uniform") == 0) {
+				g_bench.dist = SIZE_DIST_UNIFORM;
+			}
+			else if (strcmp(optarg, "log") == 0) {
+				g_bench.dist = SIZE_DIST_LOG;
+			}
+			else {
+				return false;
+			}
+			break;
+		case 'm':
+			g_bench.min_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			g_bench.max_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			g_bench.defrag_lwm_pct = (int32_t)strtol(optarg, NULL, 0);
+			break;
+		case 'S':
+			g_bench.skip_load = true;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	if (g_bench.dist == SIZE_DIST_FIXED ||
+			g_bench.max_size < g_bench.min_size) {
+		g_bench.max_size = g_bench.min_size;
+	}
+
+	return g_bench.n_threads != 0 && g_bench.report_sec != 0 &&
+			g_bench.n_keys != 0 && g_bench.read_pct <= 100 &&
+			g_bench.min_size != 0 && g_bench.max_size <= MAX_DATA_SIZE &&
+			g_bench.defrag_lwm_pct <= 99;
+}
+
+
+static void
+make_smd_directory(const char *work_dir)
+{
+	size_t len = strlen(work_dir);
+	char smd_path[len + sizeof(SMD_DIR_NAME)];
+
+	strcpy(smd_path, work_dir);
+	strcpy(smd_path + len, SMD_DIR_NAME);
+
+	if (mkdir(smd_path, 0755) != 0 && errno != EEXIST) {
+		cf_crash_nostack(AS_AS, "can't create %s: %s", smd_path,
+				cf_strerror(errno));
+	}
+}
+
+
+static as_namespace *
+find_namespace()
+{
+	as_namespace *ns = g_bench.ns_name ?
+			as_namespace_get_byname((char *)g_bench.ns_name) :
+			g_config.namespaces[0];
+
+	if (! ns) {
+		cf_crash_nostack(AS_AS, "namespace %s not configured", g_bench.ns_name);
+	}
+
+	if (ns->storage_type != AS_STORAGE_ENGINE_SSD) {
+		cf_crash_nostack(AS_AS, "{%s} must be storage-engine device", ns->name);
+	}
+
+	if (ns->storage_data_in_memory) {
+		cf_warning(AS_AS, "{%s} data-in-memory - reads won't touch devices",
+				ns->name);
+	}
+
+	return ns;
+}
+
+
+//==========================================================
+// Local helpers - benchmark phases.
+//
+
+static void
+run_phase(const char *label, bool loading)
+{
+	memset(&g_bench_stats, 0, sizeof(g_bench_stats));
+	histogram_clear(g_write_hist);
+	histogram_clear(g_read_hist);
+
+	g_loading = loading;
+	g_stop = false;
+	g_next_load_key = 0;
+
+	bench_snap start;
+	bench_snap prev;
+
+	take_snap(&start);
+	prev = start;
+
+	pthread_t threads[g_bench.n_threads];
+
+	g_n_running = (int32_t)g_bench.n_threads;
+
+	for (uint32_t i = 0; i < g_bench.n_threads; i++) {
+		if (pthread_create(&threads[i], NULL, run_bench, NULL) != 0) {
+			cf_crash(AS_AS, "failed to create bench thread");
+		}
+	}
+
+	uint64_t end_ms = start.now_ms + (uint64_t)g_bench.duration_sec * 1000;
+	uint64_t next_report_ms = start.now_ms + (uint64_t)g_bench.report_sec * 1000;
+
+	// Loading ends when all keys are written, otherwise when time's up.
+	while (cf_atomic32_get(g_n_running) != 0) {
+		usleep(100 * 1000);
+
+		uint64_t now_ms = cf_getms();
+
+		if (! loading && now_ms >= end_ms) {
+			g_stop = true;
+		}
+
+		if (now_ms >= next_report_ms) {
+			bench_snap now;
+
+			take_snap(&now);
+			report(label, &prev, &now);
+
+			prev = now;
+			next_report_ms += (uint64_t)g_bench.report_sec * 1000;
+		}
+	}
+
+	for (uint32_t i = 0; i < g_bench.n_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	bench_snap end;
+
+	take_snap(&end);
+
+	uint64_t data_bytes = cf_atomic64_get(g_bench_stats.n_write_data_bytes);
+	uint64_t device_bytes =
+			(end.n_device_write_bytes - start.n_device_write_bytes) +
+			(end.n_defrag_write_bytes - start.n_defrag_write_bytes);
+
+	// Unlike write-amp, also counts record overhead and partial wblocks.
+	cf_info(AS_AS, "{%s} bench %s done: write-fails %lu read-misses %lu read-fails %lu data-bytes %lu device-bytes-per-data-byte %.2f",
+			g_ns->name, label, cf_atomic64_get(g_bench_stats.n_write_fails),
+			cf_atomic64_get(g_bench_stats.n_read_misses),
+			cf_atomic64_get(g_bench_stats.n_read_fails), data_bytes,
+			data_bytes == 0 ? 0.0 : (double)device_bytes / (double)data_bytes);
+
+	report(label, &start, &end);
+
+	histogram_dump(g_write_hist);
+
+	if (! loading) {
+		histogram_dump(g_read_hist);
+	}
+}
+
+
+static void *
+run_bench(void *udata)
+{
+	// Random contents, so a compressing namespace doesn't flatter itself.
+	uint8_t *data = cf_malloc(g_bench.max_size);
+
+	for (uint32_t i = 0; i < g_bench.max_size; i++) {
+		data[i] = (uint8_t)cf_get_rand32();
+	}
+
+	as_bytes max_val;
+
+	as_bytes_init_wrap(&max_val, data, g_bench.max_size, false);
+
+	uint8_t *particle_buf =
+			cf_malloc(as_particle_size_from_asval((as_val *)&max_val));
+
+	while (! g_stop) {
+		if (g_loading) {
+			uint64_t key = (uint64_t)cf_atomic64_incr(&g_next_load_key) - 1;
+
+			if (key >= g_bench.n_keys) {
+				break;
+			}
+
+			bench_write(key, data, pick_size(), particle_buf);
+			continue;
+		}
+
+		uint64_t key = cf_get_rand64() % g_bench.n_keys;
+
+		if (cf_get_rand32() % 100 < g_bench.read_pct) {
+			bench_read(key);
+		}
+		else {
+			bench_write(key, data, pick_size(), particle_buf);
+		}
+	}
+
+	cf_free(particle_buf);
+	cf_free(data);
+
+	cf_atomic32_decr(&g_n_running);
+
+	return NULL;
+}
+
+
+// Like a client write replacing the whole record, minus the transaction layer.
+static void
+bench_write(uint64_t key, const uint8_t *data, uint32_t size,
+		uint8_t *particle_buf)
+{
+	as_namespace *ns = g_ns;
+	cf_digest keyd;
+	as_index_tree *tree = key_tree(key, &keyd);
+
+	uint64_t start_ns = cf_getns();
+
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	int rv = as_record_get_create(tree, &keyd, &r_ref, ns);
+
+	if (rv < 0) {
+		cf_atomic64_incr(&g_bench_stats.n_write_fails);
+		return;
+	}
+
+	bool is_create = rv == 1;
+	as_record *r = r_ref.r;
+	as_storage_rd rd;
+
+	if (is_create) {
+		as_storage_record_create(ns, r, &rd);
+	}
+	else {
+		as_storage_record_open(ns, r, &rd);
+	}
+
+	as_bytes val;
+
+	as_bytes_init_wrap(&val, (uint8_t *)data, size, false);
+
+	as_bin bin;
+
+	as_bin_init(ns, &bin, BIN_NAME);
+	as_bin_particle_stack_from_asval(&bin, particle_buf, (as_val *)&val);
+
+	rd.bins = &bin;
+	rd.n_bins = 1;
+
+	uint32_t old_void_time = r->void_time;
+	uint64_t old_last_update_time = r->last_update_time;
+	uint16_t old_generation = r->generation;
+	uint64_t now = cf_clepoch_milliseconds();
+
+	r->void_time = 0;
+
+	if (r->last_update_time < now) {
+		r->last_update_time = now;
+	}
+
+	// The generation might wrap - 0 is reserved as "uninitialized".
+	if (++r->generation == 0) {
+		r->generation = 1;
+	}
+
+	if (as_storage_record_write(&rd) < 0) {
+		r->void_time = old_void_time;
+		r->last_update_time = old_last_update_time;
+		r->generation = old_generation;
+
+		if (is_create) {
+			as_index_delete(tree, &keyd);
+		}
+
+		as_storage_record_close(&rd);
+		as_record_done(&r_ref, ns);
+
+		cf_atomic64_incr(&g_bench_stats.n_write_fails);
+		return;
+	}
+
+	as_storage_record_close(&rd);
+	as_record_done(&r_ref, ns);
+
+	histogram_insert_data_point(g_write_hist, start_ns);
+	cf_atomic64_incr(&g_bench_stats.n_writes);
+	cf_atomic64_add(&g_bench_stats.n_write_data_bytes, size);
+}
+
+
+// Like a client read of all bins - goes through ssd_read_record().
+static void
+bench_read(uint64_t key)
+{
+	as_namespace *ns = g_ns;
+	cf_digest keyd;
+	as_index_tree *tree = key_tree(key, &keyd);
+
+	uint64_t start_ns = cf_getns();
+
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	if (as_record_get(tree, &keyd, &r_ref) != 0) {
+		cf_atomic64_incr(&g_bench_stats.n_read_misses);
+		return;
+	}
+
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r_ref.r, &rd);
+
+	int result = as_storage_rd_load_n_bins(&rd); // sets rd.n_bins
+
+	if (result == 0) {
+		as_bin stack_bins[ns->storage_data_in_memory ? 0 : rd.n_bins];
+
+		result = as_storage_rd_load_bins(&rd, stack_bins);
+	}
+
+	as_storage_record_close(&rd);
+	as_record_done(&r_ref, ns);
+
+	if (result < 0) {
+		cf_atomic64_incr(&g_bench_stats.n_read_fails);
+		return;
+	}
+
+	histogram_insert_data_point(g_read_hist, start_ns);
+	cf_atomic64_incr(&g_bench_stats.n_reads);
+}
+
+
+static uint32_t
+pick_size()
+{
+	uint32_t min = g_bench.min_size;
+	uint32_t max = g_bench.max_size;
+
+	switch (g_bench.dist) {
+	case SIZE_DIST_UNIFORM:
+		return min + cf_get_rand32() % (max - min + 1);
+	case SIZE_DIST_LOG: {
+		double u = (double)cf_get_rand32() / (double)UINT32_MAX;
+		uint32_t size = (uint32_t)((double)min *
+				exp(u * log((double)max / (double)min)));
+
+		return size > max ? max : size;
+	}
+	case SIZE_DIST_FIXED:
+	default:
+		return min;
+	}
+}
+
+
+//==========================================================
+// Local helpers - reporting.
+//
+
+static void
+take_snap(bench_snap *snap)
+{
+	snap->now_ms = cf_getms();
+	snap->n_writes = cf_atomic64_get(g_bench_stats.n_writes);
+	snap->n_reads = cf_atomic64_get(g_bench_stats.n_reads);
+
+	// The ticker isn't running, so these only ever go up.
+	snap->n_device_write_bytes = cf_atomic64_get(g_ns->n_device_write_bytes);
+	snap->n_defrag_write_bytes = cf_atomic64_get(g_ns->n_defrag_write_bytes);
+}
+
+
+static void
+report(const char *label, const bench_snap *prev, const bench_snap *now)
+{
+	uint64_t ms = now->now_ms - prev->now_ms;
+	uint64_t write_bytes = now->n_device_write_bytes -
+			prev->n_device_write_bytes;
+	uint64_t defrag_write_bytes = now->n_defrag_write_bytes -
+			prev->n_defrag_write_bytes;
+
+	// Same definition as the ticker's - device bytes per byte not rewritten by
+	// defrag.
+	double write_amp = write_bytes == 0 ? 1.0 :
+			(double)(write_bytes + defrag_write_bytes) / (double)write_bytes;
+
+	int available_pct;
+	uint64_t inuse_disk_bytes;
+
+	as_storage_stats(g_ns, &available_pct, &inuse_disk_bytes);
+
+	cf_info(AS_AS, "{%s} bench %s: secs %.1f writes-per-sec %.0f reads-per-sec %.0f device-write-kbps %.0f defrag-write-kbps %.0f write-amp %.2f used-bytes %lu avail-pct %d",
+			g_ns->name, label, (double)ms / 1000.0,
+			per_sec(now->n_writes - prev->n_writes, ms),
+			per_sec(now->n_reads - prev->n_reads, ms),
+			per_sec(write_bytes, ms) / 1024.0,
+			per_sec(defrag_write_bytes, ms) / 1024.0,
+			write_amp, inuse_disk_bytes, available_pct);
+}
@@ -420,16 +420,11 @@ proxyer_handle_client_response(msg* m, proxy_request* pr)
 		return AS_PROTO_RESULT_FAIL_UNKNOWN;
 	}
 
-	as_file_handle* fd_h = pr->from.proto_fd_h;
-
-	if (cf_socket_send_all(&fd_h->sock, proto, proto_sz, MSG_NOSIGNAL,
-			CF_SOCKET_TIMEOUT) < 0) {
-		// Common when a client aborts.
-		as_end_of_transaction_force_close(fd_h);
+	// May be a reply to a pipelined request - send like a local reply.
+	if (as_msg_send_reply_buf(pr->from.proto_fd_h, proto, proto_sz) != 0) {
 		return AS_PROTO_RESULT_FAIL_UNKNOWN;
 	}
 
-	as_end_of_transaction_ok(fd_h);
 	return AS_PROTO_RESULT_OK;
 }
 
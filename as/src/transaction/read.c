@@ -64,7 +64,11 @@ void send_read_response(as_transaction* tr, as_msg_op** ops,
 		as_bin** response_bins, uint16_t n_bins, cf_dyn_buf* db);
 void read_timeout_cb(rw_request* rw);
 
-transaction_status read_local(as_transaction* tr);
+transaction_status read_local(as_transaction* tr, bool may_go_async);
+bool read_local_go_async(as_transaction* tr, as_storage_rd* rd);
+void read_local_async_cb(struct ssd_read_req_s* req, void* udata);
+transaction_status read_local_continue(as_transaction* tr,
+		as_index_ref* r_ref, as_storage_rd* rd);
 void read_local_done(as_transaction* tr, as_index_ref* r_ref, as_storage_rd* rd,
 		int result_code);
 
@@ -132,7 +136,7 @@ as_read_start(as_transaction* tr)
 	if (! read_must_duplicate_resolve(tr)) {
 		// No duplicates to resolve, or not configured to duplicate resolve.
 		// Just read local copy - response sent to origin no matter what.
-		return read_local(tr);
+		return read_local(tr, true);
 	}
 	// else - there are duplicates, and we're configured to resolve them.
 
@@ -195,7 +199,7 @@ read_dup_res_cb(rw_request* rw)
 	}
 
 	// Read the local copy and respond to origin.
-	read_local(&tr);
+	read_local(&tr, false);
 
 	// Finished transaction - rw_request cleans up reservation and msgp!
 	return true;
@@ -296,9 +300,8 @@ read_timeout_cb(rw_request* rw)
 //
 
 transaction_status
-read_local(as_transaction* tr)
+read_local(as_transaction* tr, bool may_go_async)
 {
-	as_msg* m = &tr->msgp->msg;
 	as_namespace* ns = tr->rsv.ns;
 
 	as_index_ref r_ref;
@@ -321,11 +324,91 @@ read_local(as_transaction* tr)
 
 	as_storage_record_open(ns, r, &rd);
 
+	if (may_go_async && read_local_go_async(tr, &rd)) {
+		as_storage_record_close(&rd);
+		as_record_done(&r_ref, ns);
+
+		// Device read in flight - completion callback owns msgp & reservation.
+		return TRANS_IN_PROGRESS;
+	}
+
+	return read_local_continue(tr, &r_ref, &rd);
+}
+
+
+bool
+read_local_go_async(as_transaction* tr, as_storage_rd* rd)
+{
+	if (rd->ns->storage_read_engine != AS_STORAGE_READ_ENGINE_IO_URING ||
+			(tr->msgp->msg.info1 & AS_MSG_INFO1_GET_NO_BINS) != 0) {
+		return false;
+	}
+
+	as_transaction* async_tr = cf_malloc(sizeof(as_transaction));
+
+	*async_tr = *tr;
+
+	if (! as_storage_record_read_async(rd, read_local_async_cb, async_tr)) {
+		cf_free(async_tr);
+		return false;
+	}
+
+	return true;
+}
+
+
+void
+read_local_async_cb(struct ssd_read_req_s* req, void* udata)
+{
+	as_transaction* tr = (as_transaction*)udata;
+	as_namespace* ns = tr->rsv.ns;
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	if (as_record_get_live(tr->rsv.tree, &tr->keyd, &r_ref, ns) != 0) {
+		as_storage_read_discard(req);
+		read_local_done(tr, NULL, NULL, AS_PROTO_RESULT_FAIL_NOT_FOUND);
+	}
+	else if (as_record_is_doomed(r_ref.r, ns)) {
+		as_storage_read_discard(req);
+		read_local_done(tr, &r_ref, NULL, AS_PROTO_RESULT_FAIL_NOT_FOUND);
+	}
+	else {
+		as_storage_rd rd;
+
+		as_storage_record_open(ns, r_ref.r, &rd);
+
+		// If the record moved while we were reading, this re-reads it.
+		as_storage_record_adopt_read(&rd, req);
+
+		read_local_continue(tr, &r_ref, &rd);
+	}
+
+	// Done - do what tsvc would have done had we not gone async.
+	as_partition_release(&tr->rsv);
+
+	if (tr->origin != FROM_BATCH) {
+		cf_free(tr->msgp);
+	}
+
+	cf_free(tr);
+}
+
+
+transaction_status
+read_local_continue(as_transaction* tr, as_index_ref* r_ref,
+		as_storage_rd* rd)
+{
+	as_msg* m = &tr->msgp->msg;
+	as_namespace* ns = tr->rsv.ns;
+	as_record* r = r_ref->r;
+
 	// Check the key if required.
 	// Note - for data-not-in-memory "exists" ops, key check is expensive!
 	if (as_transaction_has_key(tr) &&
-			as_storage_record_get_key(&rd) && ! check_msg_key(m, &rd)) {
-		read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_KEY_MISMATCH);
+			as_storage_record_get_key(rd) && ! check_msg_key(m, rd)) {
+		read_local_done(tr, r_ref, rd, AS_PROTO_RESULT_FAIL_KEY_MISMATCH);
 		return TRANS_DONE_ERROR;
 	}
 
@@ -334,34 +417,34 @@ read_local(as_transaction* tr)
 		tr->void_time = r->void_time;
 		tr->last_update_time = r->last_update_time;
 
-		read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_OK);
+		read_local_done(tr, r_ref, rd, AS_PROTO_RESULT_OK);
 		return TRANS_DONE_SUCCESS;
 	}
 
-	int result = as_storage_rd_load_n_bins(&rd);
+	int result = as_storage_rd_load_n_bins(rd);
 
 	if (result < 0) {
 		cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: failed as_storage_rd_load_n_bins() ", ns->name);
-		read_local_done(tr, &r_ref, &rd, -result);
+		read_local_done(tr, r_ref, rd, -result);
 		return TRANS_DONE_ERROR;
 	}
 
-	as_bin stack_bins[ns->storage_data_in_memory ? 0 : rd.n_bins];
+	as_bin stack_bins[ns->storage_data_in_memory ? 0 : rd->n_bins];
 
-	if ((result = as_storage_rd_load_bins(&rd, stack_bins)) < 0) {
+	if ((result = as_storage_rd_load_bins(rd, stack_bins)) < 0) {
 		cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: failed as_storage_rd_load_bins() ", ns->name);
-		read_local_done(tr, &r_ref, &rd, -result);
+		read_local_done(tr, r_ref, rd, -result);
 		return TRANS_DONE_ERROR;
 	}
 
-	if (! as_bin_inuse_has(&rd)) {
+	if (! as_bin_inuse_has(rd)) {
 		cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: found record with no bins ", ns->name);
-		read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_UNKNOWN);
+		read_local_done(tr, r_ref, rd, AS_PROTO_RESULT_FAIL_UNKNOWN);
 		return TRANS_DONE_ERROR;
 	}
 
 	uint32_t bin_count = (m->info1 & AS_MSG_INFO1_GET_ALL) != 0 ?
-			rd.n_bins : m->n_ops;
+			rd->n_bins : m->n_ops;
 
 	as_msg_op* ops[bin_count];
 	as_msg_op** p_ops = ops;
@@ -373,13 +456,13 @@ read_local(as_transaction* tr)
 
 	if ((m->info1 & AS_MSG_INFO1_GET_ALL) != 0) {
 		p_ops = NULL;
-		n_bins = as_bin_inuse_count(&rd);
-		as_bin_get_all_p(&rd, response_bins);
+		n_bins = as_bin_inuse_count(rd);
+		as_bin_get_all_p(rd, response_bins);
 	}
 	else {
 		if (m->n_ops == 0) {
 			cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: bin op(s) expected, none present ", ns->name);
-			read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_PARAMETER);
+			read_local_done(tr, r_ref, rd, AS_PROTO_RESULT_FAIL_PARAMETER);
 			return TRANS_DONE_ERROR;
 		}
 
@@ -390,7 +473,7 @@ read_local(as_transaction* tr)
 
 		while ((op = as_msg_op_iterate(m, op, &n)) != NULL) {
 			if (op->op == AS_MSG_OP_READ) {
-				as_bin* b = as_bin_get_from_buf(&rd, op->name, op->name_sz);
+				as_bin* b = as_bin_get_from_buf(rd, op->name, op->name_sz);
 
 				if (b || respond_all_ops) {
 					ops[n_bins] = op;
@@ -398,7 +481,7 @@ read_local(as_transaction* tr)
 				}
 			}
 			else if (op->op == AS_MSG_OP_CDT_READ) {
-				as_bin* b = as_bin_get_from_buf(&rd, op->name, op->name_sz);
+				as_bin* b = as_bin_get_from_buf(rd, op->name, op->name_sz);
 
 				if (b) {
 					as_bin* rb = &result_bins[n_result_bins];
@@ -407,7 +490,7 @@ read_local(as_transaction* tr)
 					if ((result = as_bin_cdt_read_from_client(b, op, rb)) < 0) {
 						cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: failed as_bin_cdt_read_from_client() ", ns->name);
 						destroy_stack_bins(result_bins, n_result_bins);
-						read_local_done(tr, &r_ref, &rd, -result);
+						read_local_done(tr, r_ref, rd, -result);
 						return TRANS_DONE_ERROR;
 					}
 
@@ -429,7 +512,7 @@ read_local(as_transaction* tr)
 			else {
 				cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: unexpected bin op %u ", ns->name, op->op);
 				destroy_stack_bins(result_bins, n_result_bins);
-				read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_PARAMETER);
+				read_local_done(tr, r_ref, rd, AS_PROTO_RESULT_FAIL_PARAMETER);
 				return TRANS_DONE_ERROR;
 			}
 		}
@@ -457,8 +540,8 @@ read_local(as_transaction* tr)
 	}
 
 	destroy_stack_bins(result_bins, n_result_bins);
-	as_storage_record_close(&rd);
-	as_record_done(&r_ref, ns);
+	as_storage_record_close(rd);
+	as_record_done(r_ref, ns);
 
 	// Now that we're not under the record lock, send the message we just built.
 	if (db.used_sz != 0) {
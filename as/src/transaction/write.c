@@ -541,7 +541,7 @@ write_master(rw_request* rw, as_transaction* tr)
 
 		// If it's an expired or truncated record, pretend it's a fresh create.
 		if (! record_created && as_record_is_doomed(r, ns)) {
-			as_record_rescue(&r_ref, ns);
+			as_record_rescue(tree, &r_ref, ns);
 			record_created = true;
 		}
 	}
@@ -573,6 +573,8 @@ write_master(rw_request* rw, as_transaction* tr)
 			return TRANS_DONE_ERROR;
 		}
 
+		as_index_set_index_insert(tree, &r_ref);
+
 		// Don't write record if it would be truncated.
 		if (as_truncate_now_is_truncated(ns, as_index_get_set_id(r))) {
 			write_master_failed(tr, &r_ref, record_created, tree, 0, AS_PROTO_RESULT_FAIL_FORBIDDEN);
@@ -39,6 +39,9 @@
 
 #define CF_ARENAX_BIGLOCK	(1 << 0)
 #define CF_ARENAX_CALLOC	(1 << 1)
+#define CF_ARENAX_HUGE_2M	(1 << 2) // back stages with 2M huge pages
+#define CF_ARENAX_HUGE_1G	(1 << 3) // back stages with 1G huge pages
+#define CF_ARENAX_INTERLEAVE (1 << 4) // interleave stages across NUMA nodes
 
 #ifndef CF_ARENAX_MAX_STAGES
 #define CF_ARENAX_MAX_STAGES 256
@@ -91,8 +94,27 @@ typedef struct cf_arenax_s {
 	// Current stages.
 	uint32_t			stage_count;
 	uint8_t*			stages[CF_ARENAX_MAX_STAGES];
+
+	// Per-stage usage, for draining sparse stages.
+	uint32_t			stage_n_used[CF_ARENAX_MAX_STAGES];
+	uint8_t				stage_states[CF_ARENAX_MAX_STAGES];
 } cf_arenax;
 
+// Stage states:
+#define STAGE_IN_USE	0
+#define STAGE_DRAINING	1 // elements freed here don't go on the free list
+#define STAGE_VACANT	2 // memory returned to OS, waiting to be end-allocated
+
+typedef struct cf_arenax_stats_s {
+	uint32_t	n_stages;			// stages holding memory
+	uint32_t	n_vacant_stages;	// stages whose memory was returned
+	uint64_t	n_slots;			// elements end-allocated in stages holding memory
+	uint64_t	n_used;				// elements allocated and not freed
+} cf_arenax_stats;
+
+// Return false to stop draining.
+typedef bool (*cf_arenax_drain_fn)(cf_arenax_handle h, void* udata);
+
 typedef struct free_element_s {
 	uint32_t			magic;
 	cf_arenax_handle	next_h;
@@ -116,6 +138,9 @@ void cf_arenax_free(cf_arenax* arena, cf_arenax_handle h);
 
 void* cf_arenax_resolve(cf_arenax* arena, cf_arenax_handle h);
 
+void cf_arenax_get_stats(cf_arenax* arena, cf_arenax_stats* stats);
+bool cf_arenax_drain(cf_arenax* arena, uint32_t lwm_pct, cf_arenax_drain_fn cb, void* udata);
+
 
 //==========================================================
 // Private API - for enterprise separation only.
@@ -129,3 +154,4 @@ cf_arenax_set_handle(cf_arenax_handle* h, uint32_t stage_id,
 }
 
 cf_arenax_err cf_arenax_add_stage(cf_arenax* arena);
+void cf_arenax_release_stage(cf_arenax* arena, uint32_t stage_id);
@@ -0,0 +1,78 @@
+/*
+ * uring.h
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+
+//==========================================================
+// Includes.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Opaque - wraps one kernel io_uring instance and its mapped rings.
+typedef struct cf_uring_s cf_uring;
+
+typedef struct cf_uring_cqe_s {
+	void* udata;
+	int32_t res; // bytes transferred, or -errno
+} cf_uring_cqe;
+
+
+//==========================================================
+// Public API.
+//
+
+// Returns NULL if the kernel doesn't support io_uring.
+cf_uring* cf_uring_create(uint32_t depth);
+void cf_uring_destroy(cf_uring* ring);
+
+// Any thread may submit. Returns false if the ring is full or submission
+// fails - caller should then fall back to a synchronous operation.
+bool cf_uring_read(cf_uring* ring, int fd, void* buf, uint32_t sz,
+		uint64_t offset, void* udata);
+bool cf_uring_recv(cf_uring* ring, int fd, void* buf, uint32_t sz,
+		void* udata);
+
+// Completes right away with res 0 - a way to wake the reaping thread.
+bool cf_uring_nop(cf_uring* ring, void* udata);
+
+// Only one thread may reap a given ring. If wait is true, blocks until at
+// least one completion is available.
+uint32_t cf_uring_reap(cf_uring* ring, cf_uring_cqe* cqes, uint32_t max_cqes,
+		bool wait);
+
+// Whether the kernel supports the operation - cf_uring_recv() also needs
+// fast poll, so idle sockets don't each park a kernel worker.
+bool cf_uring_supports_read(const cf_uring* ring);
+bool cf_uring_supports_recv(const cf_uring* ring);
+
+uint32_t cf_uring_n_inflight(const cf_uring* ring);
+
+// Readable (e.g. to epoll) while completions are waiting to be reaped.
+int cf_uring_fd(const cf_uring* ring);
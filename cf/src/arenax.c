@@ -51,6 +51,16 @@ const char* ARENAX_ERR_STRINGS[] = {
 };
 
 
+//==========================================================
+// Forward declarations.
+//
+
+static uint32_t pick_drain_stage(cf_arenax* arena, uint32_t lwm_pct);
+static void unlink_free_elements(cf_arenax* arena, uint32_t stage_id);
+static void relink_free_elements(cf_arenax* arena, uint32_t stage_id);
+static uint32_t stage_n_slots(const cf_arenax* arena, uint32_t stage_id);
+
+
 //==========================================================
 // Public API.
 //
@@ -114,6 +124,8 @@ cf_arenax_init(cf_arenax* arena, key_t key_base, uint32_t element_size,
 
 	arena->stage_count = 0;
 	memset(arena->stages, 0, sizeof(arena->stages));
+	memset(arena->stage_n_used, 0, sizeof(arena->stage_n_used));
+	memset(arena->stage_states, 0, sizeof(arena->stage_states));
 
 	// Add first stage.
 	if (cf_arenax_add_stage(arena) != CF_ARENAX_OK) {
@@ -145,7 +157,19 @@ cf_arenax_alloc(cf_arenax* arena)
 	// Otherwise keep end-allocating.
 	else {
 		if (arena->at_element_id >= arena->stage_capacity) {
-			if (cf_arenax_add_stage(arena) != CF_ARENAX_OK) {
+			uint32_t stage_id;
+
+			// Refill a drained stage before adding one.
+			for (stage_id = 1; stage_id < arena->stage_count; stage_id++) {
+				if (arena->stage_states[stage_id] == STAGE_VACANT) {
+					break;
+				}
+			}
+
+			if (stage_id < arena->stage_count) {
+				arena->stage_states[stage_id] = STAGE_IN_USE;
+			}
+			else if (cf_arenax_add_stage(arena) != CF_ARENAX_OK) {
 				if ((arena->flags & CF_ARENAX_BIGLOCK) != 0) {
 					pthread_mutex_unlock(&arena->lock);
 				}
@@ -153,7 +177,7 @@ cf_arenax_alloc(cf_arenax* arena)
 				return 0;
 			}
 
-			arena->at_stage_id++;
+			arena->at_stage_id = stage_id;
 			arena->at_element_id = 0;
 		}
 
@@ -162,6 +186,8 @@ cf_arenax_alloc(cf_arenax* arena)
 		arena->at_element_id++;
 	}
 
+	arena->stage_n_used[h >> ELEMENT_ID_NUM_BITS]++;
+
 	if ((arena->flags & CF_ARENAX_BIGLOCK) != 0) {
 		pthread_mutex_unlock(&arena->lock);
 	}
@@ -183,9 +209,16 @@ cf_arenax_free(cf_arenax* arena, cf_arenax_handle h)
 		pthread_mutex_lock(&arena->lock);
 	}
 
+	uint32_t stage_id = (uint32_t)(h >> ELEMENT_ID_NUM_BITS);
+
 	p_free_element->magic = FREE_MAGIC;
-	p_free_element->next_h = arena->free_h;
-	arena->free_h = h;
+	arena->stage_n_used[stage_id]--;
+
+	// A draining stage's free elements are relinked if it isn't emptied.
+	if (arena->stage_states[stage_id] != STAGE_DRAINING) {
+		p_free_element->next_h = arena->free_h;
+		arena->free_h = h;
+	}
 
 	if ((arena->flags & CF_ARENAX_BIGLOCK) != 0) {
 		pthread_mutex_unlock(&arena->lock);
@@ -199,3 +232,192 @@ cf_arenax_resolve(cf_arenax* arena, cf_arenax_handle h)
 	return arena->stages[h >> ELEMENT_ID_NUM_BITS] +
 			((h & ELEMENT_ID_MASK) * arena->element_size);
 }
+
+// Get element counts, for fragmentation stats.
+void
+cf_arenax_get_stats(cf_arenax* arena, cf_arenax_stats* stats)
+{
+	memset(stats, 0, sizeof(cf_arenax_stats));
+
+	if ((arena->flags & CF_ARENAX_BIGLOCK) != 0) {
+		pthread_mutex_lock(&arena->lock);
+	}
+
+	for (uint32_t stage_id = 0; stage_id < arena->stage_count; stage_id++) {
+		if (arena->stage_states[stage_id] == STAGE_VACANT) {
+			stats->n_vacant_stages++;
+			continue;
+		}
+
+		stats->n_stages++;
+		stats->n_slots += stage_n_slots(arena, stage_id);
+		stats->n_used += arena->stage_n_used[stage_id];
+	}
+
+	if ((arena->flags & CF_ARENAX_BIGLOCK) != 0) {
+		pthread_mutex_unlock(&arena->lock);
+	}
+}
+
+// Try to empty the emptiest stage with less than lwm_pct of its elements used,
+// and return its memory to the OS. Callback is made (without the arena lock)
+// for every element in the stage not known to be free - it must move live ones
+// to newly allocated elements and free the old ones, or leave them. Elements
+// can't be allocated from the stage meanwhile. Returns true if stage emptied.
+bool
+cf_arenax_drain(cf_arenax* arena, uint32_t lwm_pct, cf_arenax_drain_fn cb,
+		void* udata)
+{
+	if ((arena->flags & CF_ARENAX_BIGLOCK) == 0) {
+		cf_crash(CF_ARENAX, "can't drain arena without big lock");
+	}
+
+	pthread_mutex_lock(&arena->lock);
+
+	uint32_t stage_id = pick_drain_stage(arena, lwm_pct);
+
+	if (stage_id == 0) {
+		pthread_mutex_unlock(&arena->lock);
+		return false;
+	}
+
+	arena->stage_states[stage_id] = STAGE_DRAINING;
+	unlink_free_elements(arena, stage_id);
+
+	pthread_mutex_unlock(&arena->lock);
+
+	uint8_t* stage = arena->stages[stage_id];
+
+	// Racy check of usage is fine - it only goes down.
+	for (uint32_t i = 0; i < arena->stage_capacity &&
+			arena->stage_n_used[stage_id] != 0; i++) {
+		free_element* p_element =
+				(free_element*)(stage + (size_t)i * arena->element_size);
+
+		// Nothing is allocated from a draining stage - once free, stays free.
+		if (((volatile free_element*)p_element)->magic == FREE_MAGIC) {
+			continue;
+		}
+
+		cf_arenax_handle h;
+
+		cf_arenax_set_handle(&h, stage_id, i);
+
+		if (! cb(h, udata)) {
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&arena->lock);
+
+	bool emptied = arena->stage_n_used[stage_id] == 0;
+
+	if (emptied) {
+		cf_arenax_release_stage(arena, stage_id);
+		arena->stage_states[stage_id] = STAGE_VACANT;
+	}
+	else {
+		relink_free_elements(arena, stage_id);
+		arena->stage_states[stage_id] = STAGE_IN_USE;
+	}
+
+	pthread_mutex_unlock(&arena->lock);
+
+	return emptied;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Called with arena locked. Picks the emptiest eligible stage, if the other
+// stages have room for its elements. Never stage 0 (has the null element), nor
+// the stage being end-allocated. Returns 0 if there's none.
+static uint32_t
+pick_drain_stage(cf_arenax* arena, uint32_t lwm_pct)
+{
+	uint32_t best_id = 0;
+	uint64_t n_free = 0;
+
+	for (uint32_t stage_id = 0; stage_id < arena->stage_count; stage_id++) {
+		if (arena->stage_states[stage_id] != STAGE_IN_USE) {
+			continue;
+		}
+
+		uint32_t n_used = arena->stage_n_used[stage_id];
+
+		n_free += stage_n_slots(arena, stage_id) - n_used;
+
+		if (stage_id == 0 || stage_id == arena->at_stage_id) {
+			continue;
+		}
+
+		if ((uint64_t)n_used * 100 < (uint64_t)arena->stage_capacity * lwm_pct &&
+				(best_id == 0 || n_used < arena->stage_n_used[best_id])) {
+			best_id = stage_id;
+		}
+	}
+
+	if (best_id == 0) {
+		return 0;
+	}
+
+	uint32_t n_used = arena->stage_n_used[best_id];
+
+	// Moving its elements would need a new stage - no point.
+	if (n_free - (stage_n_slots(arena, best_id) - n_used) +
+			(arena->stage_capacity - arena->at_element_id) < n_used) {
+		return 0;
+	}
+
+	return best_id;
+}
+
+// Called with arena locked. Takes a stage's elements off the free list - walks
+// the whole list.
+static void
+unlink_free_elements(cf_arenax* arena, uint32_t stage_id)
+{
+	cf_arenax_handle* p_h = &arena->free_h;
+
+	while (*p_h != 0) {
+		free_element* p_free_element = cf_arenax_resolve(arena, *p_h);
+
+		if ((*p_h >> ELEMENT_ID_NUM_BITS) == stage_id) {
+			*p_h = p_free_element->next_h;
+		}
+		else {
+			p_h = &p_free_element->next_h;
+		}
+	}
+}
+
+// Called with arena locked. Puts a stage's free elements back on the free list.
+static void
+relink_free_elements(cf_arenax* arena, uint32_t stage_id)
+{
+	for (uint32_t i = 0; i < arena->stage_capacity; i++) {
+		cf_arenax_handle h;
+
+		cf_arenax_set_handle(&h, stage_id, i);
+
+		free_element* p_free_element = cf_arenax_resolve(arena, h);
+
+		if (p_free_element->magic == FREE_MAGIC) {
+			p_free_element->next_h = arena->free_h;
+			arena->free_h = h;
+		}
+	}
+}
+
+// Called with arena locked. Elements ever allocated in a stage, excluding the
+// null element.
+static uint32_t
+stage_n_slots(const cf_arenax* arena, uint32_t stage_id)
+{
+	uint32_t n_slots = stage_id == arena->at_stage_id ?
+			arena->at_element_id : arena->stage_capacity;
+
+	return stage_id == 0 ? n_slots - 1 : n_slots;
+}
@@ -26,9 +26,48 @@
 
 #include "arenax.h"
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "citrusleaf/alloc.h"
 #include "fault.h"
+#include "hardware.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Older headers may not have these.
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define HUGE_2M_SIZE (2UL * 1024 * 1024)
+#define HUGE_1G_SIZE (1024UL * 1024 * 1024)
+
+#define MAP_STAGE_FLAGS \
+	(CF_ARENAX_HUGE_2M | CF_ARENAX_HUGE_1G | CF_ARENAX_INTERLEAVE)
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static uint8_t* map_stage(cf_arenax* arena);
+static size_t map_size(const cf_arenax* arena);
 
 
 //==========================================================
@@ -45,7 +84,8 @@ cf_arenax_add_stage(cf_arenax* arena)
 		return CF_ARENAX_ERR_STAGE_CREATE;
 	}
 
-	uint8_t* p_stage = (uint8_t*)cf_try_malloc(arena->stage_size);
+	uint8_t* p_stage = (arena->flags & MAP_STAGE_FLAGS) != 0 ?
+			map_stage(arena) : (uint8_t*)cf_try_malloc(arena->stage_size);
 
 	if (! p_stage) {
 		cf_warning(CF_ARENAX, "could not allocate %zu-byte arena stage %u",
@@ -57,3 +97,94 @@ cf_arenax_add_stage(cf_arenax* arena)
 
 	return CF_ARENAX_OK;
 }
+
+// Return an emptied stage's memory to the OS. The stage stays mapped - gets
+// may still read it without the sprig lock - and is zero-filled if reused.
+void
+cf_arenax_release_stage(cf_arenax* arena, uint32_t stage_id)
+{
+	uint64_t start = (uint64_t)arena->stages[stage_id];
+	uint64_t end;
+
+	if ((arena->flags & MAP_STAGE_FLAGS) != 0) {
+		end = start + map_size(arena);
+	}
+	else {
+		// A malloc'd stage needn't be page aligned - release pages within.
+		uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+
+		end = (start + arena->stage_size) & ~(page_size - 1);
+		start = (start + page_size - 1) & ~(page_size - 1);
+	}
+
+	if (end > start && madvise((void*)start, end - start, MADV_DONTNEED) != 0) {
+		cf_warning(CF_ARENAX, "failed to release arena stage %u memory: %s",
+				stage_id, cf_strerror(errno));
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Map a stage directly, to control its page size and NUMA placement. Stages
+// are never unmapped, only released - there's no matching unmap.
+static uint8_t*
+map_stage(cf_arenax* arena)
+{
+	bool huge_1g = (arena->flags & CF_ARENAX_HUGE_1G) != 0;
+	bool huge = huge_1g || (arena->flags & CF_ARENAX_HUGE_2M) != 0;
+	size_t size = map_size(arena);
+
+	void* p = MAP_FAILED;
+
+	if (huge) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+				(huge_1g ? MAP_HUGE_1GB : MAP_HUGE_2MB), -1, 0);
+
+		if (p == MAP_FAILED) {
+			// Typically no (or not enough) huge pages reserved - see
+			// /proc/sys/vm/nr_hugepages.
+			cf_warning(CF_ARENAX, "no %s huge pages for arena stage %u - falling back to transparent huge pages",
+					huge_1g ? "1G" : "2M", arena->stage_count);
+		}
+	}
+
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+
+		if (huge) {
+			// Best effort - ignored if THP is disabled.
+			madvise(p, size, MADV_HUGEPAGE);
+		}
+	}
+
+	// Must precede first touch - policy applies when pages fault in.
+	if ((arena->flags & CF_ARENAX_INTERLEAVE) != 0) {
+		cf_topo_interleave_memory(p, size);
+	}
+
+	return (uint8_t*)p;
+}
+
+// Stage size rounded up to whole huge pages, if any.
+static size_t
+map_size(const cf_arenax* arena)
+{
+	if ((arena->flags & CF_ARENAX_HUGE_1G) != 0) {
+		return (arena->stage_size + HUGE_1G_SIZE - 1) & ~(HUGE_1G_SIZE - 1);
+	}
+
+	if ((arena->flags & CF_ARENAX_HUGE_2M) != 0) {
+		return (arena->stage_size + HUGE_2M_SIZE - 1) & ~(HUGE_2M_SIZE - 1);
+	}
+
+	return arena->stage_size;
+}
@@ -1744,6 +1744,31 @@ cf_topo_force_map_memory(const uint8_t *from, size_t size)
 	}
 }
 
+// Spread the (not yet touched) pages of a mapping evenly across NUMA nodes, so
+// memory bandwidth and remote-access latency are evenly spread too.
+void
+cf_topo_interleave_memory(void *from, size_t size)
+{
+	// If we're pinned to a NUMA node, memory already comes from there.
+	if (g_i_numa_node != INVALID_INDEX || g_n_numa_nodes < 2 || size == 0) {
+		return;
+	}
+
+	uint64_t node_mask = 0;
+
+	for (cf_topo_numa_node_index i_numa_node = 0; i_numa_node < g_n_numa_nodes; ++i_numa_node) {
+		node_mask |= 1UL << g_numa_node_index_to_os_numa_node_index[i_numa_node];
+	}
+
+	cf_detail(CF_HARDWARE, "NUMA node mask (interleave): %016" PRIx64, node_mask);
+
+	// Unlike select(), we have to pass "number of valid bits + 1".
+	if (syscall(__NR_mbind, from, size, MPOL_INTERLEAVE, &node_mask, 65, 0) < 0) {
+		cf_warning(CF_HARDWARE, "mbind() system call failed: %d (%s)",
+				errno, cf_strerror(errno));
+	}
+}
+
 void
 cf_topo_migrate_memory(void)
 {
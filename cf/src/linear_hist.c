@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
 
 #include "dynbuf.h"
 #include "fault.h"
@@ -196,7 +197,8 @@ linear_hist_insert_data_point(linear_hist *h, uint32_t point)
 		}
 	}
 
-	h->counts[bucket]++;
+	// Atomic - callers may insert concurrently, e.g. from parallel reduces.
+	cf_atomic64_incr((cf_atomic64*)&h->counts[bucket]);
 }
 
 //------------------------------------------------
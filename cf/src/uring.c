@@ -0,0 +1,415 @@
+/*
+ * uring.c
+ *
+ * Copyright (C) 2018 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "uring.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+
+#include "cf_mutex.h"
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+struct cf_uring_s {
+	int fd;
+	uint32_t depth;
+	cf_atomic32 n_inflight;
+
+	// What the kernel can do - probed at creation.
+	bool read_ok;
+	bool recv_ok;
+
+	cf_mutex sq_lock;
+
+	// Submission queue - shared with kernel.
+	uint32_t* sq_head;
+	uint32_t* sq_tail;
+	uint32_t sq_mask;
+	uint32_t* sq_array;
+	struct io_uring_sqe* sqes;
+
+	// Completion queue - shared with kernel.
+	uint32_t* cq_head;
+	uint32_t* cq_tail;
+	uint32_t cq_mask;
+	struct io_uring_cqe* cqes;
+
+	// For unmapping.
+	void* sq_ring;
+	size_t sq_ring_sz;
+	void* cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void probe_ops(cf_uring* ring, uint32_t features);
+static bool submit_one(cf_uring* ring, uint8_t opcode, int fd, void* addr,
+		uint32_t len, uint64_t offset, void* udata);
+
+
+//==========================================================
+// Inlines & macros.
+//
+
+static inline int
+sys_uring_setup(uint32_t entries, struct io_uring_params* params)
+{
+	return (int)syscall(SYS_io_uring_setup, entries, params);
+}
+
+static inline int
+sys_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+		uint32_t flags)
+{
+	return (int)syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags,
+			NULL, 0);
+}
+
+static inline int
+sys_uring_register(int fd, uint32_t opcode, void* arg, uint32_t nr_args)
+{
+	return (int)syscall(SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Max opcodes a probe reports on.
+#define PROBE_N_OPS 256
+
+#define load_acquire(__p) __atomic_load_n(__p, __ATOMIC_ACQUIRE)
+#define store_release(__p, __v) __atomic_store_n(__p, __v, __ATOMIC_RELEASE)
+
+
+//==========================================================
+// Public API.
+//
+
+cf_uring*
+cf_uring_create(uint32_t depth)
+{
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+
+	int fd = sys_uring_setup(depth, &params);
+
+	if (fd < 0) {
+		cf_warning(CF_MISC, "io_uring setup failed: errno %d (%s)", errno,
+				cf_strerror(errno));
+		return NULL;
+	}
+
+	cf_uring* ring = cf_malloc(sizeof(cf_uring));
+
+	memset(ring, 0, sizeof(cf_uring));
+
+	ring->fd = fd;
+	ring->depth = params.sq_entries;
+	cf_mutex_init(&ring->sq_lock);
+
+	ring->sq_ring_sz = params.sq_off.array +
+			(params.sq_entries * sizeof(uint32_t));
+	ring->cq_ring_sz = params.cq_off.cqes +
+			(params.cq_entries * sizeof(struct io_uring_cqe));
+
+	bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+	if (single_mmap && ring->cq_ring_sz > ring->sq_ring_sz) {
+		ring->sq_ring_sz = ring->cq_ring_sz;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+	if (ring->sq_ring == MAP_FAILED) {
+		cf_warning(CF_MISC, "io_uring sq ring mmap failed: errno %d (%s)",
+				errno, cf_strerror(errno));
+		close(fd);
+		cf_free(ring);
+		return NULL;
+	}
+
+	if (single_mmap) {
+		ring->cq_ring = ring->sq_ring;
+		ring->cq_ring_sz = 0; // don't unmap twice
+	}
+	else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+		if (ring->cq_ring == MAP_FAILED) {
+			cf_warning(CF_MISC, "io_uring cq ring mmap failed: errno %d (%s)",
+					errno, cf_strerror(errno));
+			munmap(ring->sq_ring, ring->sq_ring_sz);
+			close(fd);
+			cf_free(ring);
+			return NULL;
+		}
+	}
+
+	ring->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (ring->sqes == MAP_FAILED) {
+		cf_warning(CF_MISC, "io_uring sqes mmap failed: errno %d (%s)",
+				errno, cf_strerror(errno));
+
+		if (ring->cq_ring_sz != 0) {
+			munmap(ring->cq_ring, ring->cq_ring_sz);
+		}
+
+		munmap(ring->sq_ring, ring->sq_ring_sz);
+		close(fd);
+		cf_free(ring);
+		return NULL;
+	}
+
+	uint8_t* sq = (uint8_t*)ring->sq_ring;
+
+	ring->sq_head = (uint32_t*)(sq + params.sq_off.head);
+	ring->sq_tail = (uint32_t*)(sq + params.sq_off.tail);
+	ring->sq_mask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (uint32_t*)(sq + params.sq_off.array);
+
+	uint8_t* cq = (uint8_t*)ring->cq_ring;
+
+	ring->cq_head = (uint32_t*)(cq + params.cq_off.head);
+	ring->cq_tail = (uint32_t*)(cq + params.cq_off.tail);
+	ring->cq_mask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	probe_ops(ring, params.features);
+
+	return ring;
+}
+
+
+void
+cf_uring_destroy(cf_uring* ring)
+{
+	munmap(ring->sqes, ring->sqes_sz);
+
+	if (ring->cq_ring_sz != 0) {
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+	}
+
+	munmap(ring->sq_ring, ring->sq_ring_sz);
+	close(ring->fd);
+	cf_free(ring);
+}
+
+
+bool
+cf_uring_read(cf_uring* ring, int fd, void* buf, uint32_t sz, uint64_t offset,
+		void* udata)
+{
+	return submit_one(ring, IORING_OP_READ, fd, buf, sz, offset, udata);
+}
+
+
+bool
+cf_uring_recv(cf_uring* ring, int fd, void* buf, uint32_t sz, void* udata)
+{
+	return submit_one(ring, IORING_OP_RECV, fd, buf, sz, 0, udata);
+}
+
+
+bool
+cf_uring_nop(cf_uring* ring, void* udata)
+{
+	return submit_one(ring, IORING_OP_NOP, -1, NULL, 0, 0, udata);
+}
+
+
+uint32_t
+cf_uring_reap(cf_uring* ring, cf_uring_cqe* cqes, uint32_t max_cqes, bool wait)
+{
+	uint32_t head = *ring->cq_head;
+
+	if (wait && head == load_acquire(ring->cq_tail)) {
+		// Interrupted or not, caller will just see zero completions.
+		sys_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+	}
+
+	uint32_t tail = load_acquire(ring->cq_tail);
+	uint32_t n_cqes = 0;
+
+	while (head != tail && n_cqes < max_cqes) {
+		struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+
+		cqes[n_cqes].udata = (void*)cqe->user_data;
+		cqes[n_cqes].res = cqe->res;
+
+		n_cqes++;
+		head++;
+	}
+
+	store_release(ring->cq_head, head);
+
+	if (n_cqes != 0) {
+		cf_atomic32_sub(&ring->n_inflight, n_cqes);
+	}
+
+	return n_cqes;
+}
+
+
+bool
+cf_uring_supports_read(const cf_uring* ring)
+{
+	return ring->read_ok;
+}
+
+
+bool
+cf_uring_supports_recv(const cf_uring* ring)
+{
+	return ring->recv_ok;
+}
+
+
+uint32_t
+cf_uring_n_inflight(const cf_uring* ring)
+{
+	return cf_atomic32_get(ring->n_inflight);
+}
+
+
+int
+cf_uring_fd(const cf_uring* ring)
+{
+	return ring->fd;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static void
+probe_ops(cf_uring* ring, uint32_t features)
+{
+	size_t probe_sz = sizeof(struct io_uring_probe) +
+			(PROBE_N_OPS * sizeof(struct io_uring_probe_op));
+	struct io_uring_probe* probe = cf_malloc(probe_sz);
+
+	memset(probe, 0, probe_sz);
+
+	// Probing arrived with the first usable opcodes (5.6) - older kernels fail
+	// here, and support nothing we use.
+	if (sys_uring_register(ring->fd, IORING_REGISTER_PROBE, probe,
+			PROBE_N_OPS) < 0) {
+		cf_info(CF_MISC, "io_uring probe failed: errno %d (%s)", errno,
+				cf_strerror(errno));
+		cf_free(probe);
+		return;
+	}
+
+	bool ops_ok[PROBE_N_OPS] = { false };
+
+	for (uint32_t i = 0; i < probe->ops_len && i < PROBE_N_OPS; i++) {
+		if ((probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0) {
+			ops_ok[probe->ops[i].op] = true;
+		}
+	}
+
+	cf_free(probe);
+
+	ring->read_ok = ops_ok[IORING_OP_READ];
+
+	// Without fast poll (5.7), a recv on an idle socket parks a kernel worker
+	// thread until data arrives.
+	ring->recv_ok = ops_ok[IORING_OP_RECV] && ops_ok[IORING_OP_NOP] &&
+			(features & IORING_FEAT_FAST_POLL) != 0;
+}
+
+static bool
+submit_one(cf_uring* ring, uint8_t opcode, int fd, void* addr, uint32_t len,
+		uint64_t offset, void* udata)
+{
+	// Bounding in-flight operations by the SQ size also guarantees the CQ
+	// (which the kernel sizes at twice the SQ) can never overflow.
+	if ((uint32_t)cf_atomic32_incr(&ring->n_inflight) > ring->depth) {
+		cf_atomic32_decr(&ring->n_inflight);
+		return false;
+	}
+
+	cf_mutex_lock(&ring->sq_lock);
+
+	uint32_t tail = *ring->sq_tail;
+	uint32_t ix = tail & ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[ix];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)addr;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = (uint64_t)udata;
+
+	ring->sq_array[ix] = ix;
+	store_release(ring->sq_tail, tail + 1);
+
+	int rv = sys_uring_enter(ring->fd, 1, 0, 0);
+
+	// If the kernel consumed the entry it's in flight, whatever rv says.
+	if (rv != 1 && load_acquire(ring->sq_head) == tail) {
+		// Kernel didn't consume the entry - take it back.
+		store_release(ring->sq_tail, tail);
+
+		cf_mutex_unlock(&ring->sq_lock);
+		cf_atomic32_decr(&ring->n_inflight);
+
+		cf_warning(CF_MISC, "io_uring submit failed: rv %d errno %d (%s)", rv,
+				errno, cf_strerror(errno));
+		return false;
+	}
+
+	cf_mutex_unlock(&ring->sq_lock);
+
+	return true;
+}